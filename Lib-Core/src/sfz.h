@@ -715,6 +715,72 @@ sfz_extern_c void* __cdecl memset(void* _Dst, i32 _Val, u64 _Size);
 #endif
 
 
+// Bit helpers
+// ------------------------------------------------------------------------------------------------
+
+// The compiler intrinsics we need from intrin.h are forward declared, similar to the math functions
+// above. POPCNT is not part of the x64 baseline, so __popcnt64() is only used when it is known to
+// be available (every AVX2 capable cpu has it). tzcnt is not used at all, it requires BMI1.
+
+#if defined(_MSC_VER)
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(_M_ARM64)
+#define SFZ_BITS_BSF
+sfz_extern_c unsigned char _BitScanForward64(unsigned long* _Index, unsigned __int64 _Mask);
+#pragma intrinsic(_BitScanForward64)
+#endif
+
+#if (defined(_M_X64) || defined(_M_AMD64)) && (defined(__AVX2__) || defined(__POPCNT__))
+#define SFZ_BITS_POPCNT
+sfz_extern_c unsigned __int64 __popcnt64(unsigned __int64 _Value);
+#pragma intrinsic(__popcnt64)
+#elif defined(_M_ARM64)
+#define SFZ_BITS_POPCNT
+sfz_extern_c unsigned int _CountOneBits64(unsigned __int64 _Value);
+#pragma intrinsic(_CountOneBits64)
+#endif
+
+#else
+#error "Not implemented for this compiler"
+#endif
+
+// Returns the index of the lowest set bit. Undefined if v is 0.
+sfz_forceinline u32 sfzBitsCtz64(u64 v)
+{
+	sfz_assert(v != 0);
+#if defined(SFZ_BITS_BSF)
+	unsigned long idx = 0;
+	_BitScanForward64(&idx, v);
+	return u32(idx);
+#else
+	// De Bruijn multiplication
+	sfz_constant u64 DEBRUIJN = 0x03F79D71B4CB0A89ull;
+	sfz_constant u8 TABLE[64] = {
+		0, 1, 48, 2, 57, 49, 28, 3, 61, 58, 50, 42, 38, 29, 17, 4,
+		62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12, 5,
+		63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
+		46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19, 9, 13, 8, 7, 6
+	};
+	return TABLE[((v & (~v + 1)) * DEBRUIJN) >> 58];
+#endif
+}
+
+// Returns the number of set bits.
+sfz_forceinline u32 sfzBitsPopCount64(u64 v)
+{
+#if defined(SFZ_BITS_POPCNT) && defined(_M_ARM64)
+	return _CountOneBits64(v);
+#elif defined(SFZ_BITS_POPCNT)
+	return u32(__popcnt64(v));
+#else
+	v = v - ((v >> 1) & 0x5555555555555555ull);
+	v = (v & 0x3333333333333333ull) + ((v >> 2) & 0x3333333333333333ull);
+	v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+	return u32((v * 0x0101010101010101ull) >> 56);
+#endif
+}
+
+
 // Debug information
 // ------------------------------------------------------------------------------------------------
 
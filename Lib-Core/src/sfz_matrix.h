@@ -21,6 +21,7 @@
 #pragma once
 
 #include "sfz.h"
+#include "sfz_simd.h"
 
 // Matrix 3x3 Operators
 // ------------------------------------------------------------------------------------------------
@@ -63,7 +64,11 @@ constexpr f32x3 operator* (SfzMat33 m, f32x3 v)
 constexpr SfzMat44& operator+= (SfzMat44& lhs, const SfzMat44& rhs) { for (u32 y = 0; y < 4; y++) { lhs.rows[y] += rhs.rows[y]; } return lhs; }
 constexpr SfzMat44& operator-= (SfzMat44& lhs, const SfzMat44& rhs) { for (u32 y = 0; y < 4; y++) { lhs.rows[y] -= rhs.rows[y]; } return lhs; }
 constexpr SfzMat44& operator*= (SfzMat44& lhs, f32 s) { for (u32 y = 0; y < 4; y++) { lhs.rows[y] *= s; } return lhs; }
-constexpr SfzMat44 operator* (SfzMat44 lhs, SfzMat44 rhs)
+
+// Scalar versions of the operations that have a SIMD version (see sfz_simd.h). These are always
+// used when SFZ_SIMD is not enabled, and are mainly exposed so that the SIMD versions can be tested
+// against them.
+constexpr SfzMat44 sfzMat44MulScalar(SfzMat44 lhs, SfzMat44 rhs)
 {
 	SfzMat44 res = {};
 	for (u32 y = 0; y < 4; y++) {
@@ -75,6 +80,19 @@ constexpr SfzMat44 operator* (SfzMat44 lhs, SfzMat44 rhs)
 	}
 	return res;
 }
+constexpr f32x4 sfzMat44MulVecScalar(SfzMat44 m, f32x4 v)
+{
+	return f32x4_init(
+		f32x4_dot(m.rows[0], v), f32x4_dot(m.rows[1], v), f32x4_dot(m.rows[2], v), f32x4_dot(m.rows[3], v));
+}
+
+constexpr SfzMat44 operator* (SfzMat44 lhs, SfzMat44 rhs)
+{
+#if defined(SFZ_SIMD_ENABLED)
+	if (!sfz_is_constant_evaluated()) return sfzSimdMat44Mul(lhs, rhs);
+#endif
+	return sfzMat44MulScalar(lhs, rhs);
+}
 constexpr SfzMat44& operator*= (SfzMat44& lhs, const SfzMat44& rhs) { return (lhs = lhs * rhs); }
 constexpr SfzMat44 operator* (SfzMat44 lhs, f32 rhs) { return (lhs *= rhs); }
 constexpr SfzMat44 operator* (f32 lhs, SfzMat44 rhs) { return rhs * lhs; }
@@ -83,8 +101,10 @@ constexpr SfzMat44 operator- (SfzMat44 lhs, SfzMat44 rhs) { return (lhs -= rhs);
 constexpr SfzMat44 operator- (SfzMat44 m) { return (m *= -1.0f); }
 constexpr f32x4 operator* (SfzMat44 m, f32x4 v)
 {
-	return f32x4_init(
-		f32x4_dot(m.rows[0], v), f32x4_dot(m.rows[1], v), f32x4_dot(m.rows[2], v), f32x4_dot(m.rows[3], v));
+#if defined(SFZ_SIMD_ENABLED)
+	if (!sfz_is_constant_evaluated()) return sfzSimdF32x4Store(sfzSimdMat44MulVec(m, sfzSimdF32x4Load(v)));
+#endif
+	return sfzMat44MulVecScalar(m, v);
 }
 
 #endif
@@ -233,8 +253,66 @@ inline SfzMat44 sfzMat44Rotation3(f32x3 axis, f32 angleRad)
 		0.0f, 0.0f, 0.0f, 1.0f);
 }
 
-constexpr f32x3 sfzMat44TransformPoint(SfzMat44 m, f32x3 p) { const f32x4 v = m * f32x4_init3(p, 1.0f); return v.xyz() / v.w; }
-constexpr f32x3 sfzMat44TransformDir(SfzMat44 m, f32x3 d) { const f32x4 v = m * f32x4_init3(d, 0.0f); return v.xyz(); }
+constexpr f32x3 sfzMat44TransformPointScalar(SfzMat44 m, f32x3 p)
+{
+	const f32x4 v = sfzMat44MulVecScalar(m, f32x4_init3(p, 1.0f));
+	return v.xyz() / v.w;
+}
+
+constexpr f32x3 sfzMat44TransformPoint(SfzMat44 m, f32x3 p)
+{
+#if defined(SFZ_SIMD_ENABLED)
+	if (!sfz_is_constant_evaluated()) return sfzSimdMat44TransformPoint(m, p);
+#endif
+	return sfzMat44TransformPointScalar(m, p);
+}
+
+constexpr f32x3 sfzMat44TransformDirScalar(SfzMat44 m, f32x3 d)
+{
+	const f32x4 v = sfzMat44MulVecScalar(m, f32x4_init3(d, 0.0f));
+	return v.xyz();
+}
+
+constexpr f32x3 sfzMat44TransformDir(SfzMat44 m, f32x3 d)
+{
+#if defined(SFZ_SIMD_ENABLED)
+	if (!sfz_is_constant_evaluated()) return sfzSimdMat44TransformDir(m, d);
+#endif
+	return sfzMat44TransformDirScalar(m, d);
+}
+
+// Transforms num points (see sfzMat44TransformPoint()) from src and writes them tightly packed to
+// dst. src_stride is the number of bytes between points in src, so they can be read directly from
+// an array of larger structs (e.g. vertices). Same results as calling sfzMat44TransformPoint() in a
+// loop, but faster with SFZ_SIMD.
+inline void sfzMat44TransformPoints(
+	const SfzMat44& m, f32x3* __restrict dst, const f32x3* __restrict src, u64 src_stride, u64 num)
+{
+	sfz_assert(src_stride >= sizeof(f32x3));
+#if defined(SFZ_SIMD_ENABLED)
+	sfzSimdMat44TransformBatch<true>(m, dst, src, src_stride, num);
+#else
+	const u8* src_bytes = reinterpret_cast<const u8*>(src);
+	for (u64 i = 0; i < num; i++) {
+		dst[i] = sfzMat44TransformPoint(m, *reinterpret_cast<const f32x3*>(src_bytes + i * src_stride));
+	}
+#endif
+}
+
+// Same as sfzMat44TransformPoints(), but for directions, see sfzMat44TransformDir().
+inline void sfzMat44TransformDirs(
+	const SfzMat44& m, f32x3* __restrict dst, const f32x3* __restrict src, u64 src_stride, u64 num)
+{
+	sfz_assert(src_stride >= sizeof(f32x3));
+#if defined(SFZ_SIMD_ENABLED)
+	sfzSimdMat44TransformBatch<false>(m, dst, src, src_stride, num);
+#else
+	const u8* src_bytes = reinterpret_cast<const u8*>(src);
+	for (u64 i = 0; i < num; i++) {
+		dst[i] = sfzMat44TransformDir(m, *reinterpret_cast<const f32x3*>(src_bytes + i * src_stride));
+	}
+#endif
+}
 
 constexpr SfzMat44 sfzMat44Transpose(SfzMat44 m)
 {
@@ -264,43 +342,57 @@ constexpr f32 sfzMat44Determinant(SfzMat44 m)
 		e0[3] * e1[0] * e2[1] * e3[2] - e0[3] * e1[1] * e2[2] * e3[0] - e0[3] * e1[2] * e2[0] * e3[1];
 }
 
-constexpr SfzMat44 sfzMat44Inverse(SfzMat44 m)
+// Inverse using the Laplace expansion theorem, i.e. using the 2x2 determinants of the upper two rows
+// (s0-s5) and of the lower two rows (c0-c5). See "The Laplace Expansion Theorem: Computing the
+// Determinants and Inverses of Matrices" by David Eberly. Returns a zero matrix if m is singular.
+constexpr SfzMat44 sfzMat44InverseScalar(SfzMat44 m)
 {
-	const f32 det = sfzMat44Determinant(m);
-	SfzMat44 res = {};
-	if (det == 0) res;
-
 	const f32
 		m00 = m.rows[0][0], m01 = m.rows[0][1], m02 = m.rows[0][2], m03 = m.rows[0][3],
 		m10 = m.rows[1][0], m11 = m.rows[1][1], m12 = m.rows[1][2], m13 = m.rows[1][3],
 		m20 = m.rows[2][0], m21 = m.rows[2][1], m22 = m.rows[2][2], m23 = m.rows[2][3],
 		m30 = m.rows[3][0], m31 = m.rows[3][1], m32 = m.rows[3][2], m33 = m.rows[3][3];
 
-	const f32 b00 = m11*m22*m33 + m12*m23*m31 + m13*m21*m32 - m11*m23*m32 - m12*m21*m33 - m13*m22*m31;
-	const f32 b01 = m01*m23*m32 + m02*m21*m33 + m03*m22*m31 - m01*m22*m33 - m02*m23*m31 - m03*m21*m32;
-	const f32 b02 = m01*m12*m33 + m02*m13*m31 + m03*m11*m32 - m01*m13*m32 - m02*m11*m33 - m03*m12*m31;
-	const f32 b03 = m01*m13*m22 + m02*m11*m23 + m03*m12*m21 - m01*m12*m23 - m02*m13*m21 - m03*m11*m22;
-	const f32 b10 = m10*m23*m32 + m12*m20*m33 + m13*m22*m30 - m10*m22*m33 - m12*m23*m30 - m13*m20*m32;
-	const f32 b11 = m00*m22*m33 + m02*m23*m30 + m03*m20*m32 - m00*m23*m32 - m02*m20*m33 - m03*m22*m30;
-	const f32 b12 = m00*m13*m32 + m02*m10*m33 + m03*m12*m30 - m00*m12*m33 - m02*m13*m30 - m03*m10*m32;
-	const f32 b13 = m00*m12*m23 + m02*m13*m20 + m03*m10*m22 - m00*m13*m22 - m02*m10*m23 - m03*m12*m20;
-	const f32 b20 = m10*m21*m33 + m11*m23*m30 + m13*m20*m31 - m01*m23*m31 - m11*m20*m33 - m13*m21*m30;
-	const f32 b21 = m00*m23*m31 + m01*m20*m33 + m03*m21*m30 - m00*m21*m33 - m01*m23*m30 - m03*m20*m31;
-	const f32 b22 = m00*m11*m33 + m01*m13*m30 + m03*m10*m31 - m00*m13*m31 - m01*m10*m33 - m03*m11*m30;
-	const f32 b23 = m00*m13*m21 + m01*m10*m23 + m03*m11*m20 - m00*m11*m23 - m01*m13*m20 - m03*m10*m21;
-	const f32 b30 = m10*m22*m31 + m11*m20*m32 + m12*m21*m30 - m10*m21*m32 - m11*m22*m30 - m12*m20*m31;
-	const f32 b31 = m00*m21*m32 + m01*m22*m30 + m02*m20*m31 - m00*m22*m31 - m01*m20*m32 - m02*m21*m30;
-	const f32 b32 = m00*m12*m31 + m01*m10*m32 + m02*m11*m30 - m00*m11*m32 - m01*m12*m30 - m02*m10*m31;
-	const f32 b33 = m00*m11*m22 + m01*m12*m20 + m02*m10*m21 - m00*m12*m21 - m01*m10*m22 - m02*m11*m20;
+	const f32 s0 = m00 * m11 - m10 * m01;
+	const f32 s1 = m00 * m12 - m10 * m02;
+	const f32 s2 = m00 * m13 - m10 * m03;
+	const f32 s3 = m01 * m12 - m11 * m02;
+	const f32 s4 = m01 * m13 - m11 * m03;
+	const f32 s5 = m02 * m13 - m12 * m03;
+	const f32 c0 = m20 * m31 - m30 * m21;
+	const f32 c1 = m20 * m32 - m30 * m22;
+	const f32 c2 = m20 * m33 - m30 * m23;
+	const f32 c3 = m21 * m32 - m31 * m22;
+	const f32 c4 = m21 * m33 - m31 * m23;
+	const f32 c5 = m22 * m33 - m32 * m23;
+
+	const f32 det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+	SfzMat44 res = {};
+	if (det == 0) return res;
 
 	res = sfzMat44InitElems(
-		b00, b01, b02, b03,
-		b10, b11, b12, b13,
-		b20, b21, b22, b23,
-		b30, b31, b32, b33);
+		(m11 * c5 - m12 * c4 + m13 * c3), -(m01 * c5 - m02 * c4 + m03 * c3),
+		(m31 * s5 - m32 * s4 + m33 * s3), -(m21 * s5 - m22 * s4 + m23 * s3),
+
+		-(m10 * c5 - m12 * c2 + m13 * c1), (m00 * c5 - m02 * c2 + m03 * c1),
+		-(m30 * s5 - m32 * s2 + m33 * s1), (m20 * s5 - m22 * s2 + m23 * s1),
+
+		(m10 * c4 - m11 * c2 + m13 * c0), -(m00 * c4 - m01 * c2 + m03 * c0),
+		(m30 * s4 - m31 * s2 + m33 * s0), -(m20 * s4 - m21 * s2 + m23 * s0),
+
+		-(m10 * c3 - m11 * c1 + m12 * c0), (m00 * c3 - m01 * c1 + m02 * c0),
+		-(m30 * s3 - m31 * s1 + m32 * s0), (m20 * s3 - m21 * s1 + m22 * s0));
 	return (1.0f / det) * res;
 }
 
+constexpr SfzMat44 sfzMat44Inverse(SfzMat44 m)
+{
+#if defined(SFZ_SIMD_ENABLED)
+	if (!sfz_is_constant_evaluated()) return sfzSimdMat44Inverse(m);
+#endif
+	return sfzMat44InverseScalar(m);
+}
+
 #endif
 
 #endif
@@ -0,0 +1,653 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#ifndef SFZ_SIMD_H
+#define SFZ_SIMD_H
+#pragma once
+
+// SIMD backend
+// ------------------------------------------------------------------------------------------------
+
+// The SIMD backend is opt-in, define SFZ_SIMD (project-wide) to enable it. When enabled the
+// SfzMat44 operations in sfz_matrix.h use SSE on x64 (plus a few SSE4.1 integer ops if compiled
+// with /arch:AVX or higher) and NEON on ARM64 at runtime, the scalar versions are still used in
+// constant expressions and on other platforms.
+//
+// The SIMD versions perform the exact same floating point operations in the exact same order as
+// the scalar versions (no FMA, no reciprocal approximations), so results are bitwise identical.
+
+#if defined(SFZ_SIMD)
+#if defined(_M_X64) || defined(_M_AMD64)
+#include <intrin.h>
+#define SFZ_SIMD_SSE
+#if defined(__AVX__)
+#define SFZ_SIMD_AVX
+#endif
+#elif defined(_M_ARM64)
+#include <intrin.h>
+#include <arm_neon.h>
+#define SFZ_SIMD_NEON
+#endif
+#endif
+
+#if defined(SFZ_SIMD_SSE) || defined(SFZ_SIMD_NEON)
+#define SFZ_SIMD_ENABLED
+#endif
+
+#include "sfz.h"
+
+#if defined(__cplusplus) && defined(SFZ_SIMD_ENABLED)
+
+// True if evaluated in a constant expression, used to pick the scalar path in constexpr functions.
+#define sfz_is_constant_evaluated() __builtin_is_constant_evaluated()
+
+// 4-wide f32 register
+// ------------------------------------------------------------------------------------------------
+
+#if defined(SFZ_SIMD_SSE)
+typedef __m128 SfzSimdF32x4;
+#elif defined(SFZ_SIMD_NEON)
+typedef float32x4_t SfzSimdF32x4;
+#endif
+
+sfz_forceinline SfzSimdF32x4 sfzSimdF32x4Load(f32x4 v)
+{
+#if defined(SFZ_SIMD_SSE)
+	return _mm_loadu_ps(&v.x);
+#elif defined(SFZ_SIMD_NEON)
+	return vld1q_f32(&v.x);
+#endif
+}
+
+sfz_forceinline SfzSimdF32x4 sfzSimdF32x4Load3(f32x3 v, f32 w)
+{
+#if defined(SFZ_SIMD_SSE)
+	return _mm_set_ps(w, v.z, v.y, v.x);
+#elif defined(SFZ_SIMD_NEON)
+	const f32 tmp[4] = { v.x, v.y, v.z, w };
+	return vld1q_f32(tmp);
+#endif
+}
+
+sfz_forceinline f32x4 sfzSimdF32x4Store(SfzSimdF32x4 v)
+{
+	f32x4 res;
+#if defined(SFZ_SIMD_SSE)
+	_mm_storeu_ps(&res.x, v);
+#elif defined(SFZ_SIMD_NEON)
+	vst1q_f32(&res.x, v);
+#endif
+	return res;
+}
+
+sfz_forceinline f32x3 sfzSimdF32x4Store3(SfzSimdF32x4 v)
+{
+	const f32x4 tmp = sfzSimdF32x4Store(v);
+	return f32x3_init(tmp.x, tmp.y, tmp.z);
+}
+
+// Loads 4 floats from an unaligned pointer.
+sfz_forceinline SfzSimdF32x4 sfzSimdF32x4LoadPtr(const f32* ptr)
+{
+#if defined(SFZ_SIMD_SSE)
+	return _mm_loadu_ps(ptr);
+#elif defined(SFZ_SIMD_NEON)
+	return vld1q_f32(ptr);
+#endif
+}
+
+// Stores 4 floats to an unaligned pointer.
+sfz_forceinline void sfzSimdF32x4StorePtr(f32* ptr, SfzSimdF32x4 v)
+{
+#if defined(SFZ_SIMD_SSE)
+	_mm_storeu_ps(ptr, v);
+#elif defined(SFZ_SIMD_NEON)
+	vst1q_f32(ptr, v);
+#endif
+}
+
+// Stores the first 3 floats to an unaligned pointer, the memory after them is not touched.
+sfz_forceinline void sfzSimdF32x4StorePtr3(f32* ptr, SfzSimdF32x4 v)
+{
+#if defined(SFZ_SIMD_SSE)
+	_mm_storel_pi(reinterpret_cast<__m64*>(ptr), v);
+	_mm_store_ss(ptr + 2, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2)));
+#elif defined(SFZ_SIMD_NEON)
+	vst1_f32(ptr, vget_low_f32(v));
+	vst1q_lane_f32(ptr + 2, v, 2);
+#endif
+}
+
+sfz_forceinline SfzSimdF32x4 sfzSimdF32x4Splat(f32 s)
+{
+#if defined(SFZ_SIMD_SSE)
+	return _mm_set1_ps(s);
+#elif defined(SFZ_SIMD_NEON)
+	return vdupq_n_f32(s);
+#endif
+}
+
+sfz_forceinline SfzSimdF32x4 sfzSimdF32x4Zero() { return sfzSimdF32x4Splat(0.0f); }
+
+sfz_forceinline f32 sfzSimdF32x4GetX(SfzSimdF32x4 v)
+{
+#if defined(SFZ_SIMD_SSE)
+	return _mm_cvtss_f32(v);
+#elif defined(SFZ_SIMD_NEON)
+	return vgetq_lane_f32(v, 0);
+#endif
+}
+
+sfz_forceinline SfzSimdF32x4 sfzSimdF32x4Add(SfzSimdF32x4 l, SfzSimdF32x4 r)
+{
+#if defined(SFZ_SIMD_SSE)
+	return _mm_add_ps(l, r);
+#elif defined(SFZ_SIMD_NEON)
+	return vaddq_f32(l, r);
+#endif
+}
+
+sfz_forceinline SfzSimdF32x4 sfzSimdF32x4Sub(SfzSimdF32x4 l, SfzSimdF32x4 r)
+{
+#if defined(SFZ_SIMD_SSE)
+	return _mm_sub_ps(l, r);
+#elif defined(SFZ_SIMD_NEON)
+	return vsubq_f32(l, r);
+#endif
+}
+
+sfz_forceinline SfzSimdF32x4 sfzSimdF32x4Mul(SfzSimdF32x4 l, SfzSimdF32x4 r)
+{
+#if defined(SFZ_SIMD_SSE)
+	return _mm_mul_ps(l, r);
+#elif defined(SFZ_SIMD_NEON)
+	return vmulq_f32(l, r);
+#endif
+}
+
+sfz_forceinline SfzSimdF32x4 sfzSimdF32x4Div(SfzSimdF32x4 l, SfzSimdF32x4 r)
+{
+#if defined(SFZ_SIMD_SSE)
+	return _mm_div_ps(l, r);
+#elif defined(SFZ_SIMD_NEON)
+	return vdivq_f32(l, r);
+#endif
+}
+
+// Same semantics as f32_min(), i.e. (l < r) ? l : r, including for NaNs and signed zeroes.
+sfz_forceinline SfzSimdF32x4 sfzSimdF32x4Min(SfzSimdF32x4 l, SfzSimdF32x4 r)
+{
+#if defined(SFZ_SIMD_SSE)
+	return _mm_min_ps(l, r);
+#elif defined(SFZ_SIMD_NEON)
+	return vbslq_f32(vcltq_f32(l, r), l, r);
+#endif
+}
+
+// Same semantics as f32_max(), i.e. (l < r) ? r : l, including for NaNs and signed zeroes.
+sfz_forceinline SfzSimdF32x4 sfzSimdF32x4Max(SfzSimdF32x4 l, SfzSimdF32x4 r)
+{
+#if defined(SFZ_SIMD_SSE)
+	return _mm_max_ps(r, l);
+#elif defined(SFZ_SIMD_NEON)
+	return vbslq_f32(vcltq_f32(l, r), r, l);
+#endif
+}
+
+sfz_forceinline SfzSimdF32x4 sfzSimdF32x4Sqrt(SfzSimdF32x4 v)
+{
+#if defined(SFZ_SIMD_SSE)
+	return _mm_sqrt_ps(v);
+#elif defined(SFZ_SIMD_NEON)
+	return vsqrtq_f32(v);
+#endif
+}
+
+// Flips the sign bit of the lanes where the corresponding flip parameter is true. Unlike
+// multiplying by -1 this is exact for all inputs, including NaNs.
+template<bool FX, bool FY, bool FZ, bool FW>
+sfz_forceinline SfzSimdF32x4 sfzSimdF32x4FlipSign(SfzSimdF32x4 v)
+{
+	constexpr u32 SIGN = 0x80000000u;
+#if defined(SFZ_SIMD_SSE)
+	const __m128i mask = _mm_set_epi32(
+		FW ? i32(SIGN) : 0, FZ ? i32(SIGN) : 0, FY ? i32(SIGN) : 0, FX ? i32(SIGN) : 0);
+	return _mm_xor_ps(v, _mm_castsi128_ps(mask));
+#elif defined(SFZ_SIMD_NEON)
+	const u32 tmp[4] = { FX ? SIGN : 0u, FY ? SIGN : 0u, FZ ? SIGN : 0u, FW ? SIGN : 0u };
+	return vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(v), vld1q_u32(tmp)));
+#endif
+}
+
+// Same semantics as _mm_shuffle_ps(), i.e. returns (a[X], a[Y], b[Z], b[W]).
+template<u32 X, u32 Y, u32 Z, u32 W>
+sfz_forceinline SfzSimdF32x4 sfzSimdF32x4Shuffle(SfzSimdF32x4 a, SfzSimdF32x4 b)
+{
+	static_assert(X < 4 && Y < 4 && Z < 4 && W < 4);
+#if defined(SFZ_SIMD_SSE)
+	return _mm_shuffle_ps(a, b, _MM_SHUFFLE(W, Z, Y, X));
+#elif defined(SFZ_SIMD_NEON)
+	SfzSimdF32x4 res = vdupq_n_f32(vgetq_lane_f32(a, X));
+	res = vsetq_lane_f32(vgetq_lane_f32(a, Y), res, 1);
+	res = vsetq_lane_f32(vgetq_lane_f32(b, Z), res, 2);
+	res = vsetq_lane_f32(vgetq_lane_f32(b, W), res, 3);
+	return res;
+#endif
+}
+
+// Returns (v[I], v[I], v[I], v[I]).
+template<u32 I>
+sfz_forceinline SfzSimdF32x4 sfzSimdF32x4SplatLane(SfzSimdF32x4 v)
+{
+	static_assert(I < 4);
+#if defined(SFZ_SIMD_SSE)
+	return _mm_shuffle_ps(v, v, _MM_SHUFFLE(I, I, I, I));
+#elif defined(SFZ_SIMD_NEON)
+	return vdupq_laneq_f32(v, I);
+#endif
+}
+
+// Returns (a.x, b.x, a.y, b.y).
+sfz_forceinline SfzSimdF32x4 sfzSimdF32x4UnpackLo(SfzSimdF32x4 a, SfzSimdF32x4 b)
+{
+#if defined(SFZ_SIMD_SSE)
+	return _mm_unpacklo_ps(a, b);
+#elif defined(SFZ_SIMD_NEON)
+	return vzip1q_f32(a, b);
+#endif
+}
+
+// Returns (a.z, b.z, a.w, b.w).
+sfz_forceinline SfzSimdF32x4 sfzSimdF32x4UnpackHi(SfzSimdF32x4 a, SfzSimdF32x4 b)
+{
+#if defined(SFZ_SIMD_SSE)
+	return _mm_unpackhi_ps(a, b);
+#elif defined(SFZ_SIMD_NEON)
+	return vzip2q_f32(a, b);
+#endif
+}
+
+// Transposes four registers in place, i.e. treats them as the rows of a 4x4 matrix.
+sfz_forceinline void sfzSimdF32x4Transpose(
+	SfzSimdF32x4& r0, SfzSimdF32x4& r1, SfzSimdF32x4& r2, SfzSimdF32x4& r3)
+{
+	const SfzSimdF32x4 t0 = sfzSimdF32x4UnpackLo(r0, r2); // r0.x, r2.x, r0.y, r2.y
+	const SfzSimdF32x4 t1 = sfzSimdF32x4UnpackLo(r1, r3); // r1.x, r3.x, r1.y, r3.y
+	const SfzSimdF32x4 t2 = sfzSimdF32x4UnpackHi(r0, r2); // r0.z, r2.z, r0.w, r2.w
+	const SfzSimdF32x4 t3 = sfzSimdF32x4UnpackHi(r1, r3); // r1.z, r3.z, r1.w, r3.w
+	r0 = sfzSimdF32x4UnpackLo(t0, t1);
+	r1 = sfzSimdF32x4UnpackHi(t0, t1);
+	r2 = sfzSimdF32x4UnpackLo(t2, t3);
+	r3 = sfzSimdF32x4UnpackHi(t2, t3);
+}
+
+// f32x4 math functions
+// ------------------------------------------------------------------------------------------------
+
+// The horizontal sums are performed lane by lane in order (((x + y) + z) + w), same as
+// f32x4_dot() and f32x3_dot(). Pairwise sums would be faster, but would round differently.
+
+sfz_forceinline f32 sfzSimdF32x4Dot(SfzSimdF32x4 l, SfzSimdF32x4 r)
+{
+	const SfzSimdF32x4 p = sfzSimdF32x4Mul(l, r);
+#if defined(SFZ_SIMD_SSE)
+	__m128 sum = _mm_add_ss(p, _mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 1, 1, 1)));
+	sum = _mm_add_ss(sum, _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 2, 2)));
+	sum = _mm_add_ss(sum, _mm_shuffle_ps(p, p, _MM_SHUFFLE(3, 3, 3, 3)));
+	return _mm_cvtss_f32(sum);
+#elif defined(SFZ_SIMD_NEON)
+	return ((vgetq_lane_f32(p, 0) + vgetq_lane_f32(p, 1)) + vgetq_lane_f32(p, 2)) + vgetq_lane_f32(p, 3);
+#endif
+}
+
+sfz_forceinline f32 sfzSimdF32x3Dot(SfzSimdF32x4 l, SfzSimdF32x4 r)
+{
+	const SfzSimdF32x4 p = sfzSimdF32x4Mul(l, r);
+#if defined(SFZ_SIMD_SSE)
+	__m128 sum = _mm_add_ss(p, _mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 1, 1, 1)));
+	sum = _mm_add_ss(sum, _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 2, 2)));
+	return _mm_cvtss_f32(sum);
+#elif defined(SFZ_SIMD_NEON)
+	return (vgetq_lane_f32(p, 0) + vgetq_lane_f32(p, 1)) + vgetq_lane_f32(p, 2);
+#endif
+}
+
+// Cross product of the xyz components, w of the result is 0 (for finite inputs).
+sfz_forceinline SfzSimdF32x4 sfzSimdF32x3Cross(SfzSimdF32x4 l, SfzSimdF32x4 r)
+{
+	const SfzSimdF32x4 l_yzx = sfzSimdF32x4Shuffle<1, 2, 0, 3>(l, l);
+	const SfzSimdF32x4 l_zxy = sfzSimdF32x4Shuffle<2, 0, 1, 3>(l, l);
+	const SfzSimdF32x4 r_yzx = sfzSimdF32x4Shuffle<1, 2, 0, 3>(r, r);
+	const SfzSimdF32x4 r_zxy = sfzSimdF32x4Shuffle<2, 0, 1, 3>(r, r);
+	return sfzSimdF32x4Sub(sfzSimdF32x4Mul(l_yzx, r_zxy), sfzSimdF32x4Mul(l_zxy, r_yzx));
+}
+
+// Normalizes the xyz components, the w component is scaled by the same factor.
+sfz_forceinline SfzSimdF32x4 sfzSimdF32x3Normalize(SfzSimdF32x4 v)
+{
+	const f32 len = sfz_sqrt(sfzSimdF32x3Dot(v, v));
+	return sfzSimdF32x4Mul(v, sfzSimdF32x4Splat(1.0f / len));
+}
+
+// 4-wide i32 register
+// ------------------------------------------------------------------------------------------------
+
+#if defined(SFZ_SIMD_SSE)
+typedef __m128i SfzSimdI32x4;
+#elif defined(SFZ_SIMD_NEON)
+typedef int32x4_t SfzSimdI32x4;
+#endif
+
+sfz_forceinline SfzSimdI32x4 sfzSimdI32x4Load(i32x4 v)
+{
+#if defined(SFZ_SIMD_SSE)
+	return _mm_loadu_si128(reinterpret_cast<const __m128i*>(&v.x));
+#elif defined(SFZ_SIMD_NEON)
+	return vld1q_s32(&v.x);
+#endif
+}
+
+sfz_forceinline i32x4 sfzSimdI32x4Store(SfzSimdI32x4 v)
+{
+	i32x4 res;
+#if defined(SFZ_SIMD_SSE)
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(&res.x), v);
+#elif defined(SFZ_SIMD_NEON)
+	vst1q_s32(&res.x, v);
+#endif
+	return res;
+}
+
+sfz_forceinline SfzSimdI32x4 sfzSimdI32x4Splat(i32 s)
+{
+#if defined(SFZ_SIMD_SSE)
+	return _mm_set1_epi32(s);
+#elif defined(SFZ_SIMD_NEON)
+	return vdupq_n_s32(s);
+#endif
+}
+
+sfz_forceinline SfzSimdI32x4 sfzSimdI32x4Add(SfzSimdI32x4 l, SfzSimdI32x4 r)
+{
+#if defined(SFZ_SIMD_SSE)
+	return _mm_add_epi32(l, r);
+#elif defined(SFZ_SIMD_NEON)
+	return vaddq_s32(l, r);
+#endif
+}
+
+sfz_forceinline SfzSimdI32x4 sfzSimdI32x4Sub(SfzSimdI32x4 l, SfzSimdI32x4 r)
+{
+#if defined(SFZ_SIMD_SSE)
+	return _mm_sub_epi32(l, r);
+#elif defined(SFZ_SIMD_NEON)
+	return vsubq_s32(l, r);
+#endif
+}
+
+// Wrapping (low 32 bits) multiply.
+sfz_forceinline SfzSimdI32x4 sfzSimdI32x4Mul(SfzSimdI32x4 l, SfzSimdI32x4 r)
+{
+#if defined(SFZ_SIMD_AVX)
+	return _mm_mullo_epi32(l, r);
+#elif defined(SFZ_SIMD_SSE)
+	// SSE2 has no 32-bit multiply, multiply even and odd lanes separately as 64-bit.
+	const __m128i even = _mm_mul_epu32(l, r);
+	const __m128i odd = _mm_mul_epu32(_mm_srli_si128(l, 4), _mm_srli_si128(r, 4));
+	return _mm_unpacklo_epi32(
+		_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+#elif defined(SFZ_SIMD_NEON)
+	return vmulq_s32(l, r);
+#endif
+}
+
+sfz_forceinline SfzSimdI32x4 sfzSimdI32x4Min(SfzSimdI32x4 l, SfzSimdI32x4 r)
+{
+#if defined(SFZ_SIMD_AVX)
+	return _mm_min_epi32(l, r);
+#elif defined(SFZ_SIMD_SSE)
+	const __m128i l_less = _mm_cmplt_epi32(l, r);
+	return _mm_or_si128(_mm_and_si128(l_less, l), _mm_andnot_si128(l_less, r));
+#elif defined(SFZ_SIMD_NEON)
+	return vminq_s32(l, r);
+#endif
+}
+
+sfz_forceinline SfzSimdI32x4 sfzSimdI32x4Max(SfzSimdI32x4 l, SfzSimdI32x4 r)
+{
+#if defined(SFZ_SIMD_AVX)
+	return _mm_max_epi32(l, r);
+#elif defined(SFZ_SIMD_SSE)
+	const __m128i l_less = _mm_cmplt_epi32(l, r);
+	return _mm_or_si128(_mm_and_si128(l_less, r), _mm_andnot_si128(l_less, l));
+#elif defined(SFZ_SIMD_NEON)
+	return vmaxq_s32(l, r);
+#endif
+}
+
+// Same as f32x4_from_i32(), i.e. exact for values up to 2^24.
+sfz_forceinline SfzSimdF32x4 sfzSimdF32x4FromI32x4(SfzSimdI32x4 v)
+{
+#if defined(SFZ_SIMD_SSE)
+	return _mm_cvtepi32_ps(v);
+#elif defined(SFZ_SIMD_NEON)
+	return vcvtq_f32_s32(v);
+#endif
+}
+
+// Truncates towards zero, same as a C cast.
+sfz_forceinline SfzSimdI32x4 sfzSimdI32x4FromF32x4(SfzSimdF32x4 v)
+{
+#if defined(SFZ_SIMD_SSE)
+	return _mm_cvttps_epi32(v);
+#elif defined(SFZ_SIMD_NEON)
+	return vcvtq_s32_f32(v);
+#endif
+}
+
+// SfzMat44 functions
+// ------------------------------------------------------------------------------------------------
+
+// These are the implementations used by sfz_matrix.h when SFZ_SIMD is defined, prefer using the
+// regular operators and functions there.
+
+sfz_forceinline SfzMat44 sfzSimdMat44Mul(const SfzMat44& lhs, const SfzMat44& rhs)
+{
+	// Each row of the result is a linear combination of the rows of rhs. The accumulator starts at
+	// zero (instead of at the first product) to match the scalar version for negative zeroes.
+	// There is deliberately no 256-bit AVX version (two rows at a time), it measured about twice as
+	// slow in the SfzMat44 benchmark. Likely because rows written with 128-bit stores are then read
+	// with 256-bit loads, which can't be store-forwarded.
+	SfzMat44 res;
+	const SfzSimdF32x4 b0 = sfzSimdF32x4Load(rhs.rows[0]);
+	const SfzSimdF32x4 b1 = sfzSimdF32x4Load(rhs.rows[1]);
+	const SfzSimdF32x4 b2 = sfzSimdF32x4Load(rhs.rows[2]);
+	const SfzSimdF32x4 b3 = sfzSimdF32x4Load(rhs.rows[3]);
+	for (u32 y = 0; y < 4; y++) {
+		const SfzSimdF32x4 a = sfzSimdF32x4Load(lhs.rows[y]);
+		SfzSimdF32x4 acc = sfzSimdF32x4Zero();
+		acc = sfzSimdF32x4Add(acc, sfzSimdF32x4Mul(sfzSimdF32x4SplatLane<0>(a), b0));
+		acc = sfzSimdF32x4Add(acc, sfzSimdF32x4Mul(sfzSimdF32x4SplatLane<1>(a), b1));
+		acc = sfzSimdF32x4Add(acc, sfzSimdF32x4Mul(sfzSimdF32x4SplatLane<2>(a), b2));
+		acc = sfzSimdF32x4Add(acc, sfzSimdF32x4Mul(sfzSimdF32x4SplatLane<3>(a), b3));
+		res.rows[y] = sfzSimdF32x4Store(acc);
+	}
+	return res;
+}
+
+sfz_forceinline SfzSimdF32x4 sfzSimdMat44MulVec(const SfzMat44& m, SfzSimdF32x4 v)
+{
+	// Multiply each row with the vector, then transpose so that the horizontal sums of the four
+	// dot products can be done vertically (in the same order as f32x4_dot()).
+	SfzSimdF32x4 p0 = sfzSimdF32x4Mul(sfzSimdF32x4Load(m.rows[0]), v);
+	SfzSimdF32x4 p1 = sfzSimdF32x4Mul(sfzSimdF32x4Load(m.rows[1]), v);
+	SfzSimdF32x4 p2 = sfzSimdF32x4Mul(sfzSimdF32x4Load(m.rows[2]), v);
+	SfzSimdF32x4 p3 = sfzSimdF32x4Mul(sfzSimdF32x4Load(m.rows[3]), v);
+	sfzSimdF32x4Transpose(p0, p1, p2, p3);
+	return sfzSimdF32x4Add(sfzSimdF32x4Add(sfzSimdF32x4Add(p0, p1), p2), p3);
+}
+
+// Same as sfzSimdMat44MulVec(), but with the columns of m as a linear combination weighted by the
+// lanes of v, which gives each lane the same operation order as f32x4_dot(). The transpose of m
+// doesn't depend on v, so in a loop with a fixed matrix the compiler can hoist it out.
+sfz_forceinline SfzSimdF32x4 sfzSimdMat44MulVecColumns(const SfzMat44& m, SfzSimdF32x4 v)
+{
+	SfzSimdF32x4 c0 = sfzSimdF32x4Load(m.rows[0]);
+	SfzSimdF32x4 c1 = sfzSimdF32x4Load(m.rows[1]);
+	SfzSimdF32x4 c2 = sfzSimdF32x4Load(m.rows[2]);
+	SfzSimdF32x4 c3 = sfzSimdF32x4Load(m.rows[3]);
+	sfzSimdF32x4Transpose(c0, c1, c2, c3);
+	SfzSimdF32x4 acc = sfzSimdF32x4Mul(c0, sfzSimdF32x4SplatLane<0>(v));
+	acc = sfzSimdF32x4Add(acc, sfzSimdF32x4Mul(c1, sfzSimdF32x4SplatLane<1>(v)));
+	acc = sfzSimdF32x4Add(acc, sfzSimdF32x4Mul(c2, sfzSimdF32x4SplatLane<2>(v)));
+	return sfzSimdF32x4Add(acc, sfzSimdF32x4Mul(c3, sfzSimdF32x4SplatLane<3>(v)));
+}
+
+sfz_forceinline f32x3 sfzSimdMat44TransformPoint(const SfzMat44& m, f32x3 p)
+{
+	const SfzSimdF32x4 v = sfzSimdMat44MulVecColumns(m, sfzSimdF32x4Load3(p, 1.0f));
+	return sfzSimdF32x4Store3(sfzSimdF32x4Div(v, sfzSimdF32x4SplatLane<3>(v)));
+}
+
+sfz_forceinline f32x3 sfzSimdMat44TransformDir(const SfzMat44& m, f32x3 d)
+{
+	return sfzSimdF32x4Store3(sfzSimdMat44MulVecColumns(m, sfzSimdF32x4Load3(d, 0.0f)));
+}
+
+// Transforms num points (IS_POINT) or directions from src (with src_stride bytes between them) and
+// writes them tightly packed to dst. Four at a time are transposed to SoA form, so that each
+// component of the result is a vertical multiply-add chain, with the same order as in
+// sfzMat44TransformPoint() and sfzMat44TransformDir().
+template<bool IS_POINT>
+inline void sfzSimdMat44TransformBatch(
+	const SfzMat44& m, f32x3* __restrict dst, const f32x3* __restrict src, u64 src_stride, u64 num)
+{
+	const u8* src_bytes = reinterpret_cast<const u8*>(src);
+	const f32 w = IS_POINT ? 1.0f : 0.0f;
+	SfzSimdF32x4 elems[4][4];
+	for (u32 y = 0; y < 4; y++) {
+		elems[y][0] = sfzSimdF32x4Splat(m.rows[y].x);
+		elems[y][1] = sfzSimdF32x4Splat(m.rows[y].y);
+		elems[y][2] = sfzSimdF32x4Splat(m.rows[y].z);
+		elems[y][3] = sfzSimdF32x4Splat(m.rows[y].w * w);
+	}
+	auto dot = [&](u32 row, SfzSimdF32x4 x, SfzSimdF32x4 y, SfzSimdF32x4 z) {
+		SfzSimdF32x4 acc = sfzSimdF32x4Mul(elems[row][0], x);
+		acc = sfzSimdF32x4Add(acc, sfzSimdF32x4Mul(elems[row][1], y));
+		acc = sfzSimdF32x4Add(acc, sfzSimdF32x4Mul(elems[row][2], z));
+		return sfzSimdF32x4Add(acc, elems[row][3]);
+	};
+
+	// The 16-byte loads read 4 bytes past each point, which is only safe if it is not the last one
+	u64 i = 0;
+	for (; (i + 4) < num; i += 4) {
+		SfzSimdF32x4 x = sfzSimdF32x4LoadPtr(reinterpret_cast<const f32*>(src_bytes + (i + 0) * src_stride));
+		SfzSimdF32x4 y = sfzSimdF32x4LoadPtr(reinterpret_cast<const f32*>(src_bytes + (i + 1) * src_stride));
+		SfzSimdF32x4 z = sfzSimdF32x4LoadPtr(reinterpret_cast<const f32*>(src_bytes + (i + 2) * src_stride));
+		SfzSimdF32x4 unused = sfzSimdF32x4LoadPtr(reinterpret_cast<const f32*>(src_bytes + (i + 3) * src_stride));
+		sfzSimdF32x4Transpose(x, y, z, unused);
+
+		SfzSimdF32x4 res_x = dot(0, x, y, z);
+		SfzSimdF32x4 res_y = dot(1, x, y, z);
+		SfzSimdF32x4 res_z = dot(2, x, y, z);
+		SfzSimdF32x4 res_w = sfzSimdF32x4Zero();
+		if constexpr (IS_POINT) {
+			res_w = dot(3, x, y, z);
+			res_x = sfzSimdF32x4Div(res_x, res_w);
+			res_y = sfzSimdF32x4Div(res_y, res_w);
+			res_z = sfzSimdF32x4Div(res_z, res_w);
+		}
+		sfzSimdF32x4Transpose(res_x, res_y, res_z, res_w);
+
+		// Each store overwrites x of the next point, which is then written by the next store
+		sfzSimdF32x4StorePtr(&dst[i + 0].x, res_x);
+		sfzSimdF32x4StorePtr(&dst[i + 1].x, res_y);
+		sfzSimdF32x4StorePtr(&dst[i + 2].x, res_z);
+		sfzSimdF32x4StorePtr3(&dst[i + 3].x, res_w);
+	}
+	for (; i < num; i++) {
+		const f32x3 p = *reinterpret_cast<const f32x3*>(src_bytes + i * src_stride);
+		dst[i] = IS_POINT ? sfzSimdMat44TransformPoint(m, p) : sfzSimdMat44TransformDir(m, p);
+	}
+}
+
+// See sfzMat44Inverse() for the algorithm, this calculates the exact same expressions but for a
+// full row of the result at a time.
+inline SfzMat44 sfzSimdMat44Inverse(const SfzMat44& m)
+{
+	const SfzSimdF32x4 r0 = sfzSimdF32x4Load(m.rows[0]);
+	const SfzSimdF32x4 r1 = sfzSimdF32x4Load(m.rows[1]);
+	const SfzSimdF32x4 r2 = sfzSimdF32x4Load(m.rows[2]);
+	const SfzSimdF32x4 r3 = sfzSimdF32x4Load(m.rows[3]);
+
+	// 2x2 determinants, s0-s3, c0-c3 and (s4, s5, c4, c5)
+	const SfzSimdF32x4 s0123 = sfzSimdF32x4Sub(
+		sfzSimdF32x4Mul(sfzSimdF32x4Shuffle<0, 0, 0, 1>(r0, r0), sfzSimdF32x4Shuffle<1, 2, 3, 2>(r1, r1)),
+		sfzSimdF32x4Mul(sfzSimdF32x4Shuffle<0, 0, 0, 1>(r1, r1), sfzSimdF32x4Shuffle<1, 2, 3, 2>(r0, r0)));
+	const SfzSimdF32x4 c0123 = sfzSimdF32x4Sub(
+		sfzSimdF32x4Mul(sfzSimdF32x4Shuffle<0, 0, 0, 1>(r2, r2), sfzSimdF32x4Shuffle<1, 2, 3, 2>(r3, r3)),
+		sfzSimdF32x4Mul(sfzSimdF32x4Shuffle<0, 0, 0, 1>(r3, r3), sfzSimdF32x4Shuffle<1, 2, 3, 2>(r2, r2)));
+	const SfzSimdF32x4 s45c45 = sfzSimdF32x4Sub(
+		sfzSimdF32x4Mul(sfzSimdF32x4Shuffle<1, 2, 1, 2>(r0, r2), sfzSimdF32x4Shuffle<3, 3, 3, 3>(r1, r3)),
+		sfzSimdF32x4Mul(sfzSimdF32x4Shuffle<1, 2, 1, 2>(r1, r3), sfzSimdF32x4Shuffle<3, 3, 3, 3>(r0, r2)));
+
+	// Determinant, summed in the same order as the scalar version
+	const f32x4 s = sfzSimdF32x4Store(s0123);
+	const f32x4 c = sfzSimdF32x4Store(c0123);
+	const f32x4 sc = sfzSimdF32x4Store(s45c45);
+	const f32 det = s.x * sc.w - s.y * sc.z + s.z * c.w + s.w * c.z - sc.x * c.y + sc.y * c.x;
+	if (det == 0.0f) return SfzMat44{};
+
+	// xk = (ck, ck, sk, sk)
+	const SfzSimdF32x4 x0 = sfzSimdF32x4Shuffle<0, 0, 0, 0>(c0123, s0123);
+	const SfzSimdF32x4 x1 = sfzSimdF32x4Shuffle<1, 1, 1, 1>(c0123, s0123);
+	const SfzSimdF32x4 x2 = sfzSimdF32x4Shuffle<2, 2, 2, 2>(c0123, s0123);
+	const SfzSimdF32x4 x3 = sfzSimdF32x4Shuffle<3, 3, 3, 3>(c0123, s0123);
+	const SfzSimdF32x4 x4 = sfzSimdF32x4Shuffle<2, 2, 0, 0>(s45c45, s45c45);
+	const SfzSimdF32x4 x5 = sfzSimdF32x4Shuffle<3, 3, 1, 1>(s45c45, s45c45);
+
+	// vk = (m1k, m0k, m3k, m2k)
+	const SfzSimdF32x4 lo10 = sfzSimdF32x4UnpackLo(r1, r0);
+	const SfzSimdF32x4 lo32 = sfzSimdF32x4UnpackLo(r3, r2);
+	const SfzSimdF32x4 hi10 = sfzSimdF32x4UnpackHi(r1, r0);
+	const SfzSimdF32x4 hi32 = sfzSimdF32x4UnpackHi(r3, r2);
+	const SfzSimdF32x4 v0 = sfzSimdF32x4Shuffle<0, 1, 0, 1>(lo10, lo32);
+	const SfzSimdF32x4 v1 = sfzSimdF32x4Shuffle<2, 3, 2, 3>(lo10, lo32);
+	const SfzSimdF32x4 v2 = sfzSimdF32x4Shuffle<0, 1, 0, 1>(hi10, hi32);
+	const SfzSimdF32x4 v3 = sfzSimdF32x4Shuffle<2, 3, 2, 3>(hi10, hi32);
+
+	const SfzSimdF32x4 inv_det = sfzSimdF32x4Splat(1.0f / det);
+	auto row = [&](SfzSimdF32x4 a, SfzSimdF32x4 xa, SfzSimdF32x4 b, SfzSimdF32x4 xb, SfzSimdF32x4 c, SfzSimdF32x4 xc) {
+		return sfzSimdF32x4Add(
+			sfzSimdF32x4Sub(sfzSimdF32x4Mul(a, xa), sfzSimdF32x4Mul(b, xb)), sfzSimdF32x4Mul(c, xc));
+	};
+	SfzMat44 res;
+	res.rows[0] = sfzSimdF32x4Store(sfzSimdF32x4Mul(
+		sfzSimdF32x4FlipSign<false, true, false, true>(row(v1, x5, v2, x4, v3, x3)), inv_det));
+	res.rows[1] = sfzSimdF32x4Store(sfzSimdF32x4Mul(
+		sfzSimdF32x4FlipSign<true, false, true, false>(row(v0, x5, v2, x2, v3, x1)), inv_det));
+	res.rows[2] = sfzSimdF32x4Store(sfzSimdF32x4Mul(
+		sfzSimdF32x4FlipSign<false, true, false, true>(row(v0, x4, v1, x2, v3, x0)), inv_det));
+	res.rows[3] = sfzSimdF32x4Store(sfzSimdF32x4Mul(
+		sfzSimdF32x4FlipSign<true, false, true, false>(row(v0, x3, v1, x1, v2, x0)), inv_det));
+	return res;
+}
+
+#endif // __cplusplus && SFZ_SIMD_ENABLED
+
+#endif
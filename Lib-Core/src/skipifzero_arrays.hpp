@@ -20,11 +20,328 @@
 #define SKIPIFZERO_ARRAYS_HPP
 #pragma once
 
+#if defined(_M_X64) || defined(_M_AMD64)
+#include <intrin.h>
+#if defined(__AVX2__)
+#define SFZ_ARRAY_AVX2
+#else
+#define SFZ_ARRAY_SSE2
+#endif
+#elif defined(_M_ARM64)
+#include <intrin.h>
+#include <arm_neon.h>
+#define SFZ_ARRAY_NEON
+#endif
+
 #include "sfz.h"
 #include "sfz_cpp.hpp"
 
 #ifdef __cplusplus
 
+// SIMD search kernels
+// ------------------------------------------------------------------------------------------------
+
+// Element types that get SIMD versions of findElement(), contains(), count() (BITWISE_EQ, i.e.
+// operator== is equivalent to comparing the bytes) and minElement()/maxElement() (INTEGER).
+// Specialize for own handle-like types of 1, 2, 4 or 8 bytes with a bitwise operator==.
+template<typename T> struct SfzArraySimdTraits { static constexpr bool BITWISE_EQ = false; static constexpr bool INTEGER = false; };
+template<> struct SfzArraySimdTraits<i8> { static constexpr bool BITWISE_EQ = true; static constexpr bool INTEGER = true; static constexpr bool SIGNED = true; };
+template<> struct SfzArraySimdTraits<u8> { static constexpr bool BITWISE_EQ = true; static constexpr bool INTEGER = true; static constexpr bool SIGNED = false; };
+template<> struct SfzArraySimdTraits<i16> { static constexpr bool BITWISE_EQ = true; static constexpr bool INTEGER = true; static constexpr bool SIGNED = true; };
+template<> struct SfzArraySimdTraits<u16> { static constexpr bool BITWISE_EQ = true; static constexpr bool INTEGER = true; static constexpr bool SIGNED = false; };
+template<> struct SfzArraySimdTraits<i32> { static constexpr bool BITWISE_EQ = true; static constexpr bool INTEGER = true; static constexpr bool SIGNED = true; };
+template<> struct SfzArraySimdTraits<u32> { static constexpr bool BITWISE_EQ = true; static constexpr bool INTEGER = true; static constexpr bool SIGNED = false; };
+template<> struct SfzArraySimdTraits<i64> { static constexpr bool BITWISE_EQ = true; static constexpr bool INTEGER = true; static constexpr bool SIGNED = true; };
+template<> struct SfzArraySimdTraits<u64> { static constexpr bool BITWISE_EQ = true; static constexpr bool INTEGER = true; static constexpr bool SIGNED = false; };
+template<> struct SfzArraySimdTraits<SfzHandle> { static constexpr bool BITWISE_EQ = true; static constexpr bool INTEGER = false; };
+template<> struct SfzArraySimdTraits<SfzStrID> { static constexpr bool BITWISE_EQ = true; static constexpr bool INTEGER = false; };
+
+template<u32 Size> struct SfzArraySimdUint {};
+template<> struct SfzArraySimdUint<1> { using T = u8; };
+template<> struct SfzArraySimdUint<2> { using T = u16; };
+template<> struct SfzArraySimdUint<4> { using T = u32; };
+template<> struct SfzArraySimdUint<8> { using T = u64; };
+
+// The kernels below are written against a small set of vector primitives, implemented for AVX2
+// (32 byte vectors), SSE2 (16 byte vectors) and NEON (16 byte vectors). The comparison mask has
+// 1 bit per byte on x86 (movemask) and 4 bits per byte on NEON (shift right and narrow). Without
+// any of these the kernels are plain scalar loops.
+#if defined(SFZ_ARRAY_AVX2) || defined(SFZ_ARRAY_SSE2) || defined(SFZ_ARRAY_NEON)
+#define SFZ_ARRAY_SIMD
+#endif
+
+#if defined(SFZ_ARRAY_AVX2)
+
+typedef __m256i SfzArrVec;
+constexpr u32 SFZ_ARR_VEC_BYTES = 32;
+constexpr u32 SFZ_ARR_VEC_MASK_BITS_PER_BYTE = 1;
+constexpr bool SFZ_ARR_VEC_HAS_GT64 = true;
+constexpr bool SFZ_ARR_VEC_HAS_EQ64 = true;
+
+sfz_forceinline SfzArrVec sfzArrVecLoad(const void* ptr) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr)); }
+sfz_forceinline SfzArrVec sfzArrVecOr(SfzArrVec a, SfzArrVec b) { return _mm256_or_si256(a, b); }
+sfz_forceinline SfzArrVec sfzArrVecXor(SfzArrVec a, SfzArrVec b) { return _mm256_xor_si256(a, b); }
+sfz_forceinline SfzArrVec sfzArrVecSelect(SfzArrVec mask, SfzArrVec a, SfzArrVec b) { return _mm256_blendv_epi8(b, a, mask); }
+sfz_forceinline u64 sfzArrVecMask(SfzArrVec mask) { return u64(u32(_mm256_movemask_epi8(mask))); }
+
+template<typename U>
+sfz_forceinline SfzArrVec sfzArrVecSplat(U v)
+{
+	if constexpr (sizeof(U) == 1) return _mm256_set1_epi8(char(v));
+	else if constexpr (sizeof(U) == 2) return _mm256_set1_epi16(short(v));
+	else if constexpr (sizeof(U) == 4) return _mm256_set1_epi32(int(v));
+	else return _mm256_set1_epi64x(i64(v));
+}
+
+template<typename U>
+sfz_forceinline SfzArrVec sfzArrVecEq(SfzArrVec a, SfzArrVec b)
+{
+	if constexpr (sizeof(U) == 1) return _mm256_cmpeq_epi8(a, b);
+	else if constexpr (sizeof(U) == 2) return _mm256_cmpeq_epi16(a, b);
+	else if constexpr (sizeof(U) == 4) return _mm256_cmpeq_epi32(a, b);
+	else return _mm256_cmpeq_epi64(a, b);
+}
+
+// Signed greater than.
+template<typename U>
+sfz_forceinline SfzArrVec sfzArrVecGt(SfzArrVec a, SfzArrVec b)
+{
+	if constexpr (sizeof(U) == 1) return _mm256_cmpgt_epi8(a, b);
+	else if constexpr (sizeof(U) == 2) return _mm256_cmpgt_epi16(a, b);
+	else if constexpr (sizeof(U) == 4) return _mm256_cmpgt_epi32(a, b);
+	else return _mm256_cmpgt_epi64(a, b);
+}
+
+#elif defined(SFZ_ARRAY_SSE2)
+
+typedef __m128i SfzArrVec;
+constexpr u32 SFZ_ARR_VEC_BYTES = 16;
+constexpr u32 SFZ_ARR_VEC_MASK_BITS_PER_BYTE = 1;
+constexpr bool SFZ_ARR_VEC_HAS_GT64 = false; // pcmpgtq is SSE4.2
+constexpr bool SFZ_ARR_VEC_HAS_EQ64 = false; // pcmpeqq is SSE4.1, emulated below
+
+sfz_forceinline SfzArrVec sfzArrVecLoad(const void* ptr) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr)); }
+sfz_forceinline SfzArrVec sfzArrVecOr(SfzArrVec a, SfzArrVec b) { return _mm_or_si128(a, b); }
+sfz_forceinline SfzArrVec sfzArrVecXor(SfzArrVec a, SfzArrVec b) { return _mm_xor_si128(a, b); }
+sfz_forceinline SfzArrVec sfzArrVecSelect(SfzArrVec mask, SfzArrVec a, SfzArrVec b)
+{
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+sfz_forceinline u64 sfzArrVecMask(SfzArrVec mask) { return u64(u32(_mm_movemask_epi8(mask))); }
+
+template<typename U>
+sfz_forceinline SfzArrVec sfzArrVecSplat(U v)
+{
+	if constexpr (sizeof(U) == 1) return _mm_set1_epi8(char(v));
+	else if constexpr (sizeof(U) == 2) return _mm_set1_epi16(short(v));
+	else if constexpr (sizeof(U) == 4) return _mm_set1_epi32(int(v));
+	else return _mm_set1_epi64x(i64(v));
+}
+
+template<typename U>
+sfz_forceinline SfzArrVec sfzArrVecEq(SfzArrVec a, SfzArrVec b)
+{
+	if constexpr (sizeof(U) == 1) return _mm_cmpeq_epi8(a, b);
+	else if constexpr (sizeof(U) == 2) return _mm_cmpeq_epi16(a, b);
+	else if constexpr (sizeof(U) == 4) return _mm_cmpeq_epi32(a, b);
+	else {
+		// pcmpeqq is SSE4.1, both 32-bit halves must be equal
+		const __m128i eq32 = _mm_cmpeq_epi32(a, b);
+		return _mm_and_si128(eq32, _mm_shuffle_epi32(eq32, _MM_SHUFFLE(2, 3, 0, 1)));
+	}
+}
+
+// Signed greater than, not available for 64-bit elements.
+template<typename U>
+sfz_forceinline SfzArrVec sfzArrVecGt(SfzArrVec a, SfzArrVec b)
+{
+	static_assert(sizeof(U) < 8, "");
+	if constexpr (sizeof(U) == 1) return _mm_cmpgt_epi8(a, b);
+	else if constexpr (sizeof(U) == 2) return _mm_cmpgt_epi16(a, b);
+	else return _mm_cmpgt_epi32(a, b);
+}
+
+#elif defined(SFZ_ARRAY_NEON)
+
+typedef uint8x16_t SfzArrVec;
+constexpr u32 SFZ_ARR_VEC_BYTES = 16;
+constexpr u32 SFZ_ARR_VEC_MASK_BITS_PER_BYTE = 4;
+constexpr bool SFZ_ARR_VEC_HAS_GT64 = true;
+constexpr bool SFZ_ARR_VEC_HAS_EQ64 = true;
+
+sfz_forceinline SfzArrVec sfzArrVecLoad(const void* ptr) { return vld1q_u8(reinterpret_cast<const u8*>(ptr)); }
+sfz_forceinline SfzArrVec sfzArrVecOr(SfzArrVec a, SfzArrVec b) { return vorrq_u8(a, b); }
+sfz_forceinline SfzArrVec sfzArrVecXor(SfzArrVec a, SfzArrVec b) { return veorq_u8(a, b); }
+sfz_forceinline SfzArrVec sfzArrVecSelect(SfzArrVec mask, SfzArrVec a, SfzArrVec b) { return vbslq_u8(mask, a, b); }
+sfz_forceinline u64 sfzArrVecMask(SfzArrVec mask)
+{
+	return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(mask), 4)), 0);
+}
+
+template<typename U>
+sfz_forceinline SfzArrVec sfzArrVecSplat(U v)
+{
+	if constexpr (sizeof(U) == 1) return vdupq_n_u8(u8(v));
+	else if constexpr (sizeof(U) == 2) return vreinterpretq_u8_u16(vdupq_n_u16(u16(v)));
+	else if constexpr (sizeof(U) == 4) return vreinterpretq_u8_u32(vdupq_n_u32(u32(v)));
+	else return vreinterpretq_u8_u64(vdupq_n_u64(u64(v)));
+}
+
+template<typename U>
+sfz_forceinline SfzArrVec sfzArrVecEq(SfzArrVec a, SfzArrVec b)
+{
+	if constexpr (sizeof(U) == 1) return vceqq_u8(a, b);
+	else if constexpr (sizeof(U) == 2) return vreinterpretq_u8_u16(vceqq_u16(vreinterpretq_u16_u8(a), vreinterpretq_u16_u8(b)));
+	else if constexpr (sizeof(U) == 4) return vreinterpretq_u8_u32(vceqq_u32(vreinterpretq_u32_u8(a), vreinterpretq_u32_u8(b)));
+	else return vreinterpretq_u8_u64(vceqq_u64(vreinterpretq_u64_u8(a), vreinterpretq_u64_u8(b)));
+}
+
+// Signed greater than.
+template<typename U>
+sfz_forceinline SfzArrVec sfzArrVecGt(SfzArrVec a, SfzArrVec b)
+{
+	if constexpr (sizeof(U) == 1) return vcgtq_s8(vreinterpretq_s8_u8(a), vreinterpretq_s8_u8(b));
+	else if constexpr (sizeof(U) == 2) return vreinterpretq_u8_u16(vcgtq_s16(vreinterpretq_s16_u8(a), vreinterpretq_s16_u8(b)));
+	else if constexpr (sizeof(U) == 4) return vreinterpretq_u8_u32(vcgtq_s32(vreinterpretq_s32_u8(a), vreinterpretq_s32_u8(b)));
+	else return vreinterpretq_u8_u64(vcgtq_s64(vreinterpretq_s64_u8(a), vreinterpretq_s64_u8(b)));
+}
+
+#endif
+
+// Returns index of the first element equal to value, n if not found. U is u8, u16, u32 or u64.
+template<typename U>
+inline u32 sfzArraySimdFind(const U* data, u32 n, U value)
+{
+	u32 i = 0;
+#ifdef SFZ_ARRAY_SIMD
+	constexpr u32 LANES = SFZ_ARR_VEC_BYTES / sizeof(U);
+	constexpr u32 MASK_BITS_PER_LANE = SFZ_ARR_VEC_MASK_BITS_PER_BYTE * sizeof(U);
+	const SfzArrVec k = sfzArrVecSplat<U>(value);
+
+	// Check 4 vectors per iteration, only figure out which one matched once any of them did
+	for (; (i + 4 * LANES) <= n; i += 4 * LANES) {
+		const SfzArrVec eq0 = sfzArrVecEq<U>(sfzArrVecLoad(data + i), k);
+		const SfzArrVec eq1 = sfzArrVecEq<U>(sfzArrVecLoad(data + i + LANES), k);
+		const SfzArrVec eq2 = sfzArrVecEq<U>(sfzArrVecLoad(data + i + 2 * LANES), k);
+		const SfzArrVec eq3 = sfzArrVecEq<U>(sfzArrVecLoad(data + i + 3 * LANES), k);
+		const SfzArrVec any = sfzArrVecOr(sfzArrVecOr(eq0, eq1), sfzArrVecOr(eq2, eq3));
+		if (sfzArrVecMask(any) != 0) break;
+	}
+	for (; (i + LANES) <= n; i += LANES) {
+		const u64 mask = sfzArrVecMask(sfzArrVecEq<U>(sfzArrVecLoad(data + i), k));
+		if (mask != 0) return i + sfzBitsCtz64(mask) / MASK_BITS_PER_LANE;
+	}
+#endif
+	for (; i < n; i++) if (data[i] == value) return i;
+	return n;
+}
+
+// Returns the number of elements equal to value. U is u8, u16, u32 or u64.
+template<typename U>
+inline u32 sfzArraySimdCount(const U* data, u32 n, U value)
+{
+	u32 i = 0;
+	u32 count = 0;
+#ifdef SFZ_ARRAY_SIMD
+	// The emulated 64-bit compare is slower than the scalar loop when every element is visited
+	if constexpr (sizeof(U) < 8 || SFZ_ARR_VEC_HAS_EQ64) {
+		constexpr u32 LANES = SFZ_ARR_VEC_BYTES / sizeof(U);
+		constexpr u32 MASK_BITS_PER_LANE = SFZ_ARR_VEC_MASK_BITS_PER_BYTE * sizeof(U);
+		const SfzArrVec k = sfzArrVecSplat<U>(value);
+
+		// Pack the masks of several vectors into one word per popcount, the popcount is a plain bit
+		// twiddling sequence unless SFZ_BITS_POPCNT is enabled.
+		constexpr u32 MASK_BITS = SFZ_ARR_VEC_BYTES * SFZ_ARR_VEC_MASK_BITS_PER_BYTE;
+		constexpr u32 VECS_PER_WORD = 64 / MASK_BITS;
+		u32 num_mask_bits = 0;
+		for (; (i + VECS_PER_WORD * LANES) <= n; i += VECS_PER_WORD * LANES) {
+			u64 word = 0;
+			for (u32 j = 0; j < VECS_PER_WORD; j++) {
+				word |= sfzArrVecMask(sfzArrVecEq<U>(sfzArrVecLoad(data + i + j * LANES), k)) << (j * MASK_BITS % 64);
+			}
+			num_mask_bits += sfzBitsPopCount64(word);
+		}
+		for (; (i + LANES) <= n; i += LANES) {
+			num_mask_bits += sfzBitsPopCount64(sfzArrVecMask(sfzArrVecEq<U>(sfzArrVecLoad(data + i), k)));
+		}
+		count = num_mask_bits / MASK_BITS_PER_LANE;
+	}
+#endif
+	for (; i < n; i++) count += (data[i] == value) ? 1 : 0;
+	return count;
+}
+
+// Returns the smallest (or largest if Max is true) element. I is a signed or unsigned integer type
+// of 1, 2, 4 or 8 bytes. Undefined if n is 0.
+template<typename I, bool Max>
+inline I sfzArraySimdMinMax(const I* data, u32 n)
+{
+	sfz_assert(n > 0);
+	I res = data[0];
+	u32 i = 1;
+#ifdef SFZ_ARRAY_SIMD
+	if constexpr (sizeof(I) < 8 || SFZ_ARR_VEC_HAS_GT64) {
+		using U = typename SfzArraySimdUint<sizeof(I)>::T;
+		constexpr u32 LANES = SFZ_ARR_VEC_BYTES / sizeof(I);
+		if (n >= LANES) {
+			// Only signed compares are available, flip the sign bit to compare unsigned elements
+			const U sign_bit = U(U(1) << (sizeof(U) * 8 - 1));
+			const SfzArrVec bias = sfzArrVecSplat<U>(SfzArraySimdTraits<I>::SIGNED ? U(0) : sign_bit);
+			SfzArrVec acc = sfzArrVecXor(sfzArrVecLoad(data), bias);
+			for (i = LANES; (i + LANES) <= n; i += LANES) {
+				const SfzArrVec v = sfzArrVecXor(sfzArrVecLoad(data + i), bias);
+				if constexpr (Max) acc = sfzArrVecSelect(sfzArrVecGt<U>(v, acc), v, acc);
+				else acc = sfzArrVecSelect(sfzArrVecGt<U>(acc, v), v, acc);
+			}
+			acc = sfzArrVecXor(acc, bias);
+			I lanes[LANES];
+			memcpy(lanes, &acc, sizeof(SfzArrVec));
+			for (u32 j = 0; j < LANES; j++) res = (Max ? (lanes[j] > res) : (lanes[j] < res)) ? lanes[j] : res;
+		}
+	}
+#endif
+	for (; i < n; i++) res = (Max ? (data[i] > res) : (data[i] < res)) ? data[i] : res;
+	return res;
+}
+
+// Implementations of the search methods shared by the array types, T is the element type.
+template<typename T>
+sfz_forceinline u32 sfzArrayFindIdx(const T* data, u32 n, const T& value)
+{
+	if constexpr (SfzArraySimdTraits<T>::BITWISE_EQ) {
+		using U = typename SfzArraySimdUint<sizeof(T)>::T;
+		U u; memcpy(&u, &value, sizeof(U));
+		return sfzArraySimdFind<U>(reinterpret_cast<const U*>(data), n, u);
+	}
+	else {
+		for (u32 i = 0; i < n; i++) if (data[i] == value) return i;
+		return n;
+	}
+}
+
+// Returns the index of the first smallest (or largest if Max is true) element, n if empty.
+template<typename T, bool Max>
+sfz_forceinline u32 sfzArrayMinMaxIdx(const T* data, u32 n)
+{
+	if (n == 0) return n;
+	return sfzArrayFindIdx(data, n, sfzArraySimdMinMax<T, Max>(data, n));
+}
+
+template<typename T>
+sfz_forceinline u32 sfzArrayCount(const T* data, u32 n, const T& value)
+{
+	if constexpr (SfzArraySimdTraits<T>::BITWISE_EQ) {
+		using U = typename SfzArraySimdUint<sizeof(T)>::T;
+		U u; memcpy(&u, &value, sizeof(U));
+		return sfzArraySimdCount<U>(reinterpret_cast<const U*>(data), n, u);
+	}
+	else {
+		u32 count = 0;
+		for (u32 i = 0; i < n; i++) count += (data[i] == value) ? 1 : 0;
+		return count;
+	}
+}
+
 // Array
 // ------------------------------------------------------------------------------------------------
 
@@ -183,9 +500,21 @@ public:
 	// O(1) operation unlike remove(), but obviously does not maintain internal array order.
 	void removeQuickSwap(u32 pos) { sfz_assert(pos < m_size); sfzSwap(m_data[pos], last()); remove(m_size - 1); }
 
-	// Finds the first instance of the given element, nullptr if not found.
-	T* findElement(const T& ref) { return findImpl(m_data, [&](const T& e) { return e == ref; }); }
-	const T* findElement(const T& ref) const { return findImpl(m_data, [&](const T& e) { return e == ref; }); }
+	// Finds the first instance of the given element, nullptr if not found. Uses SIMD for integer
+	// and handle types, see SfzArraySimdTraits.
+	T* findElement(const T& ref) { const u32 idx = sfzArrayFindIdx(m_data, m_size, ref); return idx < m_size ? m_data + idx : nullptr; }
+	const T* findElement(const T& ref) const { const u32 idx = sfzArrayFindIdx(m_data, m_size, ref); return idx < m_size ? m_data + idx : nullptr; }
+
+	// Returns whether the array contains the given element.
+	bool contains(const T& ref) const { return sfzArrayFindIdx(m_data, m_size, ref) < m_size; }
+
+	// Returns the number of elements equal to the given element.
+	u32 count(const T& ref) const { return sfzArrayCount(m_data, m_size, ref); }
+
+	// Returns pointer to the (first) smallest or largest element, nullptr if empty. Only available
+	// for integer types.
+	const T* minElement() const { static_assert(SfzArraySimdTraits<T>::INTEGER, ""); const u32 idx = sfzArrayMinMaxIdx<T, false>(m_data, m_size); return idx < m_size ? m_data + idx : nullptr; }
+	const T* maxElement() const { static_assert(SfzArraySimdTraits<T>::INTEGER, ""); const u32 idx = sfzArrayMinMaxIdx<T, true>(m_data, m_size); return idx < m_size ? m_data + idx : nullptr; }
 
 	// Finds the first element that satisfies the given function.
 	// Function should have signature: bool func(const T& element)
@@ -302,56 +631,347 @@ private:
 	SfzAllocator* m_allocator = nullptr;
 };
 
+// SfzChunkArray
+// ------------------------------------------------------------------------------------------------
+
+constexpr u32 SFZ_CHUNK_ARRAY_DEFAULT_CHUNK_NUM_BITS = 10; // 1024 elements per chunk
+constexpr u32 SFZ_CHUNK_ARRAY_MIN_NUM_CHUNK_PTRS = 16;
+
+// An append-mostly array made up of fixed size chunks, each chunk holds (1 << ChunkNumBits)
+// elements.
+//
+// Unlike SfzArray elements are never moved once added, growing just allocates another chunk (and
+// occasionally grows the small array of chunk pointers). This means that pointers to elements are
+// stable until the element is removed, and that there is no copy spike proportional to the size
+// of the array when it grows. Random access is still O(1), the index is split into a chunk index
+// and an index within the chunk using a shift and a mask.
+//
+// Elements can only be removed from the end (pop()) or all at once (clear()). If recycling is
+// enabled (default) chunks that become empty are kept around and reused when the array grows
+// again, otherwise they are returned to the allocator immediately.
+//
+// Iterating chunk by chunk (using chunk() and chunkSize(), or forEachChunk()) is the most
+// efficient way to iterate over all elements, as it avoids the index split for each element.
+template<typename T, u32 ChunkNumBits = SFZ_CHUNK_ARRAY_DEFAULT_CHUNK_NUM_BITS>
+class SfzChunkArray final {
+public:
+	SFZ_DECLARE_DROP_TYPE(SfzChunkArray);
+	using ValT = T;
+
+	static constexpr u32 CHUNK_NUM_BITS = ChunkNumBits;
+	static constexpr u32 CHUNK_SIZE = 1u << ChunkNumBits;
+	static constexpr u32 CHUNK_MASK = CHUNK_SIZE - 1u;
+	static_assert(ChunkNumBits < 31, "");
+
+	explicit SfzChunkArray(
+		u32 capacity, SfzAllocator* allocator, SfzDbgInfo alloc_dbg, bool recycle_chunks = true) noexcept
+	{
+		this->init(capacity, allocator, alloc_dbg, recycle_chunks);
+	}
+
+	// State methods
+	// --------------------------------------------------------------------------------------------
+
+	// Initializes with specified parameters. Allocates enough chunks to hold capacity elements,
+	// guaranteed to only set allocator and not allocate memory if a capacity of 0 is requested.
+	void init(u32 capacity, SfzAllocator* allocator, SfzDbgInfo alloc_dbg, bool recycle_chunks = true)
+	{
+		this->destroy();
+		m_allocator = allocator;
+		m_alloc_dbg = alloc_dbg;
+		m_recycle_chunks = recycle_chunks;
+		this->ensureCapacity(capacity);
+	}
+
+	// Removes all elements. Keeps the chunks if recycling is enabled, otherwise deallocates them.
+	void clear()
+	{
+		for (u32 i = 0; i < m_size; i++) (*this)[i].~T();
+		m_size = 0;
+		if (!m_recycle_chunks) this->freeUnusedChunks();
+	}
+
+	// Destroys all elements, deallocates memory and removes allocator.
+	void destroy()
+	{
+		for (u32 i = 0; i < m_size; i++) (*this)[i].~T();
+		m_size = 0;
+		for (u32 i = 0; i < m_num_chunks; i++) m_allocator->dealloc(m_chunks[i]);
+		if (m_chunks != nullptr) m_allocator->dealloc(m_chunks);
+		m_num_chunks = 0;
+		m_num_chunk_ptrs = 0;
+		m_chunks = nullptr;
+		m_allocator = nullptr;
+	}
+
+	// Allocates chunks until the array can hold at least capacity elements.
+	void ensureCapacity(u32 capacity)
+	{
+		while (this->capacity() < capacity) this->allocChunk();
+	}
+
+	// Deallocates all chunks not currently used to hold any elements.
+	void freeUnusedChunks()
+	{
+		const u32 num_used_chunks = this->numChunks();
+		for (u32 i = num_used_chunks; i < m_num_chunks; i++) {
+			m_allocator->dealloc(m_chunks[i]);
+			m_chunks[i] = nullptr;
+		}
+		m_num_chunks = num_used_chunks;
+	}
+
+	// Getters
+	// --------------------------------------------------------------------------------------------
+
+	u32 size() const { return m_size; }
+	u32 capacity() const { return m_num_chunks * CHUNK_SIZE; }
+	bool isEmpty() const { return m_size == 0; }
+	SfzAllocator* allocator() const { return m_allocator; }
+
+	T& operator[] (u32 idx) { sfz_assert(idx < m_size); return m_chunks[idx >> ChunkNumBits][idx & CHUNK_MASK]; }
+	const T& operator[] (u32 idx) const { sfz_assert(idx < m_size); return m_chunks[idx >> ChunkNumBits][idx & CHUNK_MASK]; }
+
+	T& first() { sfz_assert(m_size > 0); return m_chunks[0][0]; }
+	const T& first() const { sfz_assert(m_size > 0); return m_chunks[0][0]; }
+
+	T& last() { sfz_assert(m_size > 0); return (*this)[m_size - 1]; }
+	const T& last() const { sfz_assert(m_size > 0); return (*this)[m_size - 1]; }
+
+	// The number of chunks that currently hold elements, not counting recycled chunks.
+	u32 numChunks() const { return (m_size + CHUNK_MASK) >> ChunkNumBits; }
+
+	// Returns pointer to the first element of the given chunk, valid in range [0, chunkSize()).
+	T* chunk(u32 chunk_idx) { sfz_assert(chunk_idx < numChunks()); return m_chunks[chunk_idx]; }
+	const T* chunk(u32 chunk_idx) const { sfz_assert(chunk_idx < numChunks()); return m_chunks[chunk_idx]; }
+
+	// Returns the number of elements in the given chunk, only the last chunk can be partially full.
+	u32 chunkSize(u32 chunk_idx) const
+	{
+		sfz_assert(chunk_idx < numChunks());
+		const u32 first_idx = chunk_idx << ChunkNumBits;
+		return u32_min(m_size - first_idx, CHUNK_SIZE);
+	}
+
+	// Methods
+	// --------------------------------------------------------------------------------------------
+
+	// Adds an element to the end of the array, allocates a new chunk if needed. Returns reference
+	// to the added element, the reference stays valid until the element is removed.
+	T& add(const T& value) { return this->addImpl<const T&>(value); }
+	T& add(T&& value) { return this->addImpl<T>(sfz_move(value)); }
+	T& add() { return this->addImpl<T>({}); }
+
+	// Adds num_elements elements from ptr to the end of the array.
+	void add(const T* ptr, u32 num_elements) { for (u32 i = 0; i < num_elements; i++) this->addImpl<const T&>(ptr[i]); }
+
+	// Removes and returns the last element. Undefined if array is empty.
+	T pop()
+	{
+		sfz_assert(m_size > 0);
+		T& ref = (*this)[m_size - 1];
+		T tmp = sfz_move(ref);
+		ref.~T();
+		m_size -= 1;
+		if (!m_recycle_chunks && (m_size & CHUNK_MASK) == 0) this->freeUnusedChunks();
+		return sfz_move(tmp);
+	}
+
+	// Calls func for each chunk that contains elements.
+	// Function should have signature: void func(T* elements, u32 num_elements)
+	template<typename F>
+	void forEachChunk(F func)
+	{
+		const u32 num_used_chunks = this->numChunks();
+		for (u32 i = 0; i < num_used_chunks; i++) func(m_chunks[i], this->chunkSize(i));
+	}
+	template<typename F>
+	void forEachChunk(F func) const
+	{
+		const u32 num_used_chunks = this->numChunks();
+		for (u32 i = 0; i < num_used_chunks; i++) func(static_cast<const T*>(m_chunks[i]), this->chunkSize(i));
+	}
+
+private:
+	// Private methods
+	// --------------------------------------------------------------------------------------------
+
+	void allocChunk()
+	{
+		sfz_assert_hard(m_allocator != nullptr);
+		sfz_assert_hard(m_num_chunks < (U32_MAX >> ChunkNumBits));
+
+		// Grow the array of chunk pointers if needed, the chunks themselves are never moved
+		if (m_num_chunks == m_num_chunk_ptrs) {
+			const u32 new_num_chunk_ptrs = u32_max(m_num_chunk_ptrs * 2, SFZ_CHUNK_ARRAY_MIN_NUM_CHUNK_PTRS);
+			T** new_chunks = static_cast<T**>(m_allocator->alloc(m_alloc_dbg, sizeof(T*) * new_num_chunk_ptrs, 32));
+			memset(new_chunks, 0, sizeof(T*) * new_num_chunk_ptrs);
+			if (m_chunks != nullptr) {
+				memcpy(new_chunks, m_chunks, sizeof(T*) * m_num_chunks);
+				m_allocator->dealloc(m_chunks);
+			}
+			m_chunks = new_chunks;
+			m_num_chunk_ptrs = new_num_chunk_ptrs;
+		}
+
+		m_chunks[m_num_chunks] = static_cast<T*>(m_allocator->alloc(
+			m_alloc_dbg, sizeof(T) * CHUNK_SIZE, alignof(T) < 32 ? 32 : alignof(T)));
+		m_num_chunks += 1;
+	}
+
+	template<typename ForwardT>
+	T& addImpl(ForwardT&& value)
+	{
+		// Perfect forwarding: const reference: ForwardT == const T&, rvalue: ForwardT == T
+		if (m_size == this->capacity()) this->allocChunk();
+		T* ptr = m_chunks[m_size >> ChunkNumBits] + (m_size & CHUNK_MASK);
+		new (ptr) T(sfz_forward(value));
+		m_size += 1;
+		return *ptr;
+	}
+
+	// Private members
+	// --------------------------------------------------------------------------------------------
+
+	u32 m_size = 0;
+	u32 m_num_chunks = 0; // Number of allocated chunks, including recycled ones
+	u32 m_num_chunk_ptrs = 0;
+	bool m_recycle_chunks = true;
+	T** m_chunks = nullptr;
+	SfzAllocator* m_allocator = nullptr;
+	SfzDbgInfo m_alloc_dbg = {};
+};
+
 // SfzArrayLocal
 // ------------------------------------------------------------------------------------------------
 
+// The inline storage of SfzArrayLocal. Selected on whether T is trivially destructible, so that
+// SfzArrayLocal's (implicit) destructor is trivial whenever T's is.
+template<typename T, u32 Capacity, bool TriviallyDestructible = __is_trivially_destructible(T)>
+struct SfzArrayLocalStorage {
+	alignas(T) u8 m_storage[sizeof(T) * Capacity];
+	u32 m_size = 0;
+	u32 m_padding[3] = {};
+};
+
+template<typename T, u32 Capacity>
+struct SfzArrayLocalStorage<T, Capacity, false> {
+	alignas(T) u8 m_storage[sizeof(T) * Capacity];
+	u32 m_size = 0;
+	u32 m_padding[3] = {};
+
+	SfzArrayLocalStorage() = default;
+	SfzArrayLocalStorage(const SfzArrayLocalStorage&) = delete;
+	SfzArrayLocalStorage& operator= (const SfzArrayLocalStorage&) = delete;
+	~SfzArrayLocalStorage()
+	{
+		T* elements = reinterpret_cast<T*>(m_storage);
+		for (u32 i = 0; i < m_size; i++) elements[i].~T();
+	}
+};
+
+// A fixed capacity array with inline storage, i.e. no allocations.
+//
+// The storage is raw (uninitialized) memory, elements are only constructed when added and are
+// destroyed when removed. So constructing, clearing, copying, moving and swapping only costs
+// O(size), not O(Capacity). Trivially copyable types are copied and moved using memcpy().
 template<typename T, u32 Capacity>
-class SfzArrayLocal final {
+class SfzArrayLocal final : private SfzArrayLocalStorage<T, Capacity> {
+	using SfzArrayLocalStorage<T, Capacity>::m_storage;
+	using SfzArrayLocalStorage<T, Capacity>::m_size;
 public:
 	static_assert(alignof(T) <= 16, "");
+	static_assert(Capacity > 0, "");
 	using ValT = T;
+	static constexpr bool TRIVIAL = __is_trivially_copyable(T);
 
 	// Constructors & destructors
 	// --------------------------------------------------------------------------------------------
 
-	SfzArrayLocal() = default;
-	SfzArrayLocal(const SfzArrayLocal&) = default;
-	SfzArrayLocal& operator= (const SfzArrayLocal&) = default;
+	SfzArrayLocal() noexcept { }
+	SfzArrayLocal(const SfzArrayLocal& other) { this->add(other.data(), other.m_size); }
+	SfzArrayLocal& operator= (const SfzArrayLocal& other)
+	{
+		if (this != &other) {
+			this->clear();
+			this->add(other.data(), other.m_size);
+		}
+		return *this;
+	}
 	SfzArrayLocal(SfzArrayLocal&& other) noexcept { this->swap(other); }
 	SfzArrayLocal& operator= (SfzArrayLocal&& other) noexcept { this->swap(other); return *this; }
-	~SfzArrayLocal() = default;
+	// No destructor, the elements are destroyed by SfzArrayLocalStorage if needed
 
 	// State methods
 	// --------------------------------------------------------------------------------------------
 
 	void swap(SfzArrayLocal& other)
 	{
-		for (u32 i = 0; i < Capacity; i++) sfzSwap(this->m_data[i], other.m_data[i]);
+		if (this == &other) return;
+		if constexpr (TRIVIAL && sizeof(T) * Capacity <= 256) {
+			// Small enough that swapping the whole (fixed size) storage is cheaper
+			sfz_memswp(m_storage, other.m_storage, sizeof(T) * Capacity);
+		}
+		else if constexpr (TRIVIAL) {
+			sfz_memswp(m_storage, other.m_storage, sizeof(T) * u32_max(m_size, other.m_size));
+		}
+		else {
+			// Swap the common elements, then move the remaining ones from the larger array
+			const u32 num_common = u32_min(m_size, other.m_size);
+			for (u32 i = 0; i < num_common; i++) sfzSwap(this->data()[i], other.data()[i]);
+			SfzArrayLocal& larger = m_size > other.m_size ? *this : other;
+			SfzArrayLocal& smaller = m_size > other.m_size ? other : *this;
+			for (u32 i = num_common; i < larger.m_size; i++) {
+				new (smaller.data() + i) T(sfz_move(larger.data()[i]));
+				larger.data()[i].~T();
+			}
+		}
 		sfzSwap(this->m_size, other.m_size);
 	}
 
-	void clear() { sfz_assert(m_size <= Capacity); for (u32 i = 0; i < m_size; i++) m_data[i] = {}; m_size = 0; }
-	void setSize(u32 size) { sfz_assert(size <= Capacity); m_size = size; }
+	void clear()
+	{
+		sfz_assert(m_size <= Capacity);
+		if constexpr (!TRIVIAL) {
+			for (u32 i = 0; i < m_size; i++) data()[i].~T();
+		}
+		m_size = 0;
+	}
+
+	// Sets the size of the array, new elements are value initialized (i.e. zero:ed for pod types).
+	void setSize(u32 size)
+	{
+		sfz_assert(size <= Capacity);
+		if (size < m_size) {
+			if constexpr (!TRIVIAL) {
+				for (u32 i = size; i < m_size; i++) data()[i].~T();
+			}
+		}
+		else {
+			for (u32 i = m_size; i < size; i++) new (data() + i) T();
+		}
+		m_size = size;
+	}
 
 	// Getters
 	// --------------------------------------------------------------------------------------------
 
 	u32 size() const { return m_size; }
 	u32 capacity() const { return Capacity; }
-	const T* data() const { return m_data; }
-	T* data() { return m_data; }
+	const T* data() const { return reinterpret_cast<const T*>(m_storage); }
+	T* data() { return reinterpret_cast<T*>(m_storage); }
 
 	bool isEmpty() const { return m_size == 0; }
 	bool isFull() const { return m_size == Capacity; }
 
-	T& operator[] (u32 idx) { sfz_assert(idx < m_size); return m_data[idx]; }
-	const T& operator[] (u32 idx) const { sfz_assert(idx < m_size); return m_data[idx]; }
+	T& operator[] (u32 idx) { sfz_assert(idx < m_size); return data()[idx]; }
+	const T& operator[] (u32 idx) const { sfz_assert(idx < m_size); return data()[idx]; }
 
-	T& first() { sfz_assert(m_size > 0); return m_data[0]; }
-	const T& first() const { sfz_assert(m_size > 0); return m_data[0]; }
+	T& first() { sfz_assert(m_size > 0); return data()[0]; }
+	const T& first() const { sfz_assert(m_size > 0); return data()[0]; }
 
-	T& last() { sfz_assert(m_size > 0); return m_data[m_size - 1]; }
-	const T& last() const { sfz_assert(m_size > 0); return m_data[m_size - 1]; }
+	T& last() { sfz_assert(m_size > 0); return data()[m_size - 1]; }
+	const T& last() const { sfz_assert(m_size > 0); return data()[m_size - 1]; }
 
 	// Methods
 	// --------------------------------------------------------------------------------------------
@@ -364,12 +984,17 @@ public:
 	void add(const T* ptr, u32 num_elements)
 	{
 		sfz_assert((m_size + num_elements) <= Capacity);
-		for (u32 i = 0; i < num_elements; i++) m_data[m_size + i] = ptr[i];
+		if constexpr (TRIVIAL) {
+			if (num_elements > 0) memcpy(data() + m_size, ptr, sizeof(T) * num_elements);
+		}
+		else {
+			for (u32 i = 0; i < num_elements; i++) new (data() + m_size + i) T(ptr[i]);
+		}
 		m_size += num_elements;
 	}
 
 	// Adds a zero:ed element and returns reference to it.
-	T& add() { addImpl<T>({}, 1); return last(); }
+	T& add() { sfz_assert(m_size < Capacity); new (data() + m_size) T(); m_size += 1; return last(); }
 
 	// Insert elements into the array at the specified position.
 	void insert(u32 pos, const T& value) { insertImpl(pos, &value, 1); }
@@ -380,44 +1005,62 @@ public:
 	{
 		sfz_assert(m_size > 0);
 		m_size -= 1;
-		T tmp = sfz_move(m_data[m_size]);
-		m_data[m_size].~T();
+		T tmp = sfz_move(data()[m_size]);
+		data()[m_size].~T();
 		return sfz_move(tmp);
 	}
 
 	// Remove numElements elements starting at the specified position.
 	void remove(u32 pos, u32 num_elements = 1)
 	{
-		// Destroy elements
 		sfz_assert(pos < m_size);
 		if (num_elements > (m_size - pos)) num_elements = (m_size - pos);
-		for (u32 i = 0; i < num_elements; i++) m_data[pos + i] = {};
 
 		// Move the elements after the removed elements
-		u32 num_elements_to_move = m_size - pos - num_elements;
-		for (u32 i = 0; i < num_elements_to_move; i++) {
-			m_data[pos + i] = sfz_move(m_data[pos + i + num_elements]);
+		T* dst = data() + pos;
+		const T* src = data() + pos + num_elements;
+		const u32 num_elements_to_move = m_size - pos - num_elements;
+		if constexpr (TRIVIAL) {
+			if (num_elements_to_move > 0) memmove(dst, src, sizeof(T) * num_elements_to_move);
+		}
+		else {
+			for (u32 i = 0; i < num_elements_to_move; i++) dst[i] = sfz_move(data()[pos + num_elements + i]);
+
+			// Destroy the now unused elements at the end
+			for (u32 i = m_size - num_elements; i < m_size; i++) data()[i].~T();
 		}
 		m_size -= num_elements;
 	}
 
 	// Removes element at given position by swapping it with the last element in array.
 	// O(1) operation unlike remove(), but obviously does not maintain internal array order.
-	void removeQuickSwap(u32 pos) { sfz_assert(pos < m_size); sfzSwap(m_data[pos], last()); remove(m_size - 1); }
+	void removeQuickSwap(u32 pos) { sfz_assert(pos < m_size); sfzSwap(data()[pos], last()); remove(m_size - 1); }
+
+	// Finds the first instance of the given element, nullptr if not found. Uses SIMD for integer
+	// and handle types, see SfzArraySimdTraits.
+	T* findElement(const T& ref) { const u32 idx = sfzArrayFindIdx(data(), m_size, ref); return idx < m_size ? data() + idx : nullptr; }
+	const T* findElement(const T& ref) const { const u32 idx = sfzArrayFindIdx(data(), m_size, ref); return idx < m_size ? data() + idx : nullptr; }
+
+	// Returns whether the array contains the given element.
+	bool contains(const T& ref) const { return sfzArrayFindIdx(data(), m_size, ref) < m_size; }
 
-	// Finds the first instance of the given element, nullptr if not found.
-	T* findElement(const T& ref) { return findImpl(m_data, [&](const T& e) { return e == ref; }); }
-	const T* findElement(const T& ref) const { return findImpl(m_data, [&](const T& e) { return e == ref; }); }
+	// Returns the number of elements equal to the given element.
+	u32 count(const T& ref) const { return sfzArrayCount(data(), m_size, ref); }
+
+	// Returns pointer to the (first) smallest or largest element, nullptr if empty. Only available
+	// for integer types.
+	const T* minElement() const { static_assert(SfzArraySimdTraits<T>::INTEGER, ""); const u32 idx = sfzArrayMinMaxIdx<T, false>(data(), m_size); return idx < m_size ? data() + idx : nullptr; }
+	const T* maxElement() const { static_assert(SfzArraySimdTraits<T>::INTEGER, ""); const u32 idx = sfzArrayMinMaxIdx<T, true>(data(), m_size); return idx < m_size ? data() + idx : nullptr; }
 
 	// Finds the first element that satisfies the given function.
 	// Function should have signature: bool func(const T& element)
-	template<typename F> T* find(F func) { return findImpl(m_data, func); }
-	template<typename F> const T* find(F func) const { return findImpl(m_data, func); }
+	template<typename F> T* find(F func) { return findImpl(data(), func); }
+	template<typename F> const T* find(F func) const { return findImpl(data(), func); }
 
 	// Finds the last element that satisfies the given function.
 	// Function should have signature: bool func(const T& element)
-	template<typename F> T* findLast(F func) { return findLastImpl(m_data, func); }
-	template<typename F> const T* findLast(F func) const { return findLastImpl(m_data, func); }
+	template<typename F> T* findLast(F func) { return findLastImpl(data(), func); }
+	template<typename F> const T* findLast(F func) const { return findLastImpl(data(), func); }
 
 	// Sorts the elements in the array, same sort of comparator as std::sort().
 	void sort() { sortImpl([](const T& lhs, const T& rhs) { return lhs < rhs; }); }
@@ -426,13 +1069,13 @@ public:
 	// Iterator methods
 	// --------------------------------------------------------------------------------------------
 
-	T* begin() { return m_data; }
-	const T* begin() const { return m_data; }
-	const T* cbegin() const { return m_data; }
+	T* begin() { return data(); }
+	const T* begin() const { return data(); }
+	const T* cbegin() const { return data(); }
 
-	T* end() { return m_data + m_size; }
-	const T* end() const { return m_data + m_size; }
-	const T* cend() const { return m_data + m_size; }
+	T* end() { return data() + m_size; }
+	const T* end() const { return data() + m_size; }
+	const T* cend() const { return data() + m_size; }
 
 private:
 	// Private methods
@@ -444,7 +1087,12 @@ private:
 		// Perfect forwarding: const reference: ForwardT == const T&, rvalue: ForwardT == T
 		// std::forward<ForwardT>(value) will then return the correct version of value
 		sfz_assert((m_size + num_copies) <= Capacity);
-		for(u32 i = 0; i < num_copies; i++) m_data[m_size + i] = sfz_forward(value);
+		if (num_copies == 1) {
+			new (data() + m_size) T(sfz_forward(value));
+		}
+		else {
+			for (u32 i = 0; i < num_copies; i++) new (data() + m_size + i) T(value);
+		}
 		m_size += num_copies;
 	}
 
@@ -452,15 +1100,31 @@ private:
 	{
 		sfz_assert(pos <= m_size);
 		sfz_assert((m_size + num_elements) <= Capacity);
-
-		// Move elements
-		T* dstPtr = m_data + pos + num_elements;
-		T* srcPtr = m_data + pos;
-		u32 num_elements_to_move = (m_size - pos);
-		for (u32 i = num_elements_to_move; i > 0; i--) dstPtr[i - 1] = sfz_move(srcPtr[i - 1]);
-
-		// Insert elements
-		for (u32 i = 0; i < num_elements; ++i) m_data[pos + i] = ptr[i];
+		if (num_elements == 0) return;
+		const u32 num_elements_to_move = (m_size - pos);
+
+		if constexpr (TRIVIAL) {
+			if (num_elements_to_move > 0) {
+				memmove(data() + pos + num_elements, data() + pos, sizeof(T) * num_elements_to_move);
+			}
+			memcpy(data() + pos, ptr, sizeof(T) * num_elements);
+		}
+		else {
+			// Move elements, back to front. Elements moved past the old end are constructed.
+			for (u32 i = m_size; i > pos; i--) {
+				const u32 src_idx = i - 1;
+				const u32 dst_idx = i - 1 + num_elements;
+				if (dst_idx >= m_size) new (data() + dst_idx) T(sfz_move(data()[src_idx]));
+				else data()[dst_idx] = sfz_move(data()[src_idx]);
+			}
+
+			// Insert elements, assign to moved from elements and construct the rest
+			for (u32 i = 0; i < num_elements; ++i) {
+				const u32 idx = pos + i;
+				if (idx < m_size) data()[idx] = ptr[i];
+				else new (data() + idx) T(ptr[i]);
+			}
+		}
 		m_size += num_elements;
 	}
 
@@ -514,15 +1178,8 @@ private:
 		};
 
 		// Sort using C's qsort()
-		qsort(m_data, m_size, sizeof(T), c_compare_func);
+		qsort(data(), m_size, sizeof(T), c_compare_func);
 	}
-
-	// Private members
-	// --------------------------------------------------------------------------------------------
-
-	T m_data[Capacity] = {};
-	u32 m_size = 0;
-	u32 m_padding[3] = {};
 };
 
 template<typename T> using SfzArr4 = SfzArrayLocal<T, 4>;
@@ -546,5 +1203,345 @@ template<typename T> using SfzArr256 = SfzArrayLocal<T, 256>;
 template<typename T> using SfzArr320 = SfzArrayLocal<T, 320>;
 template<typename T> using SfzArr512 = SfzArrayLocal<T, 512>;
 
+// SfzSmallArray
+// ------------------------------------------------------------------------------------------------
+
+// A dynamic array with inline storage for the first N elements, same API as SfzArray.
+//
+// Elements are stored inline (i.e. inside the array object itself) until the size exceeds N, at
+// which point they are moved to memory from the allocator. Useful for arrays that are typically
+// small but can occasionally grow large, as no allocation is performed in the common case. An
+// allocator is only required if the array actually grows beyond N elements.
+//
+// As the inline storage is part of the object, moving an array that has not spilled to the heap
+// moves the individual elements (O(size)) instead of just swapping pointers.
+template<typename T, u32 N>
+class SfzSmallArray final {
+public:
+	static_assert(N > 0, "");
+	using ValT = T;
+	static constexpr u32 INLINE_CAPACITY = N;
+
+	SfzSmallArray() noexcept = default;
+	SfzSmallArray(const SfzSmallArray&) = delete;
+	SfzSmallArray& operator= (const SfzSmallArray&) = delete;
+	SfzSmallArray(SfzSmallArray&& other) noexcept { this->moveFrom(other); }
+	SfzSmallArray& operator= (SfzSmallArray&& other) noexcept
+	{
+		if (this != &other) {
+			this->destroy();
+			this->moveFrom(other);
+		}
+		return *this;
+	}
+	~SfzSmallArray() noexcept { this->destroy(); }
+
+	explicit SfzSmallArray(u32 capacity, SfzAllocator* allocator, SfzDbgInfo alloc_dbg) noexcept
+	{
+		this->init(capacity, allocator, alloc_dbg);
+	}
+
+	// State methods
+	// --------------------------------------------------------------------------------------------
+
+	// Initializes with specified parameters. Guaranteed to only set allocator and not allocate
+	// memory if a capacity of N or less is requested.
+	void init(u32 capacity, SfzAllocator* allocator, SfzDbgInfo alloc_dbg)
+	{
+		this->destroy();
+		m_allocator = allocator;
+		m_alloc_dbg = alloc_dbg;
+		this->ensureCapacity(capacity);
+	}
+
+	void swap(SfzSmallArray& other)
+	{
+		SfzSmallArray tmp = sfz_move(other);
+		other = sfz_move(*this);
+		*this = sfz_move(tmp);
+	}
+
+	// Removes all elements without deallocating memory.
+	void clear() { sfz_assert(m_size <= m_capacity); for (u32 i = 0; i < m_size; i++) m_data[i].~T(); m_size = 0; }
+
+	// Destroys all elements, deallocates memory and removes allocator.
+	void destroy()
+	{
+		this->clear();
+		if (!this->isInline()) m_allocator->dealloc(m_data);
+		m_capacity = N;
+		m_data = this->inlineData();
+		m_allocator = nullptr;
+		m_alloc_dbg = {};
+	}
+
+	// Directly sets the size without touching or initializing any elements. Only safe if T is a
+	// trivial type and you know what you are doing, use at your own risk.
+	void hackSetSize(u32 size) { m_size = (size <= m_capacity) ? size : m_capacity; }
+
+	// Sets the capacity, allocating memory and moving elements if necessary. A capacity of N or
+	// less moves the elements back to the inline storage.
+	void setCapacity(u32 capacity)
+	{
+		if (m_size > capacity) capacity = m_size;
+		if (capacity < N) capacity = N;
+		if (m_capacity == capacity) return;
+		sfz_assert_hard(capacity < SFZ_ARRAY_DYNAMIC_MAX_CAPACITY);
+
+		// Allocate memory (unless moving back to inline storage) and move over elements
+		T* new_data = this->inlineData();
+		if (capacity > N) {
+			sfz_assert_hard(m_allocator != nullptr);
+			new_data = (T*)m_allocator->alloc(
+				m_alloc_dbg, capacity * sizeof(T), alignof(T) < 32 ? 32 : alignof(T));
+		}
+		for (u32 i = 0; i < m_size; i++) {
+			new (new_data + i) T(sfz_move(m_data[i]));
+			m_data[i].~T();
+		}
+
+		if (!this->isInline()) m_allocator->dealloc(m_data);
+		m_capacity = capacity;
+		m_data = new_data;
+	}
+	void ensureCapacity(u32 capacity) { if (m_capacity < capacity) setCapacity(capacity); }
+
+	// Getters
+	// --------------------------------------------------------------------------------------------
+
+	u32 size() const { return m_size; }
+	u32 capacity() const { return m_capacity; }
+	const T* data() const { return m_data; }
+	T* data() { return m_data; }
+	SfzAllocator* allocator() const { return m_allocator; }
+
+	bool isEmpty() const { return m_size == 0; }
+
+	// Whether the elements are stored inline, i.e. the array has not spilled to the heap.
+	bool isInline() const { return m_data == this->inlineData(); }
+
+	T& operator[] (u32 idx) { sfz_assert(idx < m_size); return m_data[idx]; }
+	const T& operator[] (u32 idx) const { sfz_assert(idx < m_size); return m_data[idx]; }
+
+	T& first() { sfz_assert(m_size > 0); return m_data[0]; }
+	const T& first() const { sfz_assert(m_size > 0); return m_data[0]; }
+
+	T& last() { sfz_assert(m_size > 0); return m_data[m_size - 1]; }
+	const T& last() const { sfz_assert(m_size > 0); return m_data[m_size - 1]; }
+
+	// Methods
+	// --------------------------------------------------------------------------------------------
+
+	// Copy element numCopies times to the back of this array. Increases capacity if needed.
+	void add(const T& value, u32 num_copies = 1) { addImpl<const T&>(value, num_copies); }
+	void add(T&& value) { addImpl<T>(sfz_move(value), 1); }
+
+	// Copy numElements elements to the back of this array. Increases capacity if needed.
+	void add(const T* ptr, u32 num_elements)
+	{
+		growIfNeeded(num_elements);
+		for (u32 i = 0; i < num_elements; i++) new (this->m_data + m_size + i) T(ptr[i]);
+		m_size += num_elements;
+	}
+
+	// Adds a zero:ed element and returns reference to it.
+	T& add() { addImpl<T>({}, 1); return last(); }
+
+	// Insert elements into the array at the specified position. Increases capacity if needed.
+	void insert(u32 pos, const T& value) { insertImpl(pos, &value, 1); }
+	void insert(u32 pos, const T* ptr, u32 num_elements) { insertImpl(pos, ptr, num_elements); }
+
+	// Removes and returns the last element. Undefined if array is empty.
+	T pop()
+	{
+		sfz_assert(m_size > 0);
+		m_size -= 1;
+		T tmp = sfz_move(m_data[m_size]);
+		m_data[m_size].~T();
+		return sfz_move(tmp);
+	}
+
+	// Remove numElements elements starting at the specified position.
+	void remove(u32 pos, u32 num_elements = 1)
+	{
+		// Destroy elements
+		sfz_assert(pos < m_size);
+		if (num_elements > (m_size - pos)) num_elements = (m_size - pos);
+		for (u32 i = 0; i < num_elements; i++) m_data[pos + i].~T();
+
+		// Move the elements after the removed elements
+		u32 num_elements_to_move = m_size - pos - num_elements;
+		for (u32 i = 0; i < num_elements_to_move; i++) {
+			new (m_data + pos + i) T(sfz_move(m_data[pos + i + num_elements]));
+			m_data[pos + i + num_elements].~T();
+		}
+		m_size -= num_elements;
+	}
+
+	// Removes element at given position by swapping it with the last element in array.
+	// O(1) operation unlike remove(), but obviously does not maintain internal array order.
+	void removeQuickSwap(u32 pos) { sfz_assert(pos < m_size); sfzSwap(m_data[pos], last()); remove(m_size - 1); }
+
+	// Finds the first instance of the given element, nullptr if not found. Uses SIMD for integer
+	// and handle types, see SfzArraySimdTraits.
+	T* findElement(const T& ref) { const u32 idx = sfzArrayFindIdx(m_data, m_size, ref); return idx < m_size ? m_data + idx : nullptr; }
+	const T* findElement(const T& ref) const { const u32 idx = sfzArrayFindIdx(m_data, m_size, ref); return idx < m_size ? m_data + idx : nullptr; }
+
+	// Returns whether the array contains the given element.
+	bool contains(const T& ref) const { return sfzArrayFindIdx(m_data, m_size, ref) < m_size; }
+
+	// Returns the number of elements equal to the given element.
+	u32 count(const T& ref) const { return sfzArrayCount(m_data, m_size, ref); }
+
+	// Returns pointer to the (first) smallest or largest element, nullptr if empty. Only available
+	// for integer types.
+	const T* minElement() const { static_assert(SfzArraySimdTraits<T>::INTEGER, ""); const u32 idx = sfzArrayMinMaxIdx<T, false>(m_data, m_size); return idx < m_size ? m_data + idx : nullptr; }
+	const T* maxElement() const { static_assert(SfzArraySimdTraits<T>::INTEGER, ""); const u32 idx = sfzArrayMinMaxIdx<T, true>(m_data, m_size); return idx < m_size ? m_data + idx : nullptr; }
+
+	// Finds the first element that satisfies the given function.
+	// Function should have signature: bool func(const T& element)
+	template<typename F> T* find(F func) { return findImpl(m_data, func); }
+	template<typename F> const T* find(F func) const { return findImpl(m_data, func); }
+
+	// Finds the last element that satisfies the given function.
+	// Function should have signature: bool func(const T& element)
+	template<typename F> T* findLast(F func) { return findLastImpl(m_data, func); }
+	template<typename F> const T* findLast(F func) const { return findLastImpl(m_data, func); }
+
+	// Sorts the elements in the array, same sort of comparator as std::sort().
+	void sort() { sortImpl([](const T& lhs, const T& rhs) { return lhs < rhs; }); }
+	template<typename F> void sort(F compare_func) { sortImpl<F>(compare_func); }
+
+	// Iterator methods
+	// --------------------------------------------------------------------------------------------
+
+	T* begin() { return m_data; }
+	const T* begin() const { return m_data; }
+	const T* cbegin() const { return m_data; }
+
+	T* end() { return m_data + m_size; }
+	const T* end() const { return m_data + m_size; }
+	const T* cend() const { return m_data + m_size; }
+
+private:
+	// Private methods
+	// --------------------------------------------------------------------------------------------
+
+	T* inlineData() { return reinterpret_cast<T*>(m_inline); }
+	const T* inlineData() const { return reinterpret_cast<const T*>(m_inline); }
+
+	// Assumes this array is destroyed (empty, inline and without allocator).
+	void moveFrom(SfzSmallArray& other)
+	{
+		m_allocator = other.m_allocator;
+		m_alloc_dbg = other.m_alloc_dbg;
+		if (other.isInline()) {
+			for (u32 i = 0; i < other.m_size; i++) {
+				new (this->inlineData() + i) T(sfz_move(other.m_data[i]));
+				other.m_data[i].~T();
+			}
+			m_size = other.m_size;
+		}
+		else {
+			// Steal the heap allocation
+			m_size = other.m_size;
+			m_capacity = other.m_capacity;
+			m_data = other.m_data;
+			other.m_capacity = N;
+			other.m_data = other.inlineData();
+		}
+		other.m_size = 0;
+		other.m_allocator = nullptr;
+		other.m_alloc_dbg = {};
+	}
+
+	void growIfNeeded(u32 elements_to_add)
+	{
+		u32 new_size = m_size + elements_to_add;
+		if (new_size <= m_capacity) return;
+		u32 new_capacity = u32_max(u32(m_capacity * SFZ_ARRAY_DYNAMIC_GROW_RATE), new_size);
+		setCapacity(new_capacity);
+	}
+
+	template<typename ForwardT>
+	void addImpl(ForwardT&& value, u32 num_copies)
+	{
+		// Perfect forwarding: const reference: ForwardT == const T&, rvalue: ForwardT == T
+		// std::forward<ForwardT>(value) will then return the correct version of value
+		this->growIfNeeded(num_copies);
+		for(u32 i = 0; i < num_copies; i++) new (m_data + m_size + i) T(sfz_forward(value));
+		m_size += num_copies;
+	}
+
+	void insertImpl(u32 pos, const T* ptr, u32 num_elements)
+	{
+		sfz_assert(pos <= m_size);
+		if (num_elements == 0) return;
+		growIfNeeded(num_elements);
+
+		// Move elements
+		T* dst_ptr = m_data + pos + num_elements;
+		T* src_ptr = m_data + pos;
+		u32 num_elements_to_move = (m_size - pos);
+		for (u32 i = num_elements_to_move; i > 0; i--) {
+			u32 offs = i - 1;
+			new (dst_ptr + offs) T(sfz_move(src_ptr[offs]));
+			src_ptr[offs].~T();
+		}
+
+		// Insert elements
+		for (u32 i = 0; i < num_elements; ++i) new (this->m_data + pos + i) T(ptr[i]);
+		m_size += num_elements;
+	}
+
+	template<typename F>
+	T* findImpl(T* data, F func) const
+	{
+		for (u32 i = 0; i < m_size; ++i) if (func(data[i])) return &data[i];
+		return nullptr;
+	}
+
+	template<typename F>
+	T* findLastImpl(T* data, F func) const
+	{
+		for (u32 i = m_size; i > 0; i--) if (func(data[i - 1])) return &data[i - 1];
+		return nullptr;
+	}
+
+	template<typename F>
+	void sortImpl(F cpp_compare_func)
+	{
+		if (m_size == 0) return;
+
+		// Store pointer to compare in temp variable, fix so lambda don't have to capture.
+		static thread_local const F* cpp_compare_func_ptr = nullptr;
+		cpp_compare_func_ptr = &cpp_compare_func;
+
+		// Convert C++ compare function to qsort compatible C compare function
+		using CCompareT = int(const void*, const void*);
+		CCompareT* c_compare_func = [](const void* raw_lhs, const void* raw_rhs) -> int {
+			const T& lhs = *static_cast<const T*>(raw_lhs);
+			const T& rhs = *static_cast<const T*>(raw_rhs);
+			const bool lhs_smaller = (*cpp_compare_func_ptr)(lhs, rhs);
+			if (lhs_smaller) return -1;
+			const bool rhs_smaller = (*cpp_compare_func_ptr)(rhs, lhs);
+			if (rhs_smaller) return 1;
+			return 0;
+		};
+
+		// Sort using C's qsort()
+		qsort(m_data, m_size, sizeof(T), c_compare_func);
+	}
+
+	// Private members
+	// --------------------------------------------------------------------------------------------
+
+	u32 m_size = 0, m_capacity = N;
+	T* m_data = reinterpret_cast<T*>(m_inline); // Points to m_inline until spilled to the heap
+	SfzAllocator* m_allocator = nullptr;
+	SfzDbgInfo m_alloc_dbg = {};
+	alignas(T) u8 m_inline[sizeof(T) * N];
+};
+
 #endif // __cplusplus
 #endif // SKIPIFZERO_ARRAYS_HPP
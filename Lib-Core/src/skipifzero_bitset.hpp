@@ -0,0 +1,491 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#ifndef SKIPIFZERO_BITSET_HPP
+#define SKIPIFZERO_BITSET_HPP
+#pragma once
+
+#if defined(_M_X64) || defined(_M_AMD64)
+#include <intrin.h>
+#if defined(__AVX2__)
+#define SFZ_BITSET_AVX2
+#else
+#define SFZ_BITSET_SSE2
+#endif
+#elif defined(_M_ARM64)
+#include <intrin.h>
+#include <arm_neon.h>
+#define SFZ_BITSET_NEON
+#endif
+
+#include "sfz.h"
+#include "sfz_cpp.hpp"
+
+#ifdef __cplusplus
+
+// Word kernels
+// ------------------------------------------------------------------------------------------------
+
+// Kernels operating on raw arrays of u64 words, used to implement SfzBitset and SfzBitsetLocal.
+// dst may alias a and/or b.
+
+constexpr u32 SFZ_BITSET_WORD_NUM_BITS = 64;
+
+sfz_constexpr_func u32 sfzBitsNumWords(u32 num_bits) { return (num_bits + 63) / 64; }
+
+// Mask of the bits that are in use in the last word of a bitset with num_bits bits.
+sfz_constexpr_func u64 sfzBitsLastWordMask(u32 num_bits)
+{
+	return (num_bits % 64) == 0 ? ~u64(0) : ((u64(1) << (num_bits % 64)) - 1);
+}
+
+enum class SfzBitsOp : u32 { AND, OR, AND_NOT, XOR };
+
+template<SfzBitsOp Op>
+sfz_forceinline u64 sfzBitsOpScalar(u64 a, u64 b)
+{
+	if constexpr (Op == SfzBitsOp::AND) return a & b;
+	else if constexpr (Op == SfzBitsOp::OR) return a | b;
+	else if constexpr (Op == SfzBitsOp::AND_NOT) return a & ~b;
+	else return a ^ b;
+}
+
+// dst[i] = a[i] op b[i]
+template<SfzBitsOp Op>
+inline void sfzBitsApply(u64* dst, const u64* a, const u64* b, u32 num_words)
+{
+	u32 i = 0;
+#if defined(SFZ_BITSET_AVX2)
+	for (; (i + 4) <= num_words; i += 4) {
+		const __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+		const __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+		__m256i res;
+		if constexpr (Op == SfzBitsOp::AND) res = _mm256_and_si256(va, vb);
+		else if constexpr (Op == SfzBitsOp::OR) res = _mm256_or_si256(va, vb);
+		else if constexpr (Op == SfzBitsOp::AND_NOT) res = _mm256_andnot_si256(vb, va);
+		else res = _mm256_xor_si256(va, vb);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), res);
+	}
+#elif defined(SFZ_BITSET_SSE2)
+	for (; (i + 2) <= num_words; i += 2) {
+		const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+		const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+		__m128i res;
+		if constexpr (Op == SfzBitsOp::AND) res = _mm_and_si128(va, vb);
+		else if constexpr (Op == SfzBitsOp::OR) res = _mm_or_si128(va, vb);
+		else if constexpr (Op == SfzBitsOp::AND_NOT) res = _mm_andnot_si128(vb, va);
+		else res = _mm_xor_si128(va, vb);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), res);
+	}
+#elif defined(SFZ_BITSET_NEON)
+	for (; (i + 2) <= num_words; i += 2) {
+		const uint64x2_t va = vld1q_u64(a + i);
+		const uint64x2_t vb = vld1q_u64(b + i);
+		uint64x2_t res;
+		if constexpr (Op == SfzBitsOp::AND) res = vandq_u64(va, vb);
+		else if constexpr (Op == SfzBitsOp::OR) res = vorrq_u64(va, vb);
+		else if constexpr (Op == SfzBitsOp::AND_NOT) res = vbicq_u64(va, vb);
+		else res = veorq_u64(va, vb);
+		vst1q_u64(dst + i, res);
+	}
+#endif
+	for (; i < num_words; i++) dst[i] = sfzBitsOpScalar<Op>(a[i], b[i]);
+}
+
+// Returns the number of set bits in the words.
+inline u64 sfzBitsPopCount(const u64* words, u32 num_words)
+{
+	u64 count = 0;
+	u32 i = 0;
+#if defined(SFZ_BITSET_AVX2)
+	// Nibble lookup table using vpshufb, summed into 64-bit lanes using vpsadbw (Mula et al.)
+	const __m256i lookup = _mm256_setr_epi8(
+		0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+		0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i low_mask = _mm256_set1_epi8(0x0F);
+	__m256i acc = _mm256_setzero_si256();
+	for (; (i + 4) <= num_words; i += 4) {
+		const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i));
+		const __m256i lo = _mm256_and_si256(v, low_mask);
+		const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+		const __m256i cnt = _mm256_add_epi8(
+			_mm256_shuffle_epi8(lookup, lo), _mm256_shuffle_epi8(lookup, hi));
+		acc = _mm256_add_epi64(acc, _mm256_sad_epu8(cnt, _mm256_setzero_si256()));
+	}
+	count += u64(_mm256_extract_epi64(acc, 0)) + u64(_mm256_extract_epi64(acc, 1)) +
+		u64(_mm256_extract_epi64(acc, 2)) + u64(_mm256_extract_epi64(acc, 3));
+#elif defined(SFZ_BITSET_NEON)
+	for (; (i + 2) <= num_words; i += 2) {
+		const uint8x16_t v = vreinterpretq_u8_u64(vld1q_u64(words + i));
+		count += vaddlvq_u8(vcntq_u8(v));
+	}
+#endif
+	for (; i < num_words; i++) count += sfzBitsPopCount64(words[i]);
+	return count;
+}
+
+// Returns the index of the first set bit at or after start_idx, ~0u if there is none.
+inline u32 sfzBitsFindNextSet(const u64* words, u32 num_bits, u32 start_idx)
+{
+	if (start_idx >= num_bits) return ~0u;
+	const u32 num_words = sfzBitsNumWords(num_bits);
+	u32 word_idx = start_idx / 64;
+	u64 word = words[word_idx] & (~u64(0) << (start_idx % 64));
+	while (word == 0) {
+		word_idx += 1;
+		if (word_idx >= num_words) return ~0u;
+		word = words[word_idx];
+	}
+	const u32 idx = word_idx * 64 + sfzBitsCtz64(word);
+	return idx < num_bits ? idx : ~0u;
+}
+
+// Calls func(u32 idx) for each set bit, in increasing order.
+template<typename F>
+inline void sfzBitsForEachSet(const u64* words, u32 num_words, F func)
+{
+	for (u32 word_idx = 0; word_idx < num_words; word_idx++) {
+		u64 word = words[word_idx];
+		while (word != 0) {
+			func(word_idx * 64 + sfzBitsCtz64(word));
+			word &= word - 1; // Clear lowest set bit
+		}
+	}
+}
+
+// SfzBitset
+// ------------------------------------------------------------------------------------------------
+
+// A dynamically allocated bitset.
+//
+// Bits are stored in u64 words, bits past numBits() in the last word are always kept zero. Set
+// operations (and, or, andNot, xor) use AVX2 (x64 with /arch:AVX2), SSE2 (x64) or NEON (ARM64).
+// popCount() uses AVX2 or NEON, otherwise it falls back to sfzBitsPopCount64() per word.
+// findNextSet() skips empty words and uses tzcnt/bsf on the first non-empty one.
+// Operations between two bitsets require that both have the same number of bits.
+class SfzBitset final {
+public:
+	SFZ_DECLARE_DROP_TYPE(SfzBitset);
+
+	explicit SfzBitset(u32 num_bits, SfzAllocator* allocator, SfzDbgInfo alloc_dbg) noexcept
+	{
+		this->init(num_bits, allocator, alloc_dbg);
+	}
+
+	// State methods
+	// --------------------------------------------------------------------------------------------
+
+	// Initializes with the given number of bits, all set to zero. Guaranteed to only set allocator
+	// and not allocate memory if 0 bits are requested.
+	void init(u32 num_bits, SfzAllocator* allocator, SfzDbgInfo alloc_dbg)
+	{
+		this->destroy();
+		m_allocator = allocator;
+		this->setNumBits(num_bits, alloc_dbg);
+	}
+
+	void destroy()
+	{
+		if (m_words != nullptr) m_allocator->dealloc(m_words);
+		m_num_bits = 0;
+		m_word_capacity = 0;
+		m_words = nullptr;
+		m_allocator = nullptr;
+	}
+
+	// Changes the number of bits, new bits are zero. Only reallocates when growing past capacity.
+	void setNumBits(u32 num_bits, SfzDbgInfo alloc_dbg = sfz_dbg("Bitset"))
+	{
+		const u32 num_words = sfzBitsNumWords(num_bits);
+		if (num_words > m_word_capacity) {
+			sfz_assert_hard(m_allocator != nullptr);
+			const u32 new_capacity = sfzRoundUpAlignedU32(num_words, 4);
+			u64* new_words = static_cast<u64*>(m_allocator->alloc(alloc_dbg, sizeof(u64) * new_capacity, 32));
+			memset(new_words, 0, sizeof(u64) * new_capacity);
+			if (m_words != nullptr) {
+				memcpy(new_words, m_words, sizeof(u64) * numWords());
+				m_allocator->dealloc(m_words);
+			}
+			m_words = new_words;
+			m_word_capacity = new_capacity;
+		}
+
+		// Zero bits that are removed (or were masked out) so they are zero if grown again
+		if (num_bits < m_num_bits) {
+			const u32 old_num_words = numWords();
+			if (num_words > 0) m_words[num_words - 1] &= sfzBitsLastWordMask(num_bits);
+			for (u32 i = num_words; i < old_num_words; i++) m_words[i] = 0;
+		}
+		m_num_bits = num_bits;
+	}
+
+	// Getters
+	// --------------------------------------------------------------------------------------------
+
+	u32 numBits() const { return m_num_bits; }
+	u32 numWords() const { return sfzBitsNumWords(m_num_bits); }
+	const u64* words() const { return m_words; }
+	u64* words() { return m_words; } // Bits past numBits() must be kept zero.
+	SfzAllocator* allocator() const { return m_allocator; }
+
+	bool isSet(u32 idx) const { sfz_assert(idx < m_num_bits); return ((m_words[idx / 64] >> (idx % 64)) & 1) != 0; }
+	bool operator[] (u32 idx) const { return isSet(idx); }
+
+	u64 popCount() const { return sfzBitsPopCount(m_words, numWords()); }
+	bool any() const { for (u32 i = 0; i < numWords(); i++) { if (m_words[i] != 0) return true; } return false; }
+	bool none() const { return !any(); }
+
+	// Returns the index of the first set bit at or after start_idx, ~0u if there is none.
+	u32 findNextSet(u32 start_idx) const { return sfzBitsFindNextSet(m_words, m_num_bits, start_idx); }
+	u32 findFirstSet() const { return findNextSet(0); }
+
+	// Calls func(u32 idx) for each set bit, in increasing order.
+	template<typename F> void forEachSet(F func) const { sfzBitsForEachSet(m_words, numWords(), func); }
+
+	// Methods
+	// --------------------------------------------------------------------------------------------
+
+	void set(u32 idx) { sfz_assert(idx < m_num_bits); m_words[idx / 64] |= (u64(1) << (idx % 64)); }
+	void unset(u32 idx) { sfz_assert(idx < m_num_bits); m_words[idx / 64] &= ~(u64(1) << (idx % 64)); }
+	void toggle(u32 idx) { sfz_assert(idx < m_num_bits); m_words[idx / 64] ^= (u64(1) << (idx % 64)); }
+	void setTo(u32 idx, bool value) { if (value) set(idx); else unset(idx); }
+
+	void clearAll() { if (m_words != nullptr) memset(m_words, 0, sizeof(u64) * numWords()); }
+	void setAll()
+	{
+		const u32 num_words = numWords();
+		if (num_words == 0) return;
+		memset(m_words, 0xFF, sizeof(u64) * num_words);
+		m_words[num_words - 1] &= sfzBitsLastWordMask(m_num_bits);
+	}
+
+	void andWith(const SfzBitset& o) { applyOp<SfzBitsOp::AND>(o); }
+	void orWith(const SfzBitset& o) { applyOp<SfzBitsOp::OR>(o); }
+	void andNotWith(const SfzBitset& o) { applyOp<SfzBitsOp::AND_NOT>(o); }
+	void xorWith(const SfzBitset& o) { applyOp<SfzBitsOp::XOR>(o); }
+
+private:
+	// Private methods
+	// --------------------------------------------------------------------------------------------
+
+	template<SfzBitsOp Op>
+	void applyOp(const SfzBitset& o)
+	{
+		sfz_assert(m_num_bits == o.m_num_bits);
+		sfzBitsApply<Op>(m_words, m_words, o.m_words, numWords());
+	}
+
+	// Private members
+	// --------------------------------------------------------------------------------------------
+
+	u32 m_num_bits = 0;
+	u32 m_word_capacity = 0;
+	u64* m_words = nullptr;
+	SfzAllocator* m_allocator = nullptr;
+};
+
+// SfzBitsetLocal
+// ------------------------------------------------------------------------------------------------
+
+// A fixed size bitset stored inline, same API as SfzBitset.
+template<u32 NumBits>
+class SfzBitsetLocal final {
+public:
+	static_assert(NumBits > 0, "");
+	static constexpr u32 NUM_BITS = NumBits;
+	static constexpr u32 NUM_WORDS = sfzBitsNumWords(NumBits);
+
+	// Getters
+	// --------------------------------------------------------------------------------------------
+
+	u32 numBits() const { return NumBits; }
+	u32 numWords() const { return NUM_WORDS; }
+	const u64* words() const { return m_words; }
+	u64* words() { return m_words; } // Bits past numBits() must be kept zero.
+
+	bool isSet(u32 idx) const { sfz_assert(idx < NumBits); return ((m_words[idx / 64] >> (idx % 64)) & 1) != 0; }
+	bool operator[] (u32 idx) const { return isSet(idx); }
+
+	u64 popCount() const { return sfzBitsPopCount(m_words, NUM_WORDS); }
+	bool any() const { for (u32 i = 0; i < NUM_WORDS; i++) { if (m_words[i] != 0) return true; } return false; }
+	bool none() const { return !any(); }
+
+	u32 findNextSet(u32 start_idx) const { return sfzBitsFindNextSet(m_words, NumBits, start_idx); }
+	u32 findFirstSet() const { return findNextSet(0); }
+
+	template<typename F> void forEachSet(F func) const { sfzBitsForEachSet(m_words, NUM_WORDS, func); }
+
+	// Methods
+	// --------------------------------------------------------------------------------------------
+
+	void set(u32 idx) { sfz_assert(idx < NumBits); m_words[idx / 64] |= (u64(1) << (idx % 64)); }
+	void unset(u32 idx) { sfz_assert(idx < NumBits); m_words[idx / 64] &= ~(u64(1) << (idx % 64)); }
+	void toggle(u32 idx) { sfz_assert(idx < NumBits); m_words[idx / 64] ^= (u64(1) << (idx % 64)); }
+	void setTo(u32 idx, bool value) { if (value) set(idx); else unset(idx); }
+
+	void clearAll() { memset(m_words, 0, sizeof(m_words)); }
+	void setAll() { memset(m_words, 0xFF, sizeof(m_words)); m_words[NUM_WORDS - 1] &= sfzBitsLastWordMask(NumBits); }
+
+	void andWith(const SfzBitsetLocal& o) { sfzBitsApply<SfzBitsOp::AND>(m_words, m_words, o.m_words, NUM_WORDS); }
+	void orWith(const SfzBitsetLocal& o) { sfzBitsApply<SfzBitsOp::OR>(m_words, m_words, o.m_words, NUM_WORDS); }
+	void andNotWith(const SfzBitsetLocal& o) { sfzBitsApply<SfzBitsOp::AND_NOT>(m_words, m_words, o.m_words, NUM_WORDS); }
+	void xorWith(const SfzBitsetLocal& o) { sfzBitsApply<SfzBitsOp::XOR>(m_words, m_words, o.m_words, NUM_WORDS); }
+
+private:
+	// Private members
+	// --------------------------------------------------------------------------------------------
+
+	u64 m_words[NUM_WORDS] = {};
+};
+
+// SfzBitRankSelect
+// ------------------------------------------------------------------------------------------------
+
+constexpr u32 SFZ_BIT_RANK_BLOCK_NUM_WORDS = 8; // 512 bits per block, i.e. one cache line
+
+// Acceleration tables for rank and select queries on a bitset.
+//
+// rank(idx) is the number of set bits before idx, which is the compacted index of idx if idx is
+// set (e.g. the index of an active element in a densely packed array of only active elements).
+// select(rank) is the inverse, the index of the rank:th set bit.
+//
+// Stores the cumulative number of set bits before each 512 bit block (one u32 per cache line of
+// bits, ~6% overhead). rank() is then a table lookup plus at most 8 popcounts, select() is a
+// binary search over the blocks followed by a scan inside the block.
+//
+// The tables are a snapshot, they must be rebuilt with build() after the bitset is modified.
+class SfzBitRankSelect final {
+public:
+	SFZ_DECLARE_DROP_TYPE(SfzBitRankSelect);
+
+	// State methods
+	// --------------------------------------------------------------------------------------------
+
+	void init(SfzAllocator* allocator)
+	{
+		this->destroy();
+		m_allocator = allocator;
+	}
+
+	void destroy()
+	{
+		if (m_block_ranks != nullptr) m_allocator->dealloc(m_block_ranks);
+		m_words = nullptr;
+		m_num_bits = 0;
+		m_num_blocks = 0;
+		m_block_capacity = 0;
+		m_total = 0;
+		m_block_ranks = nullptr;
+		m_allocator = nullptr;
+	}
+
+	// Builds the tables for the given words. The words are referenced, not copied, so they must
+	// stay alive (and unmodified) while the tables are used.
+	void build(const u64* words, u32 num_bits)
+	{
+		sfz_assert_hard(m_allocator != nullptr);
+		const u32 num_words = sfzBitsNumWords(num_bits);
+		const u32 num_blocks = (num_words + SFZ_BIT_RANK_BLOCK_NUM_WORDS - 1) / SFZ_BIT_RANK_BLOCK_NUM_WORDS;
+		if (num_blocks > m_block_capacity) {
+			if (m_block_ranks != nullptr) m_allocator->dealloc(m_block_ranks);
+			m_block_ranks = static_cast<u32*>(m_allocator->alloc(
+				sfz_dbg("SfzBitRankSelect"), sizeof(u32) * num_blocks, 32));
+			m_block_capacity = num_blocks;
+		}
+		m_words = words;
+		m_num_bits = num_bits;
+		m_num_blocks = num_blocks;
+
+		u32 rank = 0;
+		for (u32 block_idx = 0; block_idx < num_blocks; block_idx++) {
+			m_block_ranks[block_idx] = rank;
+			const u32 first_word = block_idx * SFZ_BIT_RANK_BLOCK_NUM_WORDS;
+			const u32 block_num_words = u32_min(SFZ_BIT_RANK_BLOCK_NUM_WORDS, num_words - first_word);
+			rank += u32(sfzBitsPopCount(words + first_word, block_num_words));
+		}
+		m_total = rank;
+	}
+	void build(const SfzBitset& bitset) { build(bitset.words(), bitset.numBits()); }
+	template<u32 N> void build(const SfzBitsetLocal<N>& bitset) { build(bitset.words(), N); }
+
+	// Getters
+	// --------------------------------------------------------------------------------------------
+
+	// Total number of set bits.
+	u32 total() const { return m_total; }
+
+	// Returns the number of set bits in range [0, idx).
+	u32 rank(u32 idx) const
+	{
+		sfz_assert(idx <= m_num_bits);
+		if (idx == m_num_bits) return m_total;
+		const u32 word_idx = idx / 64;
+		const u32 block_idx = word_idx / SFZ_BIT_RANK_BLOCK_NUM_WORDS;
+		u32 rank = m_block_ranks[block_idx];
+		for (u32 i = block_idx * SFZ_BIT_RANK_BLOCK_NUM_WORDS; i < word_idx; i++) {
+			rank += sfzBitsPopCount64(m_words[i]);
+		}
+		const u64 mask_below = (u64(1) << (idx % 64)) - 1;
+		return rank + sfzBitsPopCount64(m_words[word_idx] & mask_below);
+	}
+
+	// Returns the index of the set bit with the given rank (0 is the first set bit), ~0u if
+	// rank >= total().
+	u32 select(u32 rank) const
+	{
+		if (rank >= m_total) return ~0u;
+
+		// Binary search for the last block whose starting rank is <= rank
+		u32 low = 0, high = m_num_blocks;
+		while ((high - low) > 1) {
+			const u32 mid = (low + high) / 2;
+			if (m_block_ranks[mid] <= rank) low = mid;
+			else high = mid;
+		}
+
+		// Scan words inside block
+		u32 remaining = rank - m_block_ranks[low];
+		u32 word_idx = low * SFZ_BIT_RANK_BLOCK_NUM_WORDS;
+		while (true) {
+			const u32 count = sfzBitsPopCount64(m_words[word_idx]);
+			if (remaining < count) break;
+			remaining -= count;
+			word_idx += 1;
+		}
+
+		// Select inside word by clearing the lowest set bits
+		u64 word = m_words[word_idx];
+		for (u32 i = 0; i < remaining; i++) word &= word - 1;
+		return word_idx * 64 + sfzBitsCtz64(word);
+	}
+
+private:
+	// Private members
+	// --------------------------------------------------------------------------------------------
+
+	const u64* m_words = nullptr;
+	u32 m_num_bits = 0;
+	u32 m_num_blocks = 0;
+	u32 m_block_capacity = 0;
+	u32 m_total = 0;
+	u32* m_block_ranks = nullptr;
+	SfzAllocator* m_allocator = nullptr;
+};
+
+#endif // __cplusplus
+#endif
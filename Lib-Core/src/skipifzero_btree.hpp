@@ -0,0 +1,795 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#ifndef SKIPIFZERO_BTREE_HPP
+#define SKIPIFZERO_BTREE_HPP
+#pragma once
+
+#if defined(_M_X64) || defined(_M_AMD64)
+#include <intrin.h>
+#if defined(__AVX2__)
+#define SFZ_BTREE_AVX2
+#else
+#define SFZ_BTREE_SSE2
+#endif
+#elif defined(_M_ARM64)
+#include <intrin.h>
+#include <arm_neon.h>
+#define SFZ_BTREE_NEON
+#endif
+
+#include "sfz.h"
+#include "sfz_cpp.hpp"
+
+// Key traits
+// ------------------------------------------------------------------------------------------------
+
+// Integer key types that get a SIMD in-node search. Unused key slots in a node are filled with
+// SENTINEL (the max value), so the search can always compare all slots without masking.
+template<typename K> struct SfzBTreeKeyTraits { static constexpr bool SIMD = false; };
+template<> struct SfzBTreeKeyTraits<i32> { static constexpr bool SIMD = true; static constexpr bool SIGNED = true; static constexpr i32 SENTINEL = I32_MAX; };
+template<> struct SfzBTreeKeyTraits<u32> { static constexpr bool SIMD = true; static constexpr bool SIGNED = false; static constexpr u32 SENTINEL = U32_MAX; };
+template<> struct SfzBTreeKeyTraits<i64> { static constexpr bool SIMD = true; static constexpr bool SIGNED = true; static constexpr i64 SENTINEL = I64_MAX; };
+template<> struct SfzBTreeKeyTraits<u64> { static constexpr bool SIMD = true; static constexpr bool SIGNED = false; static constexpr u64 SENTINEL = U64_MAX; };
+
+// Returns the number of keys in the node that are less than key, i.e. the lower bound index.
+//
+// For SIMD key types all Capacity slots are compared (unused slots contain the sentinel which is
+// never less than any key), so the loop has a fixed trip count and no branches. Other types do a
+// plain linear search over the used keys, which for cache line sized nodes is about as fast as a
+// binary search and much more predictable.
+template<typename K, u32 Capacity>
+sfz_forceinline u32 sfzBTreeCountLess(const K* keys, u32 num_keys, K key)
+{
+	using Traits = SfzBTreeKeyTraits<K>;
+	if constexpr (Traits::SIMD) {
+		(void)num_keys;
+#if defined(SFZ_BTREE_AVX2)
+		static_assert((Capacity * sizeof(K)) % 32 == 0, "");
+		u32 count = 0;
+		if constexpr (sizeof(K) == 4) {
+			const __m256i bias = _mm256_set1_epi32(Traits::SIGNED ? 0 : i32(0x80000000));
+			const __m256i k = _mm256_xor_si256(_mm256_set1_epi32(i32(key)), bias);
+			for (u32 i = 0; i < Capacity; i += 8) {
+				const __m256i v = _mm256_xor_si256(
+					_mm256_load_si256(reinterpret_cast<const __m256i*>(keys + i)), bias);
+				const __m256i lt = _mm256_cmpgt_epi32(k, v);
+				count += sfzBitsPopCount64(u64(u32(_mm256_movemask_ps(_mm256_castsi256_ps(lt)))));
+			}
+		}
+		else {
+			const __m256i bias = _mm256_set1_epi64x(Traits::SIGNED ? 0 : i64(0x8000000000000000ull));
+			const __m256i k = _mm256_xor_si256(_mm256_set1_epi64x(i64(key)), bias);
+			for (u32 i = 0; i < Capacity; i += 4) {
+				const __m256i v = _mm256_xor_si256(
+					_mm256_load_si256(reinterpret_cast<const __m256i*>(keys + i)), bias);
+				const __m256i lt = _mm256_cmpgt_epi64(k, v);
+				count += sfzBitsPopCount64(u64(u32(_mm256_movemask_pd(_mm256_castsi256_pd(lt)))));
+			}
+		}
+		return count;
+#elif defined(SFZ_BTREE_SSE2)
+		if constexpr (sizeof(K) == 4) {
+			static_assert((Capacity * sizeof(K)) % 16 == 0, "");
+			u32 count = 0;
+			const __m128i bias = _mm_set1_epi32(Traits::SIGNED ? 0 : i32(0x80000000));
+			const __m128i k = _mm_xor_si128(_mm_set1_epi32(i32(key)), bias);
+			for (u32 i = 0; i < Capacity; i += 4) {
+				const __m128i v = _mm_xor_si128(
+					_mm_load_si128(reinterpret_cast<const __m128i*>(keys + i)), bias);
+				const __m128i lt = _mm_cmpgt_epi32(k, v);
+				count += sfzBitsPopCount64(u64(u32(_mm_movemask_ps(_mm_castsi128_ps(lt)))));
+			}
+			return count;
+		}
+		else {
+			// SSE2 has no 64-bit compare, fixed trip count scalar loop instead
+			u32 count = 0;
+			for (u32 i = 0; i < Capacity; i++) count += u32(keys[i] < key);
+			return count;
+		}
+#elif defined(SFZ_BTREE_NEON)
+		static_assert((Capacity * sizeof(K)) % 16 == 0, "");
+		if constexpr (sizeof(K) == 4) {
+			uint32x4_t acc = vdupq_n_u32(0);
+			for (u32 i = 0; i < Capacity; i += 4) {
+				uint32x4_t lt;
+				if constexpr (Traits::SIGNED) lt = vcltq_s32(vld1q_s32(reinterpret_cast<const i32*>(keys + i)), vdupq_n_s32(i32(key)));
+				else lt = vcltq_u32(vld1q_u32(reinterpret_cast<const u32*>(keys + i)), vdupq_n_u32(u32(key)));
+				acc = vsubq_u32(acc, lt); // lt lanes are all ones (-1)
+			}
+			return vaddvq_u32(acc);
+		}
+		else {
+			uint64x2_t acc = vdupq_n_u64(0);
+			for (u32 i = 0; i < Capacity; i += 2) {
+				uint64x2_t lt;
+				if constexpr (Traits::SIGNED) lt = vcltq_s64(vld1q_s64(reinterpret_cast<const i64*>(keys + i)), vdupq_n_s64(i64(key)));
+				else lt = vcltq_u64(vld1q_u64(reinterpret_cast<const u64*>(keys + i)), vdupq_n_u64(u64(key)));
+				acc = vsubq_u64(acc, lt);
+			}
+			return u32(vaddvq_u64(acc));
+		}
+#else
+		u32 count = 0;
+		for (u32 i = 0; i < Capacity; i++) count += u32(keys[i] < key);
+		return count;
+#endif
+	}
+	else {
+		u32 idx = 0;
+		while (idx < num_keys && keys[idx] < key) idx++;
+		return idx;
+	}
+}
+
+// SfzBTreeMap
+// ------------------------------------------------------------------------------------------------
+
+constexpr u32 SFZ_BTREE_NODE_KEY_BYTES = 128; // Two cache lines of keys per node
+constexpr u32 SFZ_BTREE_NODE_ALIGNMENT = 64;
+
+template<typename K, typename V>
+struct SfzBTreeMapPair final {
+	const K& key;
+	V& value;
+	SfzBTreeMapPair(const K& key, V& value) noexcept : key(key), value(value) { }
+	SfzBTreeMapPair(const SfzBTreeMapPair&) noexcept = default;
+	SfzBTreeMapPair& operator= (const SfzBTreeMapPair&) = delete; // Because references...
+};
+
+// An ordered map implemented as a B+tree.
+//
+// All key value pairs are stored in leaves, which are linked together so that iterating over a
+// range of keys is a linear walk over leaves. Inner nodes only contain separator keys and child
+// pointers. Every node stores its keys in a separate 128 byte (two cache line) array, searching
+// a node only touches those two lines. For i32, u32, i64 and u64 keys the in-node search uses
+// SIMD comparisons (AVX2, SSE2 or NEON), other key types use a linear search with operator<.
+//
+// Keys must be trivially copyable and comparable with operator< and operator==. Values can be any
+// movable type. Pointers to values are invalidated by inserts and removes, as elements are moved
+// around when nodes are split, merged or rebalanced.
+template<typename K, typename V>
+class SfzBTreeMap final {
+public:
+	SFZ_DECLARE_DROP_TYPE(SfzBTreeMap);
+	using KeyT = K;
+	using ValT = V;
+
+	static_assert(__is_trivially_copyable(K), "Keys must be trivially copyable");
+	static_assert(alignof(K) <= SFZ_BTREE_NODE_ALIGNMENT, "");
+	static_assert(alignof(V) <= SFZ_BTREE_NODE_ALIGNMENT, "");
+
+	static constexpr u32 MAX_KEYS =
+		(SFZ_BTREE_NODE_KEY_BYTES / sizeof(K)) < 8 ? 8 : (SFZ_BTREE_NODE_KEY_BYTES / sizeof(K));
+	static constexpr u32 MIN_KEYS = MAX_KEYS / 2;
+	static constexpr u32 BULK_LOAD_FILL = MAX_KEYS - MAX_KEYS / 4; // Leave room for inserts
+
+	SfzBTreeMap(SfzAllocator* allocator, SfzDbgInfo alloc_dbg) noexcept
+	{
+		this->init(allocator, alloc_dbg);
+	}
+
+	// Nodes
+	// --------------------------------------------------------------------------------------------
+
+	struct alignas(SFZ_BTREE_NODE_ALIGNMENT) Node {
+		K keys[MAX_KEYS];
+		u32 num_keys;
+		u32 is_leaf;
+	};
+
+	struct InnerNode : Node {
+		Node* children[MAX_KEYS + 1];
+	};
+
+	struct LeafNode : Node {
+		LeafNode* prev;
+		LeafNode* next;
+		alignas(V) u8 value_storage[sizeof(V) * MAX_KEYS];
+		V* values() { return reinterpret_cast<V*>(value_storage); }
+	};
+
+	// Iterator
+	// --------------------------------------------------------------------------------------------
+
+	// Iterates over the elements in key order by walking the linked list of leaves. Invalidated by
+	// inserts and removes.
+	class Itr final {
+	public:
+		Itr() noexcept = default;
+		Itr(LeafNode* leaf, u32 idx) noexcept : m_leaf(leaf), m_idx(idx) { }
+
+		bool valid() const { return m_leaf != nullptr; }
+		const K& key() const { sfz_assert(valid()); return m_leaf->keys[m_idx]; }
+		V& value() const { sfz_assert(valid()); return m_leaf->values()[m_idx]; }
+
+		Itr& operator++ () // Pre-increment
+		{
+			sfz_assert(valid());
+			m_idx += 1;
+			if (m_idx >= m_leaf->num_keys) {
+				m_leaf = m_leaf->next;
+				m_idx = 0;
+			}
+			return *this;
+		}
+		Itr operator++ (int) { Itr copy = *this; ++(*this); return copy; } // Post-increment
+
+		// Steps to the previous element, becomes invalid when stepping before the first element.
+		Itr& operator-- () // Pre-decrement
+		{
+			sfz_assert(valid());
+			if (m_idx > 0) {
+				m_idx -= 1;
+			}
+			else {
+				m_leaf = m_leaf->prev;
+				m_idx = m_leaf != nullptr ? m_leaf->num_keys - 1 : 0;
+			}
+			return *this;
+		}
+		Itr operator-- (int) { Itr copy = *this; --(*this); return copy; } // Post-decrement
+
+		SfzBTreeMapPair<K, V> operator* () const { return SfzBTreeMapPair<K, V>(key(), value()); }
+		bool operator== (const Itr& o) const { return m_leaf == o.m_leaf && m_idx == o.m_idx; }
+		bool operator!= (const Itr& o) const { return !(*this == o); }
+
+	private:
+		LeafNode* m_leaf = nullptr;
+		u32 m_idx = 0;
+	};
+
+	// State methods
+	// --------------------------------------------------------------------------------------------
+
+	void init(SfzAllocator* allocator, SfzDbgInfo alloc_dbg)
+	{
+		this->destroy();
+		m_allocator = allocator;
+		m_alloc_dbg = alloc_dbg;
+	}
+
+	// Initializes the tree from strictly increasing keys (and their values) in O(n), without any
+	// node splits. Leaves and inner nodes are filled to BULK_LOAD_FILL keys, so there is room for
+	// later inserts without immediately splitting.
+	void initFromSorted(const K* keys, const V* values, u32 num_elements, SfzAllocator* allocator, SfzDbgInfo alloc_dbg)
+	{
+		this->init(allocator, alloc_dbg);
+		if (num_elements == 0) return;
+
+		// Keep track of the nodes of the level being built and the min key of their subtrees
+		u32 num_nodes = (num_elements + BULK_LOAD_FILL - 1) / BULK_LOAD_FILL;
+		Node** nodes = static_cast<Node**>(m_allocator->alloc(sfz_dbg("SfzBTreeMap bulk"), sizeof(Node*) * num_nodes, 32));
+		K* min_keys = static_cast<K*>(m_allocator->alloc(sfz_dbg("SfzBTreeMap bulk"), sizeof(K) * num_nodes, 32));
+
+		// Build leaves, elements distributed as evenly as possible between them
+		LeafNode* prev = nullptr;
+		u32 src_idx = 0;
+		for (u32 i = 0; i < num_nodes; i++) {
+			const u32 count = (num_elements / num_nodes) + (i < (num_elements % num_nodes) ? 1 : 0);
+			LeafNode* leaf = this->allocLeaf();
+			for (u32 j = 0; j < count; j++) {
+				sfz_assert(src_idx == 0 || keys[src_idx - 1] < keys[src_idx]); // Must be strictly increasing
+				leaf->keys[j] = keys[src_idx];
+				new (leaf->values() + j) V(values[src_idx]);
+				src_idx += 1;
+			}
+			leaf->num_keys = count;
+			leaf->prev = prev;
+			if (prev != nullptr) prev->next = leaf;
+			else m_first_leaf = leaf;
+			prev = leaf;
+			nodes[i] = leaf;
+			min_keys[i] = leaf->keys[0];
+		}
+		m_last_leaf = prev;
+		m_size = num_elements;
+		m_height = 1;
+
+		// Build inner levels on top until there is only a root left
+		while (num_nodes > 1) {
+			const u32 num_parents = (num_nodes + BULK_LOAD_FILL) / (BULK_LOAD_FILL + 1);
+			u32 child_idx = 0;
+			for (u32 i = 0; i < num_parents; i++) {
+				const u32 num_children = (num_nodes / num_parents) + (i < (num_nodes % num_parents) ? 1 : 0);
+				InnerNode* inner = this->allocInner();
+				const K min_key = min_keys[child_idx];
+				for (u32 j = 0; j < num_children; j++) {
+					inner->children[j] = nodes[child_idx];
+					if (j > 0) inner->keys[j - 1] = min_keys[child_idx];
+					child_idx += 1;
+				}
+				inner->num_keys = num_children - 1;
+				nodes[i] = inner;
+				min_keys[i] = min_key;
+			}
+			num_nodes = num_parents;
+			m_height += 1;
+		}
+		m_root = nodes[0];
+
+		m_allocator->dealloc(nodes);
+		m_allocator->dealloc(min_keys);
+	}
+
+	// Removes all elements and deallocates all nodes, keeps the allocator.
+	void clear()
+	{
+		if (m_root != nullptr) this->freeSubtree(m_root);
+		m_root = nullptr;
+		m_first_leaf = nullptr;
+		m_last_leaf = nullptr;
+		m_size = 0;
+		m_height = 0;
+	}
+
+	void destroy()
+	{
+		this->clear();
+		m_allocator = nullptr;
+	}
+
+	// Getters
+	// --------------------------------------------------------------------------------------------
+
+	u32 size() const { return m_size; }
+	bool isEmpty() const { return m_size == 0; }
+	u32 height() const { return m_height; }
+	SfzAllocator* allocator() const { return m_allocator; }
+
+	// Returns pointer to the value associated with the given key, nullptr if it does not exist.
+	V* get(const K& key)
+	{
+		if (m_root == nullptr) return nullptr;
+		LeafNode* leaf = this->findLeaf(key);
+		const u32 idx = countLess(leaf, key);
+		if (idx < leaf->num_keys && leaf->keys[idx] == key) return leaf->values() + idx;
+		return nullptr;
+	}
+	const V* get(const K& key) const { return const_cast<SfzBTreeMap*>(this)->get(key); }
+
+	bool contains(const K& key) const { return this->get(key) != nullptr; }
+
+	V& operator[] (const K& key) { V* ptr = get(key); sfz_assert_hard(ptr != nullptr); return *ptr; }
+	const V& operator[] (const K& key) const { const V* ptr = get(key); sfz_assert_hard(ptr != nullptr); return *ptr; }
+
+	// Returns an iterator to the first element whose key is not less than key.
+	Itr lowerBound(const K& key)
+	{
+		if (m_root == nullptr) return Itr();
+		LeafNode* leaf = this->findLeaf(key);
+		const u32 idx = countLess(leaf, key);
+		if (idx < leaf->num_keys) return Itr(leaf, idx);
+		return Itr(leaf->next, 0);
+	}
+
+	// Calls func for each element with key in range [first, last] in key order. Function should
+	// have signature: void func(const K& key, V& value)
+	template<typename F>
+	void forEachInRange(const K& first, const K& last, F func)
+	{
+		for (Itr itr = this->lowerBound(first); itr.valid() && !(last < itr.key()); ++itr) {
+			func(itr.key(), itr.value());
+		}
+	}
+
+	// Methods
+	// --------------------------------------------------------------------------------------------
+
+	// Adds the specified key value pair. If a value is already associated with the given key it
+	// will be replaced with the new value. Returns a reference to the element set, which is valid
+	// until the next insert or remove.
+	V& put(const K& key, const V& value) { return this->putImpl<const V&>(key, value); }
+	V& put(const K& key, V&& value) { return this->putImpl<V>(key, sfz_move(value)); }
+
+	// Removes the element associated with the given key. Returns false if there is no such
+	// element. Underfull nodes borrow from a sibling, or are merged with it if the sibling is at
+	// minimum occupancy.
+	bool remove(const K& key)
+	{
+		if (m_root == nullptr) return false;
+		const bool removed = this->removeRecursive(m_root, key);
+		if (!removed) return false;
+		m_size -= 1;
+
+		// Shrink tree if root is an inner node with a single child, or an empty leaf
+		if (!m_root->is_leaf && m_root->num_keys == 0) {
+			InnerNode* old_root = static_cast<InnerNode*>(m_root);
+			m_root = old_root->children[0];
+			m_allocator->dealloc(old_root);
+			m_height -= 1;
+		}
+		else if (m_root->is_leaf && m_root->num_keys == 0) {
+			this->clear();
+		}
+		return true;
+	}
+
+	// Iterator methods
+	// --------------------------------------------------------------------------------------------
+
+	Itr begin() { return Itr(m_first_leaf, 0); }
+	Itr end() { return Itr(); }
+
+	// Iterator to the last element (invalid if empty), for iterating in reverse with operator--.
+	Itr last() { return m_last_leaf != nullptr ? Itr(m_last_leaf, m_last_leaf->num_keys - 1) : Itr(); }
+
+private:
+	// Private methods
+	// --------------------------------------------------------------------------------------------
+
+	static u32 countLess(const Node* node, const K& key)
+	{
+		return sfzBTreeCountLess<K, MAX_KEYS>(node->keys, node->num_keys, key);
+	}
+
+	// Index of the child of an inner node that may contain key. Separator keys[i] is the smallest
+	// key in the subtree of children[i + 1].
+	static u32 childIdx(const Node* node, const K& key)
+	{
+		const u32 idx = countLess(node, key);
+		return (idx < node->num_keys && node->keys[idx] == key) ? idx + 1 : idx;
+	}
+
+	// Fills the key slots in [from, MAX_KEYS) with the sentinel, required for the SIMD search.
+	static void padKeys(Node* node, u32 from)
+	{
+		if constexpr (SfzBTreeKeyTraits<K>::SIMD) {
+			for (u32 i = from; i < MAX_KEYS; i++) node->keys[i] = SfzBTreeKeyTraits<K>::SENTINEL;
+		}
+		else {
+			(void)node;
+			(void)from;
+		}
+	}
+
+	static void setNumKeys(Node* node, u32 num_keys)
+	{
+		if (num_keys < node->num_keys) padKeys(node, num_keys);
+		node->num_keys = num_keys;
+	}
+
+	// Moves n values from src to (uninitialized) dst, handles overlapping ranges.
+	static void moveValues(V* dst, V* src, u32 n)
+	{
+		if (dst < src) {
+			for (u32 i = 0; i < n; i++) {
+				new (dst + i) V(sfz_move(src[i]));
+				src[i].~V();
+			}
+		}
+		else if (dst > src) {
+			for (u32 i = n; i > 0; i--) {
+				new (dst + i - 1) V(sfz_move(src[i - 1]));
+				src[i - 1].~V();
+			}
+		}
+	}
+
+	static void moveKeys(K* dst, const K* src, u32 n)
+	{
+		if (n > 0) memmove(dst, src, sizeof(K) * n);
+	}
+
+	LeafNode* allocLeaf()
+	{
+		sfz_assert_hard(m_allocator != nullptr);
+		LeafNode* leaf = static_cast<LeafNode*>(
+			m_allocator->alloc(m_alloc_dbg, sizeof(LeafNode), SFZ_BTREE_NODE_ALIGNMENT));
+		leaf->num_keys = 0;
+		leaf->is_leaf = 1;
+		leaf->prev = nullptr;
+		leaf->next = nullptr;
+		padKeys(leaf, 0);
+		return leaf;
+	}
+
+	InnerNode* allocInner()
+	{
+		sfz_assert_hard(m_allocator != nullptr);
+		InnerNode* inner = static_cast<InnerNode*>(
+			m_allocator->alloc(m_alloc_dbg, sizeof(InnerNode), SFZ_BTREE_NODE_ALIGNMENT));
+		inner->num_keys = 0;
+		inner->is_leaf = 0;
+		padKeys(inner, 0);
+		return inner;
+	}
+
+	void freeSubtree(Node* node)
+	{
+		if (node->is_leaf) {
+			LeafNode* leaf = static_cast<LeafNode*>(node);
+			for (u32 i = 0; i < leaf->num_keys; i++) leaf->values()[i].~V();
+		}
+		else {
+			InnerNode* inner = static_cast<InnerNode*>(node);
+			for (u32 i = 0; i <= inner->num_keys; i++) this->freeSubtree(inner->children[i]);
+		}
+		m_allocator->dealloc(node);
+	}
+
+	LeafNode* findLeaf(const K& key) const
+	{
+		Node* node = m_root;
+		while (!node->is_leaf) {
+			node = static_cast<InnerNode*>(node)->children[childIdx(node, key)];
+		}
+		return static_cast<LeafNode*>(node);
+	}
+
+	struct SplitResult {
+		Node* right; // nullptr if no split happened
+		K separator;
+	};
+
+	template<typename ForwardV>
+	V& putImpl(const K& key, ForwardV&& value)
+	{
+		if (m_root == nullptr) {
+			LeafNode* leaf = this->allocLeaf();
+			m_root = leaf;
+			m_first_leaf = leaf;
+			m_last_leaf = leaf;
+			m_height = 1;
+		}
+
+		V* value_ptr = nullptr;
+		const SplitResult split = this->insertRecursive(m_root, key, sfz_forward(value), value_ptr);
+		if (split.right != nullptr) {
+			InnerNode* new_root = this->allocInner();
+			new_root->keys[0] = split.separator;
+			new_root->children[0] = m_root;
+			new_root->children[1] = split.right;
+			new_root->num_keys = 1;
+			m_root = new_root;
+			m_height += 1;
+		}
+		sfz_assert(value_ptr != nullptr);
+		return *value_ptr;
+	}
+
+	template<typename ForwardV>
+	SplitResult insertRecursive(Node* node, const K& key, ForwardV&& value, V*& value_ptr_out)
+	{
+		if (node->is_leaf) {
+			LeafNode* leaf = static_cast<LeafNode*>(node);
+			const u32 idx = countLess(leaf, key);
+
+			// Replace existing value
+			if (idx < leaf->num_keys && leaf->keys[idx] == key) {
+				leaf->values()[idx] = sfz_forward(value);
+				value_ptr_out = leaf->values() + idx;
+				return SplitResult{ nullptr, {} };
+			}
+			m_size += 1;
+
+			// Split full leaf, upper half goes to new right sibling
+			SplitResult result = { nullptr, {} };
+			LeafNode* dst = leaf;
+			u32 dst_idx = idx;
+			if (leaf->num_keys == MAX_KEYS) {
+				const u32 mid = MAX_KEYS / 2;
+				LeafNode* right = this->allocLeaf();
+				moveKeys(right->keys, leaf->keys + mid, MAX_KEYS - mid);
+				moveValues(right->values(), leaf->values() + mid, MAX_KEYS - mid);
+				right->num_keys = MAX_KEYS - mid;
+				setNumKeys(leaf, mid);
+
+				right->next = leaf->next;
+				right->prev = leaf;
+				if (leaf->next != nullptr) leaf->next->prev = right;
+				else m_last_leaf = right;
+				leaf->next = right;
+
+				if (idx > mid) {
+					dst = right;
+					dst_idx = idx - mid;
+				}
+				result.right = right;
+			}
+
+			// Insert into dst
+			const u32 num_to_move = dst->num_keys - dst_idx;
+			moveKeys(dst->keys + dst_idx + 1, dst->keys + dst_idx, num_to_move);
+			moveValues(dst->values() + dst_idx + 1, dst->values() + dst_idx, num_to_move);
+			dst->keys[dst_idx] = key;
+			new (dst->values() + dst_idx) V(sfz_forward(value));
+			dst->num_keys += 1;
+			value_ptr_out = dst->values() + dst_idx;
+
+			if (result.right != nullptr) result.separator = result.right->keys[0];
+			return result;
+		}
+
+		InnerNode* inner = static_cast<InnerNode*>(node);
+		const u32 idx = childIdx(inner, key);
+		const SplitResult child_split =
+			this->insertRecursive(inner->children[idx], key, sfz_forward(value), value_ptr_out);
+		if (child_split.right == nullptr) return SplitResult{ nullptr, {} };
+
+		// Child was split, insert separator at idx and new child at idx + 1. Split this node first
+		// if it is full, the middle key is pushed up to the parent.
+		SplitResult result = { nullptr, {} };
+		InnerNode* dst = inner;
+		u32 dst_idx = idx;
+		if (inner->num_keys == MAX_KEYS) {
+			const u32 mid = MAX_KEYS / 2;
+			InnerNode* right = this->allocInner();
+			const u32 num_right_keys = MAX_KEYS - mid - 1;
+			moveKeys(right->keys, inner->keys + mid + 1, num_right_keys);
+			memcpy(right->children, inner->children + mid + 1, sizeof(Node*) * (num_right_keys + 1));
+			right->num_keys = num_right_keys;
+			result.right = right;
+			result.separator = inner->keys[mid];
+			setNumKeys(inner, mid);
+
+			if (idx > mid) {
+				dst = right;
+				dst_idx = idx - mid - 1;
+			}
+		}
+
+		const u32 num_to_move = dst->num_keys - dst_idx;
+		moveKeys(dst->keys + dst_idx + 1, dst->keys + dst_idx, num_to_move);
+		memmove(dst->children + dst_idx + 2, dst->children + dst_idx + 1, sizeof(Node*) * num_to_move);
+		dst->keys[dst_idx] = child_split.separator;
+		dst->children[dst_idx + 1] = child_split.right;
+		dst->num_keys += 1;
+		return result;
+	}
+
+	bool removeRecursive(Node* node, const K& key)
+	{
+		if (node->is_leaf) {
+			LeafNode* leaf = static_cast<LeafNode*>(node);
+			const u32 idx = countLess(leaf, key);
+			if (idx >= leaf->num_keys || !(leaf->keys[idx] == key)) return false;
+			leaf->values()[idx].~V();
+			const u32 num_to_move = leaf->num_keys - idx - 1;
+			moveKeys(leaf->keys + idx, leaf->keys + idx + 1, num_to_move);
+			moveValues(leaf->values() + idx, leaf->values() + idx + 1, num_to_move);
+			setNumKeys(leaf, leaf->num_keys - 1);
+			return true;
+		}
+
+		InnerNode* inner = static_cast<InnerNode*>(node);
+		const u32 idx = childIdx(inner, key);
+		const bool removed = this->removeRecursive(inner->children[idx], key);
+		if (removed && inner->children[idx]->num_keys < MIN_KEYS) this->rebalanceChild(inner, idx);
+		return removed;
+	}
+
+	// Fixes an underfull child by borrowing from or merging with a sibling.
+	void rebalanceChild(InnerNode* parent, u32 idx)
+	{
+		Node* child = parent->children[idx];
+		Node* left = idx > 0 ? parent->children[idx - 1] : nullptr;
+		Node* right = idx < parent->num_keys ? parent->children[idx + 1] : nullptr;
+
+		if (left != nullptr && left->num_keys > MIN_KEYS) {
+			this->borrowFromLeft(parent, idx, left, child);
+		}
+		else if (right != nullptr && right->num_keys > MIN_KEYS) {
+			this->borrowFromRight(parent, idx, child, right);
+		}
+		else if (left != nullptr) {
+			this->merge(parent, idx - 1, left, child);
+		}
+		else {
+			sfz_assert(right != nullptr);
+			this->merge(parent, idx, child, right);
+		}
+	}
+
+	void borrowFromLeft(InnerNode* parent, u32 idx, Node* left, Node* child)
+	{
+		if (child->is_leaf) {
+			LeafNode* l = static_cast<LeafNode*>(left);
+			LeafNode* c = static_cast<LeafNode*>(child);
+			moveKeys(c->keys + 1, c->keys, c->num_keys);
+			moveValues(c->values() + 1, c->values(), c->num_keys);
+			c->keys[0] = l->keys[l->num_keys - 1];
+			moveValues(c->values(), l->values() + l->num_keys - 1, 1);
+			c->num_keys += 1;
+			setNumKeys(l, l->num_keys - 1);
+			parent->keys[idx - 1] = c->keys[0];
+		}
+		else {
+			InnerNode* l = static_cast<InnerNode*>(left);
+			InnerNode* c = static_cast<InnerNode*>(child);
+			moveKeys(c->keys + 1, c->keys, c->num_keys);
+			memmove(c->children + 1, c->children, sizeof(Node*) * (c->num_keys + 1));
+			c->keys[0] = parent->keys[idx - 1];
+			c->children[0] = l->children[l->num_keys];
+			c->num_keys += 1;
+			parent->keys[idx - 1] = l->keys[l->num_keys - 1];
+			setNumKeys(l, l->num_keys - 1);
+		}
+	}
+
+	void borrowFromRight(InnerNode* parent, u32 idx, Node* child, Node* right)
+	{
+		if (child->is_leaf) {
+			LeafNode* c = static_cast<LeafNode*>(child);
+			LeafNode* r = static_cast<LeafNode*>(right);
+			c->keys[c->num_keys] = r->keys[0];
+			moveValues(c->values() + c->num_keys, r->values(), 1);
+			c->num_keys += 1;
+			moveKeys(r->keys, r->keys + 1, r->num_keys - 1);
+			moveValues(r->values(), r->values() + 1, r->num_keys - 1);
+			setNumKeys(r, r->num_keys - 1);
+			parent->keys[idx] = r->keys[0];
+		}
+		else {
+			InnerNode* c = static_cast<InnerNode*>(child);
+			InnerNode* r = static_cast<InnerNode*>(right);
+			c->keys[c->num_keys] = parent->keys[idx];
+			c->children[c->num_keys + 1] = r->children[0];
+			c->num_keys += 1;
+			parent->keys[idx] = r->keys[0];
+			moveKeys(r->keys, r->keys + 1, r->num_keys - 1);
+			memmove(r->children, r->children + 1, sizeof(Node*) * r->num_keys);
+			setNumKeys(r, r->num_keys - 1);
+		}
+	}
+
+	// Merges right into left and removes right (and the separator between them) from the parent.
+	void merge(InnerNode* parent, u32 sep_idx, Node* left, Node* right)
+	{
+		if (left->is_leaf) {
+			LeafNode* l = static_cast<LeafNode*>(left);
+			LeafNode* r = static_cast<LeafNode*>(right);
+			sfz_assert((l->num_keys + r->num_keys) <= MAX_KEYS);
+			moveKeys(l->keys + l->num_keys, r->keys, r->num_keys);
+			moveValues(l->values() + l->num_keys, r->values(), r->num_keys);
+			l->num_keys += r->num_keys;
+			l->next = r->next;
+			if (r->next != nullptr) r->next->prev = l;
+			else m_last_leaf = l;
+		}
+		else {
+			InnerNode* l = static_cast<InnerNode*>(left);
+			InnerNode* r = static_cast<InnerNode*>(right);
+			sfz_assert((l->num_keys + 1 + r->num_keys) <= MAX_KEYS);
+			l->keys[l->num_keys] = parent->keys[sep_idx];
+			moveKeys(l->keys + l->num_keys + 1, r->keys, r->num_keys);
+			memcpy(l->children + l->num_keys + 1, r->children, sizeof(Node*) * (r->num_keys + 1));
+			l->num_keys += 1 + r->num_keys;
+		}
+		m_allocator->dealloc(right);
+
+		const u32 num_to_move = parent->num_keys - sep_idx - 1;
+		moveKeys(parent->keys + sep_idx, parent->keys + sep_idx + 1, num_to_move);
+		memmove(parent->children + sep_idx + 1, parent->children + sep_idx + 2, sizeof(Node*) * num_to_move);
+		setNumKeys(parent, parent->num_keys - 1);
+	}
+
+	// Private members
+	// --------------------------------------------------------------------------------------------
+
+	u32 m_size = 0;
+	u32 m_height = 0;
+	Node* m_root = nullptr;
+	LeafNode* m_first_leaf = nullptr;
+	LeafNode* m_last_leaf = nullptr;
+	SfzAllocator* m_allocator = nullptr;
+	SfzDbgInfo m_alloc_dbg = {};
+};
+
+#endif
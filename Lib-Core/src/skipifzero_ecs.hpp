@@ -0,0 +1,532 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#ifndef SKIPIFZERO_ECS_HPP
+#define SKIPIFZERO_ECS_HPP
+#pragma once
+
+#include "sfz.h"
+#include "sfz_cpp.hpp"
+#include "skipifzero_arrays.hpp"
+#include "skipifzero_hash_maps.hpp"
+#include "skipifzero_pool.hpp"
+
+#ifdef __cplusplus
+
+// Constants
+// ------------------------------------------------------------------------------------------------
+
+constexpr u32 SFZ_ECS_MAX_NUM_COMPONENTS = 64; // One bit per component in a u64 mask
+constexpr u32 SFZ_ECS_MAX_COMPONENT_ALIGNMENT = 64;
+constexpr u32 SFZ_ECS_CHUNK_SIZE = 16 * 1024;
+constexpr u32 SFZ_ECS_CHUNK_ALIGNMENT = 64;
+constexpr u32 SFZ_ECS_NO_COLUMN = ~0u;
+
+// Archetype
+// ------------------------------------------------------------------------------------------------
+
+// An archetype stores all entities that have exactly the same set of components (the mask).
+//
+// The entities are stored in fixed size chunks (SFZ_ECS_CHUNK_SIZE bytes), each chunk contains
+// the same number of rows. Inside a chunk each component is stored as a tightly packed column,
+// i.e. a chunk has the layout:
+//
+//   [SfzHandle entities[rows_per_chunk]][Comp0 col[rows_per_chunk]][Comp1 col[rows_per_chunk]]...
+//
+// Rows are always packed, all chunks except the last are full. Removing a row moves the last row
+// of the archetype into the hole.
+struct SfzEcsArchetype final {
+	u64 mask = 0;
+	u32 rows_per_chunk = 0;
+	u32 num_rows = 0;
+	u32 num_components = 0;
+	u8 component_ids[SFZ_ECS_MAX_NUM_COMPONENTS]; // The components in mask, in increasing order
+	u32 column_offsets[SFZ_ECS_MAX_NUM_COMPONENTS]; // Indexed by component id, offset into chunk
+	SfzArray<u8*> chunks;
+
+	bool hasComponent(u32 comp_id) const { return column_offsets[comp_id] != SFZ_ECS_NO_COLUMN; }
+	bool matches(u64 with_mask, u64 without_mask) const
+	{
+		return (mask & with_mask) == with_mask && (mask & without_mask) == u64(0);
+	}
+};
+
+// A view of a single chunk of an archetype, this is what query functions are given.
+//
+// All columns are valid in the range [0, num_rows). The view is invalidated by structural changes
+// (creating or destroying entities, or changing their components).
+struct SfzEcsChunkView final {
+	const SfzHandle* entities = nullptr;
+	u32 num_rows = 0;
+	u8* chunk = nullptr;
+	const SfzEcsArchetype* archetype = nullptr;
+
+	// Returns the column for the given component, nullptr if the archetype does not contain it.
+	void* column(u32 comp_id) const
+	{
+		sfz_assert(comp_id < SFZ_ECS_MAX_NUM_COMPONENTS);
+		const u32 offset = archetype->column_offsets[comp_id];
+		if (offset == SFZ_ECS_NO_COLUMN) return nullptr;
+		return chunk + offset;
+	}
+	template<typename T> T* column(u32 comp_id) const { return static_cast<T*>(column(comp_id)); }
+};
+
+// Parallel dispatch
+// ------------------------------------------------------------------------------------------------
+
+// A task, the task_idx is in the range [0, num_tasks).
+typedef void SfzEcsTaskFunc(void* task_data, u32 task_idx);
+
+// A user supplied function that runs num_tasks tasks (potentially in parallel, on a job system or
+// thread pool). It must not return until all tasks have finished executing.
+typedef void SfzEcsDispatchFunc(
+	void* dispatch_userdata, u32 num_tasks, SfzEcsTaskFunc* task_func, void* task_data);
+
+// SfzEcsWorld
+// ------------------------------------------------------------------------------------------------
+
+sfz_struct(SfzEcsEntityLoc) {
+	u32 archetype_idx;
+	u32 row;
+};
+
+// An archetype based entity component storage.
+//
+// Components are registered with registerComponent() and are identified by a component id in the
+// range [0, 64), a set of components is represented by a u64 mask ((1 << comp_id) for each
+// component). Components must be trivially copyable, they are moved around using memcpy() and
+// new components are zero initialized.
+//
+// Entities are SfzHandles (allocated from an internal SfzPool), each entity belongs to exactly one
+// archetype which is determined by its component mask. Iterating over all entities with a given
+// set of components is done with query(), which visits each matching chunk in order. Each chunk
+// contains tightly packed columns, so iterating over them is as cache friendly as iterating over
+// plain arrays.
+//
+// Structural changes (changing which components an entity has) move the entity's row to another
+// archetype. changeComponentsBulk() moves all entities of matching archetypes at once, copying
+// whole column ranges instead of single rows.
+//
+// Pointers to components are invalidated by structural changes.
+class SfzEcsWorld final {
+public:
+	SFZ_DECLARE_DROP_TYPE(SfzEcsWorld);
+
+	explicit SfzEcsWorld(u32 max_num_entities, SfzAllocator* allocator, SfzDbgInfo alloc_dbg) noexcept
+	{
+		this->init(max_num_entities, allocator, alloc_dbg);
+	}
+
+	// State methods
+	// --------------------------------------------------------------------------------------------
+
+	void init(u32 max_num_entities, SfzAllocator* allocator, SfzDbgInfo alloc_dbg)
+	{
+		this->destroy();
+		m_allocator = allocator;
+		m_entities.init(max_num_entities, allocator, alloc_dbg);
+		m_archetypes.init(64, allocator, alloc_dbg);
+		m_archetype_map.init(128, allocator, alloc_dbg);
+		m_free_chunks.init(64, allocator, alloc_dbg);
+	}
+
+	void destroy()
+	{
+		for (SfzEcsArchetype& archetype : m_archetypes) {
+			for (u8* chunk : archetype.chunks) m_allocator->dealloc(chunk);
+		}
+		for (u8* chunk : m_free_chunks) m_allocator->dealloc(chunk);
+		m_entities.destroy();
+		m_archetypes.destroy();
+		m_archetype_map.destroy();
+		m_free_chunks.destroy();
+		m_num_components = 0;
+		m_allocator = nullptr;
+	}
+
+	// Getters
+	// --------------------------------------------------------------------------------------------
+
+	u32 numEntities() const { return m_entities.numAllocated(); }
+	u32 maxNumEntities() const { return m_entities.capacity(); }
+	u32 numComponents() const { return m_num_components; }
+	u64 registeredMask() const { return m_num_components == 64 ? ~u64(0) : ((u64(1) << m_num_components) - 1); }
+	u32 componentSize(u32 comp_id) const { sfz_assert(comp_id < m_num_components); return m_comp_sizes[comp_id]; }
+	u32 numArchetypes() const { return m_archetypes.size(); }
+	const SfzEcsArchetype& archetype(u32 idx) const { return m_archetypes[idx]; }
+
+	bool entityIsValid(SfzHandle entity) const { return m_entities.handleIsValid(entity); }
+
+	u64 entityMask(SfzHandle entity) const
+	{
+		const SfzEcsEntityLoc* loc = m_entities.get(entity);
+		if (loc == nullptr) return 0;
+		return m_archetypes[loc->archetype_idx].mask;
+	}
+
+	// Returns pointer to the given component of the entity, nullptr if entity is invalid or does
+	// not have the component.
+	void* getComponent(SfzHandle entity, u32 comp_id)
+	{
+		sfz_assert(comp_id < m_num_components);
+		const SfzEcsEntityLoc* loc = m_entities.get(entity);
+		if (loc == nullptr) return nullptr;
+		SfzEcsArchetype& archetype = m_archetypes[loc->archetype_idx];
+		const u32 offset = archetype.column_offsets[comp_id];
+		if (offset == SFZ_ECS_NO_COLUMN) return nullptr;
+		u8* chunk = archetype.chunks[loc->row / archetype.rows_per_chunk];
+		return chunk + offset + (loc->row % archetype.rows_per_chunk) * m_comp_sizes[comp_id];
+	}
+	const void* getComponent(SfzHandle entity, u32 comp_id) const { return const_cast<SfzEcsWorld*>(this)->getComponent(entity, comp_id); }
+
+	template<typename T> T* getComponent(SfzHandle entity, u32 comp_id) { sfz_assert(sizeof(T) == m_comp_sizes[comp_id]); return static_cast<T*>(getComponent(entity, comp_id)); }
+	template<typename T> const T* getComponent(SfzHandle entity, u32 comp_id) const { sfz_assert(sizeof(T) == m_comp_sizes[comp_id]); return static_cast<const T*>(getComponent(entity, comp_id)); }
+
+	// Methods
+	// --------------------------------------------------------------------------------------------
+
+	// Registers a component and returns its component id. The component data must be trivially
+	// copyable, as it is moved with memcpy().
+	u32 registerComponent(u32 size, u32 align)
+	{
+		sfz_assert_hard(m_num_components < SFZ_ECS_MAX_NUM_COMPONENTS);
+		sfz_assert_hard(align != 0 && (align & (align - 1)) == 0);
+		sfz_assert_hard(align <= SFZ_ECS_MAX_COMPONENT_ALIGNMENT);
+		const u32 comp_id = m_num_components;
+		m_comp_sizes[comp_id] = size;
+		m_comp_aligns[comp_id] = align;
+		m_num_components += 1;
+		return comp_id;
+	}
+
+	template<typename T>
+	u32 registerComponent()
+	{
+		static_assert(__is_trivially_copyable(T), "Components must be trivially copyable");
+		return registerComponent(sizeof(T), alignof(T));
+	}
+
+	// Creates an entity with the given components, all of which are zero initialized.
+	SfzHandle createEntity(u64 mask)
+	{
+		sfz_assert_hard(!m_entities.isFull());
+		const u32 archetype_idx = getOrCreateArchetype(mask);
+		const SfzHandle entity = m_entities.allocate();
+		SfzEcsArchetype& archetype = m_archetypes[archetype_idx];
+		const u32 row = allocateRow(archetype);
+		u8* chunk = archetype.chunks[row / archetype.rows_per_chunk];
+		const u32 row_in_chunk = row % archetype.rows_per_chunk;
+		reinterpret_cast<SfzHandle*>(chunk)[row_in_chunk] = entity;
+		for (u32 i = 0; i < archetype.num_components; i++) {
+			const u32 comp_id = archetype.component_ids[i];
+			const u32 size = m_comp_sizes[comp_id];
+			memset(chunk + archetype.column_offsets[comp_id] + row_in_chunk * size, 0, size);
+		}
+		m_entities[entity] = SfzEcsEntityLoc{ archetype_idx, row };
+		return entity;
+	}
+
+	void destroyEntity(SfzHandle entity)
+	{
+		const SfzEcsEntityLoc* loc = m_entities.get(entity);
+		if (loc == nullptr) return;
+		removeRow(loc->archetype_idx, loc->row);
+		m_entities.deallocate(entity);
+	}
+
+	// Destroys all entities that have all components in with_mask and none in without_mask.
+	void destroyEntitiesBulk(u64 with_mask, u64 without_mask = 0)
+	{
+		for (u32 archetype_idx = 0; archetype_idx < m_archetypes.size(); archetype_idx++) {
+			SfzEcsArchetype& archetype = m_archetypes[archetype_idx];
+			if (!archetype.matches(with_mask, without_mask)) continue;
+			for (u32 row = 0; row < archetype.num_rows; row++) {
+				const u8* chunk = archetype.chunks[row / archetype.rows_per_chunk];
+				m_entities.deallocate(reinterpret_cast<const SfzHandle*>(chunk)[row % archetype.rows_per_chunk]);
+			}
+			releaseAllRows(archetype);
+		}
+	}
+
+	// Changes the components of an entity, moving it to another archetype. Components that exist
+	// in both the old and the new mask are kept, new components are zero initialized.
+	void setComponents(SfzHandle entity, u64 new_mask)
+	{
+		const SfzEcsEntityLoc* loc = m_entities.get(entity);
+		sfz_assert(loc != nullptr);
+		if (loc == nullptr) return;
+		const SfzEcsEntityLoc src = *loc;
+		if (m_archetypes[src.archetype_idx].mask == new_mask) return;
+
+		// Note: Might grow m_archetypes, so can't take references to archetypes before this.
+		const u32 dst_idx = getOrCreateArchetype(new_mask);
+		SfzEcsArchetype& src_arch = m_archetypes[src.archetype_idx];
+		SfzEcsArchetype& dst_arch = m_archetypes[dst_idx];
+
+		const u32 dst_row = allocateRow(dst_arch);
+		copyRows(dst_arch, dst_row, src_arch, src.row, 1);
+		m_entities[entity] = SfzEcsEntityLoc{ dst_idx, dst_row };
+		removeRow(src.archetype_idx, src.row);
+	}
+	void addComponents(SfzHandle entity, u64 mask) { setComponents(entity, entityMask(entity) | mask); }
+	void removeComponents(SfzHandle entity, u64 mask) { setComponents(entity, entityMask(entity) & ~mask); }
+
+	// For all archetypes that have all components in with_mask and none in without_mask, adds the
+	// components in add_mask and removes the ones in remove_mask. Moves entire column ranges from
+	// the source archetype to the destination archetype instead of moving entities one by one.
+	void changeComponentsBulk(u64 with_mask, u64 without_mask, u64 add_mask, u64 remove_mask)
+	{
+		// Note: Archetypes created by this loop are not visited, they are all destinations.
+		const u32 num_archetypes = m_archetypes.size();
+		for (u32 src_idx = 0; src_idx < num_archetypes; src_idx++) {
+			if (!m_archetypes[src_idx].matches(with_mask, without_mask)) continue;
+			if (m_archetypes[src_idx].num_rows == 0) continue;
+			const u64 new_mask = (m_archetypes[src_idx].mask | add_mask) & ~remove_mask;
+			if (new_mask == m_archetypes[src_idx].mask) continue;
+			const u32 dst_idx = getOrCreateArchetype(new_mask);
+			moveAllRows(src_idx, dst_idx);
+		}
+	}
+
+	// Calls func for each chunk of each archetype that has all components in with_mask and none in
+	// without_mask. Function should have signature: void func(const SfzEcsChunkView& view)
+	//
+	// No structural changes are allowed from within func.
+	template<typename F>
+	void query(u64 with_mask, u64 without_mask, F func)
+	{
+		for (const SfzEcsArchetype& archetype : m_archetypes) {
+			if (!archetype.matches(with_mask, without_mask)) continue;
+			for (u32 chunk_idx = 0; chunk_idx < archetype.chunks.size(); chunk_idx++) {
+				const SfzEcsChunkView view = chunkView(archetype, chunk_idx);
+				if (view.num_rows == 0) break;
+				func(view);
+			}
+		}
+	}
+	template<typename F> void query(u64 with_mask, F func) { query<F>(with_mask, 0, func); }
+
+	// Same as query(), but gathers all matching chunks and lets the dispatch function run one
+	// task per chunk. If dispatch is nullptr the chunks are processed serially on this thread.
+	//
+	// func may be called from multiple threads at the same time, but each chunk is only visited
+	// once so writing to the chunk's own columns is safe.
+	template<typename F>
+	void queryParallel(
+		u64 with_mask, u64 without_mask, F func, SfzEcsDispatchFunc* dispatch, void* dispatch_userdata)
+	{
+		SfzArray<SfzEcsChunkView> views(0, m_allocator, sfz_dbg("SfzEcsWorld::queryParallel"));
+		for (const SfzEcsArchetype& archetype : m_archetypes) {
+			if (!archetype.matches(with_mask, without_mask)) continue;
+			for (u32 chunk_idx = 0; chunk_idx < archetype.chunks.size(); chunk_idx++) {
+				const SfzEcsChunkView view = chunkView(archetype, chunk_idx);
+				if (view.num_rows == 0) break;
+				views.add(view);
+			}
+		}
+		if (views.isEmpty()) return;
+
+		if (dispatch == nullptr) {
+			for (const SfzEcsChunkView& view : views) func(view);
+			return;
+		}
+
+		struct TaskData {
+			const SfzEcsChunkView* views;
+			F* func;
+		};
+		TaskData task_data = { views.data(), &func };
+		dispatch(dispatch_userdata, views.size(), [](void* data_ptr, u32 task_idx) {
+			TaskData& data = *static_cast<TaskData*>(data_ptr);
+			(*data.func)(data.views[task_idx]);
+		}, &task_data);
+	}
+
+private:
+	// Private methods
+	// --------------------------------------------------------------------------------------------
+
+	static SfzEcsChunkView chunkView(const SfzEcsArchetype& archetype, u32 chunk_idx)
+	{
+		const u32 first_row = chunk_idx * archetype.rows_per_chunk;
+		SfzEcsChunkView view;
+		view.chunk = archetype.chunks[chunk_idx];
+		view.entities = reinterpret_cast<const SfzHandle*>(view.chunk);
+		view.num_rows = archetype.num_rows > first_row ?
+			u32_min(archetype.num_rows - first_row, archetype.rows_per_chunk) : 0;
+		view.archetype = &archetype;
+		return view;
+	}
+
+	u32 getOrCreateArchetype(u64 mask)
+	{
+		sfz_assert_hard((mask & ~registeredMask()) == 0);
+		const u32* existing_idx = m_archetype_map.get(mask);
+		if (existing_idx != nullptr) return *existing_idx;
+
+		SfzEcsArchetype& archetype = m_archetypes.add();
+		archetype.mask = mask;
+		archetype.num_rows = 0;
+		archetype.num_components = 0;
+		archetype.chunks.init(0, m_allocator, sfz_dbg("SfzEcsArchetype::chunks"));
+		u32 bytes_per_row = sizeof(SfzHandle);
+		for (u32 comp_id = 0; comp_id < SFZ_ECS_MAX_NUM_COMPONENTS; comp_id++) {
+			archetype.column_offsets[comp_id] = SFZ_ECS_NO_COLUMN;
+			if ((mask & (u64(1) << comp_id)) == 0) continue;
+			archetype.component_ids[archetype.num_components] = u8(comp_id);
+			archetype.num_components += 1;
+			bytes_per_row += m_comp_sizes[comp_id];
+		}
+
+		// Find the largest number of rows that fits in a chunk when accounting for alignment of
+		// each column.
+		u32 rows_per_chunk = SFZ_ECS_CHUNK_SIZE / bytes_per_row;
+		sfz_assert_hard(rows_per_chunk > 0);
+		while (true) {
+			u32 offset = sizeof(SfzHandle) * rows_per_chunk;
+			for (u32 i = 0; i < archetype.num_components; i++) {
+				const u32 comp_id = archetype.component_ids[i];
+				offset = sfzRoundUpAlignedU32(offset, m_comp_aligns[comp_id]);
+				archetype.column_offsets[comp_id] = offset;
+				offset += m_comp_sizes[comp_id] * rows_per_chunk;
+			}
+			if (offset <= SFZ_ECS_CHUNK_SIZE) break;
+			rows_per_chunk -= 1;
+			sfz_assert_hard(rows_per_chunk > 0);
+		}
+		archetype.rows_per_chunk = rows_per_chunk;
+
+		const u32 archetype_idx = m_archetypes.size() - 1;
+		m_archetype_map.put(mask, archetype_idx);
+		return archetype_idx;
+	}
+
+	u8* allocateChunk()
+	{
+		if (!m_free_chunks.isEmpty()) return m_free_chunks.pop();
+		return static_cast<u8*>(m_allocator->alloc(
+			sfz_dbg("SfzEcsWorld chunk"), SFZ_ECS_CHUNK_SIZE, SFZ_ECS_CHUNK_ALIGNMENT));
+	}
+
+	u32 allocateRow(SfzEcsArchetype& archetype)
+	{
+		if (archetype.num_rows == archetype.chunks.size() * archetype.rows_per_chunk) {
+			archetype.chunks.add(allocateChunk());
+		}
+		const u32 row = archetype.num_rows;
+		archetype.num_rows += 1;
+		return row;
+	}
+
+	// Copies num_rows rows (including entity handles) from src to dst. Both ranges must be within
+	// a single chunk. Components in dst but not in src are zeroed, components only in src are
+	// ignored.
+	void copyRows(SfzEcsArchetype& dst, u32 dst_row, const SfzEcsArchetype& src, u32 src_row, u32 num_rows)
+	{
+		u8* dst_chunk = dst.chunks[dst_row / dst.rows_per_chunk];
+		const u8* src_chunk = src.chunks[src_row / src.rows_per_chunk];
+		const u32 dst_in_chunk = dst_row % dst.rows_per_chunk;
+		const u32 src_in_chunk = src_row % src.rows_per_chunk;
+		sfz_assert((dst_in_chunk + num_rows) <= dst.rows_per_chunk);
+		sfz_assert((src_in_chunk + num_rows) <= src.rows_per_chunk);
+
+		memcpy(reinterpret_cast<SfzHandle*>(dst_chunk) + dst_in_chunk,
+			reinterpret_cast<const SfzHandle*>(src_chunk) + src_in_chunk, sizeof(SfzHandle) * num_rows);
+		for (u32 i = 0; i < dst.num_components; i++) {
+			const u32 comp_id = dst.component_ids[i];
+			const u32 size = m_comp_sizes[comp_id];
+			u8* dst_col = dst_chunk + dst.column_offsets[comp_id] + dst_in_chunk * size;
+			if (src.hasComponent(comp_id)) {
+				memcpy(dst_col, src_chunk + src.column_offsets[comp_id] + src_in_chunk * size, size * num_rows);
+			}
+			else {
+				memset(dst_col, 0, size * num_rows);
+			}
+		}
+	}
+
+	// Removes a row by moving the last row of the archetype into it, updates the location of the
+	// moved entity.
+	void removeRow(u32 archetype_idx, u32 row)
+	{
+		SfzEcsArchetype& archetype = m_archetypes[archetype_idx];
+		sfz_assert(row < archetype.num_rows);
+		const u32 last_row = archetype.num_rows - 1;
+		if (row != last_row) {
+			copyRows(archetype, row, archetype, last_row, 1);
+			const SfzHandle moved = reinterpret_cast<const SfzHandle*>(
+				archetype.chunks[row / archetype.rows_per_chunk])[row % archetype.rows_per_chunk];
+			m_entities[moved].row = row;
+		}
+		archetype.num_rows -= 1;
+
+		// Release last chunk if it became empty
+		if (archetype.num_rows == (archetype.chunks.size() - 1) * archetype.rows_per_chunk) {
+			m_free_chunks.add(archetype.chunks.pop());
+		}
+	}
+
+	void releaseAllRows(SfzEcsArchetype& archetype)
+	{
+		for (u8* chunk : archetype.chunks) m_free_chunks.add(chunk);
+		archetype.chunks.clear();
+		archetype.num_rows = 0;
+	}
+
+	// Appends all rows of src to dst, copying the largest possible ranges at a time.
+	void moveAllRows(u32 src_idx, u32 dst_idx)
+	{
+		sfz_assert(src_idx != dst_idx);
+		SfzEcsArchetype& src = m_archetypes[src_idx];
+		SfzEcsArchetype& dst = m_archetypes[dst_idx];
+		u32 src_row = 0;
+		while (src_row < src.num_rows) {
+			if (dst.num_rows == dst.chunks.size() * dst.rows_per_chunk) dst.chunks.add(allocateChunk());
+			const u32 dst_row = dst.num_rows;
+			const u32 num_rows = u32_min(src.num_rows - src_row, u32_min(
+				src.rows_per_chunk - (src_row % src.rows_per_chunk),
+				dst.rows_per_chunk - (dst_row % dst.rows_per_chunk)));
+			copyRows(dst, dst_row, src, src_row, num_rows);
+
+			const SfzHandle* entities = reinterpret_cast<const SfzHandle*>(
+				dst.chunks[dst_row / dst.rows_per_chunk]) + (dst_row % dst.rows_per_chunk);
+			for (u32 i = 0; i < num_rows; i++) {
+				m_entities[entities[i]] = SfzEcsEntityLoc{ dst_idx, dst_row + i };
+			}
+			dst.num_rows += num_rows;
+			src_row += num_rows;
+		}
+		releaseAllRows(src);
+	}
+
+	// Private members
+	// --------------------------------------------------------------------------------------------
+
+	u32 m_num_components = 0;
+	u32 m_comp_sizes[SFZ_ECS_MAX_NUM_COMPONENTS] = {};
+	u32 m_comp_aligns[SFZ_ECS_MAX_NUM_COMPONENTS] = {};
+	SfzPool<SfzEcsEntityLoc> m_entities;
+	SfzArray<SfzEcsArchetype> m_archetypes;
+	SfzHashMap<u64, u32> m_archetype_map;
+	SfzArray<u8*> m_free_chunks;
+	SfzAllocator* m_allocator = nullptr;
+};
+
+#endif // __cplusplus
+#endif
@@ -0,0 +1,646 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#ifndef SKIPIFZERO_FILTERS_HPP
+#define SKIPIFZERO_FILTERS_HPP
+#pragma once
+
+#if (defined(_M_X64) || defined(_M_AMD64)) && defined(__AVX2__)
+#include <intrin.h>
+#define SFZ_FILTERS_AVX2
+#elif defined(_M_ARM64)
+#include <arm_neon.h>
+#define SFZ_FILTERS_NEON
+#endif
+
+#include "sfz.h"
+#include "sfz_cpp.hpp"
+#include "skipifzero_hash_maps.hpp" // sfzHash()
+
+// Filter helpers
+// ------------------------------------------------------------------------------------------------
+
+// Probabilistic membership filters. They answer "definitely not in set" or "maybe in set", and
+// are meant to be checked before a more expensive lookup (hash map probe, file system access,
+// etc) when most queries are expected to miss.
+//
+// Keys are hashed with sfzHash() and then mixed, so keys with weak sfzHash() implementations
+// (e.g. integers, which hash to themselves) still spread out properly.
+
+// Finalizer from MurmurHash3, full avalanche of all 64 bits.
+sfz_constexpr_func u64 sfzFilterMix64(u64 h)
+{
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDull;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ull;
+	h ^= h >> 33;
+	return h;
+}
+
+constexpr u32 SFZ_FILTER_VERSION = 1;
+constexpr u32 SFZ_BLOOM_FILTER_MAGIC = 0x46424653; // "SFBF"
+constexpr u32 SFZ_CUCKOO_FILTER_MAGIC = 0x46434653; // "SFCF"
+
+// SfzBloomFilter
+// ------------------------------------------------------------------------------------------------
+
+constexpr u32 SFZ_BLOOM_BLOCK_NUM_WORDS = 8;
+constexpr u32 SFZ_BLOOM_BLOCK_SIZE = SFZ_BLOOM_BLOCK_NUM_WORDS * sizeof(u32); // 32 bytes, 256 bits
+
+struct SfzBloomBlock { u32 words[SFZ_BLOOM_BLOCK_NUM_WORDS]; };
+static_assert(sizeof(SfzBloomBlock) == SFZ_BLOOM_BLOCK_SIZE, "");
+
+struct SfzBloomFilterHeader final {
+	u32 magic;
+	u32 version;
+	u32 num_blocks;
+	u32 padding;
+};
+static_assert(sizeof(SfzBloomFilterHeader) == 16, "");
+
+// Odd constants used to derive 8 independent bit indices from a 32-bit hash.
+alignas(32) constexpr u32 SFZ_BLOOM_SALTS[SFZ_BLOOM_BLOCK_NUM_WORDS] = {
+	0x47B6137Bu, 0x44974D91u, 0x8824AD5Bu, 0xA2B7289Du,
+	0x705495C7u, 0x2DF1424Bu, 0x9EFC4947u, 0x5C6BFB31u
+};
+
+// Estimates the false positive rate of a blocked Bloom filter with the given number of bits per
+// key. The number of keys in a block is Poisson distributed, the weights are computed without
+// normalization (to avoid exp()) and normalized at the end.
+inline f64 sfzBloomEstimateFalsePositiveRate(f64 bits_per_key)
+{
+	const f64 lambda = f64(SFZ_BLOOM_BLOCK_SIZE * 8) / bits_per_key;
+	const u32 max_j = u32(lambda + 10.0 * sfz_sqrt(f32(lambda)) + 20.0);
+	f64 weight = 1.0;
+	f64 weight_sum = 0.0;
+	f64 fpr_sum = 0.0;
+	f64 word_bit_unset = 1.0; // Probability that a specific bit in a word is unset with j keys
+	for (u32 j = 0; j <= max_j; j++) {
+		if (j > 0) {
+			weight *= lambda / f64(j);
+			word_bit_unset *= 31.0 / 32.0;
+		}
+		const f64 word_bit_set = 1.0 - word_bit_unset;
+		f64 fpr_j = word_bit_set;
+		for (u32 i = 1; i < SFZ_BLOOM_BLOCK_NUM_WORDS; i++) fpr_j *= word_bit_set;
+		weight_sum += weight;
+		fpr_sum += weight * fpr_j;
+	}
+	return fpr_sum / weight_sum;
+}
+
+// A split block Bloom filter.
+//
+// The filter is an array of 256-bit blocks, each made up of 8 32-bit words. A key selects one
+// block using the upper 32 bits of its hash, and then sets (or tests) exactly one bit in each of
+// the 8 words of that block using the lower 32 bits. So every operation touches a single 32 byte
+// aligned block (i.e. one cache line) and the 8 bit tests are done as one SIMD operation.
+//
+// Compared to a classic Bloom filter this needs slightly more bits per key for the same false
+// positive rate (roughly 10 bits for 1%, 16 bits for 0.1%), but a lookup is one cache miss instead
+// of k. Keys can not be removed, use SfzCuckooFilter if that is needed.
+class SfzBloomFilter final {
+public:
+	SFZ_DECLARE_DROP_TYPE(SfzBloomFilter);
+
+	explicit SfzBloomFilter(u32 max_num_keys, f32 target_fpr, SfzAllocator* allocator, SfzDbgInfo alloc_dbg) noexcept
+	{
+		this->init(max_num_keys, target_fpr, allocator, alloc_dbg);
+	}
+
+	// State methods
+	// --------------------------------------------------------------------------------------------
+
+	// Sizes the filter so that the false positive rate is at most target_fpr (e.g. 0.01f for 1%)
+	// once max_num_keys keys have been added.
+	void init(u32 max_num_keys, f32 target_fpr, SfzAllocator* allocator, SfzDbgInfo alloc_dbg)
+	{
+		sfz_assert(0.0f < target_fpr && target_fpr < 1.0f);
+		f64 bits_per_key = 4.0;
+		while (bits_per_key < 64.0 && sfzBloomEstimateFalsePositiveRate(bits_per_key) > f64(target_fpr)) {
+			bits_per_key += 0.25;
+		}
+		const f64 num_bits = f64(u32_max(max_num_keys, 1)) * bits_per_key;
+		const u64 num_blocks = u64(num_bits / f64(SFZ_BLOOM_BLOCK_SIZE * 8)) + 1;
+		sfz_assert_hard(num_blocks <= U32_MAX);
+		this->initBlocks(u32(num_blocks), allocator, alloc_dbg);
+	}
+
+	// Allocates a cleared filter with the given number of blocks.
+	void initBlocks(u32 num_blocks, SfzAllocator* allocator, SfzDbgInfo alloc_dbg)
+	{
+		this->destroy();
+		sfz_assert_hard(num_blocks > 0);
+		m_allocator = allocator;
+		m_num_blocks = num_blocks;
+		m_blocks = static_cast<SfzBloomBlock*>(
+			m_allocator->alloc(alloc_dbg, sizeof(SfzBloomBlock) * num_blocks, 64));
+		this->clear();
+	}
+
+	void clear()
+	{
+		if (m_blocks != nullptr) memset(m_blocks, 0, sizeof(SfzBloomBlock) * m_num_blocks);
+	}
+
+	void destroy()
+	{
+		if (m_blocks != nullptr) {
+			m_allocator->dealloc(m_blocks);
+		}
+		m_num_blocks = 0;
+		m_blocks = nullptr;
+		m_allocator = nullptr;
+	}
+
+	// Getters
+	// --------------------------------------------------------------------------------------------
+
+	u32 numBlocks() const { return m_num_blocks; }
+	u64 sizeBytes() const { return u64(m_num_blocks) * sizeof(SfzBloomBlock); }
+	const SfzBloomBlock* blocks() const { return m_blocks; }
+	SfzAllocator* allocator() const { return m_allocator; }
+
+	// Returns false if the key has definitely not been added, true if it might have been. Always
+	// false for an uninitialized filter.
+	template<typename K>
+	bool mayContain(const K& key) const { return this->mayContainHash(sfzHash(key)); }
+
+	bool mayContainHash(u64 hash) const
+	{
+		if (m_blocks == nullptr) return false;
+		const u64 h = sfzFilterMix64(hash);
+		const SfzBloomBlock& block = m_blocks[blockIdx(h)];
+		const u32 bit_hash = u32(h);
+#if defined(SFZ_FILTERS_AVX2)
+		const __m256i mask = makeMask(bit_hash);
+		return _mm256_testc_si256(_mm256_load_si256(reinterpret_cast<const __m256i*>(block.words)), mask) != 0;
+#elif defined(SFZ_FILTERS_NEON)
+		uint32x4_t mask_lo, mask_hi;
+		makeMask(bit_hash, mask_lo, mask_hi);
+		const uint32x4_t hit_lo = vceqq_u32(vandq_u32(vld1q_u32(block.words), mask_lo), mask_lo);
+		const uint32x4_t hit_hi = vceqq_u32(vandq_u32(vld1q_u32(block.words + 4), mask_hi), mask_hi);
+		return vminvq_u32(vandq_u32(hit_lo, hit_hi)) != 0;
+#else
+		u32 missing = 0;
+		for (u32 i = 0; i < SFZ_BLOOM_BLOCK_NUM_WORDS; i++) {
+			const u32 bit = 1u << ((bit_hash * SFZ_BLOOM_SALTS[i]) >> 27);
+			missing |= bit & ~block.words[i];
+		}
+		return missing == 0;
+#endif
+	}
+
+	// Methods
+	// --------------------------------------------------------------------------------------------
+
+	// Adds the key. The filter must be initialized, otherwise the key is dropped (and asserts).
+	template<typename K>
+	void add(const K& key) { this->addHash(sfzHash(key)); }
+
+	void addHash(u64 hash)
+	{
+		sfz_assert(m_blocks != nullptr);
+		if (m_blocks == nullptr) return;
+		const u64 h = sfzFilterMix64(hash);
+		SfzBloomBlock& block = m_blocks[blockIdx(h)];
+		const u32 bit_hash = u32(h);
+#if defined(SFZ_FILTERS_AVX2)
+		__m256i* block_ptr = reinterpret_cast<__m256i*>(block.words);
+		_mm256_store_si256(block_ptr, _mm256_or_si256(_mm256_load_si256(block_ptr), makeMask(bit_hash)));
+#elif defined(SFZ_FILTERS_NEON)
+		uint32x4_t mask_lo, mask_hi;
+		makeMask(bit_hash, mask_lo, mask_hi);
+		vst1q_u32(block.words, vorrq_u32(vld1q_u32(block.words), mask_lo));
+		vst1q_u32(block.words + 4, vorrq_u32(vld1q_u32(block.words + 4), mask_hi));
+#else
+		for (u32 i = 0; i < SFZ_BLOOM_BLOCK_NUM_WORDS; i++) {
+			block.words[i] |= 1u << ((bit_hash * SFZ_BLOOM_SALTS[i]) >> 27);
+		}
+#endif
+	}
+
+	// Adds all keys from another filter with the same number of blocks.
+	void merge(const SfzBloomFilter& other)
+	{
+		sfz_assert_hard(m_num_blocks == other.m_num_blocks);
+		for (u32 i = 0; i < m_num_blocks; i++) {
+			for (u32 j = 0; j < SFZ_BLOOM_BLOCK_NUM_WORDS; j++) {
+				m_blocks[i].words[j] |= other.m_blocks[i].words[j];
+			}
+		}
+	}
+
+	// Serialization
+	// --------------------------------------------------------------------------------------------
+
+	// The serialized format is a SfzBloomFilterHeader followed by the raw blocks, in the native
+	// byte order of the platform.
+	u64 serializedSizeBytes() const { return sizeof(SfzBloomFilterHeader) + this->sizeBytes(); }
+
+	// Writes the filter to dst, which must be at least serializedSizeBytes() large.
+	void serialize(u8* dst) const
+	{
+		SfzBloomFilterHeader header = {};
+		header.magic = SFZ_BLOOM_FILTER_MAGIC;
+		header.version = SFZ_FILTER_VERSION;
+		header.num_blocks = m_num_blocks;
+		memcpy(dst, &header, sizeof(SfzBloomFilterHeader));
+		memcpy(dst + sizeof(SfzBloomFilterHeader), m_blocks, this->sizeBytes());
+	}
+
+	// Initializes the filter from a serialized buffer. Returns false if the buffer is invalid.
+	bool deserialize(const u8* src, u64 src_size, SfzAllocator* allocator, SfzDbgInfo alloc_dbg)
+	{
+		this->destroy();
+		if (src_size < sizeof(SfzBloomFilterHeader)) return false;
+		SfzBloomFilterHeader header = {};
+		memcpy(&header, src, sizeof(SfzBloomFilterHeader));
+		if (header.magic != SFZ_BLOOM_FILTER_MAGIC) return false;
+		if (header.version != SFZ_FILTER_VERSION) return false;
+		if (header.num_blocks == 0) return false;
+		if (src_size < sizeof(SfzBloomFilterHeader) + u64(header.num_blocks) * sizeof(SfzBloomBlock)) return false;
+		this->initBlocks(header.num_blocks, allocator, alloc_dbg);
+		memcpy(m_blocks, src + sizeof(SfzBloomFilterHeader), this->sizeBytes());
+		return true;
+	}
+
+private:
+	// Private methods
+	// --------------------------------------------------------------------------------------------
+
+	// Maps the upper 32 bits of the hash to [0, m_num_blocks) without a division.
+	u32 blockIdx(u64 h) const { return u32(((h >> 32) * u64(m_num_blocks)) >> 32); }
+
+#if defined(SFZ_FILTERS_AVX2)
+	static sfz_forceinline __m256i makeMask(u32 bit_hash)
+	{
+		const __m256i salts = _mm256_load_si256(reinterpret_cast<const __m256i*>(SFZ_BLOOM_SALTS));
+		const __m256i shifts = _mm256_srli_epi32(_mm256_mullo_epi32(salts, _mm256_set1_epi32(i32(bit_hash))), 27);
+		return _mm256_sllv_epi32(_mm256_set1_epi32(1), shifts);
+	}
+#elif defined(SFZ_FILTERS_NEON)
+	static sfz_forceinline void makeMask(u32 bit_hash, uint32x4_t& mask_lo, uint32x4_t& mask_hi)
+	{
+		const uint32x4_t h = vdupq_n_u32(bit_hash);
+		const uint32x4_t one = vdupq_n_u32(1);
+		const uint32x4_t shifts_lo = vshrq_n_u32(vmulq_u32(vld1q_u32(SFZ_BLOOM_SALTS), h), 27);
+		const uint32x4_t shifts_hi = vshrq_n_u32(vmulq_u32(vld1q_u32(SFZ_BLOOM_SALTS + 4), h), 27);
+		mask_lo = vshlq_u32(one, vreinterpretq_s32_u32(shifts_lo));
+		mask_hi = vshlq_u32(one, vreinterpretq_s32_u32(shifts_hi));
+	}
+#endif
+
+	// Private members
+	// --------------------------------------------------------------------------------------------
+
+	u32 m_num_blocks = 0;
+	SfzBloomBlock* m_blocks = nullptr;
+	SfzAllocator* m_allocator = nullptr;
+};
+
+// SfzCuckooFilter
+// ------------------------------------------------------------------------------------------------
+
+constexpr u32 SFZ_CUCKOO_BUCKET_SIZE = 4; // Number of fingerprints per bucket
+constexpr u32 SFZ_CUCKOO_MAX_KICKS = 500;
+constexpr f32 SFZ_CUCKOO_MAX_LOAD_FACTOR = 0.84f; // Conservative, 8-bit fingerprints fill up around 85-90%
+
+struct SfzCuckooFilterHeader final {
+	u32 magic;
+	u32 version;
+	u32 num_buckets;
+	u32 fingerprint_bits;
+	u32 num_keys;
+	u32 victim_fingerprint; // 0 if no victim
+	u32 victim_bucket;
+	u32 padding;
+};
+static_assert(sizeof(SfzCuckooFilterHeader) == 32, "");
+
+// A cuckoo filter (Fan et al. 2014), like a Bloom filter but supports removal of keys.
+//
+// Stores a small fingerprint of each key in one of two candidate buckets with 4 slots each. The
+// second bucket is computed from the first bucket and the fingerprint alone (partial key cuckoo
+// hashing), so fingerprints can be moved between their buckets without knowing the key. A lookup
+// compares the fingerprint against both buckets (8 slots) with a couple of SWAR operations.
+//
+// Fingerprints are either 8 or 16 bits, chosen from the target false positive rate. The false
+// positive rate is at most 8 / 2^bits, i.e. ~3% with 8 bits and ~0.012% with 16 bits.
+//
+// Only remove keys that have actually been added, removing a key that was never added may remove
+// the fingerprint of a different key that collides with it.
+class SfzCuckooFilter final {
+public:
+	SFZ_DECLARE_DROP_TYPE(SfzCuckooFilter);
+
+	explicit SfzCuckooFilter(u32 max_num_keys, f32 target_fpr, SfzAllocator* allocator, SfzDbgInfo alloc_dbg) noexcept
+	{
+		this->init(max_num_keys, target_fpr, allocator, alloc_dbg);
+	}
+
+	// State methods
+	// --------------------------------------------------------------------------------------------
+
+	void init(u32 max_num_keys, f32 target_fpr, SfzAllocator* allocator, SfzDbgInfo alloc_dbg)
+	{
+		sfz_assert(0.0f < target_fpr && target_fpr < 1.0f);
+		const f32 max_fpr_8_bits = f32(2 * SFZ_CUCKOO_BUCKET_SIZE) / 256.0f;
+		const f32 max_fpr_16_bits = f32(2 * SFZ_CUCKOO_BUCKET_SIZE) / 65536.0f;
+		sfz_assert(max_fpr_16_bits <= target_fpr); // Can't get lower than this, 16 bits is the max
+		(void)max_fpr_16_bits;
+		const u32 fingerprint_bits = target_fpr >= max_fpr_8_bits ? 8 : 16;
+
+		// Number of buckets must be a power of two for the alternate bucket computation
+		const f32 min_num_buckets =
+			f32(u32_max(max_num_keys, 1)) / (f32(SFZ_CUCKOO_BUCKET_SIZE) * SFZ_CUCKOO_MAX_LOAD_FACTOR);
+		u32 num_buckets = 1;
+		while (f32(num_buckets) < min_num_buckets) num_buckets *= 2;
+		this->initBuckets(num_buckets, fingerprint_bits, allocator, alloc_dbg);
+	}
+
+	// Allocates an empty filter with the given number of buckets (power of two) and fingerprint
+	// size (8 or 16 bits).
+	void initBuckets(u32 num_buckets, u32 fingerprint_bits, SfzAllocator* allocator, SfzDbgInfo alloc_dbg)
+	{
+		this->destroy();
+		sfz_assert_hard(num_buckets > 0 && (num_buckets & (num_buckets - 1)) == 0);
+		sfz_assert_hard(fingerprint_bits == 8 || fingerprint_bits == 16);
+		m_allocator = allocator;
+		m_num_buckets = num_buckets;
+		m_fingerprint_bits = fingerprint_bits;
+		m_buckets = static_cast<u8*>(m_allocator->alloc(alloc_dbg, this->sizeBytes(), 64));
+		this->clear();
+	}
+
+	void clear()
+	{
+		if (m_buckets != nullptr) memset(m_buckets, 0, this->sizeBytes());
+		m_num_keys = 0;
+		m_victim_fingerprint = 0;
+		m_victim_bucket = 0;
+	}
+
+	void destroy()
+	{
+		if (m_buckets != nullptr) {
+			m_allocator->dealloc(m_buckets);
+		}
+		m_num_keys = 0;
+		m_num_buckets = 0;
+		m_fingerprint_bits = 0;
+		m_victim_fingerprint = 0;
+		m_victim_bucket = 0;
+		m_rng_state = 0x2545F4914F6CDD1Dull;
+		m_buckets = nullptr;
+		m_allocator = nullptr;
+	}
+
+	// Getters
+	// --------------------------------------------------------------------------------------------
+
+	u32 numKeys() const { return m_num_keys; }
+	u32 numBuckets() const { return m_num_buckets; }
+	u32 fingerprintBits() const { return m_fingerprint_bits; }
+	u64 sizeBytes() const { return u64(m_num_buckets) * bucketSizeBytes(); }
+	f32 loadFactor() const { return f32(m_num_keys) / f32(m_num_buckets * SFZ_CUCKOO_BUCKET_SIZE); }
+	// Once full no more keys can be added until one is removed.
+	bool isFull() const { return m_victim_fingerprint != 0; }
+	SfzAllocator* allocator() const { return m_allocator; }
+
+	// Returns false if the key has definitely not been added, true if it might have been.
+	template<typename K>
+	bool mayContain(const K& key) const { return this->mayContainHash(sfzHash(key)); }
+
+	bool mayContainHash(u64 hash) const
+	{
+		if (m_buckets == nullptr) return false;
+		u32 fp, idx1, idx2;
+		this->computeFingerprintAndBuckets(hash, fp, idx1, idx2);
+		if (m_victim_fingerprint == fp && (m_victim_bucket == idx1 || m_victim_bucket == idx2)) return true;
+		if (m_fingerprint_bits == 8) {
+			constexpr u32 LO = 0x01010101u;
+			constexpr u32 HI = 0x80808080u;
+			const u32 pattern = fp * LO;
+			const u32 x1 = this->loadBucket8(idx1) ^ pattern;
+			const u32 x2 = this->loadBucket8(idx2) ^ pattern;
+			return ((((x1 - LO) & ~x1) | ((x2 - LO) & ~x2)) & HI) != 0;
+		}
+		else {
+			constexpr u64 LO = 0x0001000100010001ull;
+			constexpr u64 HI = 0x8000800080008000ull;
+			const u64 pattern = u64(fp) * LO;
+			const u64 x1 = this->loadBucket16(idx1) ^ pattern;
+			const u64 x2 = this->loadBucket16(idx2) ^ pattern;
+			return ((((x1 - LO) & ~x1) | ((x2 - LO) & ~x2)) & HI) != 0;
+		}
+	}
+
+	// Methods
+	// --------------------------------------------------------------------------------------------
+
+	// Adds the key. Returns false if the filter is full, in which case the key was not added.
+	// Adding the same key twice stores two fingerprints, so it has to be removed twice.
+	template<typename K>
+	bool add(const K& key) { return this->addHash(sfzHash(key)); }
+
+	bool addHash(u64 hash)
+	{
+		if (m_buckets == nullptr || this->isFull()) return false;
+		u32 fp, idx1, idx2;
+		this->computeFingerprintAndBuckets(hash, fp, idx1, idx2);
+		m_num_keys += 1;
+		if (this->tryInsert(idx1, fp)) return true;
+		if (this->tryInsert(idx2, fp)) return true;
+
+		// Both buckets full, kick out random fingerprints to their alternate buckets
+		u32 idx = (this->nextRandom() & 1) ? idx1 : idx2;
+		for (u32 kick = 0; kick < SFZ_CUCKOO_MAX_KICKS; kick++) {
+			const u32 slot = this->nextRandom() % SFZ_CUCKOO_BUCKET_SIZE;
+			const u32 kicked_fp = this->getSlot(idx, slot);
+			this->setSlot(idx, slot, fp);
+			fp = kicked_fp;
+			idx = this->altBucket(idx, fp);
+			if (this->tryInsert(idx, fp)) return true;
+		}
+
+		// Could not find a place for the last kicked out fingerprint, keep it as the victim so no
+		// key is lost. The filter is full until something is removed.
+		m_victim_fingerprint = fp;
+		m_victim_bucket = idx;
+		return true;
+	}
+
+	// Removes the key. Returns false if it was not found.
+	template<typename K>
+	bool remove(const K& key) { return this->removeHash(sfzHash(key)); }
+
+	bool removeHash(u64 hash)
+	{
+		if (m_buckets == nullptr) return false;
+		u32 fp, idx1, idx2;
+		this->computeFingerprintAndBuckets(hash, fp, idx1, idx2);
+		const bool removed = this->tryRemove(idx1, fp) || this->tryRemove(idx2, fp);
+		if (removed) {
+			// Freed a slot, attempt to move the victim back into the table
+			if (m_victim_fingerprint != 0) {
+				const u32 victim_alt = this->altBucket(m_victim_bucket, m_victim_fingerprint);
+				if (this->tryInsert(m_victim_bucket, m_victim_fingerprint) ||
+					this->tryInsert(victim_alt, m_victim_fingerprint)) {
+					m_victim_fingerprint = 0;
+					m_victim_bucket = 0;
+				}
+			}
+		}
+		else if (m_victim_fingerprint == fp && (m_victim_bucket == idx1 || m_victim_bucket == idx2)) {
+			m_victim_fingerprint = 0;
+			m_victim_bucket = 0;
+		}
+		else {
+			return false;
+		}
+		m_num_keys -= 1;
+		return true;
+	}
+
+	// Serialization
+	// --------------------------------------------------------------------------------------------
+
+	// The serialized format is a SfzCuckooFilterHeader followed by the raw buckets, in the native
+	// byte order of the platform.
+	u64 serializedSizeBytes() const { return sizeof(SfzCuckooFilterHeader) + this->sizeBytes(); }
+
+	// Writes the filter to dst, which must be at least serializedSizeBytes() large.
+	void serialize(u8* dst) const
+	{
+		SfzCuckooFilterHeader header = {};
+		header.magic = SFZ_CUCKOO_FILTER_MAGIC;
+		header.version = SFZ_FILTER_VERSION;
+		header.num_buckets = m_num_buckets;
+		header.fingerprint_bits = m_fingerprint_bits;
+		header.num_keys = m_num_keys;
+		header.victim_fingerprint = m_victim_fingerprint;
+		header.victim_bucket = m_victim_bucket;
+		memcpy(dst, &header, sizeof(SfzCuckooFilterHeader));
+		memcpy(dst + sizeof(SfzCuckooFilterHeader), m_buckets, this->sizeBytes());
+	}
+
+	// Initializes the filter from a serialized buffer. Returns false if the buffer is invalid.
+	bool deserialize(const u8* src, u64 src_size, SfzAllocator* allocator, SfzDbgInfo alloc_dbg)
+	{
+		this->destroy();
+		if (src_size < sizeof(SfzCuckooFilterHeader)) return false;
+		SfzCuckooFilterHeader header = {};
+		memcpy(&header, src, sizeof(SfzCuckooFilterHeader));
+		if (header.magic != SFZ_CUCKOO_FILTER_MAGIC) return false;
+		if (header.version != SFZ_FILTER_VERSION) return false;
+		if (header.num_buckets == 0 || (header.num_buckets & (header.num_buckets - 1)) != 0) return false;
+		if (header.fingerprint_bits != 8 && header.fingerprint_bits != 16) return false;
+		if (header.victim_bucket >= header.num_buckets) return false;
+		const u64 buckets_size = u64(header.num_buckets) * SFZ_CUCKOO_BUCKET_SIZE * (header.fingerprint_bits / 8);
+		if (src_size < sizeof(SfzCuckooFilterHeader) + buckets_size) return false;
+		this->initBuckets(header.num_buckets, header.fingerprint_bits, allocator, alloc_dbg);
+		memcpy(m_buckets, src + sizeof(SfzCuckooFilterHeader), buckets_size);
+		m_num_keys = header.num_keys;
+		m_victim_fingerprint = header.victim_fingerprint;
+		m_victim_bucket = header.victim_bucket;
+		return true;
+	}
+
+private:
+	// Private methods
+	// --------------------------------------------------------------------------------------------
+
+	u32 bucketSizeBytes() const { return SFZ_CUCKOO_BUCKET_SIZE * (m_fingerprint_bits / 8); }
+
+	// Fingerprint from the upper bits (never 0, which marks an empty slot), first bucket from the
+	// lower bits. Must not be called on an uninitialized filter (the shift below would be by 64).
+	void computeFingerprintAndBuckets(u64 hash, u32& fp, u32& idx1, u32& idx2) const
+	{
+		sfz_assert(m_fingerprint_bits == 8 || m_fingerprint_bits == 16);
+		const u64 h = sfzFilterMix64(hash);
+		fp = u32(h >> (64 - m_fingerprint_bits));
+		if (fp == 0) fp = 1;
+		idx1 = u32(h) & (m_num_buckets - 1);
+		idx2 = this->altBucket(idx1, fp);
+	}
+
+	// Symmetric, altBucket(altBucket(idx, fp), fp) == idx.
+	u32 altBucket(u32 idx, u32 fp) const { return (idx ^ (fp * 0x5BD1E995u)) & (m_num_buckets - 1); }
+
+	u32 loadBucket8(u32 idx) const { u32 v; memcpy(&v, m_buckets + u64(idx) * 4, sizeof(u32)); return v; }
+	u64 loadBucket16(u32 idx) const { u64 v; memcpy(&v, m_buckets + u64(idx) * 8, sizeof(u64)); return v; }
+
+	u32 getSlot(u32 idx, u32 slot) const
+	{
+		if (m_fingerprint_bits == 8) return m_buckets[u64(idx) * 4 + slot];
+		return reinterpret_cast<const u16*>(m_buckets)[u64(idx) * 4 + slot];
+	}
+
+	void setSlot(u32 idx, u32 slot, u32 fp)
+	{
+		if (m_fingerprint_bits == 8) m_buckets[u64(idx) * 4 + slot] = u8(fp);
+		else reinterpret_cast<u16*>(m_buckets)[u64(idx) * 4 + slot] = u16(fp);
+	}
+
+	bool tryInsert(u32 idx, u32 fp)
+	{
+		for (u32 slot = 0; slot < SFZ_CUCKOO_BUCKET_SIZE; slot++) {
+			if (this->getSlot(idx, slot) == 0) {
+				this->setSlot(idx, slot, fp);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool tryRemove(u32 idx, u32 fp)
+	{
+		for (u32 slot = 0; slot < SFZ_CUCKOO_BUCKET_SIZE; slot++) {
+			if (this->getSlot(idx, slot) == fp) {
+				this->setSlot(idx, slot, 0);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// xorshift64*
+	u32 nextRandom()
+	{
+		m_rng_state ^= m_rng_state >> 12;
+		m_rng_state ^= m_rng_state << 25;
+		m_rng_state ^= m_rng_state >> 27;
+		return u32((m_rng_state * 0x2545F4914F6CDD1Dull) >> 32);
+	}
+
+	// Private members
+	// --------------------------------------------------------------------------------------------
+
+	u32 m_num_keys = 0;
+	u32 m_num_buckets = 0;
+	u32 m_fingerprint_bits = 0;
+	u32 m_victim_fingerprint = 0; // 0 if no victim
+	u32 m_victim_bucket = 0;
+	u64 m_rng_state = 0x2545F4914F6CDD1Dull;
+	u8* m_buckets = nullptr;
+	SfzAllocator* m_allocator = nullptr;
+};
+
+#endif
@@ -0,0 +1,252 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#ifndef SKIPIFZERO_FLAT_SORTED_MAP_HPP
+#define SKIPIFZERO_FLAT_SORTED_MAP_HPP
+#pragma once
+
+#if defined(_M_X64) || defined(_M_AMD64)
+#include <intrin.h>
+#define SFZ_FLAT_MAP_PREFETCH(ptr) _mm_prefetch(reinterpret_cast<const char*>(ptr), _MM_HINT_T0)
+#elif defined(_M_ARM64)
+#include <intrin.h>
+#define SFZ_FLAT_MAP_PREFETCH(ptr) __prefetch(ptr)
+#else
+#define SFZ_FLAT_MAP_PREFETCH(ptr)
+#endif
+
+#include "sfz.h"
+#include "sfz_cpp.hpp"
+#include "skipifzero_arrays.hpp"
+
+// SfzFlatSortedMap
+// ------------------------------------------------------------------------------------------------
+
+constexpr u32 SFZ_FLAT_MAP_CACHE_LINE_SIZE = 64;
+constexpr u32 SFZ_FLAT_MAP_MAX_SIZE = (1u << 31) - 1;
+
+// An immutable map built once in bulk and then queried, intended for lookup tables that are
+// queried many more times than they are built (asset id -> index, SfzStrID -> resource, etc).
+//
+// Stores the keys twice:
+//
+//   * In Eytzinger (BFS) order, i.e. as an implicit binary search tree where the children of
+//     node k are at 2k and 2k + 1. Searches are branchless (the comparison result is used to
+//     compute the next index) and prefetch the cache line containing the descendants 4 levels
+//     further down (for 4 byte keys), so the memory latency of consecutive levels overlaps.
+//   * In sorted order together with the values, for ordered iteration and range queries.
+//
+// Memory overhead is one extra key and one u32 per element compared to plain sorted arrays, with
+// no empty slots. A miss costs the same as a hit (log2(n) levels).
+//
+// K must be comparable with operator< and operator==, and keys must be unique.
+template<typename K, typename V>
+class SfzFlatSortedMap final {
+public:
+	SFZ_DECLARE_DROP_TYPE(SfzFlatSortedMap);
+	using KeyT = K;
+	using ValT = V;
+
+	static constexpr u32 ALIGNMENT = SFZ_FLAT_MAP_CACHE_LINE_SIZE;
+	static constexpr u32 PREFETCH_MULT =
+		sizeof(K) < SFZ_FLAT_MAP_CACHE_LINE_SIZE ? (SFZ_FLAT_MAP_CACHE_LINE_SIZE / sizeof(K)) : 1;
+	static_assert(alignof(K) <= ALIGNMENT, "");
+	static_assert(alignof(V) <= ALIGNMENT, "");
+
+	SfzFlatSortedMap(const SfzArray<K>& keys, const SfzArray<V>& values, SfzAllocator* allocator, SfzDbgInfo alloc_dbg) noexcept
+	{
+		this->init(keys, values, allocator, alloc_dbg);
+	}
+
+	// State methods
+	// --------------------------------------------------------------------------------------------
+
+	// Builds the map from the given key value pairs (keys[i] -> values[i]). The keys do not need
+	// to be sorted, but they must be unique.
+	void init(const K* keys, const V* values, u32 num_elements, SfzAllocator* allocator, SfzDbgInfo alloc_dbg)
+	{
+		this->destroy();
+		sfz_assert_hard(num_elements <= SFZ_FLAT_MAP_MAX_SIZE);
+		m_allocator = allocator;
+		m_size = num_elements;
+		if (num_elements == 0) return;
+
+		// Allocate memory
+		const u64 sorted_keys_offset = 0;
+		const u64 values_offset =
+			sfzRoundUpAlignedU64(sorted_keys_offset + sizeof(K) * num_elements, ALIGNMENT);
+		const u64 eytz_keys_offset =
+			sfzRoundUpAlignedU64(values_offset + sizeof(V) * num_elements, ALIGNMENT);
+		const u64 eytz_to_sorted_offset =
+			sfzRoundUpAlignedU64(eytz_keys_offset + sizeof(K) * (num_elements + 1), ALIGNMENT);
+		const u64 indices_offset =
+			sfzRoundUpAlignedU64(eytz_to_sorted_offset + sizeof(u32) * (num_elements + 1), ALIGNMENT);
+		const u64 num_bytes = indices_offset + sizeof(u32) * num_elements; // Indices only used during build
+		m_allocation = static_cast<u8*>(m_allocator->alloc(alloc_dbg, num_bytes, ALIGNMENT));
+		m_sorted_keys = reinterpret_cast<K*>(m_allocation + sorted_keys_offset);
+		m_values = reinterpret_cast<V*>(m_allocation + values_offset);
+		m_eytz_keys = reinterpret_cast<K*>(m_allocation + eytz_keys_offset);
+		m_eytz_to_sorted = reinterpret_cast<u32*>(m_allocation + eytz_to_sorted_offset);
+		u32* indices = reinterpret_cast<u32*>(m_allocation + indices_offset);
+
+		// Sort indices by key, then copy key value pairs into sorted order
+		for (u32 i = 0; i < num_elements; i++) indices[i] = i;
+		static thread_local const K* sort_keys = nullptr;
+		sort_keys = keys;
+		qsort(indices, num_elements, sizeof(u32), [](const void* raw_lhs, const void* raw_rhs) -> int {
+			const K& lhs = sort_keys[*static_cast<const u32*>(raw_lhs)];
+			const K& rhs = sort_keys[*static_cast<const u32*>(raw_rhs)];
+			if (lhs < rhs) return -1;
+			if (rhs < lhs) return 1;
+			return 0;
+		});
+		for (u32 i = 0; i < num_elements; i++) {
+			new (m_sorted_keys + i) K(keys[indices[i]]);
+			new (m_values + i) V(values[indices[i]]);
+			sfz_assert(i == 0 || m_sorted_keys[i - 1] < m_sorted_keys[i]); // Keys must be unique
+		}
+
+		// Lay out keys in Eytzinger order, index 0 is unused
+		new (m_eytz_keys) K(m_sorted_keys[0]);
+		m_eytz_to_sorted[0] = ~0u;
+		const u32 num_placed = this->buildEytzinger(0, 1);
+		sfz_assert(num_placed == num_elements);
+		(void)num_placed;
+	}
+	void init(const SfzArray<K>& keys, const SfzArray<V>& values, SfzAllocator* allocator, SfzDbgInfo alloc_dbg)
+	{
+		sfz_assert_hard(keys.size() == values.size());
+		this->init(keys.data(), values.data(), keys.size(), allocator, alloc_dbg);
+	}
+
+	void destroy()
+	{
+		if (m_allocation != nullptr) {
+			for (u32 i = 0; i < m_size; i++) {
+				m_sorted_keys[i].~K();
+				m_values[i].~V();
+			}
+			for (u32 i = 0; i <= m_size; i++) m_eytz_keys[i].~K();
+			m_allocator->dealloc(m_allocation);
+		}
+		m_size = 0;
+		m_allocation = nullptr;
+		m_sorted_keys = nullptr;
+		m_values = nullptr;
+		m_eytz_keys = nullptr;
+		m_eytz_to_sorted = nullptr;
+		m_allocator = nullptr;
+	}
+
+	// Getters
+	// --------------------------------------------------------------------------------------------
+
+	u32 size() const { return m_size; }
+	bool isEmpty() const { return m_size == 0; }
+	SfzAllocator* allocator() const { return m_allocator; }
+
+	// The keys and values in sorted order, valid in range [0, size()).
+	const K* keys() const { return m_sorted_keys; }
+	V* values() { return m_values; }
+	const V* values() const { return m_values; }
+
+	// Returns the (sorted) index of the first key that is not less than key, size() if none.
+	u32 lowerBound(const K& key) const
+	{
+		const u32 eytz_idx = this->eytzLowerBound(key);
+		return eytz_idx == 0 ? m_size : m_eytz_to_sorted[eytz_idx];
+	}
+
+	// Returns the (sorted) index of the first key that is greater than key, size() if none.
+	u32 upperBound(const K& key) const
+	{
+		const u32 idx = this->lowerBound(key);
+		return (idx < m_size && m_sorted_keys[idx] == key) ? idx + 1 : idx;
+	}
+
+	// Returns the (sorted) index of the given key, ~0u if it does not exist.
+	u32 find(const K& key) const
+	{
+		const u32 eytz_idx = this->eytzLowerBound(key);
+		if (eytz_idx == 0 || !(m_eytz_keys[eytz_idx] == key)) return ~0u;
+		return m_eytz_to_sorted[eytz_idx];
+	}
+
+	bool contains(const K& key) const { return this->find(key) != ~0u; }
+
+	// Returns pointer to the value associated with the given key, nullptr if it does not exist.
+	V* get(const K& key) { const u32 idx = this->find(key); return idx == ~0u ? nullptr : m_values + idx; }
+	const V* get(const K& key) const { return const_cast<SfzFlatSortedMap*>(this)->get(key); }
+
+	V& operator[] (const K& key) { V* ptr = get(key); sfz_assert_hard(ptr != nullptr); return *ptr; }
+	const V& operator[] (const K& key) const { const V* ptr = get(key); sfz_assert_hard(ptr != nullptr); return *ptr; }
+
+	// Calls func for each key in range [first, last] in sorted order. Function should have
+	// signature: void func(const K& key, V& value)
+	template<typename F>
+	void forEachInRange(const K& first, const K& last, F func)
+	{
+		for (u32 i = this->lowerBound(first); i < m_size && !(last < m_sorted_keys[i]); i++) {
+			func(m_sorted_keys[i], m_values[i]);
+		}
+	}
+
+private:
+	// Private methods
+	// --------------------------------------------------------------------------------------------
+
+	// In-order traversal of the implicit tree, assigning sorted elements to the nodes. Returns the
+	// next sorted index to place. Recursion depth is log2(size()).
+	u32 buildEytzinger(u32 sorted_idx, u32 eytz_idx)
+	{
+		if (eytz_idx > m_size) return sorted_idx;
+		sorted_idx = this->buildEytzinger(sorted_idx, 2 * eytz_idx);
+		new (m_eytz_keys + eytz_idx) K(m_sorted_keys[sorted_idx]);
+		m_eytz_to_sorted[eytz_idx] = sorted_idx;
+		sorted_idx += 1;
+		return this->buildEytzinger(sorted_idx, 2 * eytz_idx + 1);
+	}
+
+	// Returns the Eytzinger index of the first key not less than key, 0 if none.
+	u32 eytzLowerBound(const K& key) const
+	{
+		u64 k = 1;
+		while (k <= m_size) {
+			SFZ_FLAT_MAP_PREFETCH(m_eytz_keys + PREFETCH_MULT * k);
+			k = 2 * k + u64(m_eytz_keys[k] < key);
+		}
+
+		// k now encodes the path taken, with a 1 for each right turn. The answer is the node where
+		// we last turned left, so strip all trailing right turns plus that left turn.
+		k >>= sfzBitsCtz64(~k) + 1;
+		return u32(k);
+	}
+
+	// Private members
+	// --------------------------------------------------------------------------------------------
+
+	u32 m_size = 0;
+	u8* m_allocation = nullptr;
+	K* m_sorted_keys = nullptr;
+	V* m_values = nullptr;
+	K* m_eytz_keys = nullptr;
+	u32* m_eytz_to_sorted = nullptr;
+	SfzAllocator* m_allocator = nullptr;
+};
+
+#endif
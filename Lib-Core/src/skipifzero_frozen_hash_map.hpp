@@ -0,0 +1,300 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#ifndef SKIPIFZERO_FROZEN_HASH_MAP_HPP
+#define SKIPIFZERO_FROZEN_HASH_MAP_HPP
+#pragma once
+
+#include "sfz.h"
+#include "sfz_cpp.hpp"
+#include "skipifzero_hash_maps.hpp"
+
+#ifdef __cplusplus
+
+// Frozen hash map header
+// ------------------------------------------------------------------------------------------------
+
+constexpr u32 SFZ_FROZEN_HASH_MAP_MAGIC = 0x4D484653; // "SFHM"
+constexpr u32 SFZ_FROZEN_HASH_MAP_VERSION = 1;
+constexpr u32 SFZ_FROZEN_HASH_MAP_ALIGNMENT = 32;
+constexpr u32 SFZ_FROZEN_HASH_MAP_EMPTY = ~0u;
+
+// The header at the start of a frozen hash map blob. All offsets are in bytes from the start of
+// the blob, so the blob is position independent and can be loaded (or memory mapped) anywhere.
+struct SfzFrozenHashMapHeader final {
+	u32 magic;
+	u32 version;
+	u64 layout_hash; // See sfzFrozenHashMapLayoutHash()
+	u64 size_bytes; // Size of the entire blob, including this header
+	u32 num_entries;
+	u32 num_slot_bits; // Number of slots is (1 << num_slot_bits)
+	u64 slots_offset;
+	u64 keys_offset;
+	u64 values_offset;
+};
+static_assert(sizeof(SfzFrozenHashMapHeader) == 56, "");
+
+struct SfzFrozenHashMapSlot final {
+	u32 hash;
+	u32 entry_idx; // SFZ_FROZEN_HASH_MAP_EMPTY if empty
+};
+static_assert(sizeof(SfzFrozenHashMapSlot) == 8, "");
+
+// Hash of the memory layout of the key and value types, stored in the blob and checked when it is
+// opened. The sizes and alignments are included automatically, type_tag should be changed by the
+// user whenever the layout changes in other ways (e.g. reordered members), a version number works.
+template<typename K, typename V>
+sfz_constexpr_func u64 sfzFrozenHashMapLayoutHash(u64 type_tag)
+{
+	u64 hash = sfzHashCombine(u64(sizeof(K)), u64(alignof(K)));
+	hash = sfzHashCombine(hash, u64(sizeof(V)));
+	hash = sfzHashCombine(hash, u64(alignof(V)));
+	hash = sfzHashCombine(hash, u64(sizeof(void*)));
+	return sfzHashCombine(hash, type_tag);
+}
+
+// SfzFrozenHashMap
+// ------------------------------------------------------------------------------------------------
+
+// A read-only view of a hash map that has been frozen into a single flat blob.
+//
+// Rebuilding a large SfzHashMap at startup (put() entry by entry, with rehashes along the way)
+// is expensive. Instead the map can be frozen with build() at asset build time, written to disk,
+// and then read (or memory mapped) directly at runtime. The blob contains no pointers, only
+// offsets, so it can be queried in place without any rehydration.
+//
+// Blob layout (every section aligned to 32 bytes):
+//   SfzFrozenHashMapHeader
+//   SfzFrozenHashMapSlot[1 << num_slot_bits] (open addressing, linear probing, <= 50% load)
+//   K[num_entries]
+//   V[num_entries]
+//
+// Keys and values must be trivially copyable (and should not contain pointers). The blob is in the
+// native byte order, and its start must be aligned to SFZ_FROZEN_HASH_MAP_ALIGNMENT. Keys must be
+// hashed in a process independent way, which the integer and string sfzHash() functions are.
+template<typename K, typename V>
+class SfzFrozenHashMap final {
+public:
+	static_assert(__is_trivially_copyable(K), "Keys must be trivially copyable");
+	static_assert(__is_trivially_copyable(V), "Values must be trivially copyable");
+	static_assert(alignof(K) <= SFZ_FROZEN_HASH_MAP_ALIGNMENT, "");
+	static_assert(alignof(V) <= SFZ_FROZEN_HASH_MAP_ALIGNMENT, "");
+	using KeyT = K;
+	using ValT = V;
+	using AltK = typename SfzAltType<K>::AltT;
+
+	// Building
+	// --------------------------------------------------------------------------------------------
+
+	// Returns the number of slots bits used for the given number of entries.
+	static u32 numSlotBitsFor(u32 num_entries)
+	{
+		u32 num_slot_bits = 4;
+		while ((u64(1) << num_slot_bits) < u64(num_entries) * 2) num_slot_bits += 1;
+		return num_slot_bits;
+	}
+
+	// Returns the size of the blob required to freeze the given number of entries.
+	static u64 sizeBytesFor(u32 num_entries)
+	{
+		u64 slots_offset, keys_offset, values_offset;
+		return computeLayout(num_entries, numSlotBitsFor(num_entries), slots_offset, keys_offset, values_offset);
+	}
+
+	// Freezes the given key value pairs (keys[i] -> values[i]) into dst, which must be at least
+	// sizeBytesFor(num_entries) bytes and aligned to SFZ_FROZEN_HASH_MAP_ALIGNMENT. Returns false
+	// if dst is too small or if the keys are not unique.
+	static bool build(
+		const K* keys, const V* values, u32 num_entries, u8* dst, u64 dst_size, u64 type_tag = 0)
+	{
+		sfz_assert((u64(dst) & u64(SFZ_FROZEN_HASH_MAP_ALIGNMENT - 1)) == 0);
+		sfz_assert_hard(num_entries < (1u << 30));
+		const u32 num_slot_bits = numSlotBitsFor(num_entries);
+		SfzFrozenHashMapHeader header = {};
+		header.magic = SFZ_FROZEN_HASH_MAP_MAGIC;
+		header.version = SFZ_FROZEN_HASH_MAP_VERSION;
+		header.layout_hash = sfzFrozenHashMapLayoutHash<K, V>(type_tag);
+		header.size_bytes = computeLayout(
+			num_entries, num_slot_bits, header.slots_offset, header.keys_offset, header.values_offset);
+		header.num_entries = num_entries;
+		header.num_slot_bits = num_slot_bits;
+		if (dst_size < header.size_bytes) return false;
+
+		// Clear everything (including padding, so identical maps produce identical blobs)
+		memset(dst, 0, header.size_bytes);
+		memcpy(dst, &header, sizeof(SfzFrozenHashMapHeader));
+		SfzFrozenHashMapSlot* slots = reinterpret_cast<SfzFrozenHashMapSlot*>(dst + header.slots_offset);
+		K* dst_keys = reinterpret_cast<K*>(dst + header.keys_offset);
+		V* dst_values = reinterpret_cast<V*>(dst + header.values_offset);
+		const u32 num_slots = 1u << num_slot_bits;
+		for (u32 i = 0; i < num_slots; i++) slots[i] = { 0, SFZ_FROZEN_HASH_MAP_EMPTY };
+
+		// Insert entries
+		const u32 mask = num_slots - 1;
+		for (u32 i = 0; i < num_entries; i++) {
+			const u32 hash = hashKey<K>(keys[i]);
+			u32 slot_idx = hash >> (32 - num_slot_bits);
+			while (slots[slot_idx].entry_idx != SFZ_FROZEN_HASH_MAP_EMPTY) {
+				const SfzFrozenHashMapSlot slot = slots[slot_idx];
+				if (slot.hash == hash && dst_keys[slot.entry_idx] == keys[i]) return false;
+				slot_idx = (slot_idx + 1) & mask;
+			}
+			slots[slot_idx] = { hash, i };
+			memcpy(dst_keys + i, keys + i, sizeof(K));
+			memcpy(dst_values + i, values + i, sizeof(V));
+		}
+		return true;
+	}
+
+	static bool build(const SfzHashMap<K, V>& map, u8* dst, u64 dst_size, u64 type_tag = 0)
+	{
+		return build(map.keys(), map.values(), map.size(), dst, dst_size, type_tag);
+	}
+
+	// State methods
+	// --------------------------------------------------------------------------------------------
+
+	SfzFrozenHashMap() noexcept = default;
+	SfzFrozenHashMap(const SfzFrozenHashMap&) noexcept = default;
+	SfzFrozenHashMap& operator= (const SfzFrozenHashMap&) noexcept = default;
+
+	// Opens a frozen blob, does not copy it (the blob must outlive this view). Returns false if the
+	// blob is invalid or was built for a different layout (or type_tag).
+	//
+	// By default only the header, size and alignment are validated, which is O(1) so opening a
+	// memory mapped blob doesn't touch its pages. The slots are then trusted, i.e. the blob must come
+	// from a trusted source (e.g. built by the same asset pipeline). Set validate_slots to also scan
+	// every slot, which makes it safe to query blobs that may be corrupt (lookups always terminate,
+	// but a bad entry index in an unvalidated blob is an out of bounds read).
+	bool init(const void* blob, u64 blob_size, u64 type_tag = 0, bool validate_slots = false)
+	{
+		this->destroy();
+		const u8* bytes = static_cast<const u8*>(blob);
+		if (bytes == nullptr || blob_size < sizeof(SfzFrozenHashMapHeader)) return false;
+		if ((u64(bytes) & u64(SFZ_FROZEN_HASH_MAP_ALIGNMENT - 1)) != 0) return false;
+		const SfzFrozenHashMapHeader& header = *reinterpret_cast<const SfzFrozenHashMapHeader*>(bytes);
+		if (header.magic != SFZ_FROZEN_HASH_MAP_MAGIC) return false;
+		if (header.version != SFZ_FROZEN_HASH_MAP_VERSION) return false;
+		if (header.layout_hash != sfzFrozenHashMapLayoutHash<K, V>(type_tag)) return false;
+		if (header.size_bytes > blob_size) return false;
+		if (header.num_slot_bits < 4 || header.num_slot_bits >= 32) return false;
+		if (header.num_slot_bits != numSlotBitsFor(header.num_entries)) return false;
+		u64 slots_offset, keys_offset, values_offset;
+		const u64 size_bytes =
+			computeLayout(header.num_entries, header.num_slot_bits, slots_offset, keys_offset, values_offset);
+		if (size_bytes != header.size_bytes) return false;
+		if (slots_offset != header.slots_offset) return false;
+		if (keys_offset != header.keys_offset) return false;
+		if (values_offset != header.values_offset) return false;
+
+		// Optionally validate the slots, every occupied slot must point at an entry and exactly
+		// num_entries slots must be occupied.
+		const SfzFrozenHashMapSlot* slots = reinterpret_cast<const SfzFrozenHashMapSlot*>(bytes + slots_offset);
+		if (validate_slots) {
+			const u32 num_slots = 1u << header.num_slot_bits;
+			u32 num_occupied_slots = 0;
+			for (u32 i = 0; i < num_slots; i++) {
+				const u32 entry_idx = slots[i].entry_idx;
+				if (entry_idx == SFZ_FROZEN_HASH_MAP_EMPTY) continue;
+				if (entry_idx >= header.num_entries) return false;
+				num_occupied_slots += 1;
+			}
+			if (num_occupied_slots != header.num_entries) return false;
+		}
+
+		m_num_entries = header.num_entries;
+		m_num_slot_bits = header.num_slot_bits;
+		m_slots = slots;
+		m_keys = reinterpret_cast<const K*>(bytes + keys_offset);
+		m_values = reinterpret_cast<const V*>(bytes + values_offset);
+		return true;
+	}
+
+	void destroy()
+	{
+		m_num_entries = 0;
+		m_num_slot_bits = 0;
+		m_slots = nullptr;
+		m_keys = nullptr;
+		m_values = nullptr;
+	}
+
+	// Getters
+	// --------------------------------------------------------------------------------------------
+
+	bool isValid() const { return m_slots != nullptr; }
+	u32 size() const { return m_num_entries; }
+	const K* keys() const { return m_keys; }
+	const V* values() const { return m_values; }
+
+	// Returns pointer to the value associated with the given key, nullptr if it does not exist.
+	const V* get(const K& key) const { return this->getInternal<K>(key); }
+	const V* get(const AltK& key) const { return this->getInternal<AltK>(key); }
+
+	bool contains(const K& key) const { return this->getInternal<K>(key) != nullptr; }
+	bool contains(const AltK& key) const { return this->getInternal<AltK>(key) != nullptr; }
+
+	const V& operator[] (const K& key) const { const V* ptr = get(key); sfz_assert_hard(ptr != nullptr); return *ptr; }
+	const V& operator[] (const AltK& key) const { const V* ptr = get(key); sfz_assert_hard(ptr != nullptr); return *ptr; }
+
+private:
+	// Private methods
+	// --------------------------------------------------------------------------------------------
+
+	// Fibonacci hashing on top of sfzHash(), the upper bits are used to select the home slot.
+	template<typename KT>
+	static u32 hashKey(const KT& key) { return u32((sfzHash(key) * 0x9E3779B97F4A7C15ull) >> 32); }
+
+	template<typename KT>
+	const V* getInternal(const KT& key) const
+	{
+		if (m_slots == nullptr) return nullptr;
+		const u32 hash = hashKey<KT>(key);
+		const u32 num_slots = 1u << m_num_slot_bits;
+		const u32 mask = num_slots - 1;
+		u32 slot_idx = hash >> (32 - m_num_slot_bits);
+		for (u32 i = 0; i < num_slots; i++, slot_idx = (slot_idx + 1) & mask) {
+			const SfzFrozenHashMapSlot slot = m_slots[slot_idx];
+			if (slot.entry_idx == SFZ_FROZEN_HASH_MAP_EMPTY) return nullptr;
+			if (slot.hash == hash && m_keys[slot.entry_idx] == key) return m_values + slot.entry_idx;
+		}
+		return nullptr;
+	}
+
+	static u64 computeLayout(
+		u32 num_entries, u32 num_slot_bits, u64& slots_offset, u64& keys_offset, u64& values_offset)
+	{
+		slots_offset = sfzRoundUpAlignedU64(sizeof(SfzFrozenHashMapHeader), SFZ_FROZEN_HASH_MAP_ALIGNMENT);
+		keys_offset = sfzRoundUpAlignedU64(
+			slots_offset + sizeof(SfzFrozenHashMapSlot) * (u64(1) << num_slot_bits), SFZ_FROZEN_HASH_MAP_ALIGNMENT);
+		values_offset = sfzRoundUpAlignedU64(keys_offset + sizeof(K) * u64(num_entries), SFZ_FROZEN_HASH_MAP_ALIGNMENT);
+		return sfzRoundUpAlignedU64(values_offset + sizeof(V) * u64(num_entries), SFZ_FROZEN_HASH_MAP_ALIGNMENT);
+	}
+
+	// Private members
+	// --------------------------------------------------------------------------------------------
+
+	u32 m_num_entries = 0;
+	u32 m_num_slot_bits = 0;
+	const SfzFrozenHashMapSlot* m_slots = nullptr;
+	const K* m_keys = nullptr;
+	const V* m_values = nullptr;
+};
+
+#endif // __cplusplus
+#endif // SKIPIFZERO_FROZEN_HASH_MAP_HPP
@@ -22,6 +22,7 @@
 
 #include "sfz.h"
 #include "sfz_geom.h"
+#include "sfz_matrix.h"
 
 namespace sfz {
 
@@ -42,6 +43,90 @@ struct AABB final {
 };
 static_assert(sizeof(AABB) == sizeof(f32) * 6, "AABB is padded");
 
+// AABB transforms
+// ------------------------------------------------------------------------------------------------
+
+// Returns the AABB enclosing the transformed AABB, using the method by Jim Arvo ("Transforming
+// Axis-Aligned Bounding Boxes", Graphics Gems, 1990). The matrix is assumed to be affine, i.e. the
+// last row is ignored.
+inline AABB transformAABB(const SfzMat44& m, const AABB& aabb)
+{
+	AABB res;
+	for (u32 y = 0; y < 3; y++) {
+		f32 new_min = m.at(y, 3);
+		f32 new_max = m.at(y, 3);
+		for (u32 x = 0; x < 3; x++) {
+			const f32 a = m.at(y, x) * aabb.min[x];
+			const f32 b = m.at(y, x) * aabb.max[x];
+			new_min += f32_min(a, b);
+			new_max += f32_max(a, b);
+		}
+		res.min[y] = new_min;
+		res.max[y] = new_max;
+	}
+	return res;
+}
+
+// Transforms num AABBs (see transformAABB()) from src and writes them tightly packed to dst.
+// src_stride is the number of bytes between AABBs in src. Same results as calling transformAABB()
+// in a loop, but faster with SFZ_SIMD.
+inline void transformAABBs(
+	const SfzMat44& m, AABB* __restrict dst, const AABB* __restrict src, u64 src_stride, u64 num)
+{
+	sfz_assert(src_stride >= sizeof(AABB));
+	const u8* src_bytes = reinterpret_cast<const u8*>(src);
+	u64 i = 0;
+#if defined(SFZ_SIMD_ENABLED)
+	// Four AABBs at a time in SoA form, same operations and order as transformAABB()
+	SfzSimdF32x4 elems[3][4];
+	for (u32 y = 0; y < 3; y++) {
+		for (u32 x = 0; x < 4; x++) elems[y][x] = sfzSimdF32x4Splat(m.at(y, x));
+	}
+
+	// The 16-byte loads read 4 bytes past each AABB, which is only safe if it is not the last one
+	for (; (i + 4) < num; i += 4) {
+		const f32* src0 = reinterpret_cast<const f32*>(src_bytes + (i + 0) * src_stride);
+		const f32* src1 = reinterpret_cast<const f32*>(src_bytes + (i + 1) * src_stride);
+		const f32* src2 = reinterpret_cast<const f32*>(src_bytes + (i + 2) * src_stride);
+		const f32* src3 = reinterpret_cast<const f32*>(src_bytes + (i + 3) * src_stride);
+		SfzSimdF32x4 mins[4] = {
+			sfzSimdF32x4LoadPtr(src0), sfzSimdF32x4LoadPtr(src1), sfzSimdF32x4LoadPtr(src2), sfzSimdF32x4LoadPtr(src3) };
+		SfzSimdF32x4 maxs[4] = {
+			sfzSimdF32x4LoadPtr(src0 + 3), sfzSimdF32x4LoadPtr(src1 + 3), sfzSimdF32x4LoadPtr(src2 + 3), sfzSimdF32x4LoadPtr(src3 + 3) };
+		sfzSimdF32x4Transpose(mins[0], mins[1], mins[2], mins[3]);
+		sfzSimdF32x4Transpose(maxs[0], maxs[1], maxs[2], maxs[3]);
+
+		SfzSimdF32x4 new_mins[4];
+		SfzSimdF32x4 new_maxs[4];
+		for (u32 y = 0; y < 3; y++) {
+			new_mins[y] = elems[y][3];
+			new_maxs[y] = elems[y][3];
+			for (u32 x = 0; x < 3; x++) {
+				const SfzSimdF32x4 a = sfzSimdF32x4Mul(elems[y][x], mins[x]);
+				const SfzSimdF32x4 b = sfzSimdF32x4Mul(elems[y][x], maxs[x]);
+				new_mins[y] = sfzSimdF32x4Add(new_mins[y], sfzSimdF32x4Min(a, b));
+				new_maxs[y] = sfzSimdF32x4Add(new_maxs[y], sfzSimdF32x4Max(a, b));
+			}
+		}
+		new_mins[3] = sfzSimdF32x4Zero();
+		new_maxs[3] = sfzSimdF32x4Zero();
+		sfzSimdF32x4Transpose(new_mins[0], new_mins[1], new_mins[2], new_mins[3]);
+		sfzSimdF32x4Transpose(new_maxs[0], new_maxs[1], new_maxs[2], new_maxs[3]);
+
+		// Each store overwrites the first float of the next vector, which is then written by the
+		// next store. Only the very last one has to be a 12-byte store.
+		for (u32 j = 0; j < 4; j++) {
+			sfzSimdF32x4StorePtr(&dst[i + j].min.x, new_mins[j]);
+			if (j < 3) sfzSimdF32x4StorePtr(&dst[i + j].max.x, new_maxs[j]);
+			else sfzSimdF32x4StorePtr3(&dst[i + j].max.x, new_maxs[j]);
+		}
+	}
+#endif
+	for (; i < num; i++) {
+		dst[i] = transformAABB(m, *reinterpret_cast<const AABB*>(src_bytes + i * src_stride));
+	}
+}
+
 // Ray VS AABB intersection test
 // ------------------------------------------------------------------------------------------------
 
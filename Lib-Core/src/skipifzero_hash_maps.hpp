@@ -40,6 +40,11 @@ sfz_constexpr_func u64 sfzHash(i64 v) { return u64(v); }
 
 sfz_constexpr_func u64 sfzHash(const void* v) { return u64(v); }
 
+// Defined in skipifzero_strings.hpp. Declared here so that the hash maps (templates defined before
+// skipifzero_strings.hpp might be included) hash const char* alt keys by content instead of
+// silently picking the const void* overload above.
+sfz_constexpr_func u64 sfzHash(const char* str);
+
 sfz_constexpr_func u64 sfzHashCombine(u64 h1, u64 h2)
 {
 	// hash_combine algorithm from boost
@@ -96,6 +101,41 @@ struct SfzHashMapPair final {
 	SfzHashMapPair& operator= (const SfzHashMapPair&) = delete; // Because references...
 };
 
+// Linear probing shared by all hash maps and hash sets. Finds the slot containing the given key
+// (if any) and the first free (empty or placeholder) slot in its probe sequence. Both are set to
+// ~0u if not found.
+template<typename K, typename KT>
+sfz_forceinline void sfzHashTableFindSlot(
+	const SfzHashMapSlot* slots,
+	const K* keys,
+	u32 capacity,
+	const KT& key,
+	u32& first_free_slot_idx,
+	u32& occupied_slot_idx)
+{
+	first_free_slot_idx = ~0u;
+	occupied_slot_idx = ~0u;
+
+	// Search for the element using linear probing
+	const u32 base_index = capacity != 0 ? u32(sfzHash(key) % u64(capacity)) : 0;
+	for (u32 i = 0; i < capacity; i++) {
+		const u32 slotIdx = (base_index + i) % capacity;
+		SfzHashMapSlot slot = slots[slotIdx];
+		SfzHashMapSlotState state = slot.state();
+
+		if (state != SfzHashMapSlotState::OCCUPIED) {
+			if (first_free_slot_idx == ~0u) first_free_slot_idx = slotIdx;
+			if (state == SfzHashMapSlotState::EMPTY) break;
+		}
+		else {
+			if (keys[slot.index()] == key) {
+				occupied_slot_idx = slotIdx;
+				break;
+			}
+		}
+	}
+}
+
 template<typename MapT, typename K, typename V>
 class SfzHashMapItr final {
 public:
@@ -339,27 +379,7 @@ private:
 	template<typename KT>
 	void findSlot(const KT& key, u32& first_free_slot_idx, u32& occupied_slot_idx) const
 	{
-		first_free_slot_idx = ~0u;
-		occupied_slot_idx = ~0u;
-
-		// Search for the element using linear probing
-		const u32 base_index = m_capacity != 0 ? u32(sfzHash(key) % u64(m_capacity)) : 0;
-		for (u32 i = 0; i < m_capacity; i++) {
-			const u32 slotIdx = (base_index + i) % m_capacity;
-			SfzHashMapSlot slot = m_slots[slotIdx];
-			SfzHashMapSlotState state = slot.state();
-
-			if (state != SfzHashMapSlotState::OCCUPIED) {
-				if (first_free_slot_idx == ~0u) first_free_slot_idx = slotIdx;
-				if (state == SfzHashMapSlotState::EMPTY) break;
-			}
-			else {
-				if (m_keys[slot.index()] == key) {
-					occupied_slot_idx = slotIdx;
-					break;
-				}
-			}
-		}
+		sfzHashTableFindSlot<K, KT>(m_slots, m_keys, m_capacity, key, first_free_slot_idx, occupied_slot_idx);
 	}
 
 	// Swaps the position of two key/value pairs in the internal arrays and updates their slots
@@ -593,27 +613,7 @@ private:
 	template<typename KT>
 	void findSlot(const KT& key, u32& first_free_slot_idx, u32& occupied_slot_idx) const
 	{
-		first_free_slot_idx = ~0u;
-		occupied_slot_idx = ~0u;
-
-		// Search for the element using linear probing
-		const u32 base_index = Capacity != 0 ? u32(sfzHash(key) % u64(Capacity)) : 0;
-		for (u32 i = 0; i < Capacity; i++) {
-			const u32 slotIdx = (base_index + i) % Capacity;
-			SfzHashMapSlot slot = m_slots[slotIdx];
-			SfzHashMapSlotState state = slot.state();
-
-			if (state != SfzHashMapSlotState::OCCUPIED) {
-				if (first_free_slot_idx == ~0u) first_free_slot_idx = slotIdx;
-				if (state == SfzHashMapSlotState::EMPTY) break;
-			}
-			else {
-				if (m_keys[slot.index()] == key) {
-					occupied_slot_idx = slotIdx;
-					break;
-				}
-			}
-		}
+		sfzHashTableFindSlot<K, KT>(m_slots, m_keys, Capacity, key, first_free_slot_idx, occupied_slot_idx);
 	}
 
 	// Swaps the position of two key/value pairs in the internal arrays and updates their slots
@@ -777,5 +777,541 @@ template<typename K, typename V> using SfzMap256 = SfzHashMapLocal<K, V, 256>;
 template<typename K, typename V> using SfzMap320 = SfzHashMapLocal<K, V, 320>;
 template<typename K, typename V> using SfzMap512 = SfzHashMapLocal<K, V, 512>;
 
+// HashSet
+// ------------------------------------------------------------------------------------------------
+
+// A HashSet, uses the exact same layout and probing as SfzHashMap but stores no values.
+//
+// Prefer this over using SfzHashMap<K, u8> or similar as a set, it avoids the extra value array
+// (memory, and cache traffic when rehashing). The keys are compactly stored in a sequential array,
+// so iterating over the contents is just iterating over keys() (or using a range-based for loop).
+template<typename K>
+class SfzHashSet final {
+public:
+	// Constants and typedefs
+	// --------------------------------------------------------------------------------------------
+
+	using AltK = typename SfzAltType<K>::AltT;
+
+	static constexpr u32 ALIGNMENT = 32;
+	static constexpr u32 MIN_CAPACITY = 64;
+	static constexpr u32 MAX_CAPACITY = (1 << 30) - 1; // 2 bits reserved for info
+	static constexpr f32 MAX_OCCUPIED_REHASH_FACTOR = 0.80f;
+	static constexpr f32 GROW_RATE = 1.75f;
+
+	static_assert(alignof(K) <= ALIGNMENT, "");
+
+	// Constructors & destructors
+	// --------------------------------------------------------------------------------------------
+
+	SFZ_DECLARE_DROP_TYPE(SfzHashSet);
+
+	SfzHashSet(u32 capacity, SfzAllocator* allocator, SfzDbgInfo alloc_dbg) noexcept
+	{
+		this->init(capacity, allocator, alloc_dbg);
+	}
+
+	// State methods
+	// --------------------------------------------------------------------------------------------
+
+	void init(u32 capacity, SfzAllocator* allocator, SfzDbgInfo alloc_dbg)
+	{
+		this->destroy();
+		m_allocator = allocator;
+		this->rehash(capacity, alloc_dbg);
+	}
+
+	SfzHashSet clone(SfzAllocator* allocator, SfzDbgInfo alloc_dbg) const
+	{
+		SfzHashSet tmp(m_capacity, allocator, alloc_dbg);
+		tmp.m_size = this->m_size;
+		for (u32 i = 0; i < m_size; i++) {
+			new (tmp.m_keys + i) K(this->m_keys[i]);
+		}
+		tmp.m_placeholders = this->m_placeholders;
+		for (u32 i = 0; i < m_capacity; i++) {
+			tmp.m_slots[i] = this->m_slots[i];
+		}
+		return tmp;
+	}
+
+	// Destroys all elements stored in this HashSet, deallocates all memory and removes allocator.
+	void destroy()
+	{
+		if (m_allocation == nullptr) { m_allocator = nullptr; return; }
+
+		// Remove elements
+		this->clear();
+
+		// Deallocate memory
+		m_allocator->dealloc(m_allocation);
+		m_capacity = 0;
+		m_placeholders = 0;
+		m_allocation = nullptr;
+		m_slots = nullptr;
+		m_keys = nullptr;
+		m_allocator = nullptr;
+	}
+
+	// Removes all elements from this HashSet without deallocating memory.
+	void clear()
+	{
+		if (m_size == 0) return;
+		sfz_assert(m_size <= m_capacity);
+
+		// Call destructors for all active keys
+		for (u32 i = 0; i < m_size; i++) {
+			m_keys[i].~K();
+		}
+
+		// Clear all slots
+		memset(m_slots, 0, sfzRoundUpAlignedU64(m_capacity * sizeof(SfzHashMapSlot), ALIGNMENT));
+
+		// Set size to 0
+		m_size = 0;
+		m_placeholders = 0;
+	}
+
+	// Rehashes this HashSet to the specified capacity. All old pointers and references are invalidated.
+	void rehash(u32 new_capacity, SfzDbgInfo alloc_dbg)
+	{
+		if (new_capacity == 0) return;
+		if (new_capacity < MIN_CAPACITY) new_capacity = MIN_CAPACITY;
+		if (new_capacity < m_capacity) new_capacity = m_capacity;
+		sfz_assert_hard(new_capacity <= MAX_CAPACITY);
+
+		// Don't rehash if capacity already exists and there are no placeholders
+		if (new_capacity == m_capacity && m_placeholders == 0) return;
+
+		sfz_assert_hard(m_allocator != nullptr);
+
+		// Create new hash set and calculate size of its arrays
+		SfzHashSet tmp;
+		tmp.m_capacity = new_capacity;
+		u64 size_of_slots = sfzRoundUpAlignedU64(tmp.m_capacity * sizeof(SfzHashMapSlot), ALIGNMENT);
+		u64 size_of_keys = sfzRoundUpAlignedU64(sizeof(K) * tmp.m_capacity, ALIGNMENT);
+		u64 allocSize = size_of_slots + size_of_keys;
+
+		// Allocate and clear memory for new hash set
+		tmp.m_allocation = static_cast<u8*>(m_allocator->alloc(alloc_dbg, allocSize, ALIGNMENT));
+		memset(tmp.m_allocation, 0, allocSize);
+		tmp.m_allocator = m_allocator;
+		tmp.m_slots = reinterpret_cast<SfzHashMapSlot*>(tmp.m_allocation);
+		tmp.m_keys = reinterpret_cast<K*>(tmp.m_allocation + size_of_slots);
+
+		// Move all keys in this HashSet to the new one
+		if (this->m_allocation != nullptr) {
+			for (u32 i = 0; i < m_size; i++) {
+				tmp.addInternal<K>(sfz_move(m_keys[i]));
+			}
+		}
+
+		// Replace this HashSet with the new one
+		this->swap(tmp);
+	}
+
+	// Getters
+	// --------------------------------------------------------------------------------------------
+
+	const K* keys() const { return m_keys; }
+	u32 size() const { return m_size; }
+	u32 capacity() const { return m_capacity; }
+	u32 placeholders() const { return m_placeholders; }
+	bool isEmpty() const { return m_size == 0; }
+	SfzAllocator* allocator() const { return m_allocator; }
+
+	bool contains(const K& key) const { return this->findOccupiedSlot<K>(key) != ~0u; }
+	bool contains(const AltK& key) const { return this->findOccupiedSlot<AltK>(key) != ~0u; }
+
+	// Public methods
+	// --------------------------------------------------------------------------------------------
+
+	// Adds the specified key to this HashSet. Returns true if the key was added, false if it
+	// already existed. Might trigger a rehash.
+	bool add(const K& key)
+	{
+		// A key stored in this set is already in it, and would be freed by a rehash before it is read
+		if (this->isOwnKey(&key)) return false;
+		return this->addInternal<const K&>(key);
+	}
+	bool add(K&& key) { return this->addInternal<K>(sfz_move(key)); }
+	bool add(const AltK& key) { return this->addInternal<const K&>(SfzAltType<K>::conv(key)); }
+
+	// Adds all the specified keys, rehashes at most once. Returns the number of keys added.
+	u32 add(const K* keys, u32 num_keys)
+	{
+		if (num_keys == 0) return 0;
+		if (this->isOwnKey(keys)) {
+			// Keys from this set (e.g. a union with itself), all of them are already in it. Must
+			// return before reserve(), which could free them.
+			sfz_assert(this->isOwnKey(keys + num_keys - 1));
+			return 0;
+		}
+		this->reserve(m_size + num_keys);
+		u32 num_added = 0;
+		for (u32 i = 0; i < num_keys; i++) {
+			if (this->addInternal<const K&>(keys[i])) num_added += 1;
+		}
+		return num_added;
+	}
+
+	// Makes sure the given number of keys can be stored without rehashing.
+	void reserve(u32 num_keys)
+	{
+		const u32 needed_capacity = u32(f32(num_keys) / MAX_OCCUPIED_REHASH_FACTOR) + 2;
+		if (needed_capacity > m_capacity || (num_keys + m_placeholders) >= maxNumOccupied()) {
+			this->rehash(u32_max(needed_capacity, m_capacity), sfz_dbg("HashSet"));
+		}
+	}
+
+	// Attempts to remove the given key. Returns false if this HashSet contains no such key.
+	// Guaranteed to not rehash.
+	bool remove(const K& key) { return this->removeInternal<K>(key); }
+	bool remove(const AltK& key) { return this->removeInternal<AltK>(key); }
+
+	// Set algebra, modifies this set in place. The other set can be any set type with keys(),
+	// size() and contains() (e.g. SfzHashSet or SfzHashSetLocal).
+
+	// Adds all keys in other to this set.
+	template<typename SetT>
+	void unionWith(const SetT& other)
+	{
+		if (static_cast<const void*>(&other) == this) return;
+		this->add(other.keys(), other.size());
+	}
+
+	// Removes all keys not in other from this set.
+	template<typename SetT>
+	void intersectWith(const SetT& other)
+	{
+		// Iterate backwards, remove() swaps in the last key which has then already been checked
+		for (u32 i = m_size; i > 0; i--) {
+			if (!other.contains(m_keys[i - 1])) this->removeInternal<K>(m_keys[i - 1]);
+		}
+	}
+
+	// Removes all keys in other from this set.
+	template<typename SetT>
+	void differenceWith(const SetT& other)
+	{
+		if (other.size() < m_size) {
+			const K* other_keys = other.keys();
+			for (u32 i = 0; i < other.size(); i++) this->removeInternal<K>(other_keys[i]);
+		}
+		else {
+			for (u32 i = m_size; i > 0; i--) {
+				if (other.contains(m_keys[i - 1])) this->removeInternal<K>(m_keys[i - 1]);
+			}
+		}
+	}
+
+	// Iterators
+	// --------------------------------------------------------------------------------------------
+
+	const K* begin() const { return m_keys; }
+	const K* end() const { return m_keys + m_size; }
+
+private:
+	// Private methods
+	// --------------------------------------------------------------------------------------------
+
+	u32 maxNumOccupied() const { return u32(m_capacity * MAX_OCCUPIED_REHASH_FACTOR); }
+
+	// Returns whether the pointer points into the key array of this set.
+	bool isOwnKey(const K* ptr) const
+	{
+		const uintptr_t p = reinterpret_cast<uintptr_t>(ptr);
+		const uintptr_t begin = reinterpret_cast<uintptr_t>(m_keys);
+		return begin <= p && p < begin + uintptr_t(m_size) * sizeof(K);
+	}
+
+	template<typename KT>
+	void findSlot(const KT& key, u32& first_free_slot_idx, u32& occupied_slot_idx) const
+	{
+		sfzHashTableFindSlot<K, KT>(m_slots, m_keys, m_capacity, key, first_free_slot_idx, occupied_slot_idx);
+	}
+
+	template<typename KT>
+	u32 findOccupiedSlot(const KT& key) const
+	{
+		u32 first_free_slot_idx = ~0u;
+		u32 occupied_slot_idx = ~0u;
+		this->findSlot<KT>(key, first_free_slot_idx, occupied_slot_idx);
+		return occupied_slot_idx;
+	}
+
+	template<typename KT>
+	bool addInternal(KT&& key)
+	{
+		// Rehash if necessary
+		if ((m_size + m_placeholders) >= maxNumOccupied()) {
+			this->rehash(u32((m_capacity + 1) * GROW_RATE), sfz_dbg("HashSet"));
+		}
+
+		// Finds slots
+		u32 first_free_slot_idx = ~0u;
+		u32 occupied_slot_idx = ~0u;
+		this->findSlot<K>(key, first_free_slot_idx, occupied_slot_idx);
+
+		// Return if set already contains key
+		if (occupied_slot_idx != ~0u) return false;
+
+		// Calculate next index
+		u32 next_free_idx = m_size;
+		m_size += 1;
+
+		// Check if previous slot was placeholder and then create new slot
+		sfz_assert(first_free_slot_idx < m_capacity);
+		bool was_placeholder = m_slots[first_free_slot_idx].state() == SfzHashMapSlotState::PLACEHOLDER;
+		if (was_placeholder) m_placeholders -= 1;
+		m_slots[first_free_slot_idx] = SfzHashMapSlot(SfzHashMapSlotState::OCCUPIED, next_free_idx);
+
+		// Insert key
+		new (m_keys + next_free_idx) K(sfz_forward(key));
+		return true;
+	}
+
+	template<typename KT>
+	bool removeInternal(const KT& key)
+	{
+		// Finds slot
+		const u32 occupied_slot_idx = this->findOccupiedSlot<KT>(key);
+
+		// Return false if set does not contain element
+		if (occupied_slot_idx == ~0u) return false;
+
+		// Swap the key with the last key in the array
+		sfz_assert(m_size > 0);
+		const u32 last_slot_idx = this->findOccupiedSlot<K>(m_keys[m_size - 1]);
+		sfz_assert(last_slot_idx != ~0u);
+		const u32 idx = m_slots[occupied_slot_idx].index();
+		const u32 last_idx = m_slots[last_slot_idx].index();
+		sfzSwap(m_slots[occupied_slot_idx], m_slots[last_slot_idx]);
+		sfzSwap(m_keys[idx], m_keys[last_idx]);
+
+		// Remove the element
+		sfz_assert(m_slots[occupied_slot_idx].index() == m_size - 1);
+		m_slots[occupied_slot_idx] = SfzHashMapSlot(SfzHashMapSlotState::PLACEHOLDER, ~0u);
+		m_keys[m_size - 1].~K();
+
+		// Update info
+		m_size -= 1;
+		m_placeholders += 1;
+		return true;
+	}
+
+	// Private members
+	// --------------------------------------------------------------------------------------------
+
+	u32 m_size = 0, m_capacity = 0, m_placeholders = 0;
+	u8* m_allocation = nullptr;
+	SfzHashMapSlot* m_slots = nullptr;
+	K* m_keys = nullptr;
+	SfzAllocator* m_allocator = nullptr;
+};
+
+// HashSetLocal
+// ------------------------------------------------------------------------------------------------
+
+template<typename K, u32 Capacity>
+class SfzHashSetLocal {
+public:
+	using AltK = typename SfzAltType<K>::AltT;
+	static_assert(alignof(K) <= 16, "");
+
+	// Constructors & destructors
+	// --------------------------------------------------------------------------------------------
+
+	SfzHashSetLocal() = default;
+	SfzHashSetLocal(const SfzHashSetLocal&) = default;
+	SfzHashSetLocal& operator= (const SfzHashSetLocal&) = default;
+	SfzHashSetLocal(SfzHashSetLocal&& other) noexcept { this->swap(other); }
+	SfzHashSetLocal& operator= (SfzHashSetLocal&& other) noexcept { this->swap(other); return *this; }
+	~SfzHashSetLocal() = default;
+
+	// State methods
+	// --------------------------------------------------------------------------------------------
+
+	void swap(SfzHashSetLocal& other)
+	{
+		for (u32 i = 0; i < Capacity; i++) {
+			sfzSwap(this->m_slots[i], other.m_slots[i]);
+			sfzSwap(this->m_keys[i], other.m_keys[i]);
+		}
+		sfzSwap(this->m_size, other.m_size);
+		sfzSwap(this->m_placeholders, other.m_placeholders);
+	}
+
+	void clear()
+	{
+		if (m_size == 0) return;
+		sfz_assert(m_size <= Capacity);
+
+		// Reset all active keys
+		for (u32 i = 0; i < m_size; i++) {
+			m_keys[i] = K();
+		}
+
+		// Clear all slots
+		memset(m_slots, 0, sizeof(m_slots));
+
+		// Set size to 0
+		m_size = 0;
+		m_placeholders = 0;
+	}
+
+	// Getters
+	// --------------------------------------------------------------------------------------------
+
+	const K* keys() const { return m_keys; }
+	u32 size() const { return m_size; }
+	u32 capacity() const { return Capacity; }
+	u32 placeholders() const { return m_placeholders; }
+	bool isEmpty() const { return m_size == 0; }
+	bool isFull() const { return m_size == Capacity; }
+
+	bool contains(const K& key) const { return this->findOccupiedSlot<K>(key) != ~0u; }
+	bool contains(const AltK& key) const { return this->findOccupiedSlot<AltK>(key) != ~0u; }
+
+	// Public methods
+	// --------------------------------------------------------------------------------------------
+
+	bool add(const K& key) { return this->addInternal(key); }
+	bool add(const AltK& key) { return this->addInternal(SfzAltType<K>::conv(key)); }
+
+	u32 add(const K* keys, u32 num_keys)
+	{
+		u32 num_added = 0;
+		for (u32 i = 0; i < num_keys; i++) {
+			if (this->addInternal(keys[i])) num_added += 1;
+		}
+		return num_added;
+	}
+
+	bool remove(const K& key) { return this->removeInternal<K>(key); }
+	bool remove(const AltK& key) { return this->removeInternal<AltK>(key); }
+
+	// Set algebra, see SfzHashSet.
+
+	template<typename SetT>
+	void unionWith(const SetT& other)
+	{
+		if (static_cast<const void*>(&other) == this) return;
+		this->add(other.keys(), other.size());
+	}
+
+	template<typename SetT>
+	void intersectWith(const SetT& other)
+	{
+		for (u32 i = m_size; i > 0; i--) {
+			if (!other.contains(m_keys[i - 1])) this->removeInternal<K>(m_keys[i - 1]);
+		}
+	}
+
+	template<typename SetT>
+	void differenceWith(const SetT& other)
+	{
+		for (u32 i = m_size; i > 0; i--) {
+			if (other.contains(m_keys[i - 1])) this->removeInternal<K>(m_keys[i - 1]);
+		}
+	}
+
+	// Iterators
+	// --------------------------------------------------------------------------------------------
+
+	const K* begin() const { return m_keys; }
+	const K* end() const { return m_keys + m_size; }
+
+private:
+	// Private methods
+	// --------------------------------------------------------------------------------------------
+
+	template<typename KT>
+	void findSlot(const KT& key, u32& first_free_slot_idx, u32& occupied_slot_idx) const
+	{
+		sfzHashTableFindSlot<K, KT>(m_slots, m_keys, Capacity, key, first_free_slot_idx, occupied_slot_idx);
+	}
+
+	template<typename KT>
+	u32 findOccupiedSlot(const KT& key) const
+	{
+		u32 first_free_slot_idx = ~0u;
+		u32 occupied_slot_idx = ~0u;
+		this->findSlot<KT>(key, first_free_slot_idx, occupied_slot_idx);
+		return occupied_slot_idx;
+	}
+
+	bool addInternal(const K& key)
+	{
+		// Finds slots
+		u32 first_free_slot_idx = ~0u;
+		u32 occupied_slot_idx = ~0u;
+		this->findSlot<K>(key, first_free_slot_idx, occupied_slot_idx);
+
+		// Return if set already contains key
+		if (occupied_slot_idx != ~0u) return false;
+
+		// Calculate next index
+		sfz_assert_hard(m_size < Capacity);
+		u32 next_free_idx = m_size;
+		m_size += 1;
+
+		// Check if previous slot was placeholder and then create new slot
+		sfz_assert_hard(first_free_slot_idx < Capacity);
+		bool was_placeholder = m_slots[first_free_slot_idx].state() == SfzHashMapSlotState::PLACEHOLDER;
+		if (was_placeholder) m_placeholders -= 1;
+		m_slots[first_free_slot_idx] = SfzHashMapSlot(SfzHashMapSlotState::OCCUPIED, next_free_idx);
+
+		// Insert key
+		m_keys[next_free_idx] = key;
+		return true;
+	}
+
+	template<typename KT>
+	bool removeInternal(const KT& key)
+	{
+		// Finds slot
+		const u32 occupied_slot_idx = this->findOccupiedSlot<KT>(key);
+
+		// Return false if set does not contain element
+		if (occupied_slot_idx == ~0u) return false;
+
+		// Swap the key with the last key in the array
+		sfz_assert(m_size > 0);
+		const u32 last_slot_idx = this->findOccupiedSlot<K>(m_keys[m_size - 1]);
+		sfz_assert(last_slot_idx != ~0u);
+		const u32 idx = m_slots[occupied_slot_idx].index();
+		const u32 last_idx = m_slots[last_slot_idx].index();
+		sfzSwap(m_slots[occupied_slot_idx], m_slots[last_slot_idx]);
+		sfzSwap(m_keys[idx], m_keys[last_idx]);
+
+		// Remove the element
+		sfz_assert(m_slots[occupied_slot_idx].index() == m_size - 1);
+		m_slots[occupied_slot_idx] = SfzHashMapSlot(SfzHashMapSlotState::PLACEHOLDER, ~0u);
+		m_keys[m_size - 1] = K();
+
+		// Update info
+		m_size -= 1;
+		m_placeholders += 1;
+		return true;
+	}
+
+	// Private members
+	// --------------------------------------------------------------------------------------------
+
+	SfzHashMapSlot m_slots[Capacity];
+	K m_keys[Capacity];
+	u32 m_size = 0;
+	u32 m_placeholders = 0;
+};
+
+template<typename K> using SfzSet4 = SfzHashSetLocal<K, 4>;
+template<typename K> using SfzSet8 = SfzHashSetLocal<K, 8>;
+template<typename K> using SfzSet16 = SfzHashSetLocal<K, 16>;
+template<typename K> using SfzSet32 = SfzHashSetLocal<K, 32>;
+template<typename K> using SfzSet64 = SfzHashSetLocal<K, 64>;
+template<typename K> using SfzSet128 = SfzHashSetLocal<K, 128>;
+template<typename K> using SfzSet256 = SfzHashSetLocal<K, 256>;
+
 #endif // __cplusplus
 #endif // SKIPIFZERO_HASH_MAPS
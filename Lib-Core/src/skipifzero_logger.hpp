@@ -0,0 +1,681 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#ifndef SKIPIFZERO_LOGGER_HPP
+#define SKIPIFZERO_LOGGER_HPP
+#pragma once
+
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+#include <wchar.h>
+
+#include "sfz.h"
+#include "sfz_cpp.hpp"
+#include "skipifzero_strings.hpp"
+#include "skipifzero_sync.hpp"
+
+// Log levels and sinks
+// ------------------------------------------------------------------------------------------------
+
+enum SfzLogLevel : u32 {
+	SFZ_LOG_LEVEL_NOISE = 0,
+	SFZ_LOG_LEVEL_INFO = 1,
+	SFZ_LOG_LEVEL_WARNING = 2,
+	SFZ_LOG_LEVEL_ERROR = 3,
+};
+
+inline const char* sfzLogLevelToString(SfzLogLevel level)
+{
+	switch (level) {
+	case SFZ_LOG_LEVEL_NOISE: return "NOISE";
+	case SFZ_LOG_LEVEL_INFO: return "INFO";
+	case SFZ_LOG_LEVEL_WARNING: return "WARNING";
+	case SFZ_LOG_LEVEL_ERROR: return "ERROR";
+	}
+	return "<UNKNOWN>";
+}
+
+// A formatted log message as handed to the sinks. The strings are only valid for the duration of
+// the sink call.
+struct SfzLogMessage final {
+	SfzLogLevel level;
+	u32 thread_idx; // Index of the logging thread's ring buffer, SFZ_LOGGER_MAX_NUM_THREADS if it has none
+	u64 timestamp_ns; // See sfzSyncTimestampNs()
+	const char* file;
+	i32 line;
+	const char* msg;
+};
+
+// A sink receives every message that passes the level filter. Sinks are only ever called from the
+// logger's consumer thread (the background thread, or whoever calls drain()), so they don't need
+// to be thread-safe with respect to each other.
+typedef void SfzLogSinkFunc(void* userdata, const SfzLogMessage* msg);
+
+// Simple sink which prints to stdout, or stderr for warnings and errors.
+inline void sfzLogSinkStdio(void* userdata, const SfzLogMessage* msg)
+{
+	(void)userdata;
+	FILE* file = msg->level >= SFZ_LOG_LEVEL_WARNING ? stderr : stdout;
+	fprintf(file, "[%s] %s:%i: %s\n",
+		sfzLogLevelToString(msg->level), msg->file, msg->line, msg->msg);
+}
+
+// Argument encoding
+// ------------------------------------------------------------------------------------------------
+
+// Arguments are stored raw in the ring buffer and only formatted on the consumer thread. Every
+// argument occupies one or more 8-byte slots. Trivially copyable values up to 8 bytes (integers,
+// floats, enums, pointers) are copied as is. Strings (char and wchar_t) are copied inline, as
+// pointers into the caller's memory may be dead by the time the message is formatted.
+
+template<typename T>
+struct SfzLogArg final {
+	static_assert(__is_trivially_copyable(T) && sizeof(T) <= 8, "Unsupported log argument type");
+	using DecodedT = T;
+	static u32 payloadSize(const T&) { return sizeof(T); }
+	static u32 slotSize(u32) { return 8; }
+	static void encode(u8* dst, const T& v, u32) { memcpy(dst, &v, sizeof(T)); }
+	static T decode(const u8*& src) { T v; memcpy(&v, src, sizeof(T)); src += 8; return v; }
+};
+
+template<typename CharT>
+struct SfzLogStrArg {
+	using DecodedT = const CharT*;
+	static const CharT* nonNull(const CharT* str)
+	{
+		if (str != nullptr) return str;
+		if constexpr (sizeof(CharT) == 1) return "(null)";
+		else return L"(null)";
+	}
+	static u32 payloadSize(const CharT* str)
+	{
+		if constexpr (sizeof(CharT) == 1) return u32(strlen(nonNull(str)) + 1);
+		else return u32(wcslen(nonNull(str)) + 1) * sizeof(CharT);
+	}
+	static u32 slotSize(u32 payload_size) { return sfzRoundUpAlignedU32(sizeof(u32) + payload_size, 8); }
+	static void encode(u8* dst, const CharT* str, u32 payload_size)
+	{
+		memcpy(dst, &payload_size, sizeof(u32));
+		memcpy(dst + sizeof(u32), nonNull(str), payload_size);
+	}
+	static const CharT* decode(const u8*& src)
+	{
+		u32 payload_size = 0;
+		memcpy(&payload_size, src, sizeof(u32));
+		const CharT* str = reinterpret_cast<const CharT*>(src + sizeof(u32));
+		src += slotSize(payload_size);
+		return str;
+	}
+};
+
+template<> struct SfzLogArg<const char*> final : SfzLogStrArg<char> {};
+template<> struct SfzLogArg<char*> final : SfzLogStrArg<char> {};
+template<> struct SfzLogArg<const wchar_t*> final : SfzLogStrArg<wchar_t> {};
+template<> struct SfzLogArg<wchar_t*> final : SfzLogStrArg<wchar_t> {};
+
+template<typename... Ts> struct SfzLogTypeList final {};
+
+// Decodes the arguments one by one (in order) and then formats them with sfzStrAppendf().
+template<typename... Decoded>
+void sfzLogFormatImpl(SfzStrView out, const char* fmt, const u8*, SfzLogTypeList<>, Decoded... decoded)
+{
+	sfzStrAppendf(out, fmt, decoded...);
+}
+
+template<typename T, typename... Rest, typename... Decoded>
+void sfzLogFormatImpl(
+	SfzStrView out, const char* fmt, const u8* args, SfzLogTypeList<T, Rest...>, Decoded... decoded)
+{
+	const typename SfzLogArg<T>::DecodedT v = SfzLogArg<T>::decode(args);
+	sfzLogFormatImpl(out, fmt, args, SfzLogTypeList<Rest...>(), decoded..., v);
+}
+
+// One instantiation per argument type list, stored in each entry so the consumer knows how to
+// decode the arguments.
+typedef void SfzLogFormatFunc(SfzStrView out, const char* fmt, const u8* args);
+
+template<typename... Args>
+void sfzLogFormat(SfzStrView out, const char* fmt, const u8* args)
+{
+	sfzLogFormatImpl(out, fmt, args, SfzLogTypeList<Args...>());
+}
+
+// Ring buffer
+// ------------------------------------------------------------------------------------------------
+
+// Header of each entry in a ring buffer, followed by the encoded arguments. Entries are always
+// 8-byte aligned and never wrap around the end of the buffer. If an entry does not fit in the
+// space left before the end, that space is skipped. If there is room for a header it is marked
+// with a padding entry (format_func == nullptr), otherwise it is implicitly skipped.
+struct SfzLogEntryHeader final {
+	u32 size; // Size of entry (including header) in bytes, multiple of 8
+	SfzLogLevel level;
+	u64 timestamp_ns;
+	const char* file;
+	const char* fmt;
+	SfzLogFormatFunc* format_func;
+	i32 line;
+	u32 padding;
+};
+static_assert(sizeof(SfzLogEntryHeader) == 48, "SfzLogEntryHeader is padded");
+
+// A single producer single consumer byte ring buffer, one per logging thread. Head and tail are
+// monotonically increasing byte offsets, the position in the buffer is (offset & (capacity - 1)).
+struct SfzLogRing final {
+	// Producer
+	alignas(SFZ_SYNC_CACHE_LINE_SIZE) std::atomic<u64> head = 0;
+	u64 cached_tail = 0; // Last seen tail, only refreshed when the ring looks full
+	std::atomic<u64> num_dropped = 0;
+	const void* owner = nullptr; // Address of the owning thread's thread_local token
+	u8* data = nullptr;
+	u32 capacity = 0; // Power of two
+	u32 idx = 0;
+
+	// Consumer
+	alignas(SFZ_SYNC_CACHE_LINE_SIZE) std::atomic<u64> tail = 0;
+	u64 num_dropped_reported = 0;
+};
+
+// SfzLogger
+// ------------------------------------------------------------------------------------------------
+
+constexpr u32 SFZ_LOGGER_MAX_NUM_THREADS = 64;
+constexpr u32 SFZ_LOGGER_MAX_NUM_SINKS = 8;
+constexpr u32 SFZ_LOGGER_DEFAULT_RING_SIZE = 64 * 1024;
+constexpr u32 SFZ_LOGGER_DEFAULT_POLL_INTERVAL_MS = 4;
+
+// An asynchronous logger with deferred formatting.
+//
+// The calling thread only copies the format string pointer, its arguments and some metadata
+// (level, timestamp, file and line) into its own lock-free ring buffer. All formatting and writing
+// to sinks happens on a background thread (or whichever thread calls drain() if no background
+// thread is started). This means that the format string (and file) must have static lifetime,
+// which string literals do. String arguments are copied, so they may be temporaries.
+//
+// Each thread registers its own ring buffer the first time it logs, which is the only time the
+// logger takes a lock on the calling thread. Ring buffers live as long as the logger, at most
+// SFZ_LOGGER_MAX_NUM_THREADS threads can register one. If a ring buffer is full, or the calling
+// thread could not get one, the message is dropped rather than blocking the caller. The consumer
+// reports the number of dropped messages as a warning.
+//
+// Messages from different threads are merged by timestamp within each drain, so the output is in
+// timestamp order except for messages published while a previous drain was running. Messages at or
+// above the wake level (error by default) wake up the background thread immediately, which costs a
+// syscall on the calling thread. Lower levels are picked up within the poll interval.
+class SfzLogger final {
+public:
+	SfzLogger() noexcept = default;
+	SfzLogger(const SfzLogger&) = delete;
+	SfzLogger& operator= (const SfzLogger&) = delete;
+	SfzLogger(SfzLogger&&) = delete;
+	SfzLogger& operator= (SfzLogger&&) = delete;
+	~SfzLogger() noexcept { this->destroy(); }
+
+	// State methods
+	// --------------------------------------------------------------------------------------------
+
+	// ring_size is the size in bytes of each thread's ring buffer, rounded up to a power of two.
+	// If start_thread is false no background thread is started, instead the owner must
+	// periodically call drain() from a single thread.
+	void init(
+		SfzAllocator* allocator,
+		bool start_thread = true,
+		u32 ring_size = SFZ_LOGGER_DEFAULT_RING_SIZE,
+		u32 poll_interval_ms = SFZ_LOGGER_DEFAULT_POLL_INTERVAL_MS)
+	{
+		this->destroy();
+		sfz_assert(allocator != nullptr);
+		sfz_assert(ring_size >= 1024);
+		m_allocator = allocator;
+		m_id = nextLoggerId().fetch_add(1, std::memory_order_relaxed) + 1;
+		m_ring_size = 1024;
+		while (m_ring_size < ring_size) m_ring_size *= 2;
+		m_poll_interval_ms = poll_interval_ms;
+		m_stop.store(0, std::memory_order_relaxed);
+		if (start_thread) {
+			m_thread.start([](void* logger) { static_cast<SfzLogger*>(logger)->threadMain(); }, this);
+		}
+	}
+
+	// Stops the background thread after it has written all pending messages, then frees all ring
+	// buffers. No thread may log while the logger is destroyed.
+	void destroy()
+	{
+		if (m_allocator == nullptr) return;
+		if (m_thread.isStarted()) {
+			m_stop.store(1, std::memory_order_release);
+			this->wakeConsumer();
+			m_thread.join();
+		}
+		else {
+			this->drain();
+		}
+		const u32 num_rings = m_num_rings.load(std::memory_order_acquire);
+		for (u32 i = 0; i < num_rings; i++) {
+			m_allocator->dealloc(m_rings[i]);
+			m_rings[i] = nullptr;
+		}
+		m_num_rings.store(0, std::memory_order_relaxed);
+		m_num_sinks = 0;
+		m_min_level.store(SFZ_LOG_LEVEL_NOISE, std::memory_order_relaxed);
+		m_wake_level.store(SFZ_LOG_LEVEL_ERROR, std::memory_order_relaxed);
+		m_num_dropped_unregistered.store(0, std::memory_order_relaxed);
+		m_num_dropped_unregistered_reported = 0;
+		m_id = 0;
+		m_allocator = nullptr;
+	}
+
+	// Getters and settings
+	// --------------------------------------------------------------------------------------------
+
+	SfzAllocator* allocator() const { return m_allocator; }
+	bool isThreaded() const { return m_thread.isStarted(); }
+	u32 numRegisteredThreads() const { return m_num_rings.load(std::memory_order_acquire); }
+
+	// Messages below the min level are discarded on the calling thread before anything is copied.
+	SfzLogLevel minLevel() const { return SfzLogLevel(m_min_level.load(std::memory_order_relaxed)); }
+	void setMinLevel(SfzLogLevel level) { m_min_level.store(level, std::memory_order_relaxed); }
+
+	// Messages at or above the wake level wake up the background thread immediately.
+	SfzLogLevel wakeLevel() const { return SfzLogLevel(m_wake_level.load(std::memory_order_relaxed)); }
+	void setWakeLevel(SfzLogLevel level) { m_wake_level.store(level, std::memory_order_relaxed); }
+
+	// Total number of messages dropped because a ring buffer was full, a message was too large or
+	// too many threads were registered.
+	u64 numDropped() const
+	{
+		u64 num_dropped = m_num_dropped_unregistered.load(std::memory_order_relaxed);
+		const u32 num_rings = m_num_rings.load(std::memory_order_acquire);
+		for (u32 i = 0; i < num_rings; i++) {
+			num_dropped += m_rings[i]->num_dropped.load(std::memory_order_relaxed);
+		}
+		return num_dropped;
+	}
+
+	// Adds a sink, thread-safe. Messages already in flight may or may not reach the new sink.
+	void addSink(SfzLogSinkFunc* func, void* userdata)
+	{
+		sfz_assert(func != nullptr);
+		SfzLockGuard<SfzMutex> guard(m_sinks_mutex);
+		sfz_assert_hard(m_num_sinks < SFZ_LOGGER_MAX_NUM_SINKS);
+		m_sinks[m_num_sinks] = Sink{ func, userdata };
+		m_num_sinks += 1;
+	}
+
+	// Producer methods
+	// --------------------------------------------------------------------------------------------
+
+	// Logs a printf-style message. fmt and file must have static lifetime. Prefer the SFZ_LOG_*()
+	// macros, which fill in file and line.
+	template<typename... Args>
+	void log(SfzLogLevel level, const char* file, i32 line, const char* fmt, Args... args)
+	{
+		if (u32(level) < m_min_level.load(std::memory_order_relaxed)) return;
+		SfzLogRing* ring = this->threadRing();
+		if (ring == nullptr) {
+			m_num_dropped_unregistered.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		if constexpr (sizeof...(Args) == 0) {
+			u64 new_head = 0;
+			u8* entry = this->beginEntry<>(ring, level, file, line, fmt, sizeof(SfzLogEntryHeader), &new_head);
+			if (entry != nullptr) this->publishEntry(ring, level, new_head);
+		}
+		else {
+			// Calculate size of entry, the payload sizes are kept so strings are only measured once
+			u32 payload_sizes[sizeof...(Args)];
+			u32 entry_size = sizeof(SfzLogEntryHeader);
+			u32 arg_idx = 0;
+			((payload_sizes[arg_idx] = SfzLogArg<Args>::payloadSize(args),
+				entry_size += SfzLogArg<Args>::slotSize(payload_sizes[arg_idx]),
+				arg_idx++), ...);
+
+			u64 new_head = 0;
+			u8* entry = this->beginEntry<Args...>(ring, level, file, line, fmt, entry_size, &new_head);
+			if (entry == nullptr) return;
+
+			// Write arguments
+			u8* arg_dst = entry + sizeof(SfzLogEntryHeader);
+			arg_idx = 0;
+			((SfzLogArg<Args>::encode(arg_dst, args, payload_sizes[arg_idx]),
+				arg_dst += SfzLogArg<Args>::slotSize(payload_sizes[arg_idx]),
+				arg_idx++), ...);
+			this->publishEntry(ring, level, new_head);
+		}
+	}
+
+	// Blocks until all messages logged (by any thread) before the call have been written to the
+	// sinks. If there is no background thread this simply calls drain(), so it must then only be
+	// called from the thread that drains.
+	void flush()
+	{
+		if (!m_thread.isStarted()) {
+			this->drain();
+			return;
+		}
+
+		u64 targets[SFZ_LOGGER_MAX_NUM_THREADS] = {};
+		const u32 num_rings = m_num_rings.load(std::memory_order_acquire);
+		for (u32 i = 0; i < num_rings; i++) {
+			targets[i] = m_rings[i]->head.load(std::memory_order_acquire);
+		}
+
+		m_num_flushers.fetch_add(1, std::memory_order_acq_rel);
+		while (true) {
+			const u32 drain_seq = m_drain_seq.load(std::memory_order_acquire);
+			bool done = true;
+			for (u32 i = 0; i < num_rings; i++) {
+				if (m_rings[i]->tail.load(std::memory_order_acquire) < targets[i]) {
+					done = false;
+					break;
+				}
+			}
+			if (done) break;
+			this->wakeConsumer();
+			sfzSyncWaitTimeout(&m_drain_seq, drain_seq, m_poll_interval_ms);
+		}
+		m_num_flushers.fetch_sub(1, std::memory_order_acq_rel);
+	}
+
+	// Consumer methods
+	// --------------------------------------------------------------------------------------------
+
+	// Formats and writes all pending messages to the sinks, merged across threads in timestamp
+	// order. Returns the number of messages written. Called by the background thread, only call
+	// manually if the logger was initialized without one.
+	u32 drain()
+	{
+		u64 heads[SFZ_LOGGER_MAX_NUM_THREADS] = {};
+		const u32 num_rings = m_num_rings.load(std::memory_order_acquire);
+		for (u32 i = 0; i < num_rings; i++) {
+			SfzLogRing* ring = m_rings[i];
+			heads[i] = ring->head.load(std::memory_order_acquire);
+			this->reportDropped(ring->idx, ring->num_dropped.load(std::memory_order_relaxed),
+				&ring->num_dropped_reported, "ring buffer full or message too large");
+		}
+		this->reportDropped(SFZ_LOGGER_MAX_NUM_THREADS,
+			m_num_dropped_unregistered.load(std::memory_order_relaxed), &m_num_dropped_unregistered_reported,
+			"too many threads have logged, no ring buffer left for the calling thread");
+
+		SfzStr2560 msg_str = {};
+		u32 num_written = 0;
+		while (true) {
+
+			// Find the oldest pending entry among all rings
+			SfzLogRing* next_ring = nullptr;
+			const SfzLogEntryHeader* next = nullptr;
+			for (u32 i = 0; i < num_rings; i++) {
+				const SfzLogEntryHeader* entry = peekEntry(m_rings[i], heads[i]);
+				if (entry == nullptr) continue;
+				if (next == nullptr || entry->timestamp_ns < next->timestamp_ns) {
+					next_ring = m_rings[i];
+					next = entry;
+				}
+			}
+			if (next == nullptr) break;
+
+			// Format and write to sinks
+			sfzStr2560Clear(&msg_str);
+			next->format_func(sfzStr2560ToView(&msg_str), next->fmt,
+				reinterpret_cast<const u8*>(next) + sizeof(SfzLogEntryHeader));
+			SfzLogMessage msg = {};
+			msg.level = next->level;
+			msg.thread_idx = next_ring->idx;
+			msg.timestamp_ns = next->timestamp_ns;
+			msg.file = next->file;
+			msg.line = next->line;
+			msg.msg = msg_str.str;
+			this->writeToSinks(&msg);
+			num_written += 1;
+
+			// Release entry to producer
+			const u64 tail = next_ring->tail.load(std::memory_order_relaxed);
+			next_ring->tail.store(tail + next->size, std::memory_order_release);
+		}
+		return num_written;
+	}
+
+private:
+	// Private methods
+	// --------------------------------------------------------------------------------------------
+
+	struct Sink final {
+		SfzLogSinkFunc* func;
+		void* userdata;
+	};
+
+	static std::atomic<u64>& nextLoggerId()
+	{
+		static std::atomic<u64> next_id = 0;
+		return next_id;
+	}
+
+	// Returns the calling thread's ring buffer, registering a new one if needed. Returns nullptr if
+	// all ring buffers are taken, which is cached as rings are never released before destroy().
+	SfzLogRing* threadRing()
+	{
+		// The address of a thread_local uniquely identifies a thread for as long as it is alive. If
+		// a thread exits and a new one gets the same address it simply inherits the old ring.
+		static thread_local u8 thread_token = 0;
+		static thread_local u64 cached_logger_id = 0;
+		static thread_local SfzLogRing* cached_ring = nullptr;
+		if (cached_logger_id == m_id) return cached_ring;
+
+		SfzLogRing* ring = this->findRing(&thread_token);
+		if (ring == nullptr) {
+			SfzLockGuard<SfzMutex> guard(m_register_mutex);
+			ring = this->findRing(&thread_token);
+			if (ring == nullptr) {
+				const u32 num_rings = m_num_rings.load(std::memory_order_relaxed);
+				if (num_rings >= SFZ_LOGGER_MAX_NUM_THREADS) {
+					cached_logger_id = m_id;
+					cached_ring = nullptr;
+					return nullptr;
+				}
+				const u64 alloc_size = sizeof(SfzLogRing) + m_ring_size;
+				u8* mem = static_cast<u8*>(
+					m_allocator->alloc(sfz_dbg("SfzLogRing"), alloc_size, SFZ_SYNC_CACHE_LINE_SIZE));
+				ring = new (mem) SfzLogRing();
+				ring->owner = &thread_token;
+				ring->data = mem + sizeof(SfzLogRing);
+				ring->capacity = m_ring_size;
+				ring->idx = num_rings;
+				m_rings[num_rings] = ring;
+				m_num_rings.store(num_rings + 1, std::memory_order_release);
+			}
+		}
+
+		cached_logger_id = m_id;
+		cached_ring = ring;
+		return ring;
+	}
+
+	SfzLogRing* findRing(const void* owner) const
+	{
+		const u32 num_rings = m_num_rings.load(std::memory_order_acquire);
+		for (u32 i = 0; i < num_rings; i++) {
+			if (m_rings[i]->owner == owner) return m_rings[i];
+		}
+		return nullptr;
+	}
+
+	// Reserves an entry in the calling thread's ring and writes its header, the arguments are written
+	// by the caller. Counts the message as dropped and returns nullptr if there is not enough space.
+	template<typename... Args>
+	u8* beginEntry(
+		SfzLogRing* ring, SfzLogLevel level, const char* file, i32 line, const char* fmt, u32 entry_size,
+		u64* new_head_out)
+	{
+		u8* entry = this->beginWrite(ring, entry_size, new_head_out);
+		if (entry == nullptr) {
+			ring->num_dropped.fetch_add(1, std::memory_order_relaxed);
+			return nullptr;
+		}
+		SfzLogEntryHeader* header = reinterpret_cast<SfzLogEntryHeader*>(entry);
+		header->size = entry_size;
+		header->level = level;
+		header->timestamp_ns = sfzSyncTimestampNs();
+		header->file = file;
+		header->fmt = fmt;
+		header->format_func = sfzLogFormat<Args...>;
+		header->line = line;
+		header->padding = 0;
+		return entry;
+	}
+
+	void publishEntry(SfzLogRing* ring, SfzLogLevel level, u64 new_head)
+	{
+		ring->head.store(new_head, std::memory_order_release);
+		if (u32(level) >= m_wake_level.load(std::memory_order_relaxed) && m_thread.isStarted()) {
+			this->wakeConsumer();
+		}
+	}
+
+	// Reserves entry_size bytes in the ring, returns nullptr if there is not enough space. The new
+	// head is returned in new_head_out and must be published by the caller once the entry is written.
+	static u8* beginWrite(SfzLogRing* ring, u32 entry_size, u64* new_head_out)
+	{
+		const u32 capacity = ring->capacity;
+		if (entry_size > capacity / 2) return nullptr;
+
+		u64 head = ring->head.load(std::memory_order_relaxed);
+		const u32 pos = u32(head & u64(capacity - 1));
+		const u32 until_end = capacity - pos;
+		const u32 skip = until_end < entry_size ? until_end : 0;
+		const u64 needed_end = head + skip + entry_size;
+		if (needed_end - ring->cached_tail > capacity) {
+			ring->cached_tail = ring->tail.load(std::memory_order_acquire);
+			if (needed_end - ring->cached_tail > capacity) return nullptr;
+		}
+
+		if (skip != 0) {
+			if (skip >= sizeof(SfzLogEntryHeader)) {
+				SfzLogEntryHeader* padding = reinterpret_cast<SfzLogEntryHeader*>(ring->data + pos);
+				padding->size = skip;
+				padding->format_func = nullptr;
+			}
+			head += skip;
+		}
+		*new_head_out = head + entry_size;
+		return ring->data + (head & u64(capacity - 1));
+	}
+
+	// Returns the next entry in the ring (before head), skipping padding. Consumer only.
+	static const SfzLogEntryHeader* peekEntry(SfzLogRing* ring, u64 head)
+	{
+		u64 tail = ring->tail.load(std::memory_order_relaxed);
+		while (tail < head) {
+			const u32 pos = u32(tail & u64(ring->capacity - 1));
+			const u32 until_end = ring->capacity - pos;
+			const SfzLogEntryHeader* entry =
+				reinterpret_cast<const SfzLogEntryHeader*>(ring->data + pos);
+			if (until_end >= sizeof(SfzLogEntryHeader) && entry->format_func != nullptr) return entry;
+			tail += until_end < sizeof(SfzLogEntryHeader) ? until_end : entry->size;
+			ring->tail.store(tail, std::memory_order_release);
+		}
+		return nullptr;
+	}
+
+	// Writes a warning with the number of messages dropped since the last report, if any.
+	void reportDropped(u32 thread_idx, u64 num_dropped, u64* num_reported, const char* reason)
+	{
+		if (num_dropped == *num_reported) return;
+		SfzStr320 msg_str = {};
+		sfzStr320Appendf(&msg_str, "Dropped %llu log messages (%s)", num_dropped - *num_reported, reason);
+		*num_reported = num_dropped;
+		SfzLogMessage msg = {};
+		msg.level = SFZ_LOG_LEVEL_WARNING;
+		msg.thread_idx = thread_idx;
+		msg.timestamp_ns = sfzSyncTimestampNs();
+		msg.file = __FILE__;
+		msg.line = __LINE__;
+		msg.msg = msg_str.str;
+		this->writeToSinks(&msg);
+	}
+
+	void writeToSinks(const SfzLogMessage* msg)
+	{
+		SfzLockGuard<SfzMutex> guard(m_sinks_mutex);
+		for (u32 i = 0; i < m_num_sinks; i++) {
+			m_sinks[i].func(m_sinks[i].userdata, msg);
+		}
+	}
+
+	void wakeConsumer()
+	{
+		m_wake_seq.fetch_add(1, std::memory_order_release);
+		sfzSyncWakeOne(&m_wake_seq);
+	}
+
+	void threadMain()
+	{
+		while (true) {
+			const u32 wake_seq = m_wake_seq.load(std::memory_order_acquire);
+			const bool stop = m_stop.load(std::memory_order_acquire) != 0;
+			const u32 num_written = this->drain();
+			m_drain_seq.fetch_add(1, std::memory_order_release);
+			if (m_num_flushers.load(std::memory_order_acquire) != 0) sfzSyncWakeAll(&m_drain_seq);
+			if (stop) break;
+			if (num_written == 0) sfzSyncWaitTimeout(&m_wake_seq, wake_seq, m_poll_interval_ms);
+		}
+	}
+
+	// Private members
+	// --------------------------------------------------------------------------------------------
+
+	// Written by producers
+	alignas(SFZ_SYNC_CACHE_LINE_SIZE) std::atomic<u32> m_wake_seq = 0;
+	std::atomic<u64> m_num_dropped_unregistered = 0;
+
+	// Read by producers, rarely written
+	alignas(SFZ_SYNC_CACHE_LINE_SIZE) u64 m_id = 0;
+	std::atomic<u32> m_min_level = SFZ_LOG_LEVEL_NOISE;
+	std::atomic<u32> m_wake_level = SFZ_LOG_LEVEL_ERROR;
+	std::atomic<u32> m_num_rings = 0;
+	u32 m_ring_size = 0;
+	SfzLogRing* m_rings[SFZ_LOGGER_MAX_NUM_THREADS] = {};
+	SfzMutex m_register_mutex;
+
+	// Consumer
+	alignas(SFZ_SYNC_CACHE_LINE_SIZE) std::atomic<u32> m_drain_seq = 0;
+	std::atomic<u32> m_num_flushers = 0;
+	std::atomic<u32> m_stop = 0;
+	u64 m_num_dropped_unregistered_reported = 0;
+	u32 m_poll_interval_ms = SFZ_LOGGER_DEFAULT_POLL_INTERVAL_MS;
+	SfzMutex m_sinks_mutex;
+	u32 m_num_sinks = 0;
+	Sink m_sinks[SFZ_LOGGER_MAX_NUM_SINKS] = {};
+	SfzAllocator* m_allocator = nullptr;
+	SfzThread m_thread;
+};
+
+// Logging macros
+// ------------------------------------------------------------------------------------------------
+
+#define SFZ_LOG_NOISE(logger, fmt, ...) \
+	(logger)->log(SFZ_LOG_LEVEL_NOISE, __FILE__, __LINE__, (fmt), ##__VA_ARGS__)
+#define SFZ_LOG_INFO(logger, fmt, ...) \
+	(logger)->log(SFZ_LOG_LEVEL_INFO, __FILE__, __LINE__, (fmt), ##__VA_ARGS__)
+#define SFZ_LOG_WARNING(logger, fmt, ...) \
+	(logger)->log(SFZ_LOG_LEVEL_WARNING, __FILE__, __LINE__, (fmt), ##__VA_ARGS__)
+#define SFZ_LOG_ERROR(logger, fmt, ...) \
+	(logger)->log(SFZ_LOG_LEVEL_ERROR, __FILE__, __LINE__, (fmt), ##__VA_ARGS__)
+
+#endif
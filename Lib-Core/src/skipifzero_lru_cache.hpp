@@ -0,0 +1,383 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#ifndef SKIPIFZERO_LRU_CACHE_HPP
+#define SKIPIFZERO_LRU_CACHE_HPP
+#pragma once
+
+#include "sfz.h"
+#include "sfz_cpp.hpp"
+#include "skipifzero_hash_maps.hpp" // sfzHash()
+
+// SfzLruCache
+// ------------------------------------------------------------------------------------------------
+
+constexpr u32 SFZ_LRU_CACHE_NIL = ~0u;
+constexpr u32 SFZ_LRU_CACHE_MIN_NUM_SLOTS = 16;
+constexpr u64 SFZ_LRU_CACHE_NO_COST_LIMIT = ~u64(0);
+
+// A fixed capacity key value cache that evicts the least recently used entries.
+//
+// All operations are O(1). The entries are stored in a flat array and are linked together in an
+// intrusive doubly linked list (u32 indices) ordered from most to least recently used. Lookup is
+// done through an open addressing index (linear probing, power of two size, at most 50% load)
+// that maps keys to entries. Removal from the index uses backward shift deletion, so unlike
+// SfzHashMap there are no placeholders building up when the cache constantly churns.
+//
+// Entries are evicted when the cache is full, or when the total cost of all entries exceeds the
+// cost budget. The cost of an entry is user defined (e.g. number of bytes of a decompressed
+// asset), by default every entry costs 1. An optional eviction callback is called for each entry
+// that is evicted or cleared, right before it is destroyed.
+//
+// Pointers to values are valid until the entry is evicted or removed.
+template<typename K, typename V>
+class SfzLruCache final {
+public:
+	SFZ_DECLARE_DROP_TYPE(SfzLruCache);
+	using KeyT = K;
+	using ValT = V;
+
+	// Called for each evicted entry. Not called for entries removed using remove().
+	typedef void EvictFunc(void* userdata, const K& key, V& value, u64 cost);
+
+	explicit SfzLruCache(u32 capacity, u64 max_cost, SfzAllocator* allocator, SfzDbgInfo alloc_dbg) noexcept
+	{
+		this->init(capacity, max_cost, allocator, alloc_dbg);
+	}
+
+	// State methods
+	// --------------------------------------------------------------------------------------------
+
+	// Initializes the cache. capacity is the max number of entries, max_cost is the cost budget
+	// (SFZ_LRU_CACHE_NO_COST_LIMIT if only the number of entries should be limited).
+	void init(u32 capacity, u64 max_cost, SfzAllocator* allocator, SfzDbgInfo alloc_dbg)
+	{
+		this->destroy();
+		sfz_assert_hard(capacity > 0);
+		sfz_assert_hard(capacity <= (1u << 30));
+		m_allocator = allocator;
+		m_capacity = capacity;
+		m_max_cost = max_cost;
+
+		// Number of slots is a power of two at least twice the capacity
+		m_num_slot_bits = 4;
+		while ((1u << m_num_slot_bits) < u32_max(capacity * 2, SFZ_LRU_CACHE_MIN_NUM_SLOTS)) m_num_slot_bits += 1;
+		const u32 num_slots = 1u << m_num_slot_bits;
+
+		// Allocate memory
+		const u64 entries_size = sfzRoundUpAlignedU64(sizeof(Entry) * capacity, 32);
+		const u64 slots_size = sizeof(Slot) * num_slots;
+		m_allocation = static_cast<u8*>(m_allocator->alloc(alloc_dbg, entries_size + slots_size, 32));
+		m_entries = reinterpret_cast<Entry*>(m_allocation);
+		m_slots = reinterpret_cast<Slot*>(m_allocation + entries_size);
+		for (u32 i = 0; i < num_slots; i++) m_slots[i] = Slot{ SFZ_LRU_CACHE_NIL, 0 };
+
+		// All entries start out in the free list
+		for (u32 i = 0; i < capacity; i++) m_entries[i].next = (i + 1) < capacity ? i + 1 : SFZ_LRU_CACHE_NIL;
+		m_free_head = 0;
+	}
+
+	// Sets the eviction callback, nullptr to remove it.
+	void setEvictFunc(EvictFunc* func, void* userdata)
+	{
+		m_evict_func = func;
+		m_evict_userdata = userdata;
+	}
+
+	// Evicts all entries (calling the eviction callback for each), keeps memory.
+	void clear()
+	{
+		while (m_lru_tail != SFZ_LRU_CACHE_NIL) this->evictEntry(m_lru_tail);
+		sfz_assert(m_size == 0);
+		sfz_assert(m_total_cost == 0);
+	}
+
+	void destroy()
+	{
+		if (m_allocation != nullptr) {
+			this->clear();
+			m_allocator->dealloc(m_allocation);
+		}
+		m_size = 0;
+		m_capacity = 0;
+		m_num_slot_bits = 0;
+		m_mru_head = SFZ_LRU_CACHE_NIL;
+		m_lru_tail = SFZ_LRU_CACHE_NIL;
+		m_free_head = SFZ_LRU_CACHE_NIL;
+		m_total_cost = 0;
+		m_max_cost = 0;
+		m_allocation = nullptr;
+		m_entries = nullptr;
+		m_slots = nullptr;
+		m_evict_func = nullptr;
+		m_evict_userdata = nullptr;
+		m_allocator = nullptr;
+	}
+
+	// Getters
+	// --------------------------------------------------------------------------------------------
+
+	u32 size() const { return m_size; }
+	u32 capacity() const { return m_capacity; }
+	u64 totalCost() const { return m_total_cost; }
+	u64 maxCost() const { return m_max_cost; }
+	bool isEmpty() const { return m_size == 0; }
+	SfzAllocator* allocator() const { return m_allocator; }
+
+	// Returns pointer to the value and marks it as most recently used, nullptr if not cached.
+	V* get(const K& key)
+	{
+		const u32 entry_idx = this->findEntry(key);
+		if (entry_idx == SFZ_LRU_CACHE_NIL) return nullptr;
+		this->moveToFront(entry_idx);
+		return &m_entries[entry_idx].value;
+	}
+
+	// Like get(), but does not change the eviction order.
+	const V* peek(const K& key) const
+	{
+		const u32 entry_idx = this->findEntry(key);
+		if (entry_idx == SFZ_LRU_CACHE_NIL) return nullptr;
+		return &m_entries[entry_idx].value;
+	}
+
+	bool contains(const K& key) const { return this->findEntry(key) != SFZ_LRU_CACHE_NIL; }
+
+	// Calls func for each entry from most to least recently used. Function should have signature:
+	// void func(const K& key, V& value, u64 cost)
+	template<typename F>
+	void forEach(F func)
+	{
+		for (u32 idx = m_mru_head; idx != SFZ_LRU_CACHE_NIL; idx = m_entries[idx].next) {
+			Entry& entry = m_entries[idx];
+			func(entry.key, entry.value, entry.cost);
+		}
+	}
+
+	// Methods
+	// --------------------------------------------------------------------------------------------
+
+	// Inserts (or replaces) the value for the given key and marks it as most recently used. Then
+	// evicts least recently used entries until the cache is within its capacity and cost budget.
+	// The inserted entry itself is never evicted by this call, even if its cost alone exceeds the
+	// budget. Returns reference to the cached value.
+	V& put(const K& key, const V& value, u64 cost = 1) { return this->putImpl<const V&>(key, value, cost); }
+	V& put(const K& key, V&& value, u64 cost = 1) { return this->putImpl<V>(key, sfz_move(value), cost); }
+
+	// Removes the entry without calling the eviction callback. Returns false if not cached.
+	bool remove(const K& key)
+	{
+		const u32 slot_idx = this->findSlot(key);
+		if (slot_idx == SFZ_LRU_CACHE_NIL) return false;
+		const u32 entry_idx = m_slots[slot_idx].entry_idx;
+		this->removeSlot(slot_idx);
+		this->unlink(entry_idx);
+		this->freeEntry(entry_idx);
+		return true;
+	}
+
+	// Evicts least recently used entries until total cost is at most the given cost. Useful for
+	// trimming the cache under memory pressure without changing the budget.
+	void evictUntilCost(u64 cost)
+	{
+		while (m_total_cost > cost && m_lru_tail != SFZ_LRU_CACHE_NIL) this->evictEntry(m_lru_tail);
+	}
+
+	// Changes the cost budget, evicting entries if needed.
+	void setMaxCost(u64 max_cost)
+	{
+		m_max_cost = max_cost;
+		this->evictUntilCost(max_cost);
+	}
+
+private:
+	// Private types
+	// --------------------------------------------------------------------------------------------
+
+	struct Entry {
+		K key;
+		V value;
+		u64 cost;
+		u32 prev; // Towards most recently used
+		u32 next; // Towards least recently used, also used for free list
+	};
+
+	struct Slot {
+		u32 entry_idx; // SFZ_LRU_CACHE_NIL if empty
+		u32 hash;
+	};
+
+	// Private methods
+	// --------------------------------------------------------------------------------------------
+
+	// Fibonacci hashing, spreads sequential or aligned keys over the power of two sized index.
+	static u32 hashKey(const K& key) { return u32((sfzHash(key) * 0x9E3779B97F4A7C15ull) >> 32); }
+	u32 homeSlot(u32 hash) const { return hash >> (32 - m_num_slot_bits); }
+	u32 slotMask() const { return (1u << m_num_slot_bits) - 1; }
+
+	u32 findSlot(const K& key) const
+	{
+		if (m_slots == nullptr) return SFZ_LRU_CACHE_NIL;
+		const u32 hash = hashKey(key);
+		const u32 mask = slotMask();
+		for (u32 slot_idx = homeSlot(hash); true; slot_idx = (slot_idx + 1) & mask) {
+			const Slot slot = m_slots[slot_idx];
+			if (slot.entry_idx == SFZ_LRU_CACHE_NIL) return SFZ_LRU_CACHE_NIL;
+			if (slot.hash == hash && m_entries[slot.entry_idx].key == key) return slot_idx;
+		}
+	}
+
+	u32 findEntry(const K& key) const
+	{
+		const u32 slot_idx = this->findSlot(key);
+		return slot_idx == SFZ_LRU_CACHE_NIL ? SFZ_LRU_CACHE_NIL : m_slots[slot_idx].entry_idx;
+	}
+
+	void insertSlot(u32 hash, u32 entry_idx)
+	{
+		const u32 mask = slotMask();
+		u32 slot_idx = homeSlot(hash);
+		while (m_slots[slot_idx].entry_idx != SFZ_LRU_CACHE_NIL) slot_idx = (slot_idx + 1) & mask;
+		m_slots[slot_idx] = Slot{ entry_idx, hash };
+	}
+
+	// Backward shift deletion, moves later slots in the probe sequence back into the hole as long
+	// as that does not move them before their home slot.
+	void removeSlot(u32 hole)
+	{
+		const u32 mask = slotMask();
+		u32 slot_idx = hole;
+		while (true) {
+			slot_idx = (slot_idx + 1) & mask;
+			const Slot slot = m_slots[slot_idx];
+			if (slot.entry_idx == SFZ_LRU_CACHE_NIL) break;
+			const u32 home = homeSlot(slot.hash);
+			const u32 dist_from_home = (slot_idx - home) & mask;
+			const u32 dist_from_hole = (slot_idx - hole) & mask;
+			if (dist_from_home >= dist_from_hole) {
+				m_slots[hole] = slot;
+				hole = slot_idx;
+			}
+		}
+		m_slots[hole] = Slot{ SFZ_LRU_CACHE_NIL, 0 };
+	}
+
+	void unlink(u32 entry_idx)
+	{
+		Entry& entry = m_entries[entry_idx];
+		if (entry.prev != SFZ_LRU_CACHE_NIL) m_entries[entry.prev].next = entry.next;
+		else m_mru_head = entry.next;
+		if (entry.next != SFZ_LRU_CACHE_NIL) m_entries[entry.next].prev = entry.prev;
+		else m_lru_tail = entry.prev;
+	}
+
+	void linkFront(u32 entry_idx)
+	{
+		Entry& entry = m_entries[entry_idx];
+		entry.prev = SFZ_LRU_CACHE_NIL;
+		entry.next = m_mru_head;
+		if (m_mru_head != SFZ_LRU_CACHE_NIL) m_entries[m_mru_head].prev = entry_idx;
+		else m_lru_tail = entry_idx;
+		m_mru_head = entry_idx;
+	}
+
+	void moveToFront(u32 entry_idx)
+	{
+		if (entry_idx == m_mru_head) return;
+		this->unlink(entry_idx);
+		this->linkFront(entry_idx);
+	}
+
+	// Destroys the key and value of an (unlinked) entry and returns it to the free list.
+	void freeEntry(u32 entry_idx)
+	{
+		Entry& entry = m_entries[entry_idx];
+		m_total_cost -= entry.cost;
+		m_size -= 1;
+		entry.key.~K();
+		entry.value.~V();
+		entry.next = m_free_head;
+		m_free_head = entry_idx;
+	}
+
+	void evictEntry(u32 entry_idx)
+	{
+		Entry& entry = m_entries[entry_idx];
+		if (m_evict_func != nullptr) m_evict_func(m_evict_userdata, entry.key, entry.value, entry.cost);
+		const u32 slot_idx = this->findSlot(entry.key);
+		sfz_assert(slot_idx != SFZ_LRU_CACHE_NIL);
+		this->removeSlot(slot_idx);
+		this->unlink(entry_idx);
+		this->freeEntry(entry_idx);
+	}
+
+	template<typename ForwardV>
+	V& putImpl(const K& key, ForwardV&& value, u64 cost)
+	{
+		sfz_assert_hard(m_entries != nullptr);
+		u32 entry_idx = this->findEntry(key);
+		if (entry_idx != SFZ_LRU_CACHE_NIL) {
+			// Replace existing entry
+			Entry& entry = m_entries[entry_idx];
+			entry.value = sfz_forward(value);
+			m_total_cost = m_total_cost - entry.cost + cost;
+			entry.cost = cost;
+			this->moveToFront(entry_idx);
+		}
+		else {
+			// Make room for a new entry if full
+			if (m_size == m_capacity) this->evictEntry(m_lru_tail);
+
+			entry_idx = m_free_head;
+			sfz_assert(entry_idx != SFZ_LRU_CACHE_NIL);
+			Entry& entry = m_entries[entry_idx];
+			m_free_head = entry.next;
+			new (&entry.key) K(key);
+			new (&entry.value) V(sfz_forward(value));
+			entry.cost = cost;
+			m_size += 1;
+			m_total_cost += cost;
+			this->insertSlot(hashKey(key), entry_idx);
+			this->linkFront(entry_idx);
+		}
+
+		// Evict until within budget, but never the entry that was just put
+		while (m_total_cost > m_max_cost && m_lru_tail != entry_idx) this->evictEntry(m_lru_tail);
+		return m_entries[entry_idx].value;
+	}
+
+	// Private members
+	// --------------------------------------------------------------------------------------------
+
+	u32 m_size = 0;
+	u32 m_capacity = 0;
+	u32 m_num_slot_bits = 0;
+	u32 m_mru_head = SFZ_LRU_CACHE_NIL;
+	u32 m_lru_tail = SFZ_LRU_CACHE_NIL;
+	u32 m_free_head = SFZ_LRU_CACHE_NIL;
+	u64 m_total_cost = 0;
+	u64 m_max_cost = 0;
+	u8* m_allocation = nullptr;
+	Entry* m_entries = nullptr;
+	Slot* m_slots = nullptr;
+	EvictFunc* m_evict_func = nullptr;
+	void* m_evict_userdata = nullptr;
+	SfzAllocator* m_allocator = nullptr;
+};
+
+#endif
@@ -0,0 +1,194 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#ifndef SKIPIFZERO_MEM_STREAM_HPP
+#define SKIPIFZERO_MEM_STREAM_HPP
+#pragma once
+
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_AMD64)
+#include <intrin.h>
+#define SFZ_MEM_STREAM_SSE2
+#endif
+
+#include "sfz.h"
+#include "sfz_cpp.hpp"
+#include "skipifzero_sync.hpp"
+
+// Streaming memcpy/memset
+// ------------------------------------------------------------------------------------------------
+
+// Below this size the regular memcpy()/memset() is used. Small copies are cheap either way, and
+// the destination is likely to be read again soon, in which case it is better off in the cache.
+constexpr u64 SFZ_MEM_STREAM_THRESHOLD = 64 * 1024;
+
+// Copies memory using non-temporal (streaming) stores, which write directly to memory instead of
+// going through the cache hierarchy. Use this for large copies whose destination will not be read
+// by the CPU again soon, e.g. when uploading to write-combined GPU memory. Falls back to memcpy()
+// below SFZ_MEM_STREAM_THRESHOLD and on platforms without streaming stores.
+//
+// The streaming stores are fenced before returning, so it is safe to hand the destination to
+// another thread (or the GPU) afterwards.
+inline void sfzMemcpyStream(void* __restrict dst, const void* __restrict src, u64 num_bytes)
+{
+	u8* d = static_cast<u8*>(dst);
+	const u8* s = static_cast<const u8*>(src);
+#if defined(SFZ_MEM_STREAM_SSE2)
+	if (num_bytes >= SFZ_MEM_STREAM_THRESHOLD) {
+
+		// Regular copy until destination is 16-byte aligned, source may stay unaligned
+		const u64 head = (16 - (u64(uintptr_t(d)) & 15)) & 15;
+		memcpy(d, s, head);
+		d += head;
+		s += head;
+		num_bytes -= head;
+
+		// Stream 64 bytes (a cache line) at a time
+		const u64 num_lines = num_bytes / 64;
+		for (u64 i = 0; i < num_lines; i++) {
+			const __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 0));
+			const __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 16));
+			const __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 32));
+			const __m128i v3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 48));
+			_mm_stream_si128(reinterpret_cast<__m128i*>(d + 0), v0);
+			_mm_stream_si128(reinterpret_cast<__m128i*>(d + 16), v1);
+			_mm_stream_si128(reinterpret_cast<__m128i*>(d + 32), v2);
+			_mm_stream_si128(reinterpret_cast<__m128i*>(d + 48), v3);
+			d += 64;
+			s += 64;
+		}
+		num_bytes -= num_lines * 64;
+		_mm_sfence();
+	}
+#endif
+	memcpy(d, s, num_bytes);
+}
+
+// Same as sfzMemcpyStream(), but for memset().
+inline void sfzMemsetStream(void* dst, u8 value, u64 num_bytes)
+{
+	u8* d = static_cast<u8*>(dst);
+#if defined(SFZ_MEM_STREAM_SSE2)
+	if (num_bytes >= SFZ_MEM_STREAM_THRESHOLD) {
+
+		// Regular memset until destination is 16-byte aligned
+		const u64 head = (16 - (u64(uintptr_t(d)) & 15)) & 15;
+		memset(d, value, head);
+		d += head;
+		num_bytes -= head;
+
+		// Stream 64 bytes (a cache line) at a time
+		const __m128i v = _mm_set1_epi8(char(value));
+		const u64 num_lines = num_bytes / 64;
+		for (u64 i = 0; i < num_lines; i++) {
+			_mm_stream_si128(reinterpret_cast<__m128i*>(d + 0), v);
+			_mm_stream_si128(reinterpret_cast<__m128i*>(d + 16), v);
+			_mm_stream_si128(reinterpret_cast<__m128i*>(d + 32), v);
+			_mm_stream_si128(reinterpret_cast<__m128i*>(d + 48), v);
+			d += 64;
+		}
+		num_bytes -= num_lines * 64;
+		_mm_sfence();
+	}
+#endif
+	memset(d, value, num_bytes);
+}
+
+// Parallel streaming memcpy/memset
+// ------------------------------------------------------------------------------------------------
+
+constexpr u32 SFZ_MEM_STREAM_MAX_NUM_THREADS = 16;
+
+// Each thread gets at least this many bytes, smaller copies use fewer threads. Starting a thread
+// costs in the order of tens of microseconds, so it is only worth it for really large copies.
+constexpr u64 SFZ_MEM_STREAM_MIN_BYTES_PER_THREAD = 4 * 1024 * 1024;
+
+// Chunks are split on page boundaries of the destination.
+constexpr u64 SFZ_MEM_STREAM_CHUNK_ALIGN = 4096;
+
+struct SfzMemStreamChunk final {
+	u8* dst;
+	const u8* src; // nullptr for memset
+	u64 num_bytes;
+	u8 value;
+};
+
+inline void sfzMemStreamChunk(void* chunk_ptr)
+{
+	const SfzMemStreamChunk* chunk = static_cast<const SfzMemStreamChunk*>(chunk_ptr);
+	if (chunk->src != nullptr) sfzMemcpyStream(chunk->dst, chunk->src, chunk->num_bytes);
+	else sfzMemsetStream(chunk->dst, chunk->value, chunk->num_bytes);
+}
+
+// Splits the range into one chunk per thread, runs the first chunk on the calling thread and the
+// rest on temporary threads. Returns when all threads are done.
+inline void sfzMemStreamParallelImpl(u8* dst, const u8* src, u8 value, u64 num_bytes, u32 max_num_threads)
+{
+	u64 num_threads = u64_min(u64(u32_min(max_num_threads, SFZ_MEM_STREAM_MAX_NUM_THREADS)),
+		num_bytes / SFZ_MEM_STREAM_MIN_BYTES_PER_THREAD);
+	if (num_threads <= 1) {
+		SfzMemStreamChunk chunk = { dst, src, num_bytes, value };
+		sfzMemStreamChunk(&chunk);
+		return;
+	}
+
+	// Split into equally sized chunks, rounded so that each chunk's destination is aligned
+	const u64 dst_base = u64(uintptr_t(dst));
+	const u64 bytes_per_thread = num_bytes / num_threads;
+	SfzMemStreamChunk chunks[SFZ_MEM_STREAM_MAX_NUM_THREADS] = {};
+	u64 begin = 0;
+	for (u64 i = 0; i < num_threads; i++) {
+		u64 end = num_bytes;
+		if ((i + 1) < num_threads) {
+			const u64 aligned_end = sfzRoundUpAlignedU64(
+				dst_base + bytes_per_thread * (i + 1), SFZ_MEM_STREAM_CHUNK_ALIGN);
+			end = u64_min(num_bytes, aligned_end - dst_base);
+		}
+		chunks[i] = SfzMemStreamChunk{ dst + begin, src != nullptr ? src + begin : nullptr, end - begin, value };
+		begin = end;
+	}
+
+	SfzThread threads[SFZ_MEM_STREAM_MAX_NUM_THREADS];
+	for (u64 i = 1; i < num_threads; i++) {
+		threads[i].start(sfzMemStreamChunk, &chunks[i]);
+	}
+	sfzMemStreamChunk(&chunks[0]);
+	for (u64 i = 1; i < num_threads; i++) {
+		threads[i].join();
+	}
+}
+
+// Same as sfzMemcpyStream(), but splits large copies (see SFZ_MEM_STREAM_MIN_BYTES_PER_THREAD)
+// over up to max_num_threads threads (including the calling thread). A single thread can
+// typically not saturate the memory bandwidth on its own.
+inline void sfzMemcpyStreamParallel(
+	void* __restrict dst, const void* __restrict src, u64 num_bytes, u32 max_num_threads)
+{
+	sfz_assert(src != nullptr || num_bytes == 0);
+	sfzMemStreamParallelImpl(
+		static_cast<u8*>(dst), static_cast<const u8*>(src), 0, num_bytes, max_num_threads);
+}
+
+// Same as sfzMemsetStream(), but parallel, see sfzMemcpyStreamParallel().
+inline void sfzMemsetStreamParallel(void* dst, u8 value, u64 num_bytes, u32 max_num_threads)
+{
+	sfzMemStreamParallelImpl(static_cast<u8*>(dst), nullptr, value, num_bytes, max_num_threads);
+}
+
+#endif
@@ -0,0 +1,300 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#ifndef SKIPIFZERO_PERFECT_HASH_HPP
+#define SKIPIFZERO_PERFECT_HASH_HPP
+#pragma once
+
+#include "sfz.h"
+#include "sfz_cpp.hpp"
+#include "skipifzero_hash_maps.hpp"
+#include "skipifzero_strings.hpp"
+
+// SfzPerfectHash
+// ------------------------------------------------------------------------------------------------
+
+constexpr u32 SFZ_PERFECT_HASH_NOT_FOUND = ~0u;
+constexpr u32 SFZ_PERFECT_HASH_MAX_NUM_KEYS = 1u << 16;
+constexpr u32 SFZ_PERFECT_HASH_MAX_SEED = 1u << 16;
+
+sfz_constexpr_func u32 sfzPerfectHashNextPow2(u32 v) { u32 p = 1; while (p < v) p *= 2; return p; }
+
+// Maps a key hash to a slot given the displacement seed of its bucket.
+sfz_constexpr_func u32 sfzPerfectHashSlot(u64 hash, u32 seed, u32 slot_mask)
+{
+	u64 h = hash ^ (u64(seed) * 0x9E3779B97F4A7C15ull);
+	h ^= h >> 32;
+	h *= 0xD6E8FEB86659FD93ull;
+	h ^= h >> 32;
+	return u32(h) & slot_mask;
+}
+
+// A perfect hash table for a fixed set of N strings, generated at compile time.
+//
+// Uses CHD (compress, hash, displace). The keys are first hashed (FNV-1a, i.e. the same hash as
+// SfzStrID) into buckets of ~2 keys each. Then, starting with the largest bucket, a seed is found
+// for each bucket such that all keys in the bucket map to free slots. A lookup is then one bucket
+// read (the seed) and one slot read, with no probing. The key hash is stored in the slot so keys
+// that are not part of the set can be rejected, which makes it usable with a fallback (see
+// SfzPerfectHashMap).
+//
+// Example:
+//   constexpr const char* NAMES[] = { "font_color", "base_color", "focus_color" };
+//   constexpr auto NAMES_TABLE = sfzPerfectHashCreate(NAMES);
+//   static_assert(NAMES_TABLE.isValid(), "");
+//   u32 idx = NAMES_TABLE.find("base_color"); // 1
+//
+// Keys must be unique, isValid() returns false otherwise. Generating tables for large sets (1000+
+// keys) at compile time might require raising the compiler's constexpr evaluation limit (e.g.
+// /constexpr:steps on MSVC).
+template<u32 N>
+class SfzPerfectHash final {
+public:
+	static_assert(0 < N && N <= SFZ_PERFECT_HASH_MAX_NUM_KEYS, "");
+	static constexpr u32 NUM_KEYS = N;
+	static constexpr u32 NUM_SLOTS = sfzPerfectHashNextPow2(N + N / 4 + 1); // Load factor <= 0.8
+	static constexpr u32 NUM_BUCKETS = sfzPerfectHashNextPow2((N + 1) / 2);
+
+	constexpr SfzPerfectHash() = default;
+
+	// Builds the table from hashes of the keys (e.g. sfzHashStringFNV1a() or SfzStrID ids).
+	constexpr explicit SfzPerfectHash(const u64 (&key_hashes)[N]) { this->build(key_hashes); }
+
+	constexpr explicit SfzPerfectHash(const char* const (&keys)[N])
+	{
+		u64 key_hashes[N] = {};
+		for (u32 i = 0; i < N; i++) key_hashes[i] = sfzHashStringFNV1a(keys[i]);
+		this->build(key_hashes);
+	}
+
+	// Getters
+	// --------------------------------------------------------------------------------------------
+
+	constexpr bool isValid() const { return m_valid; }
+	constexpr u32 size() const { return N; }
+
+	// Returns the index of the key (in the list the table was created from), or
+	// SFZ_PERFECT_HASH_NOT_FOUND if the key is not part of the set.
+	constexpr u32 findHash(u64 hash) const
+	{
+		const u32 seed = m_seeds[u32(hash) & (NUM_BUCKETS - 1)];
+		const u32 slot = sfzPerfectHashSlot(hash, seed, NUM_SLOTS - 1);
+		return m_slot_hashes[slot] == hash ? m_slot_key_idxs[slot] : SFZ_PERFECT_HASH_NOT_FOUND;
+	}
+	constexpr u32 find(const char* key) const { return this->findHash(sfzHashStringFNV1a(key)); }
+	constexpr u32 find(SfzStrID id) const { return this->findHash(id.id); }
+
+private:
+	// Private methods
+	// --------------------------------------------------------------------------------------------
+
+	constexpr void build(const u64 (&key_hashes)[N])
+	{
+		m_valid = false;
+
+		// Put keys into buckets, stored as per bucket linked lists of key indices
+		u32 bucket_sizes[NUM_BUCKETS] = {};
+		u32 bucket_heads[NUM_BUCKETS] = {};
+		u32 next_in_bucket[N] = {};
+		for (u32 b = 0; b < NUM_BUCKETS; b++) bucket_heads[b] = SFZ_PERFECT_HASH_NOT_FOUND;
+		u32 max_bucket_size = 0;
+		for (u32 i = 0; i < N; i++) {
+			// Hash 0 is used to mark empty slots, and keys must be unique (duplicates would end up
+			// in the same bucket)
+			if (key_hashes[i] == 0) return;
+			const u32 b = u32(key_hashes[i]) & (NUM_BUCKETS - 1);
+			for (u32 j = bucket_heads[b]; j != SFZ_PERFECT_HASH_NOT_FOUND; j = next_in_bucket[j]) {
+				if (key_hashes[j] == key_hashes[i]) return;
+			}
+			next_in_bucket[i] = bucket_heads[b];
+			bucket_heads[b] = i;
+			bucket_sizes[b] += 1;
+			if (bucket_sizes[b] > max_bucket_size) max_bucket_size = bucket_sizes[b];
+		}
+
+		// Find seeds, largest buckets first
+		for (u32 s = 0; s < NUM_SLOTS; s++) {
+			m_slot_hashes[s] = 0;
+			m_slot_key_idxs[s] = SFZ_PERFECT_HASH_NOT_FOUND;
+		}
+		for (u32 size = max_bucket_size; size > 0; size--) {
+			for (u32 b = 0; b < NUM_BUCKETS; b++) {
+				if (bucket_sizes[b] != size) continue;
+				bool found = false;
+				for (u32 seed = 0; seed < SFZ_PERFECT_HASH_MAX_SEED && !found; seed++) {
+					if (this->tryPlaceBucket(key_hashes, bucket_heads[b], next_in_bucket, seed)) {
+						m_seeds[b] = seed;
+						found = true;
+					}
+				}
+				if (!found) return;
+			}
+		}
+		m_valid = true;
+	}
+
+	// Places all keys in the bucket if they map to distinct free slots with the given seed.
+	constexpr bool tryPlaceBucket(const u64 (&key_hashes)[N], u32 head, const u32 (&next_in_bucket)[N], u32 seed)
+	{
+		for (u32 i = head; i != SFZ_PERFECT_HASH_NOT_FOUND; i = next_in_bucket[i]) {
+			const u32 slot = sfzPerfectHashSlot(key_hashes[i], seed, NUM_SLOTS - 1);
+			if (m_slot_hashes[slot] != 0) {
+				// Undo keys already placed from this bucket
+				for (u32 j = head; j != i; j = next_in_bucket[j]) {
+					const u32 placed_slot = sfzPerfectHashSlot(key_hashes[j], seed, NUM_SLOTS - 1);
+					m_slot_hashes[placed_slot] = 0;
+					m_slot_key_idxs[placed_slot] = SFZ_PERFECT_HASH_NOT_FOUND;
+				}
+				return false;
+			}
+			m_slot_hashes[slot] = key_hashes[i];
+			m_slot_key_idxs[slot] = i;
+		}
+		return true;
+	}
+
+	// Private members
+	// --------------------------------------------------------------------------------------------
+
+	u64 m_slot_hashes[NUM_SLOTS] = {}; // 0 if empty
+	u32 m_slot_key_idxs[NUM_SLOTS] = {};
+	u32 m_seeds[NUM_BUCKETS] = {};
+	bool m_valid = false;
+};
+
+template<u32 N>
+constexpr SfzPerfectHash<N> sfzPerfectHashCreate(const char* const (&keys)[N]) { return SfzPerfectHash<N>(keys); }
+
+template<u32 N>
+constexpr SfzPerfectHash<N> sfzPerfectHashCreate(const u64 (&key_hashes)[N]) { return SfzPerfectHash<N>(key_hashes); }
+
+// SfzPerfectHashMap
+// ------------------------------------------------------------------------------------------------
+
+// A map from string hashes to values, where a fixed set of known keys (given by a compile time
+// generated SfzPerfectHash) are stored in a flat array, and any other keys are stored in a
+// fallback SfzHashMap. Lookups of known keys never touch the fallback map.
+template<typename V, u32 N>
+class SfzPerfectHashMap final {
+public:
+	SFZ_DECLARE_DROP_TYPE(SfzPerfectHashMap);
+
+	SfzPerfectHashMap(const SfzPerfectHash<N>* table, u32 fallback_capacity, SfzAllocator* allocator, SfzDbgInfo alloc_dbg) noexcept
+	{
+		this->init(table, fallback_capacity, allocator, alloc_dbg);
+	}
+
+	// State methods
+	// --------------------------------------------------------------------------------------------
+
+	// The table must outlive this map, typically it is a constexpr global. The fallback map is
+	// only allocated if an unknown key is put.
+	void init(const SfzPerfectHash<N>* table, u32 fallback_capacity, SfzAllocator* allocator, SfzDbgInfo alloc_dbg)
+	{
+		this->destroy();
+		sfz_assert_hard(table != nullptr && table->isValid());
+		m_table = table;
+		m_fallback_capacity = fallback_capacity;
+		m_allocator = allocator;
+		m_alloc_dbg = alloc_dbg;
+	}
+
+	void clear()
+	{
+		for (u32 i = 0; i < N; i++) {
+			if (m_present[i]) m_values[i] = V();
+			m_present[i] = false;
+		}
+		m_num_known = 0;
+		m_fallback.clear();
+	}
+
+	void destroy()
+	{
+		this->clear();
+		m_fallback.destroy();
+		m_table = nullptr;
+		m_fallback_capacity = 0;
+		m_allocator = nullptr;
+		m_alloc_dbg = {};
+	}
+
+	// Getters
+	// --------------------------------------------------------------------------------------------
+
+	u32 size() const { return m_num_known + m_fallback.size(); }
+	const SfzHashMap<u64, V>& fallback() const { return m_fallback; }
+
+	V* get(u64 hash)
+	{
+		const u32 idx = m_table->findHash(hash);
+		if (idx != SFZ_PERFECT_HASH_NOT_FOUND) return m_present[idx] ? &m_values[idx] : nullptr;
+		return m_fallback.get(hash);
+	}
+	const V* get(u64 hash) const { return const_cast<SfzPerfectHashMap*>(this)->get(hash); }
+	V* get(const char* key) { return this->get(sfzHashStringFNV1a(key)); }
+	const V* get(const char* key) const { return this->get(sfzHashStringFNV1a(key)); }
+
+	// Methods
+	// --------------------------------------------------------------------------------------------
+
+	V& put(u64 hash, const V& value)
+	{
+		const u32 idx = m_table->findHash(hash);
+		if (idx != SFZ_PERFECT_HASH_NOT_FOUND) {
+			if (!m_present[idx]) m_num_known += 1;
+			m_present[idx] = true;
+			m_values[idx] = value;
+			return m_values[idx];
+		}
+		if (m_fallback.allocator() == nullptr) {
+			m_fallback.init(m_fallback_capacity, m_allocator, m_alloc_dbg);
+		}
+		return m_fallback.put(hash, value);
+	}
+	V& put(const char* key, const V& value) { return this->put(sfzHashStringFNV1a(key), value); }
+
+	bool remove(u64 hash)
+	{
+		const u32 idx = m_table->findHash(hash);
+		if (idx != SFZ_PERFECT_HASH_NOT_FOUND) {
+			if (!m_present[idx]) return false;
+			m_present[idx] = false;
+			m_values[idx] = V();
+			m_num_known -= 1;
+			return true;
+		}
+		return m_fallback.remove(hash);
+	}
+	bool remove(const char* key) { return this->remove(sfzHashStringFNV1a(key)); }
+
+private:
+	// Private members
+	// --------------------------------------------------------------------------------------------
+
+	const SfzPerfectHash<N>* m_table = nullptr;
+	u32 m_num_known = 0;
+	u32 m_fallback_capacity = 0;
+	V m_values[N] = {};
+	bool m_present[N] = {};
+	SfzHashMap<u64, V> m_fallback;
+	SfzAllocator* m_allocator = nullptr;
+	SfzDbgInfo m_alloc_dbg = {};
+};
+
+#endif
@@ -458,4 +458,299 @@ private:
 	u32 m_free_indices[Capacity] = {};
 };
 
+// SfzSoAPool
+// ------------------------------------------------------------------------------------------------
+
+// Helper to get the type at a given index in a parameter pack.
+template<u32 I, typename T, typename... Ts> struct SfzSoAPoolTypeAt { using Type = typename SfzSoAPoolTypeAt<I - 1, Ts...>::Type; };
+template<typename T, typename... Ts> struct SfzSoAPoolTypeAt<0, T, Ts...> { using Type = T; };
+
+// A structure-of-arrays variant of SfzPool. Handles are allocated exactly like in a SfzPool (same
+// slots, versions and free index logic), but instead of storing a whole T per slot each component
+// type (Ts) is stored in its own tightly packed column array.
+//
+// The columns are kept dense, i.e. the components of all allocated handles are always stored in
+// the range [0, numAllocated()). There is an indirection from a handle's index to its dense index
+// (and the other way around). When a handle is deallocated the last element in each column is
+// moved into the hole, so unlike SfzPool pointers to components are NOT stable.
+//
+// The point of all this is that systems which only touch a single component can iterate over a
+// single column without dragging the rest of the object through the cache. Example:
+//
+//     SfzSoAPool<f32x3, f32x3, Foo> pool; // position, velocity, other stuff
+//     f32x3* positions = pool.column<0>();
+//     const f32x3* velocities = pool.column<1>();
+//     const u32 num_allocated = pool.numAllocated();
+//     for (u32 i = 0; i < num_allocated; i++) {
+//         positions[i] += velocities[i] * delta;
+//     }
+//
+// Use denseIdx() to translate a handle to a dense index and getHandleDense() for the opposite.
+template<typename... Ts>
+class SfzSoAPool final {
+public:
+	SFZ_DECLARE_DROP_TYPE(SfzSoAPool);
+
+	static constexpr u32 NUM_COLUMNS = sizeof...(Ts);
+	static constexpr u32 ALIGNMENT = 32;
+	static_assert(NUM_COLUMNS > 0, "SfzSoAPool needs at least one column");
+	static_assert(((alignof(Ts) <= ALIGNMENT) && ...), "");
+
+	template<u32 I> using ColT = typename SfzSoAPoolTypeAt<I, Ts...>::Type;
+
+	explicit SfzSoAPool(u32 capacity, SfzAllocator* allocator, SfzDbgInfo alloc_dbg) noexcept
+	{
+		this->init(capacity, allocator, alloc_dbg);
+	}
+
+	// State methods
+	// --------------------------------------------------------------------------------------------
+
+	void init(u32 capacity, SfzAllocator* allocator, SfzDbgInfo alloc_dbg)
+	{
+		sfz_assert(capacity != 0); // We don't support resize, so this wouldn't make sense.
+		sfz_assert(capacity <= SFZ_POOL_MAX_CAPACITY);
+
+		// Destroy previous pool
+		this->destroy();
+
+		// Calculate offsets for all the columns
+		u64 column_offsets[NUM_COLUMNS] = {};
+		u64 offset = 0;
+		u32 col = 0;
+		((column_offsets[col++] = offset, offset += sfzRoundUpAlignedU64(sizeof(Ts) * capacity, ALIGNMENT)), ...);
+
+		// Calculate offsets for the bookkeeping arrays
+		const u64 slots_offset = offset;
+		const u64 idx_to_dense_offset = slots_offset + sfzRoundUpAlignedU64(sizeof(SfzPoolSlot) * capacity, ALIGNMENT);
+		const u64 dense_to_idx_offset = idx_to_dense_offset + sfzRoundUpAlignedU64(sizeof(u32) * capacity, ALIGNMENT);
+		const u64 free_indices_offset = dense_to_idx_offset + sfzRoundUpAlignedU64(sizeof(u32) * capacity, ALIGNMENT);
+		const u64 num_bytes_needed = free_indices_offset + sfzRoundUpAlignedU64(sizeof(u32) * capacity, ALIGNMENT);
+
+		// Allocate memory and clear it
+		u8* memory = reinterpret_cast<u8*>(allocator->alloc(alloc_dbg, num_bytes_needed, ALIGNMENT));
+		memset(memory, 0, num_bytes_needed);
+
+		// Set members
+		m_allocator = allocator;
+		m_capacity = capacity;
+		m_memory = memory;
+		for (u32 i = 0; i < NUM_COLUMNS; i++) m_columns[i] = memory + column_offsets[i];
+		m_slots = reinterpret_cast<SfzPoolSlot*>(memory + slots_offset);
+		m_idx_to_dense = reinterpret_cast<u32*>(memory + idx_to_dense_offset);
+		m_dense_to_idx = reinterpret_cast<u32*>(memory + dense_to_idx_offset);
+		m_free_indices = reinterpret_cast<u32*>(memory + free_indices_offset);
+	}
+
+	void destroy()
+	{
+		if (m_memory != nullptr) {
+			u32 col = 0;
+			(destroyColumn<Ts>(col++), ...);
+			m_allocator->dealloc(m_memory);
+		}
+		m_num_allocated = 0;
+		m_array_size = 0;
+		m_capacity = 0;
+		m_memory = nullptr;
+		for (u32 i = 0; i < NUM_COLUMNS; i++) m_columns[i] = nullptr;
+		m_slots = nullptr;
+		m_idx_to_dense = nullptr;
+		m_dense_to_idx = nullptr;
+		m_free_indices = nullptr;
+		m_allocator = nullptr;
+	}
+
+	// Getters
+	// --------------------------------------------------------------------------------------------
+
+	u32 numAllocated() const { return m_num_allocated; }
+	u32 numHoles() const { return m_array_size - m_num_allocated; }
+	u32 arraySize() const { return m_array_size; }
+	u32 capacity() const { return m_capacity; }
+	bool isFull() const { return m_num_allocated >= m_capacity; }
+	const SfzPoolSlot* slots() const { return m_slots; }
+	SfzAllocator* allocator() const { return m_allocator; }
+
+	// Returns the densely packed column for the I:th component type. Valid range is
+	// [0, numAllocated()), the pointer is invalidated by any call to deallocate().
+	template<u32 I> ColT<I>* column() { static_assert(I < NUM_COLUMNS, ""); return static_cast<ColT<I>*>(m_columns[I]); }
+	template<u32 I> const ColT<I>* column() const { static_assert(I < NUM_COLUMNS, ""); return static_cast<const ColT<I>*>(m_columns[I]); }
+
+	// Maps from dense indices to slot indices, i.e. denseToIdx()[dense_idx] == handle.idx().
+	const u32* denseToIdx() const { return m_dense_to_idx; }
+
+	bool handleIsValid(SfzHandle handle) const
+	{
+		const u32 idx = handle.idx();
+		if (idx >= m_array_size) return false;
+		SfzPoolSlot slot = m_slots[idx];
+		if (!slot.active()) return false;
+		if (handle.version() != slot.version()) return false;
+		sfz_assert(slot.version() != u8(0));
+		return true;
+	}
+
+	// Returns the dense index of the given handle, ~0u if the handle is not valid.
+	u32 denseIdx(SfzHandle handle) const
+	{
+		if (!handleIsValid(handle)) return ~0u;
+		const u32 dense_idx = m_idx_to_dense[handle.idx()];
+		sfz_assert(dense_idx < m_num_allocated);
+		return dense_idx;
+	}
+
+	// Returns the handle for the element at the given dense index.
+	SfzHandle getHandleDense(u32 dense_idx) const
+	{
+		sfz_assert(dense_idx < m_num_allocated);
+		const u32 idx = m_dense_to_idx[dense_idx];
+		return sfzHandleInit(idx, m_slots[idx].version());
+	}
+
+	template<u32 I>
+	ColT<I>* get(SfzHandle handle)
+	{
+		const u32 dense_idx = denseIdx(handle);
+		if (dense_idx == ~0u) return nullptr;
+		return column<I>() + dense_idx;
+	}
+	template<u32 I>
+	const ColT<I>* get(SfzHandle handle) const { return const_cast<SfzSoAPool*>(this)->get<I>(handle); }
+
+	// Methods
+	// --------------------------------------------------------------------------------------------
+
+	// Allocates a new handle and default constructs all its components.
+	SfzHandle allocate()
+	{
+		sfz_assert(m_num_allocated < m_capacity);
+		const u32 dense_idx = m_num_allocated;
+		u32 col = 0;
+		((new (static_cast<Ts*>(m_columns[col++]) + dense_idx) Ts()), ...);
+		return allocateHandle();
+	}
+
+	// Allocates a new handle and copies the specified components into it.
+	SfzHandle allocate(const Ts&... values)
+	{
+		sfz_assert(m_num_allocated < m_capacity);
+		const u32 dense_idx = m_num_allocated;
+		u32 col = 0;
+		((new (static_cast<Ts*>(m_columns[col++]) + dense_idx) Ts(values)), ...);
+		return allocateHandle();
+	}
+
+	void deallocate(SfzHandle handle)
+	{
+		const u32 idx = handle.idx();
+		sfz_assert(idx < m_array_size);
+		sfz_assert(handle.version() == m_slots[idx].version());
+		deallocate(idx);
+	}
+
+	void deallocate(u32 idx)
+	{
+		sfz_assert(m_num_allocated > 0);
+		sfz_assert(idx < m_array_size);
+		SfzPoolSlot& slot = m_slots[idx];
+		sfz_assert(slot.active());
+		sfz_assert(slot.version() != 0);
+
+		// Move the last element in each column into the hole to keep the columns dense
+		const u32 dense_idx = m_idx_to_dense[idx];
+		const u32 last_dense_idx = m_num_allocated - 1;
+		sfz_assert(dense_idx <= last_dense_idx);
+		u32 col = 0;
+		(removeSwapColumn<Ts>(col++, dense_idx, last_dense_idx), ...);
+		const u32 moved_idx = m_dense_to_idx[last_dense_idx];
+		m_dense_to_idx[dense_idx] = moved_idx;
+		m_idx_to_dense[moved_idx] = dense_idx;
+		m_dense_to_idx[last_dense_idx] = 0;
+		m_idx_to_dense[idx] = 0;
+
+		// Remove active bit
+		slot.bits = slot.version();
+		m_num_allocated -= 1;
+
+		// Store the new hole in free indices
+		const u32 holes = numHoles();
+		sfz_assert(holes > 0);
+		m_free_indices[holes - 1] = idx;
+	}
+
+private:
+	// Private methods
+	// --------------------------------------------------------------------------------------------
+
+	// Assumes the components have already been constructed at dense index m_num_allocated.
+	SfzHandle allocateHandle()
+	{
+		sfz_assert(m_num_allocated < m_capacity);
+
+		// Reuse a hole if there is one, otherwise take a new slot at the end
+		const u32 holes = numHoles();
+		u32 idx = ~0u;
+		if (holes > 0) {
+			idx = m_free_indices[holes - 1];
+			m_free_indices[holes - 1] = 0;
+		}
+		else {
+			idx = m_array_size;
+			m_array_size += 1;
+		}
+
+		// Link slot index and dense index
+		const u32 dense_idx = m_num_allocated;
+		m_idx_to_dense[idx] = dense_idx;
+		m_dense_to_idx[dense_idx] = idx;
+
+		// Update number of allocated
+		m_num_allocated += 1;
+		sfz_assert(idx < m_array_size);
+		sfz_assert(m_array_size <= m_capacity);
+		sfz_assert(m_num_allocated <= m_array_size);
+
+		// Update active bit and version in slot
+		SfzPoolSlot& slot = m_slots[idx];
+		sfz_assert(!slot.active());
+		u8 new_version = slot.bits + 1;
+		if (new_version > 127) new_version = 1;
+		slot.bits = SFZ_POOL_SLOT_ACTIVE_BIT_MASK | new_version;
+
+		// Create and return handle
+		SfzHandle handle = sfzHandleInit(idx, new_version);
+		return handle;
+	}
+
+	template<typename T>
+	void removeSwapColumn(u32 col, u32 dense_idx, u32 last_dense_idx)
+	{
+		T* data = static_cast<T*>(m_columns[col]);
+		if (dense_idx != last_dense_idx) data[dense_idx] = sfz_move(data[last_dense_idx]);
+		data[last_dense_idx].~T();
+	}
+
+	template<typename T>
+	void destroyColumn(u32 col)
+	{
+		T* data = static_cast<T*>(m_columns[col]);
+		for (u32 i = 0; i < m_num_allocated; i++) data[i].~T();
+	}
+
+	// Private members
+	// --------------------------------------------------------------------------------------------
+
+	u32 m_num_allocated = 0;
+	u32 m_array_size = 0;
+	u32 m_capacity = 0;
+	u8* m_memory = nullptr;
+	void* m_columns[NUM_COLUMNS] = {};
+	SfzPoolSlot* m_slots = nullptr;
+	u32* m_idx_to_dense = nullptr;
+	u32* m_dense_to_idx = nullptr;
+	u32* m_free_indices = nullptr;
+	SfzAllocator* m_allocator = nullptr;
+};
+
 #endif
@@ -0,0 +1,403 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#ifndef SKIPIFZERO_PRIORITY_QUEUE_HPP
+#define SKIPIFZERO_PRIORITY_QUEUE_HPP
+#pragma once
+
+#include "sfz.h"
+#include "sfz_cpp.hpp"
+#include "skipifzero_arrays.hpp"
+#include "skipifzero_pool.hpp"
+
+// Comparators
+// ------------------------------------------------------------------------------------------------
+
+// Default comparator, gives a min-heap (top() is the smallest element).
+template<typename T>
+struct SfzLess final {
+	bool operator() (const T& lhs, const T& rhs) const { return lhs < rhs; }
+};
+
+// Gives a max-heap (top() is the largest element).
+template<typename T>
+struct SfzGreater final {
+	bool operator() (const T& lhs, const T& rhs) const { return rhs < lhs; }
+};
+
+// d-ary heap helpers
+// ------------------------------------------------------------------------------------------------
+
+// Shared sift implementations for SfzPriorityQueue and SfzIndexedPriorityQueue. The on_move
+// callback (void on_move(u32 new_pos)) is called whenever an element is placed at a new position,
+// which the indexed variant uses to keep its handle -> position mapping up to date.
+
+template<u32 Arity>
+sfz_constexpr_func u32 sfzHeapParent(u32 pos) { return (pos - 1) / Arity; }
+
+template<u32 Arity>
+sfz_constexpr_func u32 sfzHeapFirstChild(u32 pos) { return pos * Arity + 1; }
+
+template<typename T, typename Cmp, u32 Arity, typename OnMove>
+void sfzHeapSiftUp(T* heap, u32 pos, const Cmp& cmp, OnMove on_move)
+{
+	// Move the element out and shift parents down into the hole, instead of swapping each level
+	T tmp = sfz_move(heap[pos]);
+	while (pos > 0) {
+		const u32 parent = sfzHeapParent<Arity>(pos);
+		if (!cmp(tmp, heap[parent])) break;
+		heap[pos] = sfz_move(heap[parent]);
+		on_move(pos);
+		pos = parent;
+	}
+	heap[pos] = sfz_move(tmp);
+	on_move(pos);
+}
+
+template<typename T, typename Cmp, u32 Arity, typename OnMove>
+void sfzHeapSiftDown(T* heap, u32 size, u32 pos, const Cmp& cmp, OnMove on_move)
+{
+	T tmp = sfz_move(heap[pos]);
+	while (true) {
+		const u32 first_child = sfzHeapFirstChild<Arity>(pos);
+		if (first_child >= size) break;
+
+		// Find the best of the (up to) Arity children, they are adjacent in memory
+		const u32 end_child = u32_min(first_child + Arity, size);
+		u32 best = first_child;
+		for (u32 c = first_child + 1; c < end_child; c++) {
+			if (cmp(heap[c], heap[best])) best = c;
+		}
+
+		if (!cmp(heap[best], tmp)) break;
+		heap[pos] = sfz_move(heap[best]);
+		on_move(pos);
+		pos = best;
+	}
+	heap[pos] = sfz_move(tmp);
+	on_move(pos);
+}
+
+// SfzPriorityQueue
+// ------------------------------------------------------------------------------------------------
+
+// A priority queue implemented as an implicit d-ary heap stored in an SfzArray.
+//
+// The top() element is the one that compares "first" according to Cmp, i.e. with the default
+// SfzLess<T> it is the smallest element. Arity is the number of children per node, a higher arity
+// gives a shallower tree and all children of a node are adjacent in memory (with 4 or 8 children
+// they typically share a cache line), at the cost of more comparisons per level in pop().
+//
+// Bulk operations (initFrom() and pushMany()) use Floyd's O(n) heapify when it's cheaper than
+// pushing the elements one by one.
+template<typename T, typename Cmp = SfzLess<T>, u32 Arity = 4>
+class SfzPriorityQueue final {
+public:
+	SFZ_DECLARE_DROP_TYPE(SfzPriorityQueue);
+	using ValT = T;
+	static_assert(Arity >= 2, "");
+
+	explicit SfzPriorityQueue(u32 capacity, SfzAllocator* allocator, SfzDbgInfo alloc_dbg, Cmp cmp = {}) noexcept
+	{
+		this->init(capacity, allocator, alloc_dbg, cmp);
+	}
+
+	// State methods
+	// --------------------------------------------------------------------------------------------
+
+	void init(u32 capacity, SfzAllocator* allocator, SfzDbgInfo alloc_dbg, Cmp cmp = {})
+	{
+		this->destroy();
+		m_heap.init(capacity, allocator, alloc_dbg);
+		m_cmp = cmp;
+	}
+
+	// Initializes the queue with the given elements, heapified in O(n).
+	void initFrom(const T* elements, u32 num_elements, SfzAllocator* allocator, SfzDbgInfo alloc_dbg, Cmp cmp = {})
+	{
+		this->init(num_elements, allocator, alloc_dbg, cmp);
+		m_heap.add(elements, num_elements);
+		this->heapify();
+	}
+
+	void clear() { m_heap.clear(); }
+	void destroy() { m_heap.destroy(); }
+
+	// Getters
+	// --------------------------------------------------------------------------------------------
+
+	u32 size() const { return m_heap.size(); }
+	u32 capacity() const { return m_heap.capacity(); }
+	bool isEmpty() const { return m_heap.isEmpty(); }
+	SfzAllocator* allocator() const { return m_heap.allocator(); }
+
+	// The elements in heap order (not sorted), valid in range [0, size()).
+	const T* data() const { return m_heap.data(); }
+
+	const T& top() const { sfz_assert(!isEmpty()); return m_heap.first(); }
+
+	// Methods
+	// --------------------------------------------------------------------------------------------
+
+	void push(const T& value) { m_heap.add(value); siftUp(m_heap.size() - 1); }
+	void push(T&& value) { m_heap.add(sfz_move(value)); siftUp(m_heap.size() - 1); }
+
+	// Pushes many elements at once. Re-heapifies the whole heap in O(n + k) instead of doing k
+	// O(log n) pushes if that is cheaper.
+	void pushMany(const T* elements, u32 num_elements)
+	{
+		const u32 old_size = m_heap.size();
+		m_heap.add(elements, num_elements);
+		const u32 new_size = m_heap.size();
+		u32 log2_size = 0;
+		for (u32 s = new_size; s > 1; s /= Arity) log2_size += 1;
+		if (num_elements * log2_size > new_size) {
+			this->heapify();
+		}
+		else {
+			for (u32 i = old_size; i < new_size; i++) siftUp(i);
+		}
+	}
+
+	// Removes and returns the top element. Undefined if queue is empty.
+	T pop()
+	{
+		sfz_assert(!isEmpty());
+		T top_value = sfz_move(m_heap.first());
+		T last_value = m_heap.pop();
+		if (!m_heap.isEmpty()) {
+			m_heap.first() = sfz_move(last_value);
+			siftDown(0);
+		}
+		return top_value;
+	}
+
+private:
+	// Private methods
+	// --------------------------------------------------------------------------------------------
+
+	void siftUp(u32 pos) { sfzHeapSiftUp<T, Cmp, Arity>(m_heap.data(), pos, m_cmp, [](u32) {}); }
+	void siftDown(u32 pos) { sfzHeapSiftDown<T, Cmp, Arity>(m_heap.data(), m_heap.size(), pos, m_cmp, [](u32) {}); }
+
+	// Floyd's heapify, sift down all inner nodes starting with the last one.
+	void heapify()
+	{
+		const u32 size = m_heap.size();
+		if (size <= 1) return;
+		for (u32 pos = sfzHeapParent<Arity>(size - 1) + 1; pos > 0; pos--) siftDown(pos - 1);
+	}
+
+	// Private members
+	// --------------------------------------------------------------------------------------------
+
+	SfzArray<T> m_heap;
+	Cmp m_cmp = {};
+};
+
+// SfzIndexedPriorityQueue
+// ------------------------------------------------------------------------------------------------
+
+template<typename T>
+struct SfzIndexedHeapEntry final {
+	T value;
+	SfzHandle handle;
+};
+
+// A priority queue where each pushed element is given an SfzHandle, which can be used to read,
+// update (decrease or increase key) or remove the element in O(log n).
+//
+// Uses an SfzPool to map handles to heap positions, so it has a fixed capacity decided in init()
+// (like SfzPool). Handles are invalidated when their element is popped or removed.
+template<typename T, typename Cmp = SfzLess<T>, u32 Arity = 4>
+class SfzIndexedPriorityQueue final {
+public:
+	SFZ_DECLARE_DROP_TYPE(SfzIndexedPriorityQueue);
+	using ValT = T;
+	using EntryT = SfzIndexedHeapEntry<T>;
+	static_assert(Arity >= 2, "");
+
+	explicit SfzIndexedPriorityQueue(u32 capacity, SfzAllocator* allocator, SfzDbgInfo alloc_dbg, Cmp cmp = {}) noexcept
+	{
+		this->init(capacity, allocator, alloc_dbg, cmp);
+	}
+
+	// State methods
+	// --------------------------------------------------------------------------------------------
+
+	void init(u32 capacity, SfzAllocator* allocator, SfzDbgInfo alloc_dbg, Cmp cmp = {})
+	{
+		this->destroy();
+		m_heap.init(capacity, allocator, alloc_dbg);
+		m_positions.init(capacity, allocator, alloc_dbg);
+		m_cmp = cmp;
+	}
+
+	// Removes all elements, invalidating all handles.
+	void clear()
+	{
+		for (const EntryT& entry : m_heap) m_positions.deallocate(entry.handle);
+		m_heap.clear();
+	}
+
+	void destroy()
+	{
+		m_heap.destroy();
+		m_positions.destroy();
+	}
+
+	// Getters
+	// --------------------------------------------------------------------------------------------
+
+	u32 size() const { return m_heap.size(); }
+	u32 capacity() const { return m_positions.capacity(); }
+	bool isEmpty() const { return m_heap.isEmpty(); }
+	bool isFull() const { return m_positions.isFull(); }
+
+	const T& top() const { sfz_assert(!isEmpty()); return m_heap.first().value; }
+	SfzHandle topHandle() const { sfz_assert(!isEmpty()); return m_heap.first().handle; }
+
+	bool contains(SfzHandle handle) const { return m_positions.handleIsValid(handle); }
+
+	// Returns pointer to the element, nullptr if handle is invalid. Use update() to modify it.
+	const T* get(SfzHandle handle) const
+	{
+		const u32* pos = m_positions.get(handle);
+		if (pos == nullptr) return nullptr;
+		return &m_heap[*pos].value;
+	}
+
+	// Methods
+	// --------------------------------------------------------------------------------------------
+
+	SfzHandle push(const T& value) { return this->pushImpl<const T&>(value); }
+	SfzHandle push(T&& value) { return this->pushImpl<T>(sfz_move(value)); }
+
+	// Pushes many elements at once and writes their handles to handles_out (optional). Heapifies
+	// the whole heap in O(n + k) if that is cheaper than k individual pushes.
+	void pushMany(const T* values, u32 num_values, SfzHandle* handles_out = nullptr)
+	{
+		sfz_assert_hard((m_positions.numAllocated() + num_values) <= m_positions.capacity());
+		const u32 old_size = m_heap.size();
+		for (u32 i = 0; i < num_values; i++) {
+			const SfzHandle handle = m_positions.allocate(old_size + i);
+			m_heap.add(EntryT{ values[i], handle });
+			if (handles_out != nullptr) handles_out[i] = handle;
+		}
+		const u32 new_size = m_heap.size();
+		u32 log2_size = 0;
+		for (u32 s = new_size; s > 1; s /= Arity) log2_size += 1;
+		if (num_values * log2_size > new_size) {
+			for (u32 pos = sfzHeapParent<Arity>(new_size - 1) + 1; pos > 0; pos--) siftDown(pos - 1);
+		}
+		else {
+			for (u32 i = old_size; i < new_size; i++) siftUp(i);
+		}
+	}
+
+	// Removes and returns the top element, its handle becomes invalid. Undefined if empty.
+	T pop()
+	{
+		sfz_assert(!isEmpty());
+		const SfzHandle handle = m_heap.first().handle;
+		T value = sfz_move(m_heap.first().value);
+		this->removeAt(0);
+		m_positions.deallocate(handle);
+		return value;
+	}
+
+	// Sets a new value for the element, and moves it up or down in the heap as needed. Use it for
+	// both decrease-key and increase-key.
+	void update(SfzHandle handle, const T& value)
+	{
+		const u32* pos_ptr = m_positions.get(handle);
+		sfz_assert(pos_ptr != nullptr);
+		if (pos_ptr == nullptr) return;
+		const u32 pos = *pos_ptr;
+		const bool moves_up = m_cmp(value, m_heap[pos].value);
+		m_heap[pos].value = value;
+		if (moves_up) siftUp(pos);
+		else siftDown(pos);
+	}
+
+	// Removes the element, returns false if the handle is invalid.
+	bool remove(SfzHandle handle)
+	{
+		const u32* pos_ptr = m_positions.get(handle);
+		if (pos_ptr == nullptr) return false;
+		this->removeAt(*pos_ptr);
+		m_positions.deallocate(handle);
+		return true;
+	}
+
+private:
+	// Private methods
+	// --------------------------------------------------------------------------------------------
+
+	template<typename ForwardT>
+	SfzHandle pushImpl(ForwardT&& value)
+	{
+		sfz_assert_hard(!m_positions.isFull());
+		const u32 pos = m_heap.size();
+		const SfzHandle handle = m_positions.allocate(pos);
+		m_heap.add(EntryT{ sfz_forward(value), handle });
+		siftUp(pos);
+		return handle;
+	}
+
+	// Removes the entry at pos from the heap by moving the last entry into its place. The handle
+	// of the removed entry is not deallocated.
+	void removeAt(u32 pos)
+	{
+		EntryT last = m_heap.pop();
+		if (pos == m_heap.size()) return; // Removed the last entry
+		const bool moves_up = m_cmp(last.value, m_heap[pos].value);
+		m_heap[pos] = sfz_move(last);
+		if (moves_up) siftUp(pos);
+		else siftDown(pos);
+	}
+
+	struct EntryCmp {
+		const Cmp* cmp;
+		bool operator() (const EntryT& lhs, const EntryT& rhs) const { return (*cmp)(lhs.value, rhs.value); }
+	};
+
+	void siftUp(u32 pos)
+	{
+		EntryT* heap = m_heap.data();
+		sfzHeapSiftUp<EntryT, EntryCmp, Arity>(heap, pos, EntryCmp{ &m_cmp }, [&](u32 new_pos) {
+			m_positions[heap[new_pos].handle] = new_pos;
+		});
+	}
+
+	void siftDown(u32 pos)
+	{
+		EntryT* heap = m_heap.data();
+		sfzHeapSiftDown<EntryT, EntryCmp, Arity>(heap, m_heap.size(), pos, EntryCmp{ &m_cmp }, [&](u32 new_pos) {
+			m_positions[heap[new_pos].handle] = new_pos;
+		});
+	}
+
+	// Private members
+	// --------------------------------------------------------------------------------------------
+
+	SfzArray<EntryT> m_heap;
+	SfzPool<u32> m_positions; // Handle -> position in m_heap
+	Cmp m_cmp = {};
+};
+
+#endif
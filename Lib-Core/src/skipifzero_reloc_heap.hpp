@@ -0,0 +1,415 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#ifndef SKIPIFZERO_RELOC_HEAP_HPP
+#define SKIPIFZERO_RELOC_HEAP_HPP
+#pragma once
+
+#include <string.h>
+
+#include "sfz.h"
+#include "sfz_cpp.hpp"
+#include "sfz_time.h"
+#include "skipifzero_pool.hpp"
+
+// SfzRelocBlock
+// ------------------------------------------------------------------------------------------------
+
+constexpr u64 SFZ_RELOC_HEAP_ALIGNMENT = 32;
+constexpr u32 SFZ_RELOC_HEAP_NO_BLOCK = ~0u;
+constexpr f32 SFZ_RELOC_HEAP_MAX_TIME_BUDGET_MS = 1.0e12f; // Larger budgets mean no time limit
+
+// Meta data about a block in a SfzRelocHeap. All blocks are kept in a doubly linked list sorted by
+// offset, the holes in the heap are the gaps between consecutive blocks.
+struct SfzRelocBlock final {
+	u64 offset = 0;
+	u64 size = 0; // Rounded up to SFZ_RELOC_HEAP_ALIGNMENT
+	u32 prev = SFZ_RELOC_HEAP_NO_BLOCK;
+	u32 next = SFZ_RELOC_HEAP_NO_BLOCK;
+	u32 pin_count = 0;
+	u32 padding = 0;
+};
+static_assert(sizeof(SfzRelocBlock) == 32, "SfzRelocBlock is padded");
+
+// Fragmentation report from a SfzRelocHeap, see SfzRelocHeap::stats().
+struct SfzRelocHeapStats final {
+	u64 capacity = 0;
+	u64 num_bytes_allocated = 0;
+	u64 num_bytes_free = 0; // capacity - num_bytes_allocated
+	u64 num_bytes_in_holes = 0; // Free bytes between blocks, i.e. not at the top of the heap
+	u64 largest_free_range = 0; // Largest allocation that would currently succeed
+	u64 peak_num_bytes_used = 0; // Highest top of heap (end of last block) since init
+	u32 num_blocks = 0;
+	u32 num_holes = 0;
+	u32 num_pinned_blocks = 0;
+
+	// 0 if all free memory is contiguous, approaches 1 as the free memory is split into many small
+	// holes. Defined as (1 - largest_free_range / num_bytes_free).
+	f32 fragmentation = 0.0f;
+};
+
+// SfzRelocHeap
+// ------------------------------------------------------------------------------------------------
+
+// A heap addressed by handles instead of pointers, which means that it can move its blocks around
+// in order to compact itself.
+//
+// All memory is allocated up front as one contiguous range. Allocations are first placed in holes
+// left by earlier deallocations (first fit), otherwise at the top of the heap. defragment() should
+// be called regularly (e.g. once per frame) with a time budget. It slides blocks down towards the
+// start of the heap to close holes, continuing where it left off the previous call.
+//
+// Pointers returned by get() are only valid until the next call to defragment(). If a pointer
+// needs to stay valid for longer (e.g. while a job is reading from the block) the block must be
+// pinned. Pinned blocks are never moved, but the hole in front of a pinned block can not be closed
+// until it is unpinned.
+//
+// The handles are versioned SfzHandles (via a SfzPool), so stale handles are detected.
+class SfzRelocHeap final {
+public:
+	SFZ_DECLARE_DROP_TYPE(SfzRelocHeap);
+
+	explicit SfzRelocHeap(
+		u64 capacity, u32 max_num_blocks, SfzAllocator* allocator, SfzDbgInfo alloc_dbg) noexcept
+	{
+		this->init(capacity, max_num_blocks, allocator, alloc_dbg);
+	}
+
+	// State methods
+	// --------------------------------------------------------------------------------------------
+
+	void init(u64 capacity, u32 max_num_blocks, SfzAllocator* allocator, SfzDbgInfo alloc_dbg)
+	{
+		sfz_assert(capacity != 0);
+		sfz_assert(max_num_blocks != 0);
+		this->destroy();
+		m_capacity = sfzRoundUpAlignedU64(capacity, SFZ_RELOC_HEAP_ALIGNMENT);
+		m_memory = static_cast<u8*>(allocator->alloc(alloc_dbg, m_capacity, SFZ_RELOC_HEAP_ALIGNMENT));
+		m_blocks.init(max_num_blocks, allocator, alloc_dbg);
+		m_allocator = allocator;
+	}
+
+	void destroy()
+	{
+		if (m_memory != nullptr) {
+			m_allocator->dealloc(m_memory);
+		}
+		m_blocks.destroy();
+		m_capacity = 0;
+		m_memory = nullptr;
+		m_num_bytes_allocated = 0;
+		m_peak_num_bytes_used = 0;
+		m_first = SFZ_RELOC_HEAP_NO_BLOCK;
+		m_last = SFZ_RELOC_HEAP_NO_BLOCK;
+		m_defrag_cursor = SFZ_RELOC_HEAP_NO_BLOCK;
+		m_allocator = nullptr;
+	}
+
+	// Getters
+	// --------------------------------------------------------------------------------------------
+
+	u64 capacity() const { return m_capacity; }
+	u64 numBytesAllocated() const { return m_num_bytes_allocated; }
+	u64 numBytesUsed() const { return this->topOffset(); }
+	u64 peakNumBytesUsed() const { return m_peak_num_bytes_used; }
+	u32 numBlocks() const { return m_blocks.numAllocated(); }
+	u32 maxNumBlocks() const { return m_blocks.capacity(); }
+	SfzAllocator* allocator() const { return m_allocator; }
+
+	// Whether there may be holes left for defragment() to close.
+	bool needsDefragment() const { return m_defrag_cursor != SFZ_RELOC_HEAP_NO_BLOCK; }
+
+	bool handleIsValid(SfzHandle handle) const { return m_blocks.handleIsValid(handle); }
+
+	// Size of the block in bytes, rounded up to SFZ_RELOC_HEAP_ALIGNMENT.
+	u64 blockSize(SfzHandle handle) const { return m_blocks[handle].size; }
+	u32 pinCount(SfzHandle handle) const { return m_blocks[handle].pin_count; }
+	bool isPinned(SfzHandle handle) const { return m_blocks[handle].pin_count != 0; }
+
+	// Returns a pointer to the block, or nullptr if the handle is invalid. The pointer is only valid
+	// until the next call to defragment(), unless the block is pinned.
+	void* get(SfzHandle handle)
+	{
+		const SfzRelocBlock* block = m_blocks.get(handle);
+		if (block == nullptr) return nullptr;
+		return m_memory + block->offset;
+	}
+	const void* get(SfzHandle handle) const { return const_cast<SfzRelocHeap*>(this)->get(handle); }
+
+	// Walks through all blocks and reports how fragmented the heap is, O(number of blocks).
+	SfzRelocHeapStats stats() const
+	{
+		SfzRelocHeapStats stats;
+		stats.capacity = m_capacity;
+		stats.num_bytes_allocated = m_num_bytes_allocated;
+		stats.num_bytes_free = m_capacity - m_num_bytes_allocated;
+		stats.peak_num_bytes_used = m_peak_num_bytes_used;
+		stats.num_blocks = m_blocks.numAllocated();
+		u64 prev_end = 0;
+		for (u32 idx = m_first; idx != SFZ_RELOC_HEAP_NO_BLOCK; idx = this->block(idx).next) {
+			const SfzRelocBlock& b = this->block(idx);
+			const u64 hole = b.offset - prev_end;
+			if (hole != 0) {
+				stats.num_holes += 1;
+				stats.num_bytes_in_holes += hole;
+				stats.largest_free_range = u64_max(stats.largest_free_range, hole);
+			}
+			if (b.pin_count != 0) stats.num_pinned_blocks += 1;
+			prev_end = b.offset + b.size;
+		}
+		stats.largest_free_range = u64_max(stats.largest_free_range, m_capacity - prev_end);
+		if (stats.num_bytes_free != 0) {
+			stats.fragmentation =
+				1.0f - f32(f64(stats.largest_free_range) / f64(stats.num_bytes_free));
+		}
+		return stats;
+	}
+
+	// Methods
+	// --------------------------------------------------------------------------------------------
+
+	// Allocates a block of (at least) the given size. Returns SFZ_NULL_HANDLE if there is no free
+	// range large enough, in which case it might help to defragmentFull() and try again.
+	SfzHandle allocate(u64 size)
+	{
+		sfz_assert(size != 0);
+		size = sfzRoundUpAlignedU64(size, SFZ_RELOC_HEAP_ALIGNMENT);
+		if (m_blocks.isFull()) return SFZ_NULL_HANDLE;
+
+		// Try to find a hole (first fit), otherwise place it at the top of the heap
+		u32 prev = SFZ_RELOC_HEAP_NO_BLOCK;
+		const u64 top = this->topOffset();
+		u64 offset = this->findHole(size, m_last, &prev);
+		if (offset == U64_MAX) {
+			if ((m_capacity - top) < size) return SFZ_NULL_HANDLE;
+			offset = top;
+			prev = m_last;
+		}
+
+		SfzRelocBlock new_block;
+		new_block.offset = offset;
+		new_block.size = size;
+		const SfzHandle handle = m_blocks.allocate(new_block);
+		this->linkAfter(prev, handle.idx());
+		m_num_bytes_allocated += size;
+		m_peak_num_bytes_used = u64_max(m_peak_num_bytes_used, this->topOffset());
+		return handle;
+	}
+
+	void deallocate(SfzHandle handle)
+	{
+		SfzRelocBlock* block = m_blocks.get(handle);
+		sfz_assert(block != nullptr);
+		if (block == nullptr) return;
+		sfz_assert(block->pin_count == 0);
+		const u32 idx = handle.idx();
+		const u32 next = block->next;
+		m_num_bytes_allocated -= block->size;
+		if (m_defrag_cursor == idx) m_defrag_cursor = next;
+		this->unlink(idx);
+		m_blocks.deallocate(handle);
+
+		// The hole is in front of the next block (if any, otherwise it's part of the top)
+		this->markHoleBefore(next);
+	}
+
+	// Pins the block so that it is not moved by defragment() and returns a pointer to it, which is
+	// valid until the block is unpinned. Pins are reference counted.
+	void* pin(SfzHandle handle)
+	{
+		SfzRelocBlock& block = m_blocks[handle];
+		block.pin_count += 1;
+		return m_memory + block.offset;
+	}
+
+	void unpin(SfzHandle handle)
+	{
+		SfzRelocBlock& block = m_blocks[handle];
+		sfz_assert(block.pin_count != 0);
+		block.pin_count -= 1;
+		if (block.pin_count == 0) this->markHoleBefore(handle.idx());
+	}
+
+	// Incrementally compacts the heap, continuing from where the previous call stopped. First the
+	// block at the top of the heap is moved down into the lowest hole it fits in, as long as this is
+	// possible. This lowers the top of the heap by a full block per move. Then the remaining holes
+	// are closed by sliding blocks down. Stops when the time budget or the byte budget is exceeded
+	// (at least one block is always moved if there is one to move). A non-finite or huge time budget
+	// means no time limit. Returns the number of bytes moved.
+	u64 defragment(f32 time_budget_ms, u64 max_num_bytes_moved = U64_MAX)
+	{
+		// Written so that NaN also ends up in the no time limit case
+		const bool has_deadline = time_budget_ms < SFZ_RELOC_HEAP_MAX_TIME_BUDGET_MS;
+		const i64 time_budget_us = has_deadline ? i64(time_budget_ms * 1000.0f) : 0;
+		return this->defragmentInternal(has_deadline, time_budget_us, max_num_bytes_moved);
+	}
+
+	// Compacts the entire heap (except for holes in front of pinned blocks). Returns bytes moved.
+	u64 defragmentFull()
+	{
+		u64 num_bytes_moved = 0;
+		while (m_defrag_cursor != SFZ_RELOC_HEAP_NO_BLOCK) {
+			num_bytes_moved += this->defragmentInternal(false, 0, U64_MAX);
+		}
+		return num_bytes_moved;
+	}
+
+private:
+	// Private methods
+	// --------------------------------------------------------------------------------------------
+
+	u64 defragmentInternal(bool has_deadline, i64 time_budget_us, u64 max_num_bytes_moved)
+	{
+		if (m_defrag_cursor == SFZ_RELOC_HEAP_NO_BLOCK) return 0;
+		const SfzTime start = has_deadline ? sfzTimeNow() : SfzTime{};
+		u64 num_bytes_moved = 0;
+		auto budgetExceeded = [&]() {
+			if (num_bytes_moved >= max_num_bytes_moved) return true;
+			if (!has_deadline || num_bytes_moved == 0) return false;
+			return sfzTimeDiff(start, sfzTimeNow()).us >= time_budget_us;
+		};
+
+		// Move top block into holes
+		while (m_defrag_cursor != SFZ_RELOC_HEAP_NO_BLOCK) {
+			const u32 idx = m_last;
+			SfzRelocBlock& b = this->block(idx);
+			if (b.pin_count != 0 || b.prev == SFZ_RELOC_HEAP_NO_BLOCK) break;
+			u32 prev = SFZ_RELOC_HEAP_NO_BLOCK;
+			const u64 offset = this->findHole(b.size, b.prev, &prev);
+			if (offset == U64_MAX) break;
+			memcpy(m_memory + offset, m_memory + b.offset, b.size);
+			num_bytes_moved += b.size;
+			if (m_defrag_cursor == idx) m_defrag_cursor = SFZ_RELOC_HEAP_NO_BLOCK;
+			this->unlink(idx);
+			b.offset = offset;
+			this->linkAfter(prev, idx);
+			this->markHoleBefore(b.next);
+			if (budgetExceeded()) return num_bytes_moved;
+		}
+
+		// Slide blocks down
+		u32 idx = m_defrag_cursor;
+		while (idx != SFZ_RELOC_HEAP_NO_BLOCK) {
+			SfzRelocBlock& b = this->block(idx);
+			const u64 prev_end = this->endOfPrev(b);
+			if (b.offset != prev_end && b.pin_count == 0) {
+				memmove(m_memory + prev_end, m_memory + b.offset, b.size);
+				b.offset = prev_end;
+				num_bytes_moved += b.size;
+			}
+			idx = b.next;
+			if (budgetExceeded()) break;
+		}
+		m_defrag_cursor = idx;
+		return num_bytes_moved;
+	}
+
+	SfzRelocBlock& block(u32 idx) { return m_blocks.data()[idx]; }
+	const SfzRelocBlock& block(u32 idx) const { return m_blocks.data()[idx]; }
+
+	u64 topOffset() const
+	{
+		if (m_last == SFZ_RELOC_HEAP_NO_BLOCK) return 0;
+		const SfzRelocBlock& last = this->block(m_last);
+		return last.offset + last.size;
+	}
+
+	// Returns the offset of the first hole (lowest offset) which fits size bytes, or U64_MAX if there
+	// is none. Only the holes in front of the blocks up to and including last are considered.
+	// prev_out is set to the block before the hole.
+	u64 findHole(u64 size, u32 last, u32* prev_out) const
+	{
+		// Early out if there are not enough bytes in holes
+		if ((this->topOffset() - m_num_bytes_allocated) < size) return U64_MAX;
+		u64 prev_end = 0;
+		u32 prev = SFZ_RELOC_HEAP_NO_BLOCK;
+		u32 idx = m_first;
+		while (idx != SFZ_RELOC_HEAP_NO_BLOCK) {
+			const SfzRelocBlock& b = this->block(idx);
+			if ((b.offset - prev_end) >= size) {
+				*prev_out = prev;
+				return prev_end;
+			}
+			if (idx == last) break;
+			prev_end = b.offset + b.size;
+			prev = idx;
+			idx = b.next;
+		}
+		return U64_MAX;
+	}
+
+	u64 endOfPrev(const SfzRelocBlock& b) const
+	{
+		if (b.prev == SFZ_RELOC_HEAP_NO_BLOCK) return 0;
+		const SfzRelocBlock& prev = this->block(b.prev);
+		return prev.offset + prev.size;
+	}
+
+	// Rewinds the defragment cursor if the given block has a hole in front of it which is located
+	// before the cursor.
+	void markHoleBefore(u32 idx)
+	{
+		if (idx == SFZ_RELOC_HEAP_NO_BLOCK) return;
+		const SfzRelocBlock& b = this->block(idx);
+		if (b.offset == this->endOfPrev(b)) return;
+		if (m_defrag_cursor == SFZ_RELOC_HEAP_NO_BLOCK ||
+			b.offset < this->block(m_defrag_cursor).offset) {
+			m_defrag_cursor = idx;
+		}
+	}
+
+	void linkAfter(u32 prev, u32 idx)
+	{
+		SfzRelocBlock& b = this->block(idx);
+		b.prev = prev;
+		if (prev == SFZ_RELOC_HEAP_NO_BLOCK) {
+			b.next = m_first;
+			m_first = idx;
+		}
+		else {
+			b.next = this->block(prev).next;
+			this->block(prev).next = idx;
+		}
+		if (b.next == SFZ_RELOC_HEAP_NO_BLOCK) m_last = idx;
+		else this->block(b.next).prev = idx;
+	}
+
+	void unlink(u32 idx)
+	{
+		const SfzRelocBlock& b = this->block(idx);
+		if (b.prev == SFZ_RELOC_HEAP_NO_BLOCK) m_first = b.next;
+		else this->block(b.prev).next = b.next;
+		if (b.next == SFZ_RELOC_HEAP_NO_BLOCK) m_last = b.prev;
+		else this->block(b.next).prev = b.prev;
+	}
+
+	// Private members
+	// --------------------------------------------------------------------------------------------
+
+	u64 m_capacity = 0;
+	u8* m_memory = nullptr;
+	u64 m_num_bytes_allocated = 0;
+	u64 m_peak_num_bytes_used = 0;
+	u32 m_first = SFZ_RELOC_HEAP_NO_BLOCK; // Block with lowest offset
+	u32 m_last = SFZ_RELOC_HEAP_NO_BLOCK; // Block with highest offset
+	u32 m_defrag_cursor = SFZ_RELOC_HEAP_NO_BLOCK; // Next block to examine, NO_BLOCK if compact
+	SfzPool<SfzRelocBlock> m_blocks;
+	SfzAllocator* m_allocator = nullptr;
+};
+
+#endif
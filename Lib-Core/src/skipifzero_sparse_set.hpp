@@ -0,0 +1,368 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#ifndef SKIPIFZERO_SPARSE_SET_HPP
+#define SKIPIFZERO_SPARSE_SET_HPP
+#pragma once
+
+#include "sfz.h"
+#include "sfz_cpp.hpp"
+
+#ifdef __cplusplus
+
+// SfzSparseSet
+// ------------------------------------------------------------------------------------------------
+
+constexpr u32 SFZ_SPARSE_SET_PAGE_NUM_BITS = 12;
+constexpr u32 SFZ_SPARSE_SET_PAGE_SIZE = 1u << SFZ_SPARSE_SET_PAGE_NUM_BITS; // 4096 entries (16 KiB) per page
+constexpr u32 SFZ_SPARSE_SET_PAGE_MASK = SFZ_SPARSE_SET_PAGE_SIZE - 1;
+constexpr u32 SFZ_SPARSE_SET_MAX_KEY = SFZ_HANDLE_INDEX_MASK;
+constexpr u32 SFZ_SPARSE_SET_MAX_NUM_PAGES = (SFZ_SPARSE_SET_MAX_KEY >> SFZ_SPARSE_SET_PAGE_NUM_BITS) + 1;
+constexpr u32 SFZ_SPARSE_SET_EMPTY = ~0u;
+constexpr f32 SFZ_SPARSE_SET_GROW_RATE = 1.75f;
+constexpr u32 SFZ_SPARSE_SET_MIN_CAPACITY = 64;
+
+// A sparse set mapping small integer keys (typically SfzHandle::idx()) to values.
+//
+// Compared to a SfzHashMap<u32, T> a lookup is just two array reads (no hashing or probing), and
+// both adding and removing are O(1). It consists of three parts:
+//
+//   * A paged sparse array mapping keys to dense indices. Pages are allocated lazily the first
+//     time a key in their range is added, so a set with only a few large keys stays small.
+//   * A dense array of keys, i.e. the dense index -> key mapping.
+//   * A dense array of values, stored in the same order as the dense keys.
+//
+// The dense arrays are always packed, i.e. both keys() and values() are valid in the range
+// [0, size()), which makes iterating over all elements as cache efficient as iterating over an
+// array. Removal swaps in the last element, so the order of elements is not preserved and pointers
+// to values are invalidated by both add and remove.
+//
+// Note that the key is only the index, versions have to be checked elsewhere (e.g. with a SfzPool).
+template<typename T>
+class SfzSparseSet final {
+public:
+	SFZ_DECLARE_DROP_TYPE(SfzSparseSet);
+	using ValT = T;
+
+	static constexpr u32 ALIGNMENT = 32;
+	static_assert(alignof(T) <= ALIGNMENT, "");
+
+	explicit SfzSparseSet(u32 capacity, SfzAllocator* allocator, SfzDbgInfo alloc_dbg) noexcept
+	{
+		this->init(capacity, allocator, alloc_dbg);
+	}
+
+	// State methods
+	// --------------------------------------------------------------------------------------------
+
+	// Initializes with specified parameters. Guaranteed to only set allocator and not allocate
+	// memory if a capacity of 0 is requested.
+	void init(u32 capacity, SfzAllocator* allocator, SfzDbgInfo alloc_dbg)
+	{
+		this->destroy();
+		m_allocator = allocator;
+		this->setCapacity(capacity, alloc_dbg);
+	}
+
+	// Removes all elements without deallocating memory.
+	void clear()
+	{
+		for (u32 i = 0; i < m_size; i++) {
+			setSparse(m_keys[i], SFZ_SPARSE_SET_EMPTY);
+			m_values[i].~T();
+		}
+		m_size = 0;
+	}
+
+	// Destroys all elements, deallocates memory and removes allocator.
+	void destroy()
+	{
+		this->clear();
+		for (u32 i = 0; i < m_num_pages; i++) {
+			if (m_pages[i] != nullptr) m_allocator->dealloc(m_pages[i]);
+		}
+		if (m_pages != nullptr) m_allocator->dealloc(m_pages);
+		if (m_dense_allocation != nullptr) m_allocator->dealloc(m_dense_allocation);
+		m_capacity = 0;
+		m_num_pages = 0;
+		m_pages = nullptr;
+		m_dense_allocation = nullptr;
+		m_keys = nullptr;
+		m_values = nullptr;
+		m_allocator = nullptr;
+	}
+
+	// Sets the capacity of the dense arrays, moving elements if necessary.
+	void setCapacity(u32 capacity, SfzDbgInfo alloc_dbg = sfz_dbg("SparseSet"))
+	{
+		if (m_size > capacity) capacity = m_size;
+		if (m_capacity == capacity) return;
+		if (capacity < SFZ_SPARSE_SET_MIN_CAPACITY) capacity = SFZ_SPARSE_SET_MIN_CAPACITY;
+		sfz_assert_hard(m_allocator != nullptr);
+		sfz_assert_hard(capacity <= (SFZ_SPARSE_SET_MAX_KEY + 1));
+
+		// Allocate memory for the new dense arrays
+		const u64 keys_size = sfzRoundUpAlignedU64(sizeof(u32) * capacity, ALIGNMENT);
+		const u64 values_size = sfzRoundUpAlignedU64(sizeof(T) * capacity, ALIGNMENT);
+		u8* new_allocation = static_cast<u8*>(m_allocator->alloc(alloc_dbg, keys_size + values_size, ALIGNMENT));
+		u32* new_keys = reinterpret_cast<u32*>(new_allocation);
+		T* new_values = reinterpret_cast<T*>(new_allocation + keys_size);
+
+		// Move over elements from old memory
+		if (m_size > 0) memcpy(new_keys, m_keys, sizeof(u32) * m_size);
+		for (u32 i = 0; i < m_size; i++) {
+			new (new_values + i) T(sfz_move(m_values[i]));
+			m_values[i].~T();
+		}
+
+		// Replace old memory
+		if (m_dense_allocation != nullptr) m_allocator->dealloc(m_dense_allocation);
+		m_capacity = capacity;
+		m_dense_allocation = new_allocation;
+		m_keys = new_keys;
+		m_values = new_values;
+	}
+	void ensureCapacity(u32 capacity) { if (m_capacity < capacity) setCapacity(capacity); }
+
+	// Getters
+	// --------------------------------------------------------------------------------------------
+
+	u32 size() const { return m_size; }
+	u32 capacity() const { return m_capacity; }
+	bool isEmpty() const { return m_size == 0; }
+	SfzAllocator* allocator() const { return m_allocator; }
+
+	// The dense arrays, both valid in range [0, size()). keys()[i] is the key of values()[i].
+	const u32* keys() const { return m_keys; }
+	T* values() { return m_values; }
+	const T* values() const { return m_values; }
+
+	// Returns the dense index of the given key, ~0u if the set does not contain the key.
+	u32 denseIdx(u32 key) const
+	{
+		const u32 page_idx = key >> SFZ_SPARSE_SET_PAGE_NUM_BITS;
+		if (page_idx >= m_num_pages) return SFZ_SPARSE_SET_EMPTY;
+		const u32* page = m_pages[page_idx];
+		if (page == nullptr) return SFZ_SPARSE_SET_EMPTY;
+		return page[key & SFZ_SPARSE_SET_PAGE_MASK];
+	}
+
+	bool contains(u32 key) const { return denseIdx(key) != SFZ_SPARSE_SET_EMPTY; }
+
+	// The sparse pages. Page i maps the keys starting at i * SFZ_SPARSE_SET_PAGE_SIZE to dense
+	// indices (SFZ_SPARSE_SET_EMPTY if not in the set). Pages that were never needed are nullptr.
+	u32 numPages() const { return m_num_pages; }
+	const u32* page(u32 page_idx) const { sfz_assert(page_idx < m_num_pages); return m_pages[page_idx]; }
+
+	// Returns pointer to the value associated with the given key, or nullptr if no such element
+	// exists. The pointer is valid until the set is modified.
+	T* get(u32 key)
+	{
+		const u32 dense_idx = denseIdx(key);
+		if (dense_idx == SFZ_SPARSE_SET_EMPTY) return nullptr;
+		sfz_assert(dense_idx < m_size);
+		return m_values + dense_idx;
+	}
+	const T* get(u32 key) const { return const_cast<SfzSparseSet*>(this)->get(key); }
+
+	T& operator[] (u32 key) { T* ptr = get(key); sfz_assert_hard(ptr != nullptr); return *ptr; }
+	const T& operator[] (u32 key) const { const T* ptr = get(key); sfz_assert_hard(ptr != nullptr); return *ptr; }
+
+	// Methods
+	// --------------------------------------------------------------------------------------------
+
+	// Adds the specified key value pair. If a value is already associated with the given key it
+	// will be replaced with the new value. Returns a reference to the element set.
+	T& put(u32 key, const T& value) { return this->putImpl<const T&>(key, value); }
+	T& put(u32 key, T&& value) { return this->putImpl<T>(key, sfz_move(value)); }
+
+	// Adds a zero:ed element (or returns existing one) and returns reference to it.
+	T& put(u32 key) { T* ptr = get(key); if (ptr != nullptr) return *ptr; return this->putImpl<T>(key, {}); }
+
+	// Removes the element associated with the given key by swapping in the last element of the
+	// dense arrays. Returns false if the set contains no such element.
+	bool remove(u32 key)
+	{
+		const u32 dense_idx = denseIdx(key);
+		if (dense_idx == SFZ_SPARSE_SET_EMPTY) return false;
+		sfz_assert(dense_idx < m_size);
+
+		const u32 last_idx = m_size - 1;
+		if (dense_idx != last_idx) {
+			const u32 last_key = m_keys[last_idx];
+			m_keys[dense_idx] = last_key;
+			m_values[dense_idx] = sfz_move(m_values[last_idx]);
+			setSparse(last_key, dense_idx);
+		}
+		m_values[last_idx].~T();
+		setSparse(key, SFZ_SPARSE_SET_EMPTY);
+		m_size -= 1;
+		return true;
+	}
+
+	// Iterator methods (iterates over the values in dense order)
+	// --------------------------------------------------------------------------------------------
+
+	T* begin() { return m_values; }
+	const T* begin() const { return m_values; }
+	T* end() { return m_values + m_size; }
+	const T* end() const { return m_values + m_size; }
+
+private:
+	// Private methods
+	// --------------------------------------------------------------------------------------------
+
+	void setSparse(u32 key, u32 dense_idx)
+	{
+		const u32 page_idx = key >> SFZ_SPARSE_SET_PAGE_NUM_BITS;
+		sfz_assert(page_idx < m_num_pages);
+		sfz_assert(m_pages[page_idx] != nullptr);
+		m_pages[page_idx][key & SFZ_SPARSE_SET_PAGE_MASK] = dense_idx;
+	}
+
+	// Returns the page for the given key, allocates it (and grows the page directory) if needed.
+	u32* getOrCreatePage(u32 key)
+	{
+		sfz_assert_hard(key <= SFZ_SPARSE_SET_MAX_KEY);
+		const u32 page_idx = key >> SFZ_SPARSE_SET_PAGE_NUM_BITS;
+
+		// Grow page directory if necessary, pages themselves are never moved
+		if (page_idx >= m_num_pages) {
+			const u32 new_num_pages = u32_min(
+				u32_max(page_idx + 1, m_num_pages * 2), SFZ_SPARSE_SET_MAX_NUM_PAGES);
+			u32** new_pages = static_cast<u32**>(m_allocator->alloc(
+				sfz_dbg("SparseSet pages"), sizeof(u32*) * new_num_pages, ALIGNMENT));
+			memset(new_pages, 0, sizeof(u32*) * new_num_pages);
+			if (m_pages != nullptr) {
+				memcpy(new_pages, m_pages, sizeof(u32*) * m_num_pages);
+				m_allocator->dealloc(m_pages);
+			}
+			m_pages = new_pages;
+			m_num_pages = new_num_pages;
+		}
+
+		// Allocate page if necessary, all entries start out empty (0xFFFFFFFF)
+		u32*& page = m_pages[page_idx];
+		if (page == nullptr) {
+			page = static_cast<u32*>(m_allocator->alloc(
+				sfz_dbg("SparseSet page"), sizeof(u32) * SFZ_SPARSE_SET_PAGE_SIZE, ALIGNMENT));
+			memset(page, 0xFF, sizeof(u32) * SFZ_SPARSE_SET_PAGE_SIZE);
+		}
+		return page;
+	}
+
+	template<typename ForwardT>
+	T& putImpl(u32 key, ForwardT&& value)
+	{
+		// Replace value if key already exists
+		const u32 existing_idx = denseIdx(key);
+		if (existing_idx != SFZ_SPARSE_SET_EMPTY) {
+			sfz_assert(existing_idx < m_size);
+			m_values[existing_idx] = sfz_forward(value);
+			return m_values[existing_idx];
+		}
+
+		// Grow dense arrays if necessary
+		if (m_size >= m_capacity) {
+			setCapacity(u32_max(u32(m_capacity * SFZ_SPARSE_SET_GROW_RATE), m_size + 1));
+		}
+
+		// Insert new element at end of dense arrays
+		u32* page = getOrCreatePage(key);
+		const u32 dense_idx = m_size;
+		page[key & SFZ_SPARSE_SET_PAGE_MASK] = dense_idx;
+		m_keys[dense_idx] = key;
+		new (m_values + dense_idx) T(sfz_forward(value));
+		m_size += 1;
+		return m_values[dense_idx];
+	}
+
+	// Private members
+	// --------------------------------------------------------------------------------------------
+
+	u32 m_size = 0, m_capacity = 0;
+	u32 m_num_pages = 0;
+	u32** m_pages = nullptr;
+	u8* m_dense_allocation = nullptr;
+	u32* m_keys = nullptr;
+	T* m_values = nullptr;
+	SfzAllocator* m_allocator = nullptr;
+};
+
+// Intersection
+// ------------------------------------------------------------------------------------------------
+
+// Calls func for every key that exists in both sets, in no particular order. Function should have
+// signature: void func(u32 key, T1& value1, T2& value2)
+//
+// The smaller of the two sets drives the iteration (its dense arrays are read linearly, the other
+// set is only probed), so the elements are visited in the dense order of the smaller set, i.e.
+// insertion order shuffled by removals. This is the fastest option when the order doesn't matter.
+// If both sets have the same size the order of set1 is used. The sets may not be modified from
+// func.
+template<typename T1, typename T2, typename F>
+void sfzSparseSetIntersect(SfzSparseSet<T1>& set1, SfzSparseSet<T2>& set2, F func)
+{
+	if (set2.size() < set1.size()) {
+		const u32* keys = set2.keys();
+		T2* values = set2.values();
+		for (u32 i = 0, size = set2.size(); i < size; i++) {
+			const u32 key = keys[i];
+			T1* value1 = set1.get(key);
+			if (value1 != nullptr) func(key, *value1, values[i]);
+		}
+	}
+	else {
+		const u32* keys = set1.keys();
+		T1* values = set1.values();
+		for (u32 i = 0, size = set1.size(); i < size; i++) {
+			const u32 key = keys[i];
+			T2* value2 = set2.get(key);
+			if (value2 != nullptr) func(key, values[i], *value2);
+		}
+	}
+}
+
+// Same as sfzSparseSetIntersect(), but visits the keys in ascending order. Walks the sparse pages
+// that exist in both sets instead of the dense arrays, so the cost is proportional to the number
+// of shared pages (SFZ_SPARSE_SET_PAGE_SIZE entries each) rather than to the number of elements.
+// Cheap for dense key ranges (e.g. handle indices), slower than the unordered variant for a few
+// scattered keys.
+template<typename T1, typename T2, typename F>
+void sfzSparseSetIntersectOrdered(SfzSparseSet<T1>& set1, SfzSparseSet<T2>& set2, F func)
+{
+	if (set1.isEmpty() || set2.isEmpty()) return;
+	T1* values1 = set1.values();
+	T2* values2 = set2.values();
+	const u32 num_pages = u32_min(set1.numPages(), set2.numPages());
+	for (u32 page_idx = 0; page_idx < num_pages; page_idx++) {
+		const u32* page1 = set1.page(page_idx);
+		const u32* page2 = set2.page(page_idx);
+		if (page1 == nullptr || page2 == nullptr) continue;
+		for (u32 i = 0; i < SFZ_SPARSE_SET_PAGE_SIZE; i++) {
+			const u32 dense_idx1 = page1[i];
+			const u32 dense_idx2 = page2[i];
+			if (dense_idx1 == SFZ_SPARSE_SET_EMPTY || dense_idx2 == SFZ_SPARSE_SET_EMPTY) continue;
+			const u32 key = (page_idx << SFZ_SPARSE_SET_PAGE_NUM_BITS) | i;
+			func(key, values1[dense_idx1], values2[dense_idx2]);
+		}
+	}
+}
+
+#endif // __cplusplus
+#endif // SKIPIFZERO_SPARSE_SET_HPP
@@ -29,7 +29,10 @@
 #include "sfz_cpp.hpp"
 
 #ifdef SFZ_STR_ID_IMPLEMENTATION
-#include "skipifzero_hash_maps.hpp"
+#include <atomic>
+#if defined(_M_X64) || defined(_M_AMD64) || defined(_M_ARM64)
+#include <intrin.h> // _mm_pause(), __yield()
+#endif
 #endif
 
 // String hashing
@@ -74,57 +77,252 @@ sfz_constexpr_func u64 sfzHash(const char* str) { return sfzHashStringFNV1a(str)
 // SfzStrID
 // ------------------------------------------------------------------------------------------------
 
+// Registry of strings that have been turned into SfzStrIDs, so the original strings can be
+// retrieved from the ids. Registering the same string multiple times is fine.
+//
+// Looking up strings (sfzStrIDGetStr(), sfzStrIDGetStrLen()) is lock-free and can be done from any
+// number of threads, also while strings are being registered. Registration is either single
+// writer (num_shards == 1, the caller must make sure only one thread registers at a time) or
+// concurrent (num_shards > 1, the ids are split between shards that each have their own lock).
 struct SfzStrIDs;
 
 sfz_constexpr_func SfzStrID sfzStrIDCreate(const char* str) { return { sfzHashStringFNV1a(str) }; }
 sfz_extern_c SfzStrID sfzStrIDCreateRegister(SfzStrIDs* ids, const char* str);
 sfz_extern_c const char* sfzStrIDGetStr(const SfzStrIDs* ids, SfzStrID id);
+sfz_extern_c u32 sfzStrIDGetStrLen(const SfzStrIDs* ids, SfzStrID id); // 0 if not registered
 
 sfz_constexpr_func u64 sfzHash(SfzStrID str) { return str.id; }
 
 #ifdef SFZ_STR_ID_IMPLEMENTATION
 
+constexpr u32 SFZ_STR_IDS_PAGE_SIZE = 64 * 1024;
+
+// A registered string, immediately followed by the null-terminated string itself. Entries are
+// never moved or freed until the SfzStrIDs is destroyed.
+struct SfzStrIDEntry final {
+	u64 id;
+	u32 len;
+	u32 padding;
+	const char* str() const { return reinterpret_cast<const char*>(this + 1); }
+};
+static_assert(sizeof(SfzStrIDEntry) == 16, "");
+
+// Arena page that the entries are appended to.
+struct SfzStrIDPage final {
+	SfzStrIDPage* next;
+	u32 size;
+	u32 used;
+	u8* data() { return reinterpret_cast<u8*>(this + 1); }
+};
+static_assert(sizeof(SfzStrIDPage) == 16, "");
+
+// Open addressing (linear probing, <= 50% load) index from id to entry. Tables are never modified
+// after they have been replaced by a larger one (only the writer inserts into the current table),
+// and are kept alive until destruction so that readers never access freed memory.
+struct SfzStrIDTable final {
+	SfzStrIDTable* prev_retired;
+	u32 num_slot_bits;
+	u32 size;
+	std::atomic<const SfzStrIDEntry*>* slots() { return reinterpret_cast<std::atomic<const SfzStrIDEntry*>*>(this + 1); }
+	const std::atomic<const SfzStrIDEntry*>* slots() const { return reinterpret_cast<const std::atomic<const SfzStrIDEntry*>*>(this + 1); }
+	u32 homeSlot(u64 id) const { return u32((id * 0x9E3779B97F4A7C15ull) >> (64 - num_slot_bits)); }
+	u32 slotMask() const { return (1u << num_slot_bits) - 1; }
+};
+static_assert(sizeof(SfzStrIDTable) == 16, "");
+
+// Aligned to keep shards on separate cache lines.
+struct alignas(64) SfzStrIDShard final {
+	std::atomic<SfzStrIDTable*> table = nullptr;
+	std::atomic<u32> lock = 0;
+	SfzStrIDPage* pages = nullptr; // Current page first
+};
+static_assert(sizeof(SfzStrIDShard) == 64, "");
+
 struct SfzStrIDs final {
 	SfzAllocator* allocator = nullptr;
-	SfzHashMap<SfzStrID, char*> strs;
+	u32 num_shards = 0;
+	SfzStrIDShard* shards = nullptr; // num_shards shards, allocated from the allocator
 
-	SfzStrIDs(u32 initial_capacity, SfzAllocator* allocator)
+	SfzStrIDs() noexcept = default;
+	SfzStrIDs(const SfzStrIDs&) = delete;
+	SfzStrIDs& operator= (const SfzStrIDs&) = delete;
+	~SfzStrIDs() noexcept { this->destroy(); }
+
+	SfzStrIDs(u32 initial_capacity, SfzAllocator* allocator, u32 num_shards = 1) noexcept
 	{
-		this->allocator = allocator;
-		this->strs.init(initial_capacity, allocator, sfz_dbg(""));
+		this->init(initial_capacity, allocator, num_shards);
 	}
 
-	SfzStrIDs(const SfzStrIDs&) = delete;
-	SfzStrIDs& operator= (const SfzStrIDs&) = delete;
+	void init(u32 initial_capacity, SfzAllocator* allocator, u32 num_shards = 1)
+	{
+		this->destroy();
+		sfz_assert_hard(num_shards > 0);
+		this->allocator = allocator;
+		this->num_shards = num_shards;
+		shards = static_cast<SfzStrIDShard*>(allocator->alloc(
+			sfz_dbg("SfzStrIDShard"), sizeof(SfzStrIDShard) * num_shards, alignof(SfzStrIDShard)));
+		const u32 capacity_per_shard = initial_capacity / num_shards;
+		u32 num_slot_bits = 6;
+		while ((1u << num_slot_bits) < capacity_per_shard * 2) num_slot_bits += 1;
+		for (u32 i = 0; i < num_shards; i++) {
+			new (shards + i) SfzStrIDShard();
+			shards[i].table.store(allocTable(num_slot_bits), std::memory_order_release);
+		}
+	}
 
-	~SfzStrIDs()
+	void destroy()
 	{
-		for (auto pair : strs) {
-			char* str = pair.value;
-			allocator->dealloc(str);
+		for (u32 i = 0; i < num_shards; i++) {
+			SfzStrIDShard& shard = shards[i];
+			SfzStrIDTable* table = shard.table.load(std::memory_order_acquire);
+			while (table != nullptr) {
+				SfzStrIDTable* prev = table->prev_retired;
+				allocator->dealloc(table);
+				table = prev;
+			}
+			SfzStrIDPage* page = shard.pages;
+			while (page != nullptr) {
+				SfzStrIDPage* next = page->next;
+				allocator->dealloc(page);
+				page = next;
+			}
+			shard.~SfzStrIDShard();
 		}
-		strs.destroy();
+		if (shards != nullptr) allocator->dealloc(shards);
+		shards = nullptr;
+		num_shards = 0;
 		allocator = nullptr;
 	}
+
+	SfzStrIDShard& shardFor(SfzStrID id) { return shards[id.id % num_shards]; }
+	const SfzStrIDShard& shardFor(SfzStrID id) const { return shards[id.id % num_shards]; }
+
+	// Lock-free, can be called concurrently with registration.
+	const SfzStrIDEntry* find(SfzStrID id) const
+	{
+		if (shards == nullptr) return nullptr;
+		const SfzStrIDTable* table = shardFor(id).table.load(std::memory_order_acquire);
+		const std::atomic<const SfzStrIDEntry*>* slots = table->slots();
+		const u32 mask = table->slotMask();
+		for (u32 slot_idx = table->homeSlot(id.id); true; slot_idx = (slot_idx + 1) & mask) {
+			const SfzStrIDEntry* entry = slots[slot_idx].load(std::memory_order_acquire);
+			if (entry == nullptr) return nullptr;
+			if (entry->id == id.id) return entry;
+		}
+	}
+
+	SfzStrIDTable* allocTable(u32 num_slot_bits)
+	{
+		const u64 num_slots = u64(1) << num_slot_bits;
+		const u64 size = sizeof(SfzStrIDTable) + sizeof(std::atomic<const SfzStrIDEntry*>) * num_slots;
+		SfzStrIDTable* table = static_cast<SfzStrIDTable*>(allocator->alloc(sfz_dbg("SfzStrIDTable"), size, 64));
+		memset(table, 0, size);
+		table->num_slot_bits = num_slot_bits;
+		return table;
+	}
+
+	static void insertIntoTable(SfzStrIDTable* table, const SfzStrIDEntry* entry)
+	{
+		std::atomic<const SfzStrIDEntry*>* slots = table->slots();
+		const u32 mask = table->slotMask();
+		u32 slot_idx = table->homeSlot(entry->id);
+		while (slots[slot_idx].load(std::memory_order_relaxed) != nullptr) slot_idx = (slot_idx + 1) & mask;
+		slots[slot_idx].store(entry, std::memory_order_release);
+		table->size += 1;
+	}
+
+	// Copies the string into the shard's arena. Only called by the writer of the shard.
+	SfzStrIDEntry* allocEntry(SfzStrIDShard& shard, SfzStrID id, const char* str, u32 len)
+	{
+		const u32 entry_size = sfzRoundUpAlignedU32(sizeof(SfzStrIDEntry) + len + 1, alignof(SfzStrIDEntry));
+		SfzStrIDPage* page = shard.pages;
+		if (page == nullptr || (page->size - page->used) < entry_size) {
+			const u32 page_size = u32_max(SFZ_STR_IDS_PAGE_SIZE, sizeof(SfzStrIDPage) + entry_size);
+			SfzStrIDPage* new_page = static_cast<SfzStrIDPage*>(
+				allocator->alloc(sfz_dbg("SfzStrIDPage"), page_size, alignof(SfzStrIDPage)));
+			new_page->size = page_size - u32(sizeof(SfzStrIDPage));
+			new_page->used = 0;
+			new_page->next = shard.pages;
+			shard.pages = new_page;
+			page = new_page;
+		}
+		SfzStrIDEntry* entry = reinterpret_cast<SfzStrIDEntry*>(page->data() + page->used);
+		page->used += entry_size;
+		entry->id = id.id;
+		entry->len = len;
+		entry->padding = 0;
+		char* dst = reinterpret_cast<char*>(entry + 1);
+		memcpy(dst, str, len);
+		dst[len] = '\0';
+		return entry;
+	}
+
+	// Only called by the writer of the shard.
+	const SfzStrIDEntry* insert(SfzStrIDShard& shard, SfzStrID id, const char* str, u32 len)
+	{
+		// Grow table if necessary, the old table is retired but kept alive for concurrent readers
+		SfzStrIDTable* table = shard.table.load(std::memory_order_relaxed);
+		if ((table->size + 1) * 2 > (1u << table->num_slot_bits)) {
+			SfzStrIDTable* new_table = allocTable(table->num_slot_bits + 1);
+			const std::atomic<const SfzStrIDEntry*>* old_slots = table->slots();
+			for (u32 i = 0, n = 1u << table->num_slot_bits; i < n; i++) {
+				const SfzStrIDEntry* entry = old_slots[i].load(std::memory_order_relaxed);
+				if (entry != nullptr) insertIntoTable(new_table, entry);
+			}
+			new_table->prev_retired = table;
+			shard.table.store(new_table, std::memory_order_release);
+			table = new_table;
+		}
+
+		const SfzStrIDEntry* entry = allocEntry(shard, id, str, len);
+		insertIntoTable(table, entry);
+		return entry;
+	}
 };
 
+// Hint to the CPU that we are in a spin-wait loop.
+sfz_forceinline void sfzStrIDPause()
+{
+#if defined(_M_X64) || defined(_M_AMD64)
+	_mm_pause();
+#elif defined(_M_ARM64)
+	__yield();
+#endif
+}
+
 sfz_extern_c SfzStrID sfzStrIDCreateRegister(SfzStrIDs* ids, const char* str)
 {
-	sfz_assert(ids != nullptr);
+	sfz_assert(ids != nullptr && ids->shards != nullptr);
 	SfzStrID id = SFZ_NULL_STR_ID;
 	id.id = sfzHash(str);
 	sfz_assert_hard(id != SFZ_NULL_STR_ID);
-	
-	// Add string to storage and check for collisions
-	char** stored_str = ids->strs.get(id);
-	if (stored_str == nullptr) {
-		u32 str_len = u32(strlen(str));
-		char* new_str = reinterpret_cast<char*>(ids->allocator->alloc(sfz_dbg(""), str_len + 1));
-		memcpy(new_str, str, str_len);
-		new_str[str_len] = '\0';
-		stored_str = &ids->strs.put(id, new_str);
+	const u32 str_len = u32(strlen(str));
+
+	// Fast path, lock-free check if string is already registered
+	const SfzStrIDEntry* entry = ids->find(id);
+	if (entry == nullptr) {
+		SfzStrIDShard& shard = ids->shardFor(id);
+		const bool concurrent = ids->num_shards > 1;
+		if (concurrent) {
+			// Spin with exponential backoff, registration of new strings is rare and short
+			u32 num_pauses = 1;
+			while (shard.lock.exchange(1, std::memory_order_acquire) != 0) {
+				while (shard.lock.load(std::memory_order_relaxed) != 0) {
+					for (u32 i = 0; i < num_pauses; i++) sfzStrIDPause();
+					num_pauses = u32_min(num_pauses * 2, 64);
+				}
+			}
+		}
+
+		// Another thread might have registered the string while we were waiting for the lock
+		entry = ids->find(id);
+		if (entry == nullptr) entry = ids->insert(shard, id, str, str_len);
+
+		if (concurrent) shard.lock.store(0, std::memory_order_release);
 	}
-	sfz_assert_hard(strcmp(str, *stored_str) == 0);
+
+	// Check for collisions
+	sfz_assert_hard(entry->len == str_len && memcmp(str, entry->str(), str_len) == 0);
 
 	return id;
 }
@@ -132,9 +330,17 @@ sfz_extern_c SfzStrID sfzStrIDCreateRegister(SfzStrIDs* ids, const char* str)
 sfz_extern_c const char* sfzStrIDGetStr(const SfzStrIDs* ids, SfzStrID id)
 {
 	sfz_assert(ids != nullptr);
-	const char* const* strPtr = ids->strs.get(id);
-	if (strPtr == nullptr) return "<unknown>";
-	return *strPtr;
+	const SfzStrIDEntry* entry = ids->find(id);
+	if (entry == nullptr) return "<unknown>";
+	return entry->str();
+}
+
+sfz_extern_c u32 sfzStrIDGetStrLen(const SfzStrIDs* ids, SfzStrID id)
+{
+	sfz_assert(ids != nullptr);
+	const SfzStrIDEntry* entry = ids->find(id);
+	if (entry == nullptr) return 0;
+	return entry->len;
 }
 
 #endif
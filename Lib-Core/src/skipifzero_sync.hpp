@@ -0,0 +1,665 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#ifndef SKIPIFZERO_SYNC_HPP
+#define SKIPIFZERO_SYNC_HPP
+#pragma once
+
+#include <atomic>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(_M_ARM64)
+#include <intrin.h> // _mm_pause(), __yield()
+#endif
+
+#include "sfz.h"
+#include "sfz_cpp.hpp"
+
+// Platform specific nonsense
+// ------------------------------------------------------------------------------------------------
+
+#if defined(_MSC_VER)
+
+#include "sfz_time.h"
+
+// Forward declare WaitOnAddress(), WakeByAddressSingle() and WakeByAddressAll() from windows.h
+#pragma comment(lib, "Synchronization.lib")
+sfz_extern_c __declspec(dllimport) i32 __stdcall WaitOnAddress(
+	volatile void* address, void* compare_address, u64 address_size, unsigned long milliseconds);
+sfz_extern_c __declspec(dllimport) void __stdcall WakeByAddressSingle(void* address);
+sfz_extern_c __declspec(dllimport) void __stdcall WakeByAddressAll(void* address);
+
+// Forward declare CreateThread(), WaitForSingleObject() and CloseHandle() from windows.h
+struct _SECURITY_ATTRIBUTES;
+sfz_extern_c __declspec(dllimport) void* __stdcall CreateThread(
+	_SECURITY_ATTRIBUTES* thread_attributes,
+	u64 stack_size,
+	unsigned long (__stdcall* start_address)(void*),
+	void* parameter,
+	unsigned long creation_flags,
+	unsigned long* thread_id);
+sfz_extern_c __declspec(dllimport) unsigned long __stdcall WaitForSingleObject(
+	void* handle, unsigned long milliseconds);
+sfz_extern_c __declspec(dllimport) i32 __stdcall CloseHandle(void* handle);
+
+#else
+#error "Not implemented for this compiler"
+#endif
+
+// Sync helpers
+// ------------------------------------------------------------------------------------------------
+
+constexpr u32 SFZ_SYNC_CACHE_LINE_SIZE = 64;
+
+// Hint to the CPU that we are in a spin-wait loop.
+sfz_forceinline void sfzSyncPause()
+{
+#if defined(_M_X64) || defined(_M_AMD64)
+	_mm_pause();
+#elif defined(_M_ARM64)
+	__yield();
+#endif
+}
+
+// Blocks the calling thread while *addr == expected. May return spuriously, callers must recheck
+// the value in a loop.
+inline void sfzSyncWait(std::atomic<u32>* addr, u32 expected)
+{
+	WaitOnAddress(addr, &expected, sizeof(u32), 0xFFFFFFFF);
+}
+
+// Same as sfzSyncWait(), but gives up after roughly timeout_ms milliseconds.
+inline void sfzSyncWaitTimeout(std::atomic<u32>* addr, u32 expected, u32 timeout_ms)
+{
+	WaitOnAddress(addr, &expected, sizeof(u32), timeout_ms);
+}
+
+// Wakes up one or all threads blocked in sfzSyncWait() on addr.
+inline void sfzSyncWakeOne(std::atomic<u32>* addr)
+{
+	WakeByAddressSingle(addr);
+}
+inline void sfzSyncWakeAll(std::atomic<u32>* addr)
+{
+	WakeByAddressAll(addr);
+}
+
+// Monotonic timestamp in nanoseconds, used for lock statistics.
+inline u64 sfzSyncTimestampNs()
+{
+	static const f64 ns_per_tick = 1000000000.0 / f64(sfzQueryPerfFreq());
+	return u64(f64(sfzQueryPerfCounter()) * ns_per_tick);
+}
+
+// SfzThread
+// ------------------------------------------------------------------------------------------------
+
+typedef void SfzThreadFunc(void* userdata);
+
+// A minimal wrapper around an OS thread. Not movable, as the running thread has a pointer to it.
+// The destructor joins the thread if it is still running.
+class SfzThread final {
+public:
+	SfzThread() noexcept = default;
+	SfzThread(const SfzThread&) = delete;
+	SfzThread& operator= (const SfzThread&) = delete;
+	SfzThread(SfzThread&&) = delete;
+	SfzThread& operator= (SfzThread&&) = delete;
+	~SfzThread() noexcept { this->join(); }
+
+	// Whether the thread has been started and not yet joined.
+	bool isStarted() const { return m_started; }
+
+	void start(SfzThreadFunc* func, void* userdata)
+	{
+		sfz_assert(func != nullptr);
+		sfz_assert(!m_started);
+		m_func = func;
+		m_userdata = userdata;
+		m_handle = CreateThread(nullptr, 0, threadMainWin32, this, 0, nullptr);
+		sfz_assert_hard(m_handle != nullptr);
+		m_started = true;
+	}
+
+	// Blocks until the thread has returned from its function. No-op if not started.
+	void join()
+	{
+		if (!m_started) return;
+		WaitForSingleObject(m_handle, 0xFFFFFFFF);
+		CloseHandle(m_handle);
+		m_handle = nullptr;
+		m_started = false;
+	}
+
+private:
+	static unsigned long __stdcall threadMainWin32(void* thread)
+	{
+		SfzThread* t = static_cast<SfzThread*>(thread);
+		t->m_func(t->m_userdata);
+		return 0;
+	}
+
+	SfzThreadFunc* m_func = nullptr;
+	void* m_userdata = nullptr;
+	bool m_started = false;
+	void* m_handle = nullptr;
+};
+
+// SfzTripleBuffer
+// ------------------------------------------------------------------------------------------------
+
+// A lock-free triple buffer, used to hand off the latest value from one producer thread to one
+// consumer thread running at a different rate. E.g. publishing simulation state each (360hz) tick
+// to a render thread running at the display's refresh rate.
+//
+// Neither side ever blocks or waits for the other. The writer always has a buffer to write to, and
+// the reader always has a complete buffer to read from. Of the three buffers one is owned by the
+// writer, one by the reader and one is the "middle" buffer that is exchanged between them. When the
+// writer publishes it swaps its buffer with the middle buffer, when the reader updates it swaps its
+// buffer with the middle buffer if it has been published since the last update. Values that are
+// published faster than they are read are simply overwritten, the reader always gets the latest.
+//
+// Only one thread may call the writer methods (writeBuffer(), publish(), write()) and only one
+// thread may call the reader methods (update(), readBuffer(), read()).
+template<typename T>
+class SfzTripleBuffer final {
+public:
+	SfzTripleBuffer() noexcept = default;
+	SfzTripleBuffer(const SfzTripleBuffer&) = delete;
+	SfzTripleBuffer& operator= (const SfzTripleBuffer&) = delete;
+	SfzTripleBuffer(SfzTripleBuffer&&) = delete;
+	SfzTripleBuffer& operator= (SfzTripleBuffer&&) = delete;
+
+	// Sets all three buffers to the initial value. Not thread-safe, call before the writer and
+	// reader threads start using the buffer.
+	explicit SfzTripleBuffer(const T& initial) noexcept { this->reset(initial); }
+	void reset(const T& initial)
+	{
+		for (u32 i = 0; i < 3; i++) m_buffers[i].value = initial;
+		m_write_idx = 0;
+		m_middle.store(1, std::memory_order_relaxed);
+		m_read_idx = 2;
+	}
+
+	// Writer methods
+	// --------------------------------------------------------------------------------------------
+
+	// The buffer owned by the writer. Contains an arbitrary older value, not necessarily the last
+	// published one, so it should be completely overwritten before publishing.
+	T& writeBuffer() { return m_buffers[m_write_idx].value; }
+
+	// Publishes the write buffer to the reader, the writer gets a new buffer to write to.
+	void publish()
+	{
+		const u32 prev_middle = m_middle.exchange(m_write_idx | DIRTY_BIT, std::memory_order_acq_rel);
+		m_write_idx = prev_middle & IDX_MASK;
+	}
+
+	// Copies the value into the write buffer and publishes it.
+	void write(const T& value) { this->writeBuffer() = value; this->publish(); }
+
+	// Reader methods
+	// --------------------------------------------------------------------------------------------
+
+	// Fetches the latest published value (if any) into the read buffer. Returns whether a new
+	// value has been published since the last update.
+	bool update()
+	{
+		if ((m_middle.load(std::memory_order_relaxed) & DIRTY_BIT) == 0) return false;
+		const u32 prev_middle = m_middle.exchange(m_read_idx, std::memory_order_acq_rel);
+		m_read_idx = prev_middle & IDX_MASK;
+		return true;
+	}
+
+	// The buffer owned by the reader, contains the value fetched by the last update().
+	const T& readBuffer() const { return m_buffers[m_read_idx].value; }
+
+	// Updates and returns the latest value.
+	const T& read() { this->update(); return this->readBuffer(); }
+
+private:
+	// Private members
+	// --------------------------------------------------------------------------------------------
+
+	static constexpr u32 IDX_MASK = 0x3;
+	static constexpr u32 DIRTY_BIT = 0x4;
+
+	// Each buffer on its own cache line(s) to avoid false sharing between writer and reader
+	struct alignas(SFZ_SYNC_CACHE_LINE_SIZE) Buffer final { T value = {}; };
+
+	Buffer m_buffers[3];
+	alignas(SFZ_SYNC_CACHE_LINE_SIZE) u32 m_write_idx = 0; // Writer only
+	alignas(SFZ_SYNC_CACHE_LINE_SIZE) std::atomic<u32> m_middle = 1;
+	alignas(SFZ_SYNC_CACHE_LINE_SIZE) u32 m_read_idx = 2; // Reader only
+};
+
+// SfzSeqLock
+// ------------------------------------------------------------------------------------------------
+
+// A sequence lock, for publishing small trivially copyable snapshots (e.g. a camera transform or
+// a handful of counters) from one writer thread to any number of reader threads.
+//
+// The writer never blocks, it increments the sequence number to an odd value, writes the data and
+// then increments the sequence number to an even value again. Readers copy the data and retry if
+// the sequence number was odd or changed during the copy. So readers can spin if the writer
+// writes very frequently, which is why this is only suitable for small values. Use SfzTripleBuffer
+// for larger state.
+//
+// The data is stored as atomic words so that the racy copy in the reader is well-defined. The words
+// are stored with release and loaded with acquire semantics, which orders them with respect to the
+// sequence number without separate fences (free on x86). Only one thread may call store() at a
+// time.
+template<typename T>
+class SfzSeqLock final {
+public:
+	static_assert(__is_trivially_copyable(T), "SfzSeqLock requires a trivially copyable type");
+	static constexpr u32 NUM_WORDS = (sizeof(T) + 7) / 8;
+
+	SfzSeqLock() noexcept { this->storeWords(T{}, std::memory_order_relaxed); }
+	explicit SfzSeqLock(const T& initial) noexcept { this->storeWords(initial, std::memory_order_relaxed); }
+	SfzSeqLock(const SfzSeqLock&) = delete;
+	SfzSeqLock& operator= (const SfzSeqLock&) = delete;
+	SfzSeqLock(SfzSeqLock&&) = delete;
+	SfzSeqLock& operator= (SfzSeqLock&&) = delete;
+
+	// Getters
+	// --------------------------------------------------------------------------------------------
+
+	// The number of stores that has been made (if no store is in progress).
+	u32 version() const { return m_seq.load(std::memory_order_acquire) / 2; }
+
+	// Methods
+	// --------------------------------------------------------------------------------------------
+
+	// Writes a new value, never blocks. Only one thread may store at a time.
+	void store(const T& value)
+	{
+		const u32 seq = m_seq.load(std::memory_order_relaxed);
+		sfz_assert((seq & 1) == 0);
+		m_seq.store(seq + 1, std::memory_order_relaxed);
+		this->storeWords(value, std::memory_order_release); // Ordered after the odd sequence number
+		m_seq.store(seq + 2, std::memory_order_release);
+	}
+
+	// Reads the latest value, spins while a store is in progress.
+	T load() const
+	{
+		T value;
+		while (!this->tryLoad(&value)) sfzSyncPause();
+		return value;
+	}
+
+	// Attempts to read the latest value once, returns false (and leaves out untouched) if a store
+	// was in progress.
+	bool tryLoad(T* out) const
+	{
+		const u32 seq_before = m_seq.load(std::memory_order_acquire);
+		if ((seq_before & 1) != 0) return false;
+		u64 words[NUM_WORDS];
+		for (u32 i = 0; i < NUM_WORDS; i++) words[i] = m_words[i].load(std::memory_order_acquire);
+		const u32 seq_after = m_seq.load(std::memory_order_relaxed);
+		if (seq_before != seq_after) return false;
+		memcpy(out, words, sizeof(T));
+		return true;
+	}
+
+private:
+	// Private methods
+	// --------------------------------------------------------------------------------------------
+
+	void storeWords(const T& value, std::memory_order order)
+	{
+		u64 words[NUM_WORDS] = {};
+		memcpy(words, &value, sizeof(T));
+		for (u32 i = 0; i < NUM_WORDS; i++) m_words[i].store(words[i], order);
+	}
+
+	// Private members
+	// --------------------------------------------------------------------------------------------
+
+	alignas(SFZ_SYNC_CACHE_LINE_SIZE) std::atomic<u32> m_seq = 0;
+	std::atomic<u64> m_words[NUM_WORDS];
+};
+
+// Lock statistics
+// ------------------------------------------------------------------------------------------------
+
+// Contention statistics of a lock, only recorded by the "WithStats" lock variants.
+struct SfzLockStats final {
+	u64 num_acquires = 0; // Total number of times the lock was acquired (shared or exclusive)
+	u64 num_contended = 0; // Acquires that could not take the lock immediately
+	u64 num_parks = 0; // Number of times a thread was put to sleep waiting for the lock
+	u64 wait_time_ns = 0; // Total time spent in contended acquires
+};
+
+template<bool RecordStats>
+struct SfzLockStatsCounters {
+	void recordAcquire() {}
+	u64 beginContended() { return 0; }
+	void recordPark() {}
+	void endContended(u64) {}
+};
+
+template<>
+struct SfzLockStatsCounters<true> {
+	void recordAcquire() { m_num_acquires.fetch_add(1, std::memory_order_relaxed); }
+	u64 beginContended() { m_num_contended.fetch_add(1, std::memory_order_relaxed); return sfzSyncTimestampNs(); }
+	void recordPark() { m_num_parks.fetch_add(1, std::memory_order_relaxed); }
+	void endContended(u64 begin_ns) { m_wait_time_ns.fetch_add(sfzSyncTimestampNs() - begin_ns, std::memory_order_relaxed); }
+
+	SfzLockStats stats() const
+	{
+		SfzLockStats stats;
+		stats.num_acquires = m_num_acquires.load(std::memory_order_relaxed);
+		stats.num_contended = m_num_contended.load(std::memory_order_relaxed);
+		stats.num_parks = m_num_parks.load(std::memory_order_relaxed);
+		stats.wait_time_ns = m_wait_time_ns.load(std::memory_order_relaxed);
+		return stats;
+	}
+
+	void resetStats()
+	{
+		m_num_acquires.store(0, std::memory_order_relaxed);
+		m_num_contended.store(0, std::memory_order_relaxed);
+		m_num_parks.store(0, std::memory_order_relaxed);
+		m_wait_time_ns.store(0, std::memory_order_relaxed);
+	}
+
+	std::atomic<u64> m_num_acquires = 0;
+	std::atomic<u64> m_num_contended = 0;
+	std::atomic<u64> m_num_parks = 0;
+	std::atomic<u64> m_wait_time_ns = 0;
+};
+
+// Spins for a while with exponential backoff (1, 2, 4, ... pauses) before a lock gives up and
+// parks the thread. Bounded to a few microseconds in total, roughly the cost of a context switch.
+constexpr u32 SFZ_SYNC_SPIN_NUM_ROUNDS = 7;
+
+// SfzMutex
+// ------------------------------------------------------------------------------------------------
+
+// A mutex that spins with bounded backoff and then parks the thread using WaitOnAddress() (futex
+// on Linux). Not recursive.
+//
+// The lock is a single u32 with 3 states: unlocked (0), locked (1) and locked with (possibly)
+// sleeping waiters (2). Locking and unlocking an uncontended mutex is a single atomic operation
+// each, unlocking only makes a syscall if there might be sleeping waiters.
+//
+// SfzMutexWithStats additionally records contention statistics, see SfzLockStats.
+template<bool RecordStats>
+class SfzMutexT final : private SfzLockStatsCounters<RecordStats> {
+public:
+	SfzMutexT() noexcept = default;
+	SfzMutexT(const SfzMutexT&) = delete;
+	SfzMutexT& operator= (const SfzMutexT&) = delete;
+	SfzMutexT(SfzMutexT&&) = delete;
+	SfzMutexT& operator= (SfzMutexT&&) = delete;
+	~SfzMutexT() noexcept { sfz_assert(m_state.load(std::memory_order_relaxed) == UNLOCKED); }
+
+	// Methods
+	// --------------------------------------------------------------------------------------------
+
+	void lock()
+	{
+		u32 expected = UNLOCKED;
+		if (!m_state.compare_exchange_strong(expected, LOCKED, std::memory_order_acquire)) this->lockSlow();
+		this->recordAcquire();
+	}
+
+	bool tryLock()
+	{
+		u32 expected = UNLOCKED;
+		const bool success = m_state.compare_exchange_strong(expected, LOCKED, std::memory_order_acquire);
+		if (success) this->recordAcquire();
+		return success;
+	}
+
+	void unlock()
+	{
+		const u32 prev_state = m_state.exchange(UNLOCKED, std::memory_order_release);
+		sfz_assert(prev_state != UNLOCKED);
+		if (prev_state == LOCKED_WAITERS) sfzSyncWakeOne(&m_state);
+	}
+
+	// Statistics, only available for SfzMutexWithStats.
+	SfzLockStats stats() const { return SfzLockStatsCounters<RecordStats>::stats(); }
+	void resetStats() { SfzLockStatsCounters<RecordStats>::resetStats(); }
+
+private:
+	// Private methods
+	// --------------------------------------------------------------------------------------------
+
+	void lockSlow()
+	{
+		const u64 begin_ns = this->beginContended();
+
+		// Spin with backoff, only attempt to take the lock if it looks unlocked
+		for (u32 round = 0; round < SFZ_SYNC_SPIN_NUM_ROUNDS; round++) {
+			for (u32 i = 0; i < (1u << round); i++) sfzSyncPause();
+			u32 expected = UNLOCKED;
+			if (m_state.load(std::memory_order_relaxed) == UNLOCKED &&
+				m_state.compare_exchange_weak(expected, LOCKED, std::memory_order_acquire)) {
+				this->endContended(begin_ns);
+				return;
+			}
+		}
+
+		// Mark the lock as having waiters and park until we get it. Once we have marked it we must
+		// keep taking it in the "with waiters" state, as we can't know if there are other waiters.
+		while (m_state.exchange(LOCKED_WAITERS, std::memory_order_acquire) != UNLOCKED) {
+			this->recordPark();
+			sfzSyncWait(&m_state, LOCKED_WAITERS);
+		}
+		this->endContended(begin_ns);
+	}
+
+	// Private members
+	// --------------------------------------------------------------------------------------------
+
+	static constexpr u32 UNLOCKED = 0;
+	static constexpr u32 LOCKED = 1;
+	static constexpr u32 LOCKED_WAITERS = 2;
+
+	std::atomic<u32> m_state = UNLOCKED;
+};
+
+using SfzMutex = SfzMutexT<false>;
+using SfzMutexWithStats = SfzMutexT<true>;
+static_assert(sizeof(SfzMutex) == sizeof(u32), "");
+
+// SfzRWLock
+// ------------------------------------------------------------------------------------------------
+
+// A reader-writer lock, multiple readers (shared) or a single writer (exclusive). Spins with
+// bounded backoff and then parks the thread, same as SfzMutex. Not recursive, a reader can't
+// upgrade to a writer.
+//
+// The lock is a single u32: bits [0, 30) is the number of readers, bit 30 is set while a writer
+// holds the lock and bit 31 is set if there are (possibly) sleeping waiters. Whoever clears the
+// waiters bit must wake up all sleeping threads, which then race for the lock again. New readers
+// don't take the lock while there are waiters, so a steady stream of readers can't starve a
+// waiting writer.
+//
+// SfzRWLockWithStats additionally records contention statistics, see SfzLockStats.
+template<bool RecordStats>
+class SfzRWLockT final : private SfzLockStatsCounters<RecordStats> {
+public:
+	SfzRWLockT() noexcept = default;
+	SfzRWLockT(const SfzRWLockT&) = delete;
+	SfzRWLockT& operator= (const SfzRWLockT&) = delete;
+	SfzRWLockT(SfzRWLockT&&) = delete;
+	SfzRWLockT& operator= (SfzRWLockT&&) = delete;
+	~SfzRWLockT() noexcept { sfz_assert((m_state.load(std::memory_order_relaxed) & ~WAITERS) == 0); }
+
+	// Exclusive (writer) methods
+	// --------------------------------------------------------------------------------------------
+
+	void lock()
+	{
+		u32 expected = 0;
+		if (!m_state.compare_exchange_strong(expected, WRITER, std::memory_order_acquire)) this->lockSlow();
+		this->recordAcquire();
+	}
+
+	bool tryLock()
+	{
+		u32 state = m_state.load(std::memory_order_relaxed);
+		while ((state & (WRITER | READERS_MASK)) == 0) {
+			if (m_state.compare_exchange_weak(state, state | WRITER, std::memory_order_acquire)) {
+				this->recordAcquire();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void unlock()
+	{
+		const u32 prev_state = m_state.fetch_and(~(WRITER | WAITERS), std::memory_order_release);
+		sfz_assert((prev_state & WRITER) != 0);
+		if ((prev_state & WAITERS) != 0) sfzSyncWakeAll(&m_state);
+	}
+
+	// Shared (reader) methods
+	// --------------------------------------------------------------------------------------------
+
+	void lockShared()
+	{
+		if (!this->tryLockSharedImpl()) this->lockSharedSlow();
+		this->recordAcquire();
+	}
+
+	bool tryLockShared()
+	{
+		const bool success = this->tryLockSharedImpl();
+		if (success) this->recordAcquire();
+		return success;
+	}
+
+	void unlockShared()
+	{
+		const u32 prev_state = m_state.fetch_sub(1, std::memory_order_release);
+		sfz_assert((prev_state & READERS_MASK) != 0);
+
+		// Last reader out wakes up the waiters (if any)
+		if ((prev_state & READERS_MASK) == 1 && (prev_state & WAITERS) != 0) {
+			const u32 state = m_state.fetch_and(~WAITERS, std::memory_order_relaxed);
+			if ((state & WAITERS) != 0) sfzSyncWakeAll(&m_state);
+		}
+	}
+
+	// Statistics, only available for SfzRWLockWithStats.
+	SfzLockStats stats() const { return SfzLockStatsCounters<RecordStats>::stats(); }
+	void resetStats() { SfzLockStatsCounters<RecordStats>::resetStats(); }
+
+private:
+	// Private methods
+	// --------------------------------------------------------------------------------------------
+
+	bool tryLockSharedImpl()
+	{
+		u32 state = m_state.load(std::memory_order_relaxed);
+		while ((state & (WRITER | WAITERS)) == 0) {
+			sfz_assert((state & READERS_MASK) != READERS_MASK);
+			if (m_state.compare_exchange_weak(state, state + 1, std::memory_order_acquire)) return true;
+		}
+		return false;
+	}
+
+	// Shared implementation of the slow paths, BlockedMask are the bits that prevent taking the lock
+	// and Add is what is added to the state when the lock is taken.
+	template<u32 BlockedMask, u32 Add>
+	void lockSlowImpl()
+	{
+		const u64 begin_ns = this->beginContended();
+
+		// Spin with backoff
+		for (u32 round = 0; round < SFZ_SYNC_SPIN_NUM_ROUNDS; round++) {
+			for (u32 i = 0; i < (1u << round); i++) sfzSyncPause();
+			u32 state = m_state.load(std::memory_order_relaxed);
+			if ((state & BlockedMask) == 0 &&
+				m_state.compare_exchange_weak(state, state + Add, std::memory_order_acquire)) {
+				this->endContended(begin_ns);
+				return;
+			}
+		}
+
+		// Set the waiters bit and park
+		u32 state = m_state.load(std::memory_order_relaxed);
+		while (true) {
+			if ((state & BlockedMask) == 0) {
+				if (m_state.compare_exchange_weak(state, state + Add, std::memory_order_acquire)) break;
+				continue;
+			}
+			if ((state & WAITERS) == 0) {
+				if (!m_state.compare_exchange_weak(state, state | WAITERS, std::memory_order_relaxed)) continue;
+				state |= WAITERS;
+			}
+			this->recordPark();
+			sfzSyncWait(&m_state, state);
+			state = m_state.load(std::memory_order_relaxed);
+		}
+		this->endContended(begin_ns);
+	}
+
+	// A writer waits for the writer and all readers to leave, waiting readers don't block it.
+	void lockSlow() { this->lockSlowImpl<WRITER | READERS_MASK, WRITER>(); }
+
+	// A reader waits for the writer to leave, and doesn't barge past other waiters.
+	void lockSharedSlow() { this->lockSlowImpl<WRITER | WAITERS, 1>(); }
+
+	// Private members
+	// --------------------------------------------------------------------------------------------
+
+	static constexpr u32 READERS_MASK = (1u << 30) - 1u;
+	static constexpr u32 WRITER = 1u << 30;
+	static constexpr u32 WAITERS = 1u << 31;
+
+	std::atomic<u32> m_state = 0;
+};
+
+using SfzRWLock = SfzRWLockT<false>;
+using SfzRWLockWithStats = SfzRWLockT<true>;
+static_assert(sizeof(SfzRWLock) == sizeof(u32), "");
+
+// Lock guards
+// ------------------------------------------------------------------------------------------------
+
+// Scoped lock guards, locks in constructor and unlocks in destructor.
+template<typename LockT>
+class SfzLockGuard final {
+public:
+	explicit SfzLockGuard(LockT& lock) noexcept : m_lock(lock) { m_lock.lock(); }
+	~SfzLockGuard() noexcept { m_lock.unlock(); }
+	SfzLockGuard(const SfzLockGuard&) = delete;
+	SfzLockGuard& operator= (const SfzLockGuard&) = delete;
+private:
+	LockT& m_lock;
+};
+
+template<typename LockT>
+class SfzSharedLockGuard final {
+public:
+	explicit SfzSharedLockGuard(LockT& lock) noexcept : m_lock(lock) { m_lock.lockShared(); }
+	~SfzSharedLockGuard() noexcept { m_lock.unlockShared(); }
+	SfzSharedLockGuard(const SfzSharedLockGuard&) = delete;
+	SfzSharedLockGuard& operator= (const SfzSharedLockGuard&) = delete;
+private:
+	LockT& m_lock;
+};
+
+#endif
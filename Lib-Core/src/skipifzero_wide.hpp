@@ -0,0 +1,691 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#ifndef SKIPIFZERO_WIDE_HPP
+#define SKIPIFZERO_WIDE_HPP
+#pragma once
+
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_AMD64)
+#include <intrin.h>
+#define SFZ_WIDE_SSE
+#if defined(__AVX2__)
+#define SFZ_WIDE_AVX2
+#endif
+#elif defined(_M_ARM64)
+#include <intrin.h>
+#include <arm_neon.h>
+#define SFZ_WIDE_NEON
+#endif
+
+#include "sfz.h"
+#include "sfz_cpp.hpp"
+#include "skipifzero_arrays.hpp"
+
+// Wide (SoA) types
+// ------------------------------------------------------------------------------------------------
+
+// Unlike f32x4, which is a single 4-component vector, f32x4w and f32x8w are registers of 4 and 8
+// independent scalars. Use them for data-parallel math over many entities, typically in SoA form,
+// see f32x3_soa8 below.
+//
+// f32x4w is backed by SSE on x64 and NEON on ARM64. f32x8w is backed by AVX2 if compiled with
+// /arch:AVX2 and by a pair of f32x4w otherwise. There is a scalar fallback for other platforms.
+//
+// Comparisons return masks (mask4w, mask8w), where each lane is either all ones or all zeroes.
+// min/max have the same semantics as f32_min()/f32_max(), including for NaNs. Horizontal
+// reductions are performed pairwise, so hsum() may round differently than a sequential sum.
+
+struct f32x4w final {
+#if defined(SFZ_WIDE_SSE)
+	__m128 v;
+#elif defined(SFZ_WIDE_NEON)
+	float32x4_t v;
+#else
+	f32 v[4];
+#endif
+};
+
+struct mask4w final {
+#if defined(SFZ_WIDE_SSE)
+	__m128 v;
+#elif defined(SFZ_WIDE_NEON)
+	uint32x4_t v;
+#else
+	u32 v[4];
+#endif
+};
+
+// mask4w
+// ------------------------------------------------------------------------------------------------
+
+sfz_forceinline mask4w operator& (mask4w l, mask4w r)
+{
+#if defined(SFZ_WIDE_SSE)
+	return { _mm_and_ps(l.v, r.v) };
+#elif defined(SFZ_WIDE_NEON)
+	return { vandq_u32(l.v, r.v) };
+#else
+	for (u32 i = 0; i < 4; i++) l.v[i] &= r.v[i];
+	return l;
+#endif
+}
+
+sfz_forceinline mask4w operator| (mask4w l, mask4w r)
+{
+#if defined(SFZ_WIDE_SSE)
+	return { _mm_or_ps(l.v, r.v) };
+#elif defined(SFZ_WIDE_NEON)
+	return { vorrq_u32(l.v, r.v) };
+#else
+	for (u32 i = 0; i < 4; i++) l.v[i] |= r.v[i];
+	return l;
+#endif
+}
+
+sfz_forceinline mask4w operator^ (mask4w l, mask4w r)
+{
+#if defined(SFZ_WIDE_SSE)
+	return { _mm_xor_ps(l.v, r.v) };
+#elif defined(SFZ_WIDE_NEON)
+	return { veorq_u32(l.v, r.v) };
+#else
+	for (u32 i = 0; i < 4; i++) l.v[i] ^= r.v[i];
+	return l;
+#endif
+}
+
+sfz_forceinline mask4w operator~ (mask4w m)
+{
+#if defined(SFZ_WIDE_SSE)
+	return { _mm_xor_ps(m.v, _mm_castsi128_ps(_mm_set1_epi32(-1))) };
+#elif defined(SFZ_WIDE_NEON)
+	return { vmvnq_u32(m.v) };
+#else
+	for (u32 i = 0; i < 4; i++) m.v[i] = ~m.v[i];
+	return m;
+#endif
+}
+
+// Returns one bit per lane, lane 0 in the lowest bit.
+sfz_forceinline u32 mask4w_bits(mask4w m)
+{
+#if defined(SFZ_WIDE_SSE)
+	return u32(_mm_movemask_ps(m.v));
+#elif defined(SFZ_WIDE_NEON)
+	const u32 lane_bits[4] = { 1, 2, 4, 8 };
+	return vaddvq_u32(vandq_u32(m.v, vld1q_u32(lane_bits)));
+#else
+	u32 bits = 0;
+	for (u32 i = 0; i < 4; i++) bits |= (m.v[i] & 1u) << i;
+	return bits;
+#endif
+}
+
+sfz_forceinline bool mask4w_any(mask4w m) { return mask4w_bits(m) != 0; }
+sfz_forceinline bool mask4w_all(mask4w m) { return mask4w_bits(m) == 0xF; }
+
+// f32x4w
+// ------------------------------------------------------------------------------------------------
+
+sfz_forceinline f32x4w f32x4w_splat(f32 s)
+{
+#if defined(SFZ_WIDE_SSE)
+	return { _mm_set1_ps(s) };
+#elif defined(SFZ_WIDE_NEON)
+	return { vdupq_n_f32(s) };
+#else
+	return { { s, s, s, s } };
+#endif
+}
+
+sfz_forceinline f32x4w f32x4w_zero() { return f32x4w_splat(0.0f); }
+
+// Loads 4 floats, ptr does not need to be aligned.
+sfz_forceinline f32x4w f32x4w_load(const f32* ptr)
+{
+#if defined(SFZ_WIDE_SSE)
+	return { _mm_loadu_ps(ptr) };
+#elif defined(SFZ_WIDE_NEON)
+	return { vld1q_f32(ptr) };
+#else
+	f32x4w res;
+	memcpy(res.v, ptr, sizeof(f32) * 4);
+	return res;
+#endif
+}
+
+// Stores 4 floats, ptr does not need to be aligned.
+sfz_forceinline void f32x4w_store(f32* ptr, f32x4w v)
+{
+#if defined(SFZ_WIDE_SSE)
+	_mm_storeu_ps(ptr, v.v);
+#elif defined(SFZ_WIDE_NEON)
+	vst1q_f32(ptr, v.v);
+#else
+	memcpy(ptr, v.v, sizeof(f32) * 4);
+#endif
+}
+
+// Returns a single lane, slow. Mostly intended for debugging and tests.
+inline f32 f32x4w_lane(f32x4w v, u32 idx)
+{
+	sfz_assert(idx < 4);
+	f32 tmp[4];
+	f32x4w_store(tmp, v);
+	return tmp[idx];
+}
+
+sfz_forceinline f32x4w operator+ (f32x4w l, f32x4w r)
+{
+#if defined(SFZ_WIDE_SSE)
+	return { _mm_add_ps(l.v, r.v) };
+#elif defined(SFZ_WIDE_NEON)
+	return { vaddq_f32(l.v, r.v) };
+#else
+	for (u32 i = 0; i < 4; i++) l.v[i] += r.v[i];
+	return l;
+#endif
+}
+
+sfz_forceinline f32x4w operator- (f32x4w l, f32x4w r)
+{
+#if defined(SFZ_WIDE_SSE)
+	return { _mm_sub_ps(l.v, r.v) };
+#elif defined(SFZ_WIDE_NEON)
+	return { vsubq_f32(l.v, r.v) };
+#else
+	for (u32 i = 0; i < 4; i++) l.v[i] -= r.v[i];
+	return l;
+#endif
+}
+
+sfz_forceinline f32x4w operator* (f32x4w l, f32x4w r)
+{
+#if defined(SFZ_WIDE_SSE)
+	return { _mm_mul_ps(l.v, r.v) };
+#elif defined(SFZ_WIDE_NEON)
+	return { vmulq_f32(l.v, r.v) };
+#else
+	for (u32 i = 0; i < 4; i++) l.v[i] *= r.v[i];
+	return l;
+#endif
+}
+
+sfz_forceinline f32x4w operator/ (f32x4w l, f32x4w r)
+{
+#if defined(SFZ_WIDE_SSE)
+	return { _mm_div_ps(l.v, r.v) };
+#elif defined(SFZ_WIDE_NEON)
+	return { vdivq_f32(l.v, r.v) };
+#else
+	for (u32 i = 0; i < 4; i++) l.v[i] /= r.v[i];
+	return l;
+#endif
+}
+
+sfz_forceinline f32x4w operator- (f32x4w v)
+{
+#if defined(SFZ_WIDE_SSE)
+	return { _mm_xor_ps(v.v, _mm_set1_ps(-0.0f)) };
+#elif defined(SFZ_WIDE_NEON)
+	return { vnegq_f32(v.v) };
+#else
+	for (u32 i = 0; i < 4; i++) v.v[i] = -v.v[i];
+	return v;
+#endif
+}
+
+sfz_forceinline f32x4w& operator+= (f32x4w& l, f32x4w r) { return (l = l + r); }
+sfz_forceinline f32x4w& operator-= (f32x4w& l, f32x4w r) { return (l = l - r); }
+sfz_forceinline f32x4w& operator*= (f32x4w& l, f32x4w r) { return (l = l * r); }
+sfz_forceinline f32x4w& operator/= (f32x4w& l, f32x4w r) { return (l = l / r); }
+
+// Returns a * b + c. Fused (single rounding) on AVX2 and NEON, a separate multiply and add
+// otherwise. Use regular operators if the results need to be identical on all platforms.
+sfz_forceinline f32x4w f32x4w_fma(f32x4w a, f32x4w b, f32x4w c)
+{
+#if defined(SFZ_WIDE_AVX2)
+	return { _mm_fmadd_ps(a.v, b.v, c.v) };
+#elif defined(SFZ_WIDE_SSE)
+	return { _mm_add_ps(_mm_mul_ps(a.v, b.v), c.v) };
+#elif defined(SFZ_WIDE_NEON)
+	return { vfmaq_f32(c.v, a.v, b.v) };
+#else
+	for (u32 i = 0; i < 4; i++) a.v[i] = a.v[i] * b.v[i] + c.v[i];
+	return a;
+#endif
+}
+
+sfz_forceinline f32x4w f32x4w_min(f32x4w l, f32x4w r)
+{
+#if defined(SFZ_WIDE_SSE)
+	return { _mm_min_ps(l.v, r.v) };
+#elif defined(SFZ_WIDE_NEON)
+	return { vbslq_f32(vcltq_f32(l.v, r.v), l.v, r.v) };
+#else
+	for (u32 i = 0; i < 4; i++) l.v[i] = f32_min(l.v[i], r.v[i]);
+	return l;
+#endif
+}
+
+sfz_forceinline f32x4w f32x4w_max(f32x4w l, f32x4w r)
+{
+#if defined(SFZ_WIDE_SSE)
+	return { _mm_max_ps(r.v, l.v) };
+#elif defined(SFZ_WIDE_NEON)
+	return { vbslq_f32(vcltq_f32(l.v, r.v), r.v, l.v) };
+#else
+	for (u32 i = 0; i < 4; i++) l.v[i] = f32_max(l.v[i], r.v[i]);
+	return l;
+#endif
+}
+
+sfz_forceinline f32x4w f32x4w_abs(f32x4w v)
+{
+#if defined(SFZ_WIDE_SSE)
+	return { _mm_andnot_ps(_mm_set1_ps(-0.0f), v.v) };
+#elif defined(SFZ_WIDE_NEON)
+	return { vabsq_f32(v.v) };
+#else
+	// Clear the sign bit, unlike f32_abs() this also handles -0 and NaNs
+	u32 bits[4];
+	memcpy(bits, v.v, sizeof(bits));
+	for (u32 i = 0; i < 4; i++) bits[i] &= 0x7FFFFFFFu;
+	memcpy(v.v, bits, sizeof(bits));
+	return v;
+#endif
+}
+
+sfz_forceinline f32x4w f32x4w_sqrt(f32x4w v)
+{
+#if defined(SFZ_WIDE_SSE)
+	return { _mm_sqrt_ps(v.v) };
+#elif defined(SFZ_WIDE_NEON)
+	return { vsqrtq_f32(v.v) };
+#else
+	for (u32 i = 0; i < 4; i++) v.v[i] = sfz_sqrt(v.v[i]);
+	return v;
+#endif
+}
+
+#if defined(SFZ_WIDE_SSE)
+#define SFZ_WIDE_CMP4(op, sse_func, neon_func) \
+	sfz_forceinline mask4w operator op (f32x4w l, f32x4w r) { return { sse_func(l.v, r.v) }; }
+#elif defined(SFZ_WIDE_NEON)
+#define SFZ_WIDE_CMP4(op, sse_func, neon_func) \
+	sfz_forceinline mask4w operator op (f32x4w l, f32x4w r) { return { neon_func(l.v, r.v) }; }
+#else
+#define SFZ_WIDE_CMP4(op, sse_func, neon_func) \
+	sfz_forceinline mask4w operator op (f32x4w l, f32x4w r) \
+	{ \
+		mask4w res; \
+		for (u32 i = 0; i < 4; i++) res.v[i] = (l.v[i] op r.v[i]) ? ~0u : 0u; \
+		return res; \
+	}
+#endif
+SFZ_WIDE_CMP4(==, _mm_cmpeq_ps, vceqq_f32)
+SFZ_WIDE_CMP4(<, _mm_cmplt_ps, vcltq_f32)
+SFZ_WIDE_CMP4(<=, _mm_cmple_ps, vcleq_f32)
+SFZ_WIDE_CMP4(>, _mm_cmpgt_ps, vcgtq_f32)
+SFZ_WIDE_CMP4(>=, _mm_cmpge_ps, vcgeq_f32)
+#undef SFZ_WIDE_CMP4
+
+sfz_forceinline mask4w operator!= (f32x4w l, f32x4w r)
+{
+#if defined(SFZ_WIDE_SSE)
+	return { _mm_cmpneq_ps(l.v, r.v) };
+#else
+	return ~(l == r);
+#endif
+}
+
+// Returns if_true in lanes where the mask is set, if_false otherwise.
+sfz_forceinline f32x4w f32x4w_select(mask4w m, f32x4w if_true, f32x4w if_false)
+{
+#if defined(SFZ_WIDE_SSE)
+	return { _mm_or_ps(_mm_and_ps(m.v, if_true.v), _mm_andnot_ps(m.v, if_false.v)) };
+#elif defined(SFZ_WIDE_NEON)
+	return { vbslq_f32(m.v, if_true.v, if_false.v) };
+#else
+	for (u32 i = 0; i < 4; i++) if_true.v[i] = m.v[i] != 0 ? if_true.v[i] : if_false.v[i];
+	return if_true;
+#endif
+}
+
+sfz_forceinline f32 f32x4w_hsum(f32x4w v)
+{
+#if defined(SFZ_WIDE_SSE)
+	const __m128 t = _mm_add_ps(v.v, _mm_movehl_ps(v.v, v.v)); // (0 + 2, 1 + 3, ...)
+	return _mm_cvtss_f32(_mm_add_ss(t, _mm_shuffle_ps(t, t, _MM_SHUFFLE(1, 1, 1, 1))));
+#elif defined(SFZ_WIDE_NEON)
+	return vaddvq_f32(v.v);
+#else
+	return (v.v[0] + v.v[2]) + (v.v[1] + v.v[3]);
+#endif
+}
+
+sfz_forceinline f32 f32x4w_hmin(f32x4w v)
+{
+#if defined(SFZ_WIDE_SSE)
+	const __m128 t = _mm_min_ps(v.v, _mm_movehl_ps(v.v, v.v));
+	return _mm_cvtss_f32(_mm_min_ss(t, _mm_shuffle_ps(t, t, _MM_SHUFFLE(1, 1, 1, 1))));
+#elif defined(SFZ_WIDE_NEON)
+	return vminvq_f32(v.v);
+#else
+	return f32_min(f32_min(v.v[0], v.v[2]), f32_min(v.v[1], v.v[3]));
+#endif
+}
+
+sfz_forceinline f32 f32x4w_hmax(f32x4w v)
+{
+#if defined(SFZ_WIDE_SSE)
+	const __m128 t = _mm_max_ps(_mm_movehl_ps(v.v, v.v), v.v);
+	return _mm_cvtss_f32(_mm_max_ss(_mm_shuffle_ps(t, t, _MM_SHUFFLE(1, 1, 1, 1)), t));
+#elif defined(SFZ_WIDE_NEON)
+	return vmaxvq_f32(v.v);
+#else
+	return f32_max(f32_max(v.v[0], v.v[2]), f32_max(v.v[1], v.v[3]));
+#endif
+}
+
+// f32x8w
+// ------------------------------------------------------------------------------------------------
+
+struct f32x8w final {
+#if defined(SFZ_WIDE_AVX2)
+	__m256 v;
+#else
+	f32x4w lo, hi;
+#endif
+};
+
+struct mask8w final {
+#if defined(SFZ_WIDE_AVX2)
+	__m256 v;
+#else
+	mask4w lo, hi;
+#endif
+};
+
+#if defined(SFZ_WIDE_AVX2)
+#define SFZ_WIDE_OP8(avx_expr, pair_expr) return avx_expr
+#else
+#define SFZ_WIDE_OP8(avx_expr, pair_expr) return pair_expr
+#endif
+
+sfz_forceinline mask8w operator& (mask8w l, mask8w r) { SFZ_WIDE_OP8(mask8w{ _mm256_and_ps(l.v, r.v) }, (mask8w{ l.lo & r.lo, l.hi & r.hi })); }
+sfz_forceinline mask8w operator| (mask8w l, mask8w r) { SFZ_WIDE_OP8(mask8w{ _mm256_or_ps(l.v, r.v) }, (mask8w{ l.lo | r.lo, l.hi | r.hi })); }
+sfz_forceinline mask8w operator^ (mask8w l, mask8w r) { SFZ_WIDE_OP8(mask8w{ _mm256_xor_ps(l.v, r.v) }, (mask8w{ l.lo ^ r.lo, l.hi ^ r.hi })); }
+sfz_forceinline mask8w operator~ (mask8w m) { SFZ_WIDE_OP8(mask8w{ _mm256_xor_ps(m.v, _mm256_castsi256_ps(_mm256_set1_epi32(-1))) }, (mask8w{ ~m.lo, ~m.hi })); }
+
+// Returns one bit per lane, lane 0 in the lowest bit.
+sfz_forceinline u32 mask8w_bits(mask8w m) { SFZ_WIDE_OP8(u32(_mm256_movemask_ps(m.v)), mask4w_bits(m.lo) | (mask4w_bits(m.hi) << 4)); }
+sfz_forceinline bool mask8w_any(mask8w m) { return mask8w_bits(m) != 0; }
+sfz_forceinline bool mask8w_all(mask8w m) { return mask8w_bits(m) == 0xFF; }
+
+sfz_forceinline f32x8w f32x8w_splat(f32 s) { SFZ_WIDE_OP8(f32x8w{ _mm256_set1_ps(s) }, (f32x8w{ f32x4w_splat(s), f32x4w_splat(s) })); }
+sfz_forceinline f32x8w f32x8w_zero() { return f32x8w_splat(0.0f); }
+
+// Loads 8 floats, ptr does not need to be aligned.
+sfz_forceinline f32x8w f32x8w_load(const f32* ptr) { SFZ_WIDE_OP8(f32x8w{ _mm256_loadu_ps(ptr) }, (f32x8w{ f32x4w_load(ptr), f32x4w_load(ptr + 4) })); }
+
+// Stores 8 floats, ptr does not need to be aligned.
+sfz_forceinline void f32x8w_store(f32* ptr, f32x8w v)
+{
+#if defined(SFZ_WIDE_AVX2)
+	_mm256_storeu_ps(ptr, v.v);
+#else
+	f32x4w_store(ptr, v.lo);
+	f32x4w_store(ptr + 4, v.hi);
+#endif
+}
+
+// Returns a single lane, slow. Mostly intended for debugging and tests.
+inline f32 f32x8w_lane(f32x8w v, u32 idx)
+{
+	sfz_assert(idx < 8);
+	f32 tmp[8];
+	f32x8w_store(tmp, v);
+	return tmp[idx];
+}
+
+sfz_forceinline f32x8w operator+ (f32x8w l, f32x8w r) { SFZ_WIDE_OP8(f32x8w{ _mm256_add_ps(l.v, r.v) }, (f32x8w{ l.lo + r.lo, l.hi + r.hi })); }
+sfz_forceinline f32x8w operator- (f32x8w l, f32x8w r) { SFZ_WIDE_OP8(f32x8w{ _mm256_sub_ps(l.v, r.v) }, (f32x8w{ l.lo - r.lo, l.hi - r.hi })); }
+sfz_forceinline f32x8w operator* (f32x8w l, f32x8w r) { SFZ_WIDE_OP8(f32x8w{ _mm256_mul_ps(l.v, r.v) }, (f32x8w{ l.lo * r.lo, l.hi * r.hi })); }
+sfz_forceinline f32x8w operator/ (f32x8w l, f32x8w r) { SFZ_WIDE_OP8(f32x8w{ _mm256_div_ps(l.v, r.v) }, (f32x8w{ l.lo / r.lo, l.hi / r.hi })); }
+sfz_forceinline f32x8w operator- (f32x8w v) { SFZ_WIDE_OP8(f32x8w{ _mm256_xor_ps(v.v, _mm256_set1_ps(-0.0f)) }, (f32x8w{ -v.lo, -v.hi })); }
+
+sfz_forceinline f32x8w& operator+= (f32x8w& l, f32x8w r) { return (l = l + r); }
+sfz_forceinline f32x8w& operator-= (f32x8w& l, f32x8w r) { return (l = l - r); }
+sfz_forceinline f32x8w& operator*= (f32x8w& l, f32x8w r) { return (l = l * r); }
+sfz_forceinline f32x8w& operator/= (f32x8w& l, f32x8w r) { return (l = l / r); }
+
+// Returns a * b + c, see f32x4w_fma().
+sfz_forceinline f32x8w f32x8w_fma(f32x8w a, f32x8w b, f32x8w c) { SFZ_WIDE_OP8(f32x8w{ _mm256_fmadd_ps(a.v, b.v, c.v) }, (f32x8w{ f32x4w_fma(a.lo, b.lo, c.lo), f32x4w_fma(a.hi, b.hi, c.hi) })); }
+
+sfz_forceinline f32x8w f32x8w_min(f32x8w l, f32x8w r) { SFZ_WIDE_OP8(f32x8w{ _mm256_min_ps(l.v, r.v) }, (f32x8w{ f32x4w_min(l.lo, r.lo), f32x4w_min(l.hi, r.hi) })); }
+sfz_forceinline f32x8w f32x8w_max(f32x8w l, f32x8w r) { SFZ_WIDE_OP8(f32x8w{ _mm256_max_ps(r.v, l.v) }, (f32x8w{ f32x4w_max(l.lo, r.lo), f32x4w_max(l.hi, r.hi) })); }
+sfz_forceinline f32x8w f32x8w_abs(f32x8w v) { SFZ_WIDE_OP8(f32x8w{ _mm256_andnot_ps(_mm256_set1_ps(-0.0f), v.v) }, (f32x8w{ f32x4w_abs(v.lo), f32x4w_abs(v.hi) })); }
+sfz_forceinline f32x8w f32x8w_sqrt(f32x8w v) { SFZ_WIDE_OP8(f32x8w{ _mm256_sqrt_ps(v.v) }, (f32x8w{ f32x4w_sqrt(v.lo), f32x4w_sqrt(v.hi) })); }
+
+sfz_forceinline mask8w operator== (f32x8w l, f32x8w r) { SFZ_WIDE_OP8(mask8w{ _mm256_cmp_ps(l.v, r.v, _CMP_EQ_OQ) }, (mask8w{ l.lo == r.lo, l.hi == r.hi })); }
+sfz_forceinline mask8w operator!= (f32x8w l, f32x8w r) { SFZ_WIDE_OP8(mask8w{ _mm256_cmp_ps(l.v, r.v, _CMP_NEQ_UQ) }, (mask8w{ l.lo != r.lo, l.hi != r.hi })); }
+sfz_forceinline mask8w operator< (f32x8w l, f32x8w r) { SFZ_WIDE_OP8(mask8w{ _mm256_cmp_ps(l.v, r.v, _CMP_LT_OQ) }, (mask8w{ l.lo < r.lo, l.hi < r.hi })); }
+sfz_forceinline mask8w operator<= (f32x8w l, f32x8w r) { SFZ_WIDE_OP8(mask8w{ _mm256_cmp_ps(l.v, r.v, _CMP_LE_OQ) }, (mask8w{ l.lo <= r.lo, l.hi <= r.hi })); }
+sfz_forceinline mask8w operator> (f32x8w l, f32x8w r) { SFZ_WIDE_OP8(mask8w{ _mm256_cmp_ps(l.v, r.v, _CMP_GT_OQ) }, (mask8w{ l.lo > r.lo, l.hi > r.hi })); }
+sfz_forceinline mask8w operator>= (f32x8w l, f32x8w r) { SFZ_WIDE_OP8(mask8w{ _mm256_cmp_ps(l.v, r.v, _CMP_GE_OQ) }, (mask8w{ l.lo >= r.lo, l.hi >= r.hi })); }
+
+// Returns if_true in lanes where the mask is set, if_false otherwise.
+sfz_forceinline f32x8w f32x8w_select(mask8w m, f32x8w if_true, f32x8w if_false)
+{
+	SFZ_WIDE_OP8(f32x8w{ _mm256_blendv_ps(if_false.v, if_true.v, m.v) },
+		(f32x8w{ f32x4w_select(m.lo, if_true.lo, if_false.lo), f32x4w_select(m.hi, if_true.hi, if_false.hi) }));
+}
+
+#if defined(SFZ_WIDE_AVX2)
+sfz_forceinline f32x4w sfzWideLo(f32x8w v) { return { _mm256_castps256_ps128(v.v) }; }
+sfz_forceinline f32x4w sfzWideHi(f32x8w v) { return { _mm256_extractf128_ps(v.v, 1) }; }
+#else
+sfz_forceinline f32x4w sfzWideLo(f32x8w v) { return v.lo; }
+sfz_forceinline f32x4w sfzWideHi(f32x8w v) { return v.hi; }
+#endif
+
+sfz_forceinline f32 f32x8w_hsum(f32x8w v) { return f32x4w_hsum(sfzWideLo(v) + sfzWideHi(v)); }
+sfz_forceinline f32 f32x8w_hmin(f32x8w v) { return f32x4w_hmin(f32x4w_min(sfzWideLo(v), sfzWideHi(v))); }
+sfz_forceinline f32 f32x8w_hmax(f32x8w v) { return f32x4w_hmax(f32x4w_max(sfzWideLo(v), sfzWideHi(v))); }
+
+#undef SFZ_WIDE_OP8
+
+// f32x3_soa8
+// ------------------------------------------------------------------------------------------------
+
+// 8 f32x3 vectors in SoA form.
+struct f32x3_soa8 final {
+	f32x8w x, y, z;
+};
+
+sfz_forceinline f32x3_soa8 f32x3_soa8_splat(f32x3 v)
+{
+	return { f32x8w_splat(v.x), f32x8w_splat(v.y), f32x8w_splat(v.z) };
+}
+
+sfz_forceinline f32x3_soa8 operator+ (f32x3_soa8 l, f32x3_soa8 r) { return { l.x + r.x, l.y + r.y, l.z + r.z }; }
+sfz_forceinline f32x3_soa8 operator- (f32x3_soa8 l, f32x3_soa8 r) { return { l.x - r.x, l.y - r.y, l.z - r.z }; }
+sfz_forceinline f32x3_soa8 operator* (f32x3_soa8 l, f32x3_soa8 r) { return { l.x * r.x, l.y * r.y, l.z * r.z }; }
+sfz_forceinline f32x3_soa8 operator* (f32x3_soa8 l, f32x8w s) { return { l.x * s, l.y * s, l.z * s }; }
+sfz_forceinline f32x3_soa8 operator* (f32x8w s, f32x3_soa8 r) { return r * s; }
+sfz_forceinline f32x3_soa8 operator- (f32x3_soa8 v) { return { -v.x, -v.y, -v.z }; }
+sfz_forceinline f32x3_soa8& operator+= (f32x3_soa8& l, f32x3_soa8 r) { return (l = l + r); }
+sfz_forceinline f32x3_soa8& operator-= (f32x3_soa8& l, f32x3_soa8 r) { return (l = l - r); }
+sfz_forceinline f32x3_soa8& operator*= (f32x3_soa8& l, f32x8w s) { return (l = l * s); }
+
+// Returns a * s + c, see f32x4w_fma().
+sfz_forceinline f32x3_soa8 f32x3_soa8_fma(f32x3_soa8 a, f32x8w s, f32x3_soa8 c)
+{
+	return { f32x8w_fma(a.x, s, c.x), f32x8w_fma(a.y, s, c.y), f32x8w_fma(a.z, s, c.z) };
+}
+
+sfz_forceinline f32x8w f32x3_soa8_dot(f32x3_soa8 l, f32x3_soa8 r) { return l.x * r.x + l.y * r.y + l.z * r.z; }
+sfz_forceinline f32x8w f32x3_soa8_length(f32x3_soa8 v) { return f32x8w_sqrt(f32x3_soa8_dot(v, v)); }
+
+sfz_forceinline f32x3_soa8 f32x3_soa8_min(f32x3_soa8 l, f32x3_soa8 r)
+{
+	return { f32x8w_min(l.x, r.x), f32x8w_min(l.y, r.y), f32x8w_min(l.z, r.z) };
+}
+
+sfz_forceinline f32x3_soa8 f32x3_soa8_max(f32x3_soa8 l, f32x3_soa8 r)
+{
+	return { f32x8w_max(l.x, r.x), f32x8w_max(l.y, r.y), f32x8w_max(l.z, r.z) };
+}
+
+sfz_forceinline f32x3_soa8 f32x3_soa8_select(mask8w m, f32x3_soa8 if_true, f32x3_soa8 if_false)
+{
+	return {
+		f32x8w_select(m, if_true.x, if_false.x),
+		f32x8w_select(m, if_true.y, if_false.y),
+		f32x8w_select(m, if_true.z, if_false.z)
+	};
+}
+
+// AoS <-> SoA conversion
+// ------------------------------------------------------------------------------------------------
+
+// Converts 4 tightly packed f32x3 (12 floats) to SoA form.
+sfz_forceinline void sfzWideAoSToSoA4(const f32* src, f32x4w& x, f32x4w& y, f32x4w& z)
+{
+#if defined(SFZ_WIDE_SSE)
+	const __m128 a = _mm_loadu_ps(src + 0); // x0 y0 z0 x1
+	const __m128 b = _mm_loadu_ps(src + 4); // y1 z1 x2 y2
+	const __m128 c = _mm_loadu_ps(src + 8); // z2 x3 y3 z3
+	const __m128 xy = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 1, 3, 2)); // x2 y2 x3 y3
+	const __m128 yz = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 0, 2, 1)); // y0 z0 y1 z1
+	x.v = _mm_shuffle_ps(a, xy, _MM_SHUFFLE(2, 0, 3, 0));
+	y.v = _mm_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0));
+	z.v = _mm_shuffle_ps(yz, c, _MM_SHUFFLE(3, 0, 3, 1));
+#elif defined(SFZ_WIDE_NEON)
+	const float32x4x3_t v = vld3q_f32(src);
+	x.v = v.val[0];
+	y.v = v.val[1];
+	z.v = v.val[2];
+#else
+	for (u32 i = 0; i < 4; i++) {
+		x.v[i] = src[i * 3 + 0];
+		y.v[i] = src[i * 3 + 1];
+		z.v[i] = src[i * 3 + 2];
+	}
+#endif
+}
+
+// Converts 4 vectors in SoA form to 4 tightly packed f32x3 (12 floats).
+sfz_forceinline void sfzWideSoAToAoS4(f32* dst, f32x4w x, f32x4w y, f32x4w z)
+{
+#if defined(SFZ_WIDE_SSE)
+	const __m128 xy_lo = _mm_unpacklo_ps(x.v, y.v); // x0 y0 x1 y1
+	const __m128 xy_hi = _mm_unpackhi_ps(x.v, y.v); // x2 y2 x3 y3
+	const __m128 zxy = _mm_shuffle_ps(z.v, xy_lo, _MM_SHUFFLE(3, 2, 1, 0)); // z0 z1 x1 y1
+	const __m128 zzxy = _mm_shuffle_ps(z.v, xy_hi, _MM_SHUFFLE(3, 2, 3, 2)); // z2 z3 x3 y3
+	_mm_storeu_ps(dst + 0, _mm_shuffle_ps(xy_lo, zxy, _MM_SHUFFLE(2, 0, 1, 0))); // x0 y0 z0 x1
+	_mm_storeu_ps(dst + 4, _mm_shuffle_ps(zxy, xy_hi, _MM_SHUFFLE(1, 0, 1, 3))); // y1 z1 x2 y2
+	_mm_storeu_ps(dst + 8, _mm_shuffle_ps(zzxy, zzxy, _MM_SHUFFLE(1, 3, 2, 0))); // z2 x3 y3 z3
+#elif defined(SFZ_WIDE_NEON)
+	float32x4x3_t v;
+	v.val[0] = x.v;
+	v.val[1] = y.v;
+	v.val[2] = z.v;
+	vst3q_f32(dst, v);
+#else
+	for (u32 i = 0; i < 4; i++) {
+		dst[i * 3 + 0] = x.v[i];
+		dst[i * 3 + 1] = y.v[i];
+		dst[i * 3 + 2] = z.v[i];
+	}
+#endif
+}
+
+#if defined(SFZ_WIDE_AVX2)
+sfz_forceinline f32x8w sfzWideCombine(f32x4w lo, f32x4w hi)
+{
+	return { _mm256_insertf128_ps(_mm256_castps128_ps256(lo.v), hi.v, 1) };
+}
+#else
+sfz_forceinline f32x8w sfzWideCombine(f32x4w lo, f32x4w hi) { return { lo, hi }; }
+#endif
+
+// Loads up to 8 tightly packed f32x3 into SoA form, lanes past count are set to zero.
+inline f32x3_soa8 f32x3_soa8_load(const f32x3* src, u32 count)
+{
+	f32x3 tmp[8];
+	const f32* src_floats = &src->x;
+	if (count < 8) {
+		memset(tmp, 0, sizeof(tmp));
+		memcpy(tmp, src, sizeof(f32x3) * count);
+		src_floats = &tmp[0].x;
+	}
+	f32x4w x_lo, y_lo, z_lo, x_hi, y_hi, z_hi;
+	sfzWideAoSToSoA4(src_floats, x_lo, y_lo, z_lo);
+	sfzWideAoSToSoA4(src_floats + 12, x_hi, y_hi, z_hi);
+	return { sfzWideCombine(x_lo, x_hi), sfzWideCombine(y_lo, y_hi), sfzWideCombine(z_lo, z_hi) };
+}
+
+// Stores the first count (at most 8) vectors as tightly packed f32x3.
+inline void f32x3_soa8_store(f32x3* dst, u32 count, f32x3_soa8 v)
+{
+	f32x3 tmp[8];
+	f32* dst_floats = count < 8 ? &tmp[0].x : &dst->x;
+	sfzWideSoAToAoS4(dst_floats, sfzWideLo(v.x), sfzWideLo(v.y), sfzWideLo(v.z));
+	sfzWideSoAToAoS4(dst_floats + 12, sfzWideHi(v.x), sfzWideHi(v.y), sfzWideHi(v.z));
+	if (count < 8) memcpy(dst, tmp, sizeof(f32x3) * count);
+}
+
+// Loads the 8 (or fewer, at the end of the array) elements starting at first_idx, see
+// f32x3_soa8_load().
+inline f32x3_soa8 f32x3_soa8_load(const SfzArray<f32x3>& arr, u32 first_idx)
+{
+	sfz_assert(first_idx < arr.size());
+	return f32x3_soa8_load(arr.data() + first_idx, u32_min(8, arr.size() - first_idx));
+}
+
+// Stores to the 8 (or fewer, at the end of the array) elements starting at first_idx, see
+// f32x3_soa8_store().
+inline void f32x3_soa8_store(SfzArray<f32x3>& arr, u32 first_idx, f32x3_soa8 v)
+{
+	sfz_assert(first_idx < arr.size());
+	f32x3_soa8_store(arr.data() + first_idx, u32_min(8, arr.size() - first_idx), v);
+}
+
+// Gathers 8 arbitrary elements into SoA form. Hardware gather instructions are not used, they are
+// typically not faster than 8 scalar loads for this access pattern.
+inline f32x3_soa8 f32x3_soa8_gather(const f32x3* base, const u32 indices[8])
+{
+	f32x3 tmp[8];
+	for (u32 i = 0; i < 8; i++) tmp[i] = base[indices[i]];
+	return f32x3_soa8_load(tmp, 8);
+}
+
+// Scatters the 8 vectors to arbitrary elements, if an index occurs multiple times the last lane
+// with that index wins.
+inline void f32x3_soa8_scatter(f32x3* base, const u32 indices[8], f32x3_soa8 v)
+{
+	f32x3 tmp[8];
+	f32x3_soa8_store(tmp, 8, v);
+	for (u32 i = 0; i < 8; i++) base[indices[i]] = tmp[i];
+}
+
+#endif
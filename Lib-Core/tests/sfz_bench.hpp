@@ -0,0 +1,69 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#pragma once
+
+#include "doctest.h"
+
+#include "sfz.h"
+
+#include <chrono>
+#include <cstdio>
+
+// Benchmarks
+// ------------------------------------------------------------------------------------------------
+
+// Benchmarks are regular test cases in the "benchmarks" test suite, skipped by default. Run them
+// with an optimized build:
+//
+//     sfz_core_tests -ts=benchmarks --no-skip
+//
+// They print one line per measurement and only CHECK that the compared implementations agree.
+#define SFZ_BENCHMARK(name) TEST_CASE(name * doctest::test_suite("benchmarks") * doctest::skip())
+
+struct SfzBenchTimer final {
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	void restart() { start = std::chrono::high_resolution_clock::now(); }
+	f64 elapsedNs() const
+	{
+		return std::chrono::duration<f64, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+	f64 elapsedMs() const { return elapsedNs() / 1000000.0; }
+};
+
+// Calls func once to warm up, then num_reps times. Returns the average time per call in ms.
+template<typename Func>
+f64 sfzBenchMs(u32 num_reps, Func&& func)
+{
+	func();
+	SfzBenchTimer timer;
+	for (u32 i = 0; i < num_reps; i++) func();
+	return timer.elapsedMs() / f64(num_reps);
+}
+
+// Makes a result observable so the compiler can't remove the work that produced it.
+template<typename T>
+void sfzBenchKeep(const T& value)
+{
+	static volatile u8 sink = 0;
+	const volatile u8* bytes = reinterpret_cast<const volatile u8*>(&value);
+	for (u64 i = 0; i < sizeof(T); i++) sink = sink ^ bytes[i];
+}
+
+#define SFZ_BENCH_PRINT(fmt, ...) printf("[bench] " fmt "\n", ##__VA_ARGS__)
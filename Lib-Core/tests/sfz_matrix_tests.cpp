@@ -0,0 +1,460 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#include "doctest.h"
+#include "sfz_bench.hpp"
+
+#include "sfz.h"
+#include "sfz_matrix.h"
+#include "sfz_simd.h"
+
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+// When SFZ_SIMD is enabled the SIMD matrix paths must produce results bitwise identical to the
+// scalar reference paths, i.e. the same operations in the same order. This requires that the
+// compiler does not contract multiplies and adds into FMAs, which MSVC doesn't by default (the
+// test target turns it off for other compilers). Without SFZ_SIMD these tests compare the scalar
+// paths to themselves.
+
+namespace {
+
+constexpr f32 INF = std::numeric_limits<f32>::infinity();
+constexpr f32 NAN_F32 = std::numeric_limits<f32>::quiet_NaN();
+
+// Bitwise equal, except that any NaN is considered equal to any other NaN. Which NaN payload
+// propagates through an operation depends on operand order, which the compiler may swap for the
+// commutative scalar operations.
+bool sameBits(f32 a, f32 b)
+{
+	if (a != a && b != b) return true;
+	return memcmp(&a, &b, sizeof(f32)) == 0;
+}
+
+template<typename T>
+bool sameBits(const T& a, const T& b)
+{
+	static_assert(sizeof(T) % sizeof(f32) == 0);
+	const f32* a_f = reinterpret_cast<const f32*>(&a);
+	const f32* b_f = reinterpret_cast<const f32*>(&b);
+	for (u64 i = 0; i < sizeof(T) / sizeof(f32); i++) {
+		if (!sameBits(a_f[i], b_f[i])) return false;
+	}
+	return true;
+}
+
+SfzMat44 randomMat(std::mt19937& rng, std::uniform_real_distribution<f32>& dist)
+{
+	SfzMat44 m;
+	for (u32 i = 0; i < 4; i++) {
+		m.rows[i] = f32x4_init(dist(rng), dist(rng), dist(rng), dist(rng));
+	}
+	return m;
+}
+
+// A random value that is special (signed zeroes, infinities, NaN, denormals, huge values) roughly
+// half of the time.
+f32 randomSpecial(std::mt19937& rng)
+{
+	constexpr u32 NUM_SPECIALS = 12;
+	constexpr f32 SPECIALS[NUM_SPECIALS] = {
+		0.0f, -0.0f, 1.0f, -1.0f, INF, -INF, NAN_F32, 1e-40f, -1e-40f, 3e38f, -3e38f, 1e-20f };
+	const u32 r = rng() % (2 * NUM_SPECIALS);
+	if (r < NUM_SPECIALS) return SPECIALS[r];
+	return f32(i32(rng() % 2001) - 1000) * 0.01f;
+}
+
+SfzMat44 randomSpecialMat(std::mt19937& rng)
+{
+	SfzMat44 m;
+	for (u32 i = 0; i < 4; i++) {
+		m.rows[i] = f32x4_init(randomSpecial(rng), randomSpecial(rng), randomSpecial(rng), randomSpecial(rng));
+	}
+	return m;
+}
+
+bool approxIdentity(const SfzMat44& m, f32 eps)
+{
+	for (u32 y = 0; y < 4; y++) {
+		for (u32 x = 0; x < 4; x++) {
+			const f32 expected = x == y ? 1.0f : 0.0f;
+			if (!(f32_abs(m.at(y, x) - expected) <= eps)) return false;
+		}
+	}
+	return true;
+}
+
+} // namespace
+
+// SIMD against scalar
+// ------------------------------------------------------------------------------------------------
+
+TEST_CASE("SfzMat44: SIMD and scalar paths are bitwise identical")
+{
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<f32> dist(-10.0f, 10.0f);
+	u32 num_mul = 0, num_mul_vec = 0, num_point = 0, num_dir = 0, num_inverse = 0;
+	constexpr u32 NUM_ITERS = 100000;
+	for (u32 i = 0; i < NUM_ITERS; i++) {
+		const SfzMat44 a = randomMat(rng, dist);
+		const SfzMat44 b = randomMat(rng, dist);
+		const f32x4 v = f32x4_init(dist(rng), dist(rng), dist(rng), dist(rng));
+		const f32x3 p = v.xyz();
+		num_mul += sameBits(a * b, sfzMat44MulScalar(a, b)) ? 1 : 0;
+		num_mul_vec += sameBits(a * v, sfzMat44MulVecScalar(a, v)) ? 1 : 0;
+		num_point += sameBits(sfzMat44TransformPoint(a, p), sfzMat44TransformPointScalar(a, p)) ? 1 : 0;
+		num_dir += sameBits(sfzMat44TransformDir(a, p), sfzMat44TransformDirScalar(a, p)) ? 1 : 0;
+		num_inverse += sameBits(sfzMat44Inverse(a), sfzMat44InverseScalar(a)) ? 1 : 0;
+	}
+	CHECK(num_mul == NUM_ITERS);
+	CHECK(num_mul_vec == NUM_ITERS);
+	CHECK(num_point == NUM_ITERS);
+	CHECK(num_dir == NUM_ITERS);
+	CHECK(num_inverse == NUM_ITERS);
+}
+
+TEST_CASE("SfzMat44: SIMD and scalar paths agree for signed zeroes, infinities, NaNs and denormals")
+{
+	std::mt19937 rng(2);
+	u32 num_bad = 0;
+	constexpr u32 NUM_ITERS = 50000;
+	for (u32 i = 0; i < NUM_ITERS; i++) {
+		const SfzMat44 a = randomSpecialMat(rng);
+		const SfzMat44 b = randomSpecialMat(rng);
+		const f32x4 v = f32x4_init(randomSpecial(rng), randomSpecial(rng), randomSpecial(rng), randomSpecial(rng));
+		const f32x3 p = v.xyz();
+		num_bad += sameBits(a * b, sfzMat44MulScalar(a, b)) ? 0 : 1;
+		num_bad += sameBits(a * v, sfzMat44MulVecScalar(a, v)) ? 0 : 1;
+		num_bad += sameBits(sfzMat44TransformPoint(a, p), sfzMat44TransformPointScalar(a, p)) ? 0 : 1;
+		num_bad += sameBits(sfzMat44TransformDir(a, p), sfzMat44TransformDirScalar(a, p)) ? 0 : 1;
+		num_bad += sameBits(sfzMat44Inverse(a), sfzMat44InverseScalar(a)) ? 0 : 1;
+	}
+	CHECK(num_bad == 0);
+
+	// -0 must survive, i.e. -1 * 0 summed four times is -0 and not +0
+	SfzMat44 neg;
+	for (u32 i = 0; i < 4; i++) neg.rows[i] = f32x4_splat(-1.0f);
+	const f32x4 zero_v = f32x4_splat(0.0f);
+	const f32x4 r = neg * zero_v;
+	CHECK(sameBits(r, sfzMat44MulVecScalar(neg, zero_v)));
+	CHECK(sameBits(r, f32x4_splat(-0.0f)));
+
+	// Transforming a point with w = 0 divides by zero
+	SfzMat44 proj = sfzMat44Identity();
+	proj.rows[3] = f32x4_init(0.0f, 0.0f, 0.0f, 0.0f);
+	const f32x3 inf_p = sfzMat44TransformPoint(proj, f32x3_init(1.0f, -1.0f, 0.0f));
+	CHECK(sameBits(inf_p, sfzMat44TransformPointScalar(proj, f32x3_init(1.0f, -1.0f, 0.0f))));
+	CHECK(inf_p.x == INF);
+	CHECK(inf_p.y == -INF);
+	CHECK(inf_p.z != inf_p.z);
+}
+
+// Inverse
+// ------------------------------------------------------------------------------------------------
+
+TEST_CASE("SfzMat44: inverse")
+{
+	const SfzMat44 m = sfzMat44Rotation3(f32x3_init(1.0f, 1.0f, 0.0f), 0.5f) *
+		sfzMat44Translation3(f32x3_init(1.0f, 2.0f, 3.0f));
+	CHECK(approxIdentity(m * sfzMat44Inverse(m), 1e-5f));
+	CHECK(approxIdentity(sfzMat44Inverse(m) * m, 1e-5f));
+
+	// The identity is its own inverse, exactly (though some of the zeroes are negative)
+	CHECK(approxIdentity(sfzMat44Inverse(sfzMat44Identity()), 0.0f));
+
+	// Random well conditioned matrices, i.e. diagonally dominant
+	std::mt19937 rng(4);
+	std::uniform_real_distribution<f32> dist(-1.0f, 1.0f);
+	u32 num_bad = 0;
+	for (u32 i = 0; i < 1000; i++) {
+		SfzMat44 r = randomMat(rng, dist);
+		for (u32 j = 0; j < 4; j++) r.at(j, j) += 8.0f;
+		num_bad += approxIdentity(r * sfzMat44Inverse(r), 1e-5f) ? 0 : 1;
+	}
+	CHECK(num_bad == 0);
+}
+
+TEST_CASE("SfzMat44: inverse of singular matrices is zero")
+{
+	const SfzMat44 zero = {};
+
+	// Two equal rows
+	SfzMat44 m = sfzMat44InitElems(
+		1.0f, 2.0f, 3.0f, 4.0f,
+		5.0f, 6.0f, 7.0f, 8.0f,
+		1.0f, 2.0f, 3.0f, 4.0f,
+		0.0f, 0.0f, 0.0f, 1.0f);
+	CHECK(sameBits(sfzMat44Inverse(m), zero));
+	CHECK(sameBits(sfzMat44InverseScalar(m), zero));
+
+	// Projection onto a plane, and the zero matrix itself
+	const SfzMat44 flatten = sfzMat44Scaling3(f32x3_init(1.0f, 0.0f, 1.0f));
+	CHECK(sameBits(sfzMat44Inverse(flatten), zero));
+	CHECK(sameBits(sfzMat44Inverse(zero), zero));
+
+	// Nearly singular but not exactly, must not be flushed to zero
+	m.rows[2].x += 1e-3f;
+	const SfzMat44 inv = sfzMat44Inverse(m);
+	CHECK(!sameBits(inv, zero));
+	CHECK(sameBits(inv, sfzMat44InverseScalar(m)));
+}
+
+// Batch transforms
+// ------------------------------------------------------------------------------------------------
+
+TEST_CASE("sfzMat44TransformPoints/Dirs: identical to transforming one at a time")
+{
+	std::mt19937 rng(3);
+	std::uniform_real_distribution<f32> dist(-10.0f, 10.0f);
+	u32 num_bad = 0;
+	for (u32 it = 0; it < 2000; it++) {
+		SfzMat44 m = randomMat(rng, dist);
+		if (it % 2 != 0) m.rows[3] = f32x4_init(0.0f, 0.0f, 0.0f, 1.0f);
+		if (it % 5 == 0) m.rows[1].y = -0.0f;
+
+		// Tightly packed f32x3 and strided (e.g. a position inside a vertex) sources. The source is
+		// allocated with its exact size so that reading past the last element would be caught by
+		// sanitizers.
+		const u64 num = rng() % 40;
+		const u64 stride_floats = it % 3 == 0 ? 3 : 3 + rng() % 6;
+		std::vector<f32> src(num * stride_floats);
+		for (f32& f : src) f = rng() % 11 == 0 ? -0.0f : dist(rng);
+		const f32x3* src_ptr = reinterpret_cast<const f32x3*>(src.data());
+		const u64 stride = stride_floats * sizeof(f32);
+		auto srcAt = [&](u64 i) { return *reinterpret_cast<const f32x3*>(src.data() + i * stride_floats); };
+
+		std::vector<f32x3> dst(num), ref(num);
+		sfzMat44TransformPoints(m, dst.data(), src_ptr, stride, num);
+		for (u64 i = 0; i < num; i++) ref[i] = sfzMat44TransformPoint(m, srcAt(i));
+		if (num != 0 && memcmp(dst.data(), ref.data(), num * sizeof(f32x3)) != 0) num_bad += 1;
+
+		sfzMat44TransformDirs(m, dst.data(), src_ptr, stride, num);
+		for (u64 i = 0; i < num; i++) ref[i] = sfzMat44TransformDir(m, srcAt(i));
+		if (num != 0 && memcmp(dst.data(), ref.data(), num * sizeof(f32x3)) != 0) num_bad += 1;
+	}
+	CHECK(num_bad == 0);
+}
+
+TEST_CASE("sfzMat44TransformPoints/Dirs: special values, unaligned source and destination bounds")
+{
+	std::mt19937 rng(6);
+	constexpr f32 GUARD = 12345.0f;
+	u32 num_bad = 0, num_guard_bad = 0;
+	for (u32 it = 0; it < 3000; it++) {
+		const SfzMat44 m = it % 2 == 0 ? randomSpecialMat(rng) : sfzMat44Translation3(f32x3_init(1.0f, -0.0f, 0.0f));
+
+		// Every count around the 4-wide main loop and its scalar tail, from a source that starts 4
+		// bytes into its allocation (i.e. never 16-byte aligned) and ends exactly at its last point
+		const u64 num = it % 13;
+		const u64 stride_floats = 3 + it % 3;
+		std::vector<f32> src_storage(1 + num * stride_floats);
+		f32* src = src_storage.data() + 1;
+		for (u64 i = 0; i < num * stride_floats; i++) src[i] = randomSpecial(rng);
+		const f32x3* src_ptr = reinterpret_cast<const f32x3*>(src);
+		auto srcAt = [&](u64 i) { return *reinterpret_cast<const f32x3*>(src + i * stride_floats); };
+
+		// The destination has a guard element after the last point which must not be written
+		std::vector<f32x3> dst(num + 1, f32x3_splat(GUARD));
+		for (u32 dirs = 0; dirs < 2; dirs++) {
+			if (dirs) sfzMat44TransformDirs(m, dst.data(), src_ptr, stride_floats * sizeof(f32), num);
+			else sfzMat44TransformPoints(m, dst.data(), src_ptr, stride_floats * sizeof(f32), num);
+			for (u64 i = 0; i < num; i++) {
+				const f32x3 ref = dirs ? sfzMat44TransformDir(m, srcAt(i)) : sfzMat44TransformPoint(m, srcAt(i));
+				num_bad += sameBits(dst[i], ref) ? 0 : 1;
+				num_bad += sameBits(dst[i], dirs ?
+					sfzMat44TransformDirScalar(m, srcAt(i)) : sfzMat44TransformPointScalar(m, srcAt(i))) ? 0 : 1;
+			}
+			num_guard_bad += sameBits(dst[num], f32x3_splat(GUARD)) ? 0 : 1;
+		}
+	}
+	CHECK(num_bad == 0);
+	CHECK(num_guard_bad == 0);
+}
+
+// Register helpers
+// ------------------------------------------------------------------------------------------------
+
+#if defined(SFZ_SIMD_ENABLED)
+
+TEST_CASE("sfzSimdF32x3Dot/Cross/Normalize: identical to the f32x3 functions")
+{
+	std::mt19937 rng(5);
+	u32 num_bad = 0;
+	for (u32 i = 0; i < 100000; i++) {
+		const bool special = i % 2 == 0;
+		std::uniform_real_distribution<f32> dist(-100.0f, 100.0f);
+		const f32x4 a = special ?
+			f32x4_init(randomSpecial(rng), randomSpecial(rng), randomSpecial(rng), randomSpecial(rng)) :
+			f32x4_init(dist(rng), dist(rng), dist(rng), dist(rng));
+		const f32x4 b = f32x4_init(dist(rng), dist(rng), dist(rng), dist(rng));
+		const SfzSimdF32x4 sa = sfzSimdF32x4Load(a);
+		const SfzSimdF32x4 sb = sfzSimdF32x4Load(b);
+
+		num_bad += sameBits(sfzSimdF32x4Dot(sa, sb), f32x4_dot(a, b)) ? 0 : 1;
+		num_bad += sameBits(sfzSimdF32x3Dot(sa, sb), f32x3_dot(a.xyz(), b.xyz())) ? 0 : 1;
+		num_bad += sameBits(sfzSimdF32x4Store(sfzSimdF32x3Cross(sa, sb)).xyz(), f32x3_cross(a.xyz(), b.xyz())) ? 0 : 1;
+		if (f32x3_dot(a.xyz(), a.xyz()) != 0.0f) {
+			num_bad += sameBits(sfzSimdF32x4Store(sfzSimdF32x3Normalize(sa)).xyz(), f32x3_normalize(a.xyz())) ? 0 : 1;
+		}
+	}
+	CHECK(num_bad == 0);
+
+	// Cross of parallel vectors is zero, w is zero
+	const f32x4 c = sfzSimdF32x4Store(sfzSimdF32x3Cross(
+		sfzSimdF32x4Load(f32x4_init(1.0f, 2.0f, 3.0f, 7.0f)), sfzSimdF32x4Load(f32x4_init(2.0f, 4.0f, 6.0f, 9.0f))));
+	CHECK(c == f32x4_splat(0.0f));
+
+	// Normalizing a zero vector gives NaNs, same as f32x3_normalize()
+	const f32x4 n = sfzSimdF32x4Store(sfzSimdF32x3Normalize(sfzSimdF32x4Zero()));
+	CHECK(n.x != n.x);
+	CHECK(sameBits(n.xyz(), f32x3_normalize(f32x3_splat(0.0f))));
+}
+
+#endif
+
+// Benchmarks
+// ------------------------------------------------------------------------------------------------
+
+namespace {
+
+// Runs op over NUM inputs per rep and returns ns per op. NUM is small enough that everything stays
+// in L1, so this measures the arithmetic rather than memory.
+template<typename Op>
+f64 benchNsPerOp(u32 num, Op&& op)
+{
+	constexpr u32 NUM_REPS = 2000;
+	const f64 ms = sfzBenchMs(NUM_REPS, [&]() { for (u32 i = 0; i < num; i++) op(i); });
+	return ms * 1000000.0 / f64(num);
+}
+
+} // namespace
+
+SFZ_BENCHMARK("SfzMat44: SIMD against scalar for mat*mat, mat*vec, inverse, dot, cross and normalize")
+{
+	constexpr u32 NUM = 256;
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<f32> dist(-1.0f, 1.0f);
+	std::vector<SfzMat44> mats(NUM), out_mats(NUM);
+	std::vector<f32x4> vecs(NUM), out_vecs(NUM);
+	std::vector<f32> out_f(NUM);
+	for (u32 i = 0; i < NUM; i++) {
+		mats[i] = randomMat(rng, dist);
+		for (u32 j = 0; j < 4; j++) mats[i].at(j, j) += 4.0f;
+		vecs[i] = f32x4_init(dist(rng), dist(rng), dist(rng), 0.0f);
+	}
+	SFZ_BENCH_PRINT("ns per op, %u independent ops per rep (throughput), chained = each op depends on the previous", NUM);
+
+	auto report = [](const char* name, f64 simd_ns, f64 scalar_ns) {
+		SFZ_BENCH_PRINT("%-22s simd %6.2f ns  scalar %6.2f ns  speedup %.2fx", name, simd_ns, scalar_ns, scalar_ns / simd_ns);
+	};
+
+	const f64 mul_simd = benchNsPerOp(NUM, [&](u32 i) { out_mats[i] = mats[i] * mats[(i + 1) % NUM]; });
+	sfzBenchKeep(out_mats[NUM / 2]);
+	const f64 mul_scalar = benchNsPerOp(NUM, [&](u32 i) { out_mats[i] = sfzMat44MulScalar(mats[i], mats[(i + 1) % NUM]); });
+	sfzBenchKeep(out_mats[NUM / 2]);
+	report("mat * mat", mul_simd, mul_scalar);
+
+	SfzMat44 acc = sfzMat44Identity();
+	const f64 chain_simd = benchNsPerOp(NUM, [&](u32 i) { acc = acc * mats[i]; acc.rows[3] = f32x4_init(0.0f, 0.0f, 0.0f, 1.0f); });
+	sfzBenchKeep(acc);
+	acc = sfzMat44Identity();
+	const f64 chain_scalar = benchNsPerOp(NUM, [&](u32 i) { acc = sfzMat44MulScalar(acc, mats[i]); acc.rows[3] = f32x4_init(0.0f, 0.0f, 0.0f, 1.0f); });
+	sfzBenchKeep(acc);
+	report("mat * mat (chained)", chain_simd, chain_scalar);
+
+	const f64 vec_simd = benchNsPerOp(NUM, [&](u32 i) { out_vecs[i] = mats[i % 16] * vecs[i]; });
+	sfzBenchKeep(out_vecs[NUM / 2]);
+	const f64 vec_scalar = benchNsPerOp(NUM, [&](u32 i) { out_vecs[i] = sfzMat44MulVecScalar(mats[i % 16], vecs[i]); });
+	sfzBenchKeep(out_vecs[NUM / 2]);
+	report("mat * vec", vec_simd, vec_scalar);
+
+	const f64 inv_simd = benchNsPerOp(NUM, [&](u32 i) { out_mats[i] = sfzMat44Inverse(mats[i]); });
+	sfzBenchKeep(out_mats[NUM / 2]);
+	const f64 inv_scalar = benchNsPerOp(NUM, [&](u32 i) { out_mats[i] = sfzMat44InverseScalar(mats[i]); });
+	sfzBenchKeep(out_mats[NUM / 2]);
+	report("inverse", inv_simd, inv_scalar);
+
+#if defined(SFZ_SIMD_ENABLED)
+	// The register helpers are meant for data that already lives in registers, here they load from
+	// and store to memory on every op, same as the f32x3 functions.
+	const f64 dot_simd = benchNsPerOp(NUM, [&](u32 i) {
+		out_f[i] = sfzSimdF32x3Dot(sfzSimdF32x4Load(vecs[i]), sfzSimdF32x4Load(vecs[(i + 1) % NUM])); });
+	sfzBenchKeep(out_f[NUM / 2]);
+	const f64 dot_scalar = benchNsPerOp(NUM, [&](u32 i) { out_f[i] = f32x3_dot(vecs[i].xyz(), vecs[(i + 1) % NUM].xyz()); });
+	sfzBenchKeep(out_f[NUM / 2]);
+	report("dot", dot_simd, dot_scalar);
+
+	const f64 cross_simd = benchNsPerOp(NUM, [&](u32 i) {
+		out_vecs[i] = sfzSimdF32x4Store(sfzSimdF32x3Cross(sfzSimdF32x4Load(vecs[i]), sfzSimdF32x4Load(vecs[(i + 1) % NUM]))); });
+	sfzBenchKeep(out_vecs[NUM / 2]);
+	const f64 cross_scalar = benchNsPerOp(NUM, [&](u32 i) {
+		out_vecs[i] = f32x4_init3(f32x3_cross(vecs[i].xyz(), vecs[(i + 1) % NUM].xyz()), 0.0f); });
+	sfzBenchKeep(out_vecs[NUM / 2]);
+	report("cross", cross_simd, cross_scalar);
+
+	const f64 norm_simd = benchNsPerOp(NUM, [&](u32 i) {
+		out_vecs[i] = sfzSimdF32x4Store(sfzSimdF32x3Normalize(sfzSimdF32x4Load(vecs[i]))); });
+	sfzBenchKeep(out_vecs[NUM / 2]);
+	const f64 norm_scalar = benchNsPerOp(NUM, [&](u32 i) { out_vecs[i] = f32x4_init3(f32x3_normalize(vecs[i].xyz()), 0.0f); });
+	sfzBenchKeep(out_vecs[NUM / 2]);
+	report("normalize", norm_simd, norm_scalar);
+#endif
+
+	CHECK(sameBits(mats[0] * mats[1], sfzMat44MulScalar(mats[0], mats[1])));
+}
+
+SFZ_BENCHMARK("sfzMat44TransformPoints/Dirs: points per second against the per-point loop for 1K to 10M points")
+{
+	constexpr u64 MAX_NUM = 10000000;
+	constexpr u64 VERTEX_FLOATS = 8; // Position, normal and texcoord, i.e. 32 bytes
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<f32> dist(-10.0f, 10.0f);
+	std::vector<f32> src(MAX_NUM * VERTEX_FLOATS);
+	for (f32& f : src) f = dist(rng);
+	std::vector<f32x3> dst(MAX_NUM), ref(MAX_NUM);
+	SfzMat44 m = randomMat(rng, dist);
+	m.rows[3] = f32x4_init(0.01f, 0.02f, 0.03f, 1.0f); // Projective, so points pay for the divide
+	SFZ_BENCH_PRINT("M points/s; loop = sfzMat44TransformPoint() per point, scalar = the scalar reference per point");
+
+	for (u64 stride_floats : { u64(3), VERTEX_FLOATS }) {
+		const u64 stride = stride_floats * sizeof(f32);
+		const f32x3* src_ptr = reinterpret_cast<const f32x3*>(src.data());
+		auto srcAt = [&](u64 i) { return *reinterpret_cast<const f32x3*>(src.data() + i * stride_floats); };
+		for (u64 num = 1000; num <= MAX_NUM; num *= 10) {
+			const u32 num_reps = u32(u64_max(3, 50000000 / num));
+			auto mps = [&](auto func) { return f64(num) / (sfzBenchMs(num_reps, func) * 1000.0); };
+
+			const f64 points_batch = mps([&]() { sfzMat44TransformPoints(m, dst.data(), src_ptr, stride, num); });
+			const f64 points_loop = mps([&]() { for (u64 i = 0; i < num; i++) ref[i] = sfzMat44TransformPoint(m, srcAt(i)); });
+			CHECK(memcmp(dst.data(), ref.data(), num * sizeof(f32x3)) == 0);
+			const f64 points_scalar = mps([&]() { for (u64 i = 0; i < num; i++) ref[i] = sfzMat44TransformPointScalar(m, srcAt(i)); });
+			sfzBenchKeep(ref[num / 2]);
+
+			const f64 dirs_batch = mps([&]() { sfzMat44TransformDirs(m, dst.data(), src_ptr, stride, num); });
+			const f64 dirs_loop = mps([&]() { for (u64 i = 0; i < num; i++) ref[i] = sfzMat44TransformDir(m, srcAt(i)); });
+			CHECK(memcmp(dst.data(), ref.data(), num * sizeof(f32x3)) == 0);
+			const f64 dirs_scalar = mps([&]() { for (u64 i = 0; i < num; i++) ref[i] = sfzMat44TransformDirScalar(m, srcAt(i)); });
+			sfzBenchKeep(ref[num / 2]);
+
+			SFZ_BENCH_PRINT("stride %2llu B, %8llu: points batch %7.1f loop %7.1f scalar %7.1f | dirs batch %7.1f loop %7.1f scalar %7.1f",
+				stride, num, points_batch, points_loop, points_scalar, dirs_batch, dirs_loop, dirs_scalar);
+		}
+	}
+}
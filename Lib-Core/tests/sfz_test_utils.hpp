@@ -0,0 +1,57 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#pragma once
+
+#include "sfz.h"
+#include "skipifzero_allocators.hpp"
+
+// SfzTestCountingAllocator
+// ------------------------------------------------------------------------------------------------
+
+// Wraps the standard allocator and counts calls, to check when (and how often) containers
+// allocate. Not movable, as the SfzAllocator points back to it.
+struct SfzTestCountingAllocator final {
+	u64 num_allocs = 0;
+	u64 num_deallocs = 0;
+	u64 num_bytes_allocated = 0; // Total, not subtracted on dealloc
+	u64 max_align = 0;
+	SfzAllocator allocator = {};
+
+	SfzTestCountingAllocator()
+	{
+		allocator.impl_data = this;
+		allocator.alloc_func = [](void* impl, SfzDbgInfo dbg, u64 size, u64 align) -> void* {
+			SfzTestCountingAllocator& self = *static_cast<SfzTestCountingAllocator*>(impl);
+			self.num_allocs += 1;
+			self.num_bytes_allocated += size;
+			if (align > self.max_align) self.max_align = align;
+			return sfz::sfzStandardAlloc(nullptr, dbg, size, align);
+		};
+		allocator.dealloc_func = [](void* impl, void* ptr) {
+			if (ptr == nullptr) return;
+			static_cast<SfzTestCountingAllocator*>(impl)->num_deallocs += 1;
+			sfz::sfzStandardDealloc(nullptr, ptr);
+		};
+	}
+	SfzTestCountingAllocator(const SfzTestCountingAllocator&) = delete;
+	SfzTestCountingAllocator& operator= (const SfzTestCountingAllocator&) = delete;
+
+	SfzAllocator* ptr() { return &allocator; }
+	u64 numLive() const { return num_allocs - num_deallocs; }
+};
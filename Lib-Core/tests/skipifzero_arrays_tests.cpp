@@ -0,0 +1,863 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#include "doctest.h"
+#include "sfz_bench.hpp"
+#include "sfz_test_utils.hpp"
+
+#include "sfz.h"
+#include "sfz_cpp.hpp"
+#include "skipifzero_allocators.hpp"
+#include "skipifzero_arrays.hpp"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+static_assert(__is_trivially_destructible(SfzArrayLocal<u32, 16>), "");
+static_assert(!__is_trivially_destructible(SfzArrayLocal<std::string, 16>), "");
+static_assert(sizeof(SfzArrayLocal<u32, 4>) == sizeof(u32) * 4 + 16, "");
+
+namespace {
+
+struct Tracked {
+	static inline i32 num_alive = 0;
+	i32 value = -1;
+	Tracked() { num_alive += 1; }
+	explicit Tracked(i32 v) : value(v) { num_alive += 1; }
+	Tracked(const Tracked& o) : value(o.value) { num_alive += 1; }
+	Tracked& operator= (const Tracked& o) { value = o.value; return *this; }
+	~Tracked() { num_alive -= 1; }
+};
+
+struct alignas(64) CacheLine { u32 v[16]; };
+struct alignas(16) Vec4 { f32 v[4]; };
+static_assert(alignof(SfzArrayLocal<Vec4, 4>) == 16, "");
+
+// Applies the same random operations to two arrays and two std::vectors and checks that they agree.
+template<typename ArrT, typename T, bool IsSmallArray, typename Gen>
+void randomArrayOps(ArrT& a, ArrT& b, Gen gen)
+{
+	std::vector<T> va, vb;
+	std::mt19937 rng(1);
+	for (u32 it = 0; it < 50000; it++) {
+		const u32 op = rng() % 11;
+		const bool first = (rng() & 1) != 0;
+		ArrT& arr = first ? a : b;
+		std::vector<T>& ref = first ? va : vb;
+		switch (op) {
+		case 0:
+			if (arr.size() < 64) {
+				const T t = gen();
+				arr.add(t);
+				ref.push_back(t);
+			}
+			break;
+		case 1:
+			if (arr.size() > 0) {
+				const T t = arr.pop();
+				REQUIRE(t == ref.back());
+				ref.pop_back();
+			}
+			break;
+		case 2:
+			if (arr.size() > 0) {
+				const u32 pos = u32(rng() % arr.size());
+				const u32 num = 1 + u32(rng() % 3);
+				arr.remove(pos, num);
+				ref.erase(ref.begin() + pos, ref.begin() + std::min<size_t>(ref.size(), pos + num));
+			}
+			break;
+		case 3: {
+			const u32 num = u32(rng() % 4);
+			if (arr.size() + num <= 64) {
+				const u32 pos = u32(rng() % (arr.size() + 1));
+				T ts[4];
+				for (u32 i = 0; i < num; i++) ts[i] = gen();
+				arr.insert(pos, ts, num);
+				ref.insert(ref.begin() + pos, ts, ts + num);
+			}
+		} break;
+		case 4:
+			a.swap(b);
+			std::swap(va, vb);
+			break;
+		case 5:
+			if (rng() % 10 == 0) {
+				arr.clear();
+				ref.clear();
+			}
+			break;
+		case 6:
+			if constexpr (IsSmallArray) {
+				arr.setCapacity(u32(rng() % 20));
+			}
+			else {
+				const u32 size = u32(rng() % 65);
+				arr.setSize(size);
+				ref.resize(size);
+			}
+			break;
+		case 7: {
+			ArrT tmp = sfz_move(arr);
+			arr = sfz_move(tmp);
+		} break;
+		case 8:
+			if (arr.size() > 0) {
+				const u32 pos = u32(rng() % arr.size());
+				arr.removeQuickSwap(pos);
+				std::swap(ref[pos], ref.back());
+				ref.pop_back();
+			}
+			break;
+		case 9:
+			if constexpr (std::is_copy_assignable_v<ArrT>) {
+				b = a;
+				vb = va;
+			}
+			break;
+		case 10:
+			if (arr.size() + 2 <= 64) {
+				const T t = gen();
+				arr.add(t, 2);
+				ref.push_back(t);
+				ref.push_back(t);
+			}
+			break;
+		}
+
+		for (u32 k = 0; k < 2; k++) {
+			const ArrT& x = k == 0 ? a : b;
+			const std::vector<T>& w = k == 0 ? va : vb;
+			REQUIRE(x.size() == w.size());
+			if constexpr (IsSmallArray) REQUIRE(x.isInline() == (x.capacity() == 4));
+			bool equal = true;
+			for (u32 i = 0; i < x.size(); i++) equal = equal && x[i] == w[i];
+			REQUIRE(equal);
+		}
+	}
+}
+
+template<typename T>
+void simdSearchTest(SfzAllocator* allocator)
+{
+	std::mt19937 rng(u32(sizeof(T) * 2 + std::is_signed_v<T>));
+	for (u32 it = 0; it < 1000; it++) {
+		const u32 n = rng() % 300;
+		SfzArray<T> a(n, allocator, sfz_dbg(""));
+		SfzArrayLocal<T, 300> l;
+		SfzSmallArray<T, 8> s(0, allocator, sfz_dbg(""));
+		std::vector<T> v;
+		const u32 range = 1 + rng() % 50;
+		for (u32 i = 0; i < n; i++) {
+			const T x = T(u64(rng() % range) * 0x0101010101010101ull - (rng() % 2) * 17);
+			a.add(x);
+			l.add(x);
+			s.add(x);
+			v.push_back(x);
+		}
+
+		for (u32 q = 0; q < 20; q++) {
+			const T x = (q < 10 && n > 0) ? v[rng() % n] : T(u64(rng() % range) * 0x0101010101010101ull);
+			const u32 ref_idx = u32(std::find(v.begin(), v.end(), x) - v.begin());
+			const T* f = a.findElement(x);
+			CHECK((f != nullptr ? u32(f - a.data()) : n) == ref_idx);
+			const T* fl = l.findElement(x);
+			CHECK((fl != nullptr ? u32(fl - l.data()) : n) == ref_idx);
+			CHECK(s.contains(x) == (ref_idx < n));
+			const u32 ref_count = u32(std::count(v.begin(), v.end(), x));
+			CHECK(a.count(x) == ref_count);
+			CHECK(l.count(x) == ref_count);
+			CHECK(s.count(x) == ref_count);
+		}
+
+		if (n == 0) {
+			CHECK(a.minElement() == nullptr);
+			CHECK(l.maxElement() == nullptr);
+			CHECK(s.minElement() == nullptr);
+		}
+		else {
+			CHECK(a.minElement() == a.data() + (std::min_element(v.begin(), v.end()) - v.begin()));
+			CHECK(l.maxElement() == l.data() + (std::max_element(v.begin(), v.end()) - v.begin()));
+		}
+	}
+}
+
+// Places a single needle at every position in arrays of every size up to a few vectors, so all
+// the unrolled, single vector and scalar tail loops are exercised. Elements past the size are set
+// to the needle and must never be found.
+template<typename T>
+void simdSearchBoundaryTest(SfzAllocator* allocator)
+{
+	constexpr u32 MAX_N = 4 * 32 + 40;
+	const T needle = T(0x5A5A5A5A5A5A5A5Aull);
+	const T lo = std::is_signed_v<T> ? T(u64(1) << (sizeof(T) * 8 - 1)) : T(0); // Min value
+	const T hi = T(~u64(lo) & (~u64(0) >> (64 - sizeof(T) * 8))); // Max value
+	SfzArray<T> arr(MAX_N + 1, allocator, sfz_dbg(""));
+	bool ok = true;
+	for (u32 n = 0; n <= MAX_N; n++) {
+		for (u32 pos = 0; pos <= n; pos++) {
+			arr.clear();
+			for (u32 i = 0; i < n; i++) arr.add(i == pos ? needle : T(i % 50));
+			arr.add(needle);
+			arr.pop(); // Stale needle just past the end
+			const u32 expected = pos < n ? pos : n;
+			const T* found = arr.findElement(needle);
+			ok = ok && (found != nullptr ? u32(found - arr.data()) : n) == expected;
+			ok = ok && arr.count(needle) == (pos < n ? 1u : 0u);
+		}
+		if (n > 0) {
+			// Extremes at the last position, checks the sign bias of unsigned compares and the tail
+			arr.clear();
+			for (u32 i = 0; i < n; i++) arr.add(T(1));
+			arr[n - 1] = lo;
+			ok = ok && arr.minElement() == arr.data() + n - 1;
+			arr[n - 1] = hi;
+			ok = ok && arr.maxElement() == arr.data() + n - 1;
+			arr[0] = hi;
+			ok = ok && arr.maxElement() == arr.data(); // First of equal elements
+		}
+	}
+	CHECK(ok);
+}
+
+// Stand-in for the previous SfzArrayLocal, which stored Capacity constructed elements and swapped
+// all of them (used as the baseline in the benchmarks).
+template<typename T, u32 Capacity>
+struct EagerArrayLocal final {
+	T m_data[Capacity];
+	u32 m_size = 0;
+	EagerArrayLocal() = default;
+	EagerArrayLocal(EagerArrayLocal&& other) noexcept { this->swap(other); }
+	void swap(EagerArrayLocal& other)
+	{
+		for (u32 i = 0; i < Capacity; i++) sfzSwap(m_data[i], other.m_data[i]);
+		sfzSwap(m_size, other.m_size);
+	}
+	void clear() { for (u32 i = 0; i < m_size; i++) m_data[i] = {}; m_size = 0; }
+	void add(const T& value) { m_data[m_size] = value; m_size += 1; }
+	u32 size() const { return m_size; }
+	const T& operator[] (u32 idx) const { return m_data[idx]; }
+};
+
+} // namespace
+
+// SfzArrayLocal
+// ------------------------------------------------------------------------------------------------
+
+TEST_CASE("SfzArrayLocal: random operations against std::vector")
+{
+	u32 counter = 0;
+	SUBCASE("u32") {
+		SfzArrayLocal<u32, 64> a, b;
+		randomArrayOps<SfzArrayLocal<u32, 64>, u32, false>(a, b, [&]() { return counter++; });
+		a.sort();
+		bool sorted = true;
+		for (u32 i = 1; i < a.size(); i++) sorted = sorted && a[i - 1] <= a[i];
+		CHECK(sorted);
+	}
+	SUBCASE("std::string") {
+		std::mt19937 rng(2);
+		SfzArrayLocal<std::string, 64> a, b;
+		randomArrayOps<SfzArrayLocal<std::string, 64>, std::string, false>(a, b, [&]() {
+			return std::string(rng() % 40, char('a' + (counter++ % 26)));
+		});
+	}
+}
+
+TEST_CASE("SfzArrayLocal: only live elements are constructed and destroyed")
+{
+	Tracked::num_alive = 0;
+	{
+		SfzArr512<Tracked> a;
+		CHECK(Tracked::num_alive == 0);
+		for (i32 i = 0; i < 3; i++) a.add(Tracked(i));
+		CHECK(Tracked::num_alive == 3);
+
+		SfzArr512<Tracked> b = a;
+		CHECK(Tracked::num_alive == 6);
+		b.add();
+		b.add();
+		CHECK(Tracked::num_alive == 8);
+		CHECK(b.last().value == -1);
+
+		// Swapping arrays of different sizes moves the extra elements over
+		a.swap(b);
+		CHECK(a.size() == 5);
+		CHECK(b.size() == 3);
+		CHECK(Tracked::num_alive == 8);
+
+		SfzArr512<Tracked> c = sfz_move(a);
+		CHECK(c.size() == 5);
+		CHECK(a.size() == 0);
+		CHECK(Tracked::num_alive == 8);
+
+		c.setSize(100);
+		CHECK(Tracked::num_alive == 103);
+		c.setSize(2);
+		CHECK(Tracked::num_alive == 5);
+		CHECK(c[1].value == 1);
+
+		c.insert(1, Tracked(7));
+		CHECK(Tracked::num_alive == 6);
+		CHECK(c[1].value == 7);
+		CHECK(c[2].value == 1);
+		c.remove(0, 2);
+		CHECK(Tracked::num_alive == 4);
+		CHECK(c.pop().value == 1);
+		CHECK(Tracked::num_alive == 3);
+		CHECK(c.isEmpty());
+
+		b.clear();
+		CHECK(Tracked::num_alive == 0);
+		b.add(Tracked(9));
+		c = b;
+		CHECK(Tracked::num_alive == 2);
+	}
+	CHECK(Tracked::num_alive == 0);
+
+	SfzArrayLocal<Vec4, 4> vecs;
+	vecs.add(Vec4{ { 1.0f, 2.0f, 3.0f, 4.0f } });
+	CHECK(uintptr_t(vecs.data()) % 16 == 0);
+	CHECK(vecs[0].v[3] == 4.0f);
+}
+
+// SfzSmallArray
+// ------------------------------------------------------------------------------------------------
+
+TEST_CASE("SfzSmallArray: random operations against std::vector")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	u32 counter = 0;
+	SUBCASE("u32") {
+		SfzSmallArray<u32, 4> a(0, &allocator, sfz_dbg("")), b(0, &allocator, sfz_dbg(""));
+		randomArrayOps<SfzSmallArray<u32, 4>, u32, true>(a, b, [&]() { return counter++; });
+		CHECK(a.allocator() == &allocator);
+		CHECK(b.allocator() == &allocator);
+	}
+	SUBCASE("std::string") {
+		std::mt19937 rng(2);
+		SfzSmallArray<std::string, 4> a(0, &allocator, sfz_dbg("")), b(0, &allocator, sfz_dbg(""));
+		randomArrayOps<SfzSmallArray<std::string, 4>, std::string, true>(a, b, [&]() {
+			return std::string(rng() % 40, char('a' + (counter++ % 26)));
+		});
+		CHECK(a.allocator() == &allocator);
+		CHECK(b.allocator() == &allocator);
+	}
+}
+
+TEST_CASE("SfzSmallArray: only allocates when growing beyond N")
+{
+	SfzSmallArray<u32, 4> no_allocator;
+	for (u32 i = 0; i < 4; i++) no_allocator.add(i);
+	CHECK(no_allocator.isInline());
+	CHECK(no_allocator.capacity() == 4);
+	CHECK(no_allocator[3] == 3);
+
+	SfzTestCountingAllocator counting;
+	SfzSmallArray<u32, 8> arr(8, counting.ptr(), sfz_dbg(""));
+	for (u32 i = 0; i < 8; i++) arr.add(i);
+	CHECK(arr.isInline());
+	CHECK(counting.num_allocs == 0);
+	arr.add(8);
+	CHECK(!arr.isInline());
+	CHECK(counting.num_allocs == 1);
+	CHECK(counting.max_align == 32);
+	for (u32 i = 9; i < 1000; i++) arr.add(i);
+	const u64 num_allocs = counting.num_allocs;
+	CHECK(num_allocs < 16);
+
+	// Moving a spilled array steals its buffer
+	SfzSmallArray<u32, 8> moved = sfz_move(arr);
+	CHECK(counting.num_allocs == num_allocs);
+	CHECK(arr.isEmpty());
+	CHECK(arr.isInline());
+	CHECK(moved[999] == 999);
+
+	// Shrinking to N or less moves the elements back inline
+	moved.remove(8, moved.size() - 8);
+	moved.setCapacity(0);
+	CHECK(moved.isInline());
+	CHECK(moved.capacity() == 8);
+	CHECK(moved[7] == 7);
+	CHECK(counting.numLive() == 0);
+	SfzSmallArray<u32, 8> big(9, counting.ptr(), sfz_dbg(""));
+	CHECK(!big.isInline());
+	big.destroy();
+	CHECK(counting.numLive() == 0);
+}
+
+TEST_CASE("SfzSmallArray: element lifetimes when spilling and moving")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	Tracked::num_alive = 0;
+	{
+		SfzSmallArray<Tracked, 4> a(0, &allocator, sfz_dbg(""));
+		CHECK(Tracked::num_alive == 0);
+		for (i32 i = 0; i < 3; i++) a.add(Tracked(i));
+		CHECK(Tracked::num_alive == 3);
+
+		// Moving an inline array moves the elements
+		SfzSmallArray<Tracked, 4> b = sfz_move(a);
+		CHECK(Tracked::num_alive == 3);
+		CHECK(b[2].value == 2);
+		for (i32 i = 3; i < 10; i++) b.add(Tracked(i));
+		CHECK(Tracked::num_alive == 10);
+		CHECK(!b.isInline());
+
+		a.add(Tracked(100));
+		a.swap(b);
+		CHECK(a.size() == 10);
+		CHECK(b.size() == 1);
+		CHECK(b[0].value == 100);
+		CHECK(Tracked::num_alive == 11);
+		a.remove(0, 8);
+		CHECK(Tracked::num_alive == 3);
+		a.setCapacity(0);
+		CHECK(a.isInline());
+		CHECK(a[1].value == 9);
+		CHECK(Tracked::num_alive == 3);
+	}
+	CHECK(Tracked::num_alive == 0);
+
+	SfzSmallArray<CacheLine, 2> lines(0, &allocator, sfz_dbg(""));
+	for (u32 i = 0; i < 5; i++) lines.add();
+	CHECK(uintptr_t(lines.data()) % 64 == 0);
+}
+
+// SfzChunkArray
+// ------------------------------------------------------------------------------------------------
+
+TEST_CASE("SfzChunkArray: chunk boundaries")
+{
+	SfzTestCountingAllocator counting;
+	SfzChunkArray<u32, 2> arr(0, counting.ptr(), sfz_dbg(""));
+	CHECK(counting.num_allocs == 0); // Capacity 0 only sets the allocator
+	CHECK(arr.capacity() == 0);
+	CHECK(arr.numChunks() == 0);
+
+	for (u32 i = 0; i < 4; i++) arr.add(i);
+	CHECK(arr.numChunks() == 1);
+	CHECK(arr.capacity() == 4);
+	CHECK(arr.chunkSize(0) == 4);
+	CHECK(counting.num_allocs == 2); // Array of chunk pointers and the first chunk
+
+	arr.add(4);
+	CHECK(arr.numChunks() == 2);
+	CHECK(arr.capacity() == 8);
+	CHECK(arr.chunkSize(1) == 1);
+	CHECK(arr.chunk(1)[0] == 4);
+	CHECK(arr[4] == 4);
+	CHECK(arr.first() == 0);
+	CHECK(arr.last() == 4);
+
+	// Growing past the initial array of chunk pointers must not move any element
+	std::vector<const u32*> ptrs;
+	for (u32 i = 0; i < arr.size(); i++) ptrs.push_back(&arr[i]);
+	for (u32 i = 5; i < 4 * SFZ_CHUNK_ARRAY_MIN_NUM_CHUNK_PTRS * 3; i++) ptrs.push_back(&arr.add(i));
+	CHECK(arr.numChunks() == SFZ_CHUNK_ARRAY_MIN_NUM_CHUNK_PTRS * 3);
+	bool stable = true;
+	for (u32 i = 0; i < arr.size(); i++) stable = stable && &arr[i] == ptrs[i] && arr[i] == i;
+	CHECK(stable);
+
+	// Each chunk is contiguous
+	u32 expected = 0;
+	bool contiguous = true;
+	arr.forEachChunk([&](const u32* elems, u32 num_elems) {
+		contiguous = contiguous && num_elems == 4;
+		for (u32 i = 0; i < num_elems; i++) contiguous = contiguous && elems[i] == expected++;
+	});
+	CHECK(contiguous);
+	CHECK(expected == arr.size());
+
+	arr.destroy();
+	CHECK(counting.numLive() == 0);
+}
+
+TEST_CASE("SfzChunkArray: chunk recycling")
+{
+	SfzTestCountingAllocator counting;
+	SUBCASE("Recycling keeps empty chunks for reuse") {
+		SfzChunkArray<u32, 4> arr(0, counting.ptr(), sfz_dbg(""), true);
+		for (u32 i = 0; i < 16 * 4; i++) arr.add(i);
+		const u64 num_allocs = counting.num_allocs;
+		for (u32 i = 0; i < 16 * 3; i++) arr.pop();
+		CHECK(arr.numChunks() == 1);
+		CHECK(arr.capacity() == 16 * 4);
+		CHECK(counting.num_deallocs == 0);
+		for (u32 i = 0; i < 16 * 3; i++) arr.add(i);
+		arr.clear();
+		for (u32 i = 0; i < 16 * 4; i++) arr.add(i);
+		CHECK(counting.num_allocs == num_allocs);
+
+		arr.clear();
+		arr.freeUnusedChunks();
+		CHECK(arr.capacity() == 0);
+		CHECK(counting.numLive() == 1); // Only the array of chunk pointers
+	}
+	SUBCASE("Without recycling chunks are freed as soon as they become empty") {
+		SfzChunkArray<u32, 4> arr(0, counting.ptr(), sfz_dbg(""), false);
+		for (u32 i = 0; i < 16 * 4; i++) arr.add(i);
+		CHECK(counting.numLive() == 5);
+		for (u32 i = 0; i < 15; i++) arr.pop();
+		CHECK(counting.numLive() == 5); // Last chunk still holds one element
+		arr.pop();
+		CHECK(counting.numLive() == 4);
+		CHECK(arr.capacity() == 16 * 3);
+		arr.clear();
+		CHECK(counting.numLive() == 1);
+		CHECK(arr.capacity() == 0);
+	}
+	CHECK(counting.numLive() == 0);
+}
+
+TEST_CASE("SfzChunkArray: element lifetimes and alignment")
+{
+	SfzTestCountingAllocator counting;
+	Tracked::num_alive = 0;
+	{
+		SfzChunkArray<Tracked, 3> arr(20, counting.ptr(), sfz_dbg(""));
+		CHECK(arr.capacity() == 24);
+		CHECK(Tracked::num_alive == 0); // Capacity is raw memory
+		for (i32 i = 0; i < 20; i++) arr.add(Tracked(i));
+		CHECK(Tracked::num_alive == 20);
+		CHECK(arr.pop().value == 19);
+		CHECK(Tracked::num_alive == 19);
+
+		SfzChunkArray<Tracked, 3> moved = sfz_move(arr);
+		CHECK(arr.size() == 0);
+		CHECK(moved.size() == 19);
+		CHECK(moved.last().value == 18);
+		moved.clear();
+		CHECK(Tracked::num_alive == 0);
+		for (i32 i = 0; i < 5; i++) moved.add(Tracked(i));
+	}
+	CHECK(Tracked::num_alive == 0);
+	CHECK(counting.numLive() == 0);
+
+	SfzChunkArray<CacheLine, 2> lines(0, counting.ptr(), sfz_dbg(""));
+	for (u32 i = 0; i < 20; i++) lines.add();
+	bool aligned = true;
+	for (u32 i = 0; i < 20; i++) aligned = aligned && uintptr_t(&lines[i]) % 64 == 0;
+	CHECK(aligned);
+	CHECK(counting.max_align == 64);
+}
+
+TEST_CASE("SfzChunkArray: random add/pop/clear keeps pointers stable")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	for (u32 recycle = 0; recycle < 2; recycle++) {
+		SfzChunkArray<std::string, 4> arr(0, &allocator, sfz_dbg(""), recycle == 1);
+		std::vector<std::string> ref;
+		std::vector<std::string*> ptrs;
+		std::mt19937 rng(4);
+		for (u32 it = 0; it < 20000; it++) {
+			if (rng() % 3 != 0 || ref.empty()) {
+				const std::string s = std::to_string(rng());
+				ptrs.push_back(&arr.add(s));
+				ref.push_back(s);
+			}
+			else {
+				REQUIRE(arr.pop() == ref.back());
+				ref.pop_back();
+				ptrs.pop_back();
+			}
+			if (it == 10000) {
+				arr.clear();
+				ref.clear();
+				ptrs.clear();
+			}
+		}
+
+		REQUIRE(arr.size() == ref.size());
+		bool equal = true;
+		for (u32 i = 0; i < ref.size(); i++) equal = equal && arr[i] == ref[i] && &arr[i] == ptrs[i];
+		CHECK(equal);
+	}
+}
+
+// SIMD search
+// ------------------------------------------------------------------------------------------------
+
+TEST_CASE("SfzArray: findElement/contains/count/minElement/maxElement against std")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	simdSearchTest<u8>(&allocator);
+	simdSearchTest<i8>(&allocator);
+	simdSearchTest<u16>(&allocator);
+	simdSearchTest<i16>(&allocator);
+	simdSearchTest<u32>(&allocator);
+	simdSearchTest<i32>(&allocator);
+	simdSearchTest<u64>(&allocator);
+	simdSearchTest<i64>(&allocator);
+}
+
+TEST_CASE("SfzArray: SIMD search vector boundaries and extremes")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	simdSearchBoundaryTest<u8>(&allocator);
+	simdSearchBoundaryTest<i8>(&allocator);
+	simdSearchBoundaryTest<u16>(&allocator);
+	simdSearchBoundaryTest<i16>(&allocator);
+	simdSearchBoundaryTest<u32>(&allocator);
+	simdSearchBoundaryTest<i32>(&allocator);
+	simdSearchBoundaryTest<u64>(&allocator);
+	simdSearchBoundaryTest<i64>(&allocator);
+
+	SfzArray<SfzHandle> handles(0, &allocator, sfz_dbg(""));
+	for (u32 i = 0; i < 100; i++) handles.add(sfzHandleInit(i, 1));
+	CHECK(handles.contains(sfzHandleInit(77, 1)));
+	CHECK(!handles.contains(sfzHandleInit(77, 2)));
+	CHECK(handles.findElement(sfzHandleInit(50, 1)) == handles.data() + 50);
+	CHECK(handles.count(sfzHandleInit(3, 1)) == 1);
+
+	SfzArray<u32> empty(0, &allocator, sfz_dbg(""));
+	CHECK(empty.findElement(0) == nullptr);
+	CHECK(empty.count(0) == 0);
+	CHECK(empty.minElement() == nullptr);
+	CHECK(empty.maxElement() == nullptr);
+}
+
+// Benchmarks
+// ------------------------------------------------------------------------------------------------
+
+SFZ_BENCHMARK("SfzChunkArray: append throughput and tail latency against SfzArray")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	struct Elem { u64 v[4]; };
+	constexpr u32 NUM_ELEMS = 1u << 23;
+
+	// Times every single add, the worst adds are the ones where SfzArray grows and copies
+	std::vector<f32> latencies(NUM_ELEMS);
+	auto appendAll = [&](auto& arr, const char* name) {
+		SfzBenchTimer total;
+		for (u32 i = 0; i < NUM_ELEMS; i++) {
+			SfzBenchTimer timer;
+			arr.add(Elem{ { i, i, i, i } });
+			latencies[i] = f32(timer.elapsedNs());
+		}
+		const f64 total_ms = total.elapsedMs();
+		std::sort(latencies.begin(), latencies.end());
+		SFZ_BENCH_PRINT("%-13s %u adds: %7.2f ms (timed individually), p99.99 %7.0f ns, max %10.0f ns",
+			name, NUM_ELEMS, total_ms, latencies[NUM_ELEMS - NUM_ELEMS / 10000], latencies.back());
+		CHECK(arr[NUM_ELEMS - 1].v[3] == NUM_ELEMS - 1);
+	};
+
+	// Untimed appends, for throughput
+	auto throughput = [&](auto make, const char* name) {
+		u64 sum = 0;
+		const f64 ms = sfzBenchMs(5, [&]() {
+			auto arr = make();
+			for (u32 i = 0; i < NUM_ELEMS; i++) arr.add(Elem{ { i, i, i, i } });
+			sum += arr[NUM_ELEMS / 2].v[0];
+		});
+		sfzBenchKeep(sum);
+		SFZ_BENCH_PRINT("%-13s %u adds: %7.2f ms, %6.1f M adds/s", name, NUM_ELEMS, ms, f64(NUM_ELEMS) / (ms * 1000.0));
+	};
+
+	throughput([&]() { return SfzArray<Elem>(0, &allocator, sfz_dbg("")); }, "SfzArray");
+	throughput([&]() { return SfzChunkArray<Elem>(0, &allocator, sfz_dbg("")); }, "SfzChunkArray");
+	{
+		SfzArray<Elem> arr(0, &allocator, sfz_dbg(""));
+		appendAll(arr, "SfzArray");
+	}
+	{
+		SfzChunkArray<Elem> arr(0, &allocator, sfz_dbg(""));
+		appendAll(arr, "SfzChunkArray");
+	}
+}
+
+namespace {
+
+struct Foo {
+	u32 id = 0;
+	f32 weight = 1.0f;
+	u64 handle = 0;
+};
+
+// Constructs an array, adds 3 elements, moves and swaps it, then clears it.
+template<typename ArrT>
+f64 benchArrayLocalLifecycle(u32 num_reps, u64& checksum)
+{
+	checksum = 0;
+	SfzBenchTimer timer;
+	for (u32 i = 0; i < num_reps; i++) {
+		ArrT a;
+		for (u32 j = 0; j < 3; j++) a.add(Foo{ i + j, 1.0f, u64(j) });
+		ArrT b = sfz_move(a);
+		ArrT c;
+		c.swap(b);
+		checksum += c[2].id + c.size();
+		c.clear();
+	}
+	return timer.elapsedNs() / f64(num_reps);
+}
+
+template<u32 Capacity>
+void benchArrayLocal(const char* alias)
+{
+	constexpr u32 NUM_REPS = 1u << 18;
+	u64 checksum_lazy = 0, checksum_eager = 0;
+	benchArrayLocalLifecycle<SfzArrayLocal<Foo, Capacity>>(NUM_REPS / 8, checksum_lazy); // Warm up
+	const f64 lazy_ns = benchArrayLocalLifecycle<SfzArrayLocal<Foo, Capacity>>(NUM_REPS, checksum_lazy);
+	const f64 eager_ns = benchArrayLocalLifecycle<EagerArrayLocal<Foo, Capacity>>(NUM_REPS, checksum_eager);
+	CHECK(checksum_lazy == checksum_eager);
+	SFZ_BENCH_PRINT("%-9s construct + 3 adds + move + swap + clear: %8.1f ns, previous (eager) %8.1f ns (%5.1fx)",
+		alias, lazy_ns, eager_ns, eager_ns / lazy_ns);
+}
+
+} // namespace
+
+SFZ_BENCHMARK("SfzArrayLocal: lifecycle with 3 elements over the SfzArr4...SfzArr512 aliases")
+{
+	benchArrayLocal<4>("SfzArr4");
+	benchArrayLocal<8>("SfzArr8");
+	benchArrayLocal<16>("SfzArr16");
+	benchArrayLocal<32>("SfzArr32");
+	benchArrayLocal<64>("SfzArr64");
+	benchArrayLocal<128>("SfzArr128");
+	benchArrayLocal<256>("SfzArr256");
+	benchArrayLocal<512>("SfzArr512");
+}
+
+namespace {
+
+// Simulated ZeroUI widget tree, every widget has an array of child widget indices
+template<typename ChildArrT>
+struct Widget {
+	u32 parent = ~0u;
+	ChildArrT children;
+};
+
+// Number of children per widget, most widgets are leaves or have a handful of children (buttons
+// in a row, items in a list), a few are large lists.
+std::vector<u32> widgetTreeShape(u32 num_widgets)
+{
+	std::mt19937 rng(41);
+	std::vector<u32> num_children;
+	u32 num_total = 1;
+	for (u32 i = 0; i < num_total && num_total < num_widgets; i++) {
+		const u32 r = rng() % 100;
+		u32 n = r < 60 ? 0 : r < 98 ? 1 + rng() % 7 : 20 + rng() % 40;
+		if (i == 0) n = 8;
+		n = u32_min(n, num_widgets - num_total);
+		num_children.push_back(n);
+		num_total += n;
+	}
+	num_children.resize(num_total, 0);
+	return num_children;
+}
+
+template<typename ChildArrT, typename MakeFunc>
+void benchWidgetTree(const std::vector<u32>& shape, const char* name, MakeFunc make)
+{
+	SfzTestCountingAllocator counting;
+	u64 checksum = 0;
+	const f64 ms = sfzBenchMs(5, [&]() {
+		std::vector<Widget<ChildArrT>> widgets(shape.size());
+		u32 next = 1;
+		for (u32 i = 0; i < shape.size(); i++) {
+			widgets[i].children = make(counting.ptr());
+			for (u32 j = 0; j < shape[i]; j++) {
+				widgets[next].parent = i;
+				widgets[i].children.add(next);
+				next += 1;
+			}
+		}
+		u64 sum = 0;
+		for (const Widget<ChildArrT>& w : widgets) sum += w.children.size();
+		checksum = sum;
+	});
+	CHECK(checksum == shape.size() - 1);
+	SFZ_BENCH_PRINT("%-24s %7.2f ms per build, %7.0f allocations per build, %4u bytes per widget",
+		name, ms, f64(counting.num_allocs) / 6.0, u32(sizeof(Widget<ChildArrT>)));
+}
+
+} // namespace
+
+SFZ_BENCHMARK("SfzSmallArray: allocations and build time for a simulated widget tree")
+{
+	const std::vector<u32> shape = widgetTreeShape(100000);
+	u32 num_small = 0;
+	for (u32 n : shape) num_small += n <= 8 ? 1 : 0;
+	SFZ_BENCH_PRINT("%u widgets, %.1f%% with at most 8 children", u32(shape.size()), 100.0 * num_small / shape.size());
+
+	benchWidgetTree<SfzArray<u32>>(shape, "SfzArray<u32>", [](SfzAllocator* a) {
+		return SfzArray<u32>(0, a, sfz_dbg(""));
+	});
+	benchWidgetTree<SfzSmallArray<u32, 8>>(shape, "SfzSmallArray<u32, 8>", [](SfzAllocator* a) {
+		return SfzSmallArray<u32, 8>(0, a, sfz_dbg(""));
+	});
+	benchWidgetTree<SfzArrayLocal<u32, 64>>(shape, "SfzArrayLocal<u32, 64>", [](SfzAllocator*) {
+		return SfzArrayLocal<u32, 64>();
+	});
+}
+
+namespace {
+
+template<typename T>
+void benchSimdSearch(SfzAllocator* allocator, const char* type_name)
+{
+	for (u32 n : { 16u, 256u, 4096u, 65536u, 1u << 20 }) {
+		SfzArray<T> arr(n, allocator, sfz_dbg(""));
+		std::mt19937_64 rng(n);
+		for (u32 i = 0; i < n; i++) arr.add(T(1 + rng() % 100));
+		const T missing = T(0);
+		const u32 num_reps = u32_max(1, (1u << 26) / n);
+
+		// Every query scans the whole array (the value is missing, or everything is counted)
+		u64 simd_sum = 0, scalar_sum = 0;
+		auto run = [&](auto func) {
+			u64 sum = 0;
+			const f64 ms = sfzBenchMs(1, [&]() {
+				for (u32 r = 0; r < num_reps; r++) sum += func();
+			});
+			return std::make_pair(ms * 1000000.0 / (f64(num_reps) * f64(n)), sum);
+		};
+		const auto find_simd = run([&]() { return u64(arr.findElement(missing) == nullptr ? n : 0); });
+		const auto find_scalar = run([&]() { return u64(std::find(arr.begin(), arr.end(), missing) - arr.begin()); });
+		const auto count_simd = run([&]() { return u64(arr.count(arr[0])); });
+		const auto count_scalar = run([&]() {
+			u32 count = 0;
+			for (const T& x : arr) count += (x == arr[0]) ? 1 : 0;
+			return u64(count);
+		});
+		const auto min_simd = run([&]() { return u64(arr.minElement() - arr.data()); });
+		const auto min_scalar = run([&]() { return u64(std::min_element(arr.begin(), arr.end()) - arr.begin()); });
+		simd_sum = find_simd.second + count_simd.second + min_simd.second;
+		scalar_sum = find_scalar.second + count_scalar.second + min_scalar.second;
+		CHECK(simd_sum == scalar_sum);
+
+		SFZ_BENCH_PRINT("%-3s %8u elems (ns/elem): find %6.3f vs std::find %6.3f | count %6.3f vs loop %6.3f | min %6.3f vs std::min_element %6.3f",
+			type_name, n, find_simd.first, find_scalar.first, count_simd.first, count_scalar.first,
+			min_simd.first, min_scalar.first);
+	}
+}
+
+} // namespace
+
+SFZ_BENCHMARK("SfzArray: SIMD findElement/count/minElement against scalar code for 16 to 1M elements")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	benchSimdSearch<u8>(&allocator, "u8");
+	benchSimdSearch<u32>(&allocator, "u32");
+	benchSimdSearch<u64>(&allocator, "u64");
+}
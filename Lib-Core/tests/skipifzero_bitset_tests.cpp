@@ -0,0 +1,297 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#include "doctest.h"
+#include "sfz_bench.hpp"
+#include "sfz_test_utils.hpp"
+
+#include "sfz.h"
+#include "sfz_cpp.hpp"
+#include "skipifzero_allocators.hpp"
+#include "skipifzero_bitset.hpp"
+
+#include <random>
+#include <vector>
+
+TEST_CASE("SfzBitset: empty bitset")
+{
+	SfzTestCountingAllocator counting;
+	SfzBitset bits(0, counting.ptr(), sfz_dbg(""));
+	CHECK(counting.num_allocs == 0);
+	CHECK(bits.numBits() == 0);
+	CHECK(bits.numWords() == 0);
+	CHECK(bits.popCount() == 0);
+	CHECK(bits.none());
+	CHECK(bits.findFirstSet() == ~0u);
+	bits.setAll();
+	bits.clearAll();
+	bits.andWith(bits);
+	u32 num_visited = 0;
+	bits.forEachSet([&](u32) { num_visited += 1; });
+	CHECK(num_visited == 0);
+
+	SfzBitRankSelect rs;
+	rs.init(counting.ptr());
+	rs.build(bits);
+	CHECK(rs.total() == 0);
+	CHECK(rs.rank(0) == 0);
+	CHECK(rs.select(0) == ~0u);
+	rs.destroy();
+	CHECK(counting.num_allocs == 0);
+}
+
+TEST_CASE("SfzBitset: bits past numBits() stay zero at word boundaries")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	const u32 sizes[] = { 1, 63, 64, 65, 127, 128, 129, 255, 256, 257, 511, 512, 513 };
+	for (u32 n : sizes) {
+		CAPTURE(n);
+		SfzBitset all(n, &allocator, sfz_dbg("")), x(n, &allocator, sfz_dbg(""));
+		all.setAll();
+		CHECK(all.popCount() == n);
+		CHECK((all.words()[all.numWords() - 1] & ~sfzBitsLastWordMask(n)) == 0);
+		CHECK(all.findFirstSet() == 0);
+		CHECK(all.findNextSet(n - 1) == n - 1);
+		CHECK(all.findNextSet(n) == ~0u);
+
+		// Inverting through xor must not set the unused bits of the last word
+		x.set(n - 1);
+		x.xorWith(all);
+		CHECK(x.popCount() == n - 1);
+		CHECK(!x.isSet(n - 1));
+		CHECK(x.findNextSet(n - 1) == ~0u);
+		x.andNotWith(all);
+		CHECK(x.none());
+		x.orWith(all);
+		CHECK(x.popCount() == n);
+
+		// Last bit found by iteration
+		u32 last = ~0u;
+		all.forEachSet([&](u32 idx) { last = idx; });
+		CHECK(last == n - 1);
+	}
+}
+
+TEST_CASE("SfzBitset: resizing")
+{
+	SfzTestCountingAllocator counting;
+	SfzBitset bits(100, counting.ptr(), sfz_dbg(""));
+	CHECK(counting.num_allocs == 1);
+	CHECK(counting.max_align == 32);
+	bits.setAll();
+
+	// Shrinking into the middle of a word clears the removed bits, growing back shows zeros
+	bits.setNumBits(70);
+	CHECK(bits.popCount() == 70);
+	bits.setNumBits(256); // Capacity is rounded up to 4 words, so this doesn't reallocate
+	CHECK(counting.num_allocs == 1);
+	CHECK(bits.popCount() == 70);
+	CHECK(bits.findNextSet(70) == ~0u);
+
+	// Growing past capacity keeps the bits
+	bits.set(255);
+	bits.setNumBits(1000);
+	CHECK(counting.num_allocs == 2);
+	CHECK(counting.numLive() == 1);
+	CHECK(bits.popCount() == 71);
+	CHECK(bits.findNextSet(70) == 255);
+
+	bits.setNumBits(0);
+	CHECK(bits.none());
+	bits.setNumBits(1000);
+	CHECK(bits.none());
+	bits.destroy();
+	CHECK(counting.numLive() == 0);
+}
+
+TEST_CASE("SfzBitRankSelect: block boundaries")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	SfzBitset bits(2048, &allocator, sfz_dbg(""));
+	const u32 set_bits[] = { 0, 63, 64, 511, 512, 513, 1023, 1024, 2047 };
+	for (u32 idx : set_bits) bits.set(idx);
+
+	SfzBitRankSelect rs;
+	rs.init(&allocator);
+	rs.build(bits);
+	CHECK(rs.total() == 9);
+	for (u32 i = 0; i < 9; i++) {
+		CHECK(rs.rank(set_bits[i]) == i);
+		CHECK(rs.rank(set_bits[i] + 1) == i + 1);
+		CHECK(rs.select(i) == set_bits[i]);
+	}
+	CHECK(rs.rank(2048) == 9);
+	CHECK(rs.select(9) == ~0u);
+
+	// Empty blocks in the middle
+	bits.clearAll();
+	bits.set(5);
+	bits.set(1900);
+	rs.build(bits);
+	CHECK(rs.rank(1024) == 1);
+	CHECK(rs.select(1) == 1900);
+
+	SfzBitsetLocal<130> local;
+	local.set(129);
+	rs.build(local);
+	CHECK(rs.select(0) == 129);
+	CHECK(rs.rank(129) == 0);
+	CHECK(rs.rank(130) == 1);
+}
+
+TEST_CASE("SfzBitsetLocal: set algebra")
+{
+	SfzBitsetLocal<130> a;
+	CHECK(a.none());
+	a.set(129);
+	a.set(3);
+	a.toggle(64);
+	a.toggle(64);
+	CHECK(!a.isSet(64));
+	SfzBitsetLocal<130> b;
+	b.setAll();
+	CHECK(b.popCount() == 130);
+	CHECK((b.words()[2] >> 2) == 0);
+	b.andWith(a);
+	CHECK(b.popCount() == 2);
+	CHECK(b.findFirstSet() == 3);
+	CHECK(b.findNextSet(4) == 129);
+	b.setTo(129, false);
+	CHECK(b.findNextSet(4) == ~0u);
+
+	SfzBitsetLocal<64> one_word;
+	one_word.setAll();
+	CHECK(one_word.popCount() == 64);
+	CHECK(one_word.findNextSet(63) == 63);
+}
+
+TEST_CASE("SfzBitset: set algebra, iteration and rank/select against std::vector<bool>")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	std::mt19937 rng(5);
+	for (u32 round = 0; round < 200; round++) {
+		const u32 n = rng() % 3000;
+		SfzBitset x(n, &allocator, sfz_dbg("")), y(n, &allocator, sfz_dbg(""));
+		std::vector<bool> rx(n), ry(n);
+		for (u32 i = 0; i < n; i++) {
+			if (rng() % 4 == 0) { x.set(i); rx[i] = true; }
+			if (rng() % 3 == 0) { y.set(i); ry[i] = true; }
+		}
+
+		switch (rng() % 5) {
+		case 0: x.andWith(y); for (u32 i = 0; i < n; i++) rx[i] = rx[i] && ry[i]; break;
+		case 1: x.orWith(y); for (u32 i = 0; i < n; i++) rx[i] = rx[i] || ry[i]; break;
+		case 2: x.andNotWith(y); for (u32 i = 0; i < n; i++) rx[i] = rx[i] && !ry[i]; break;
+		case 3: x.xorWith(y); for (u32 i = 0; i < n; i++) rx[i] = rx[i] != ry[i]; break;
+		case 4: x.setAll(); for (u32 i = 0; i < n; i++) rx[i] = true; break;
+		}
+
+		u64 pop_count = 0;
+		bool bits_ok = true;
+		for (u32 i = 0; i < n; i++) {
+			bits_ok = bits_ok && x.isSet(i) == rx[i];
+			pop_count += rx[i] ? 1 : 0;
+		}
+		REQUIRE(bits_ok);
+		REQUIRE(x.popCount() == pop_count);
+
+		std::vector<u32> visited;
+		x.forEachSet([&](u32 i) { visited.push_back(i); });
+		CHECK(visited.size() == pop_count);
+		u32 idx = x.findFirstSet();
+		for (u32 i = 0; i < n; i++) {
+			if (!rx[i]) continue;
+			REQUIRE(idx == i);
+			idx = x.findNextSet(i + 1);
+		}
+		CHECK(idx == ~0u);
+
+		SfzBitRankSelect rs;
+		rs.init(&allocator);
+		rs.build(x);
+		u32 rank = 0;
+		for (u32 i = 0; i <= n; i++) {
+			REQUIRE(rs.rank(i) == rank);
+			if (i < n && rx[i]) {
+				REQUIRE(rs.select(rank) == i);
+				rank += 1;
+			}
+		}
+		CHECK(rs.select(rank) == ~0u);
+	}
+}
+
+// Benchmarks
+// ------------------------------------------------------------------------------------------------
+
+SFZ_BENCHMARK("SfzBitset: set operations and iteration against a byte per flag array")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	std::mt19937 rng(1);
+	const u32 sizes[] = { 4096, 1u << 20, 1u << 24 };
+	const u32 densities[] = { 1, 10, 50 }; // Percent of set flags
+
+	for (u32 n : sizes) {
+		for (u32 density : densities) {
+			SfzBitset a(n, &allocator, sfz_dbg("")), b(n, &allocator, sfz_dbg(""));
+			std::vector<u8> ba(n), bb(n);
+			for (u32 i = 0; i < n; i++) {
+				if (rng() % 100 < density) { a.set(i); ba[i] = 1; }
+				if (rng() % 100 < density) { b.set(i); bb[i] = 1; }
+			}
+			const u32 reps = u32_max(1, (1u << 26) / n);
+
+			// visible = visible & ~culled, then count
+			SfzBitset res(n, &allocator, sfz_dbg(""));
+			std::vector<u8> bres(n);
+			u64 bits_count = 0, bytes_count = 0;
+			const f64 bits_op_ms = sfzBenchMs(reps, [&]() {
+				memcpy(res.words(), a.words(), sizeof(u64) * a.numWords());
+				res.andNotWith(b);
+				bits_count = res.popCount();
+			});
+			const f64 bytes_op_ms = sfzBenchMs(reps, [&]() {
+				u64 count = 0;
+				for (u32 i = 0; i < n; i++) {
+					bres[i] = ba[i] & u8(!bb[i]);
+					count += bres[i];
+				}
+				bytes_count = count;
+			});
+			CHECK(bits_count == bytes_count);
+
+			// Visit the index of each set flag
+			u64 bits_sum = 0, bytes_sum = 0;
+			const f64 bits_iter_ms = sfzBenchMs(reps, [&]() {
+				u64 sum = 0;
+				a.forEachSet([&](u32 idx) { sum += idx; });
+				bits_sum = sum;
+			});
+			const f64 bytes_iter_ms = sfzBenchMs(reps, [&]() {
+				u64 sum = 0;
+				for (u32 i = 0; i < n; i++) if (ba[i] != 0) sum += i;
+				bytes_sum = sum;
+			});
+			CHECK(bits_sum == bytes_sum);
+
+			SFZ_BENCH_PRINT("%8u flags, %2u%% set: andNot+popCount %9.4f ms vs %9.4f ms (%5.1fx), iteration %9.4f ms vs %9.4f ms (%5.1fx)",
+				n, density, bits_op_ms, bytes_op_ms, bytes_op_ms / bits_op_ms,
+				bits_iter_ms, bytes_iter_ms, bytes_iter_ms / bits_iter_ms);
+		}
+	}
+}
@@ -0,0 +1,359 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#include "doctest.h"
+#include "sfz_bench.hpp"
+#include "sfz_test_utils.hpp"
+
+#include "sfz.h"
+#include "sfz_cpp.hpp"
+#include "skipifzero_allocators.hpp"
+#include "skipifzero_arrays.hpp"
+#include "skipifzero_btree.hpp"
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Tracked {
+	static inline i32 num_alive = 0;
+	i32 value = -1;
+	Tracked() { num_alive += 1; }
+	explicit Tracked(i32 v) : value(v) { num_alive += 1; }
+	Tracked(const Tracked& o) : value(o.value) { num_alive += 1; }
+	Tracked& operator= (const Tracked& o) { value = o.value; return *this; }
+	~Tracked() { num_alive -= 1; }
+};
+
+template<typename K, typename V, typename MakeV>
+void randomBTreeOps(SfzAllocator* allocator, MakeV makeV, u32 range, u32 num_iters)
+{
+	std::mt19937 rng(7);
+	SfzBTreeMap<K, V> m(allocator, sfz_dbg(""));
+	std::map<K, V> ref;
+	const K offset = (K(-1) < K(0)) ? K(range / 3) : K(0); // Negative keys for signed types
+
+	for (u32 it = 0; it < num_iters; it++) {
+		const K k = K(rng() % range) - offset;
+		const u32 op = rng() % 10;
+		if (op < 5) {
+			const V v = makeV(rng());
+			REQUIRE(m.put(k, v) == v);
+			ref[k] = v;
+		}
+		else if (op < 9) {
+			REQUIRE(m.remove(k) == (ref.erase(k) == 1));
+		}
+		else {
+			const V* v = m.get(k);
+			REQUIRE((v != nullptr) == (ref.count(k) == 1));
+			if (v != nullptr) REQUIRE(*v == ref[k]);
+		}
+		REQUIRE(m.size() == ref.size());
+
+		if (it % 5000 == 0 || it == num_iters - 1) {
+			// Forward iteration
+			auto ref_it = ref.begin();
+			for (auto itr = m.begin(); itr != m.end(); ++itr, ++ref_it) {
+				REQUIRE(ref_it != ref.end());
+				REQUIRE(itr.key() == ref_it->first);
+				REQUIRE(itr.value() == ref_it->second);
+			}
+			REQUIRE(ref_it == ref.end());
+
+			// Backward iteration
+			auto ref_rit = ref.rbegin();
+			for (auto itr = m.last(); itr.valid(); --itr, ++ref_rit) {
+				REQUIRE(itr.key() == ref_rit->first);
+			}
+			REQUIRE(ref_rit == ref.rend());
+
+			// Range query
+			const K lo = K(rng() % range);
+			const K hi = lo + K(40);
+			size_t num_in_range = 0;
+			m.forEachInRange(lo, hi, [&](const K&, V&) { num_in_range += 1; });
+			size_t expected = 0;
+			for (auto& [key, val] : ref) expected += (key >= lo && key <= hi) ? 1 : 0;
+			REQUIRE(num_in_range == expected);
+		}
+	}
+
+	// Bulk load from sorted
+	std::vector<K> keys;
+	std::vector<V> values;
+	for (auto& [k, v] : ref) {
+		keys.push_back(k);
+		values.push_back(v);
+	}
+	SfzBTreeMap<K, V> bulk;
+	bulk.initFromSorted(keys.data(), values.data(), u32(keys.size()), allocator, sfz_dbg(""));
+	REQUIRE(bulk.size() == ref.size());
+	for (auto& [k, v] : ref) {
+		REQUIRE(bulk.get(k) != nullptr);
+		REQUIRE(*bulk.get(k) == v);
+	}
+	for (size_t i = 0; i < keys.size(); i += 2) REQUIRE(bulk.remove(keys[i]));
+	for (size_t i = 1; i < keys.size(); i += 2) REQUIRE(bulk.get(keys[i]) != nullptr);
+	for (u32 i = 0; i < range; i++) bulk.put(K(i), makeV(1));
+	CHECK(bulk.get(K(range - 1)) != nullptr);
+}
+
+} // namespace
+
+TEST_CASE("SfzBTreeMap: empty tree")
+{
+	SfzTestCountingAllocator counting;
+	SfzBTreeMap<u32, u32> m(counting.ptr(), sfz_dbg(""));
+	CHECK(m.isEmpty());
+	CHECK(m.height() == 0);
+	CHECK(m.get(0) == nullptr);
+	CHECK(!m.remove(0));
+	CHECK(!m.lowerBound(0).valid());
+	CHECK(m.begin() == m.end());
+	CHECK(!m.last().valid());
+	u32 num_visited = 0;
+	m.forEachInRange(0, U32_MAX, [&](const u32&, u32&) { num_visited += 1; });
+	CHECK(num_visited == 0);
+	m.initFromSorted(nullptr, nullptr, 0, counting.ptr(), sfz_dbg(""));
+	CHECK(m.isEmpty());
+	CHECK(counting.num_allocs == 0);
+}
+
+TEST_CASE("SfzBTreeMap: splits and merges change the height")
+{
+	SfzTestCountingAllocator counting;
+	Tracked::num_alive = 0;
+	{
+		using Map = SfzBTreeMap<u64, Tracked>;
+		Map m(counting.ptr(), sfz_dbg(""));
+		const u32 max_keys = Map::MAX_KEYS;
+
+		// A single leaf holds MAX_KEYS elements, one more splits it
+		for (u32 i = 0; i < max_keys; i++) m.put(i, Tracked(i32(i)));
+		CHECK(m.height() == 1);
+		CHECK(counting.num_allocs == 1);
+		CHECK(counting.max_align == SFZ_BTREE_NODE_ALIGNMENT);
+		m.put(max_keys, Tracked(i32(max_keys)));
+		CHECK(m.height() == 2);
+		CHECK(counting.numLive() == 3); // Two leaves and a root
+
+		// Replacing a value doesn't change the structure
+		m.put(0, Tracked(-1));
+		CHECK(m.size() == max_keys + 1);
+		CHECK(m[0].value == -1);
+
+		// Ascending inserts until the tree has three levels
+		u64 next_key = max_keys + 1;
+		while (m.height() < 3) {
+			m.put(next_key, Tracked(i32(next_key)));
+			next_key += 1;
+		}
+		CHECK(Tracked::num_alive == i32(m.size()));
+
+		// Leaves are linked in both directions across all inner nodes
+		u64 expected = 0;
+		bool ordered = true;
+		for (Map::Itr itr = m.begin(); itr != m.end(); ++itr) ordered = ordered && itr.key() == expected++;
+		for (Map::Itr itr = m.last(); itr.valid(); --itr) ordered = ordered && itr.key() == --expected;
+		CHECK(ordered);
+		CHECK(expected == 0);
+
+		// Removing from the front rebalances and merges until the root is a single leaf again
+		for (u64 k = 0; k < next_key - 3; k++) REQUIRE(m.remove(k));
+		CHECK(m.height() == 1);
+		CHECK(m.size() == 3);
+		CHECK(counting.numLive() == 1);
+		CHECK(Tracked::num_alive == 3);
+		CHECK(m.begin().key() == next_key - 3);
+
+		// Removing the last element frees the root but keeps the allocator
+		CHECK(!m.remove(0));
+		for (u64 k = next_key - 3; k < next_key; k++) REQUIRE(m.remove(k));
+		CHECK(m.isEmpty());
+		CHECK(m.height() == 0);
+		CHECK(counting.numLive() == 0);
+		CHECK(m.allocator() == counting.ptr());
+		m.put(7, Tracked(7));
+		CHECK(m[7].value == 7);
+	}
+	CHECK(Tracked::num_alive == 0);
+	CHECK(counting.numLive() == 0);
+}
+
+TEST_CASE("SfzBTreeMap: sentinel and extreme keys")
+{
+	// Unused key slots in SIMD nodes hold the max value, which must still work as a real key
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	SfzBTreeMap<u32, u32> u(&allocator, sfz_dbg(""));
+	u.put(U32_MAX, 1);
+	u.put(0, 2);
+	CHECK(u[U32_MAX] == 1);
+	CHECK(u.get(U32_MAX - 1) == nullptr);
+	CHECK(u.lowerBound(1).key() == U32_MAX);
+	CHECK(u.last().key() == U32_MAX);
+
+	SfzBTreeMap<i32, i32> s(&allocator, sfz_dbg(""));
+	for (i32 i = 0; i < 1000; i++) s.put(I32_MIN + i, i);
+	for (i32 i = 0; i < 1000; i++) s.put(I32_MAX - i, -i);
+	s.put(0, 0);
+	CHECK(s.begin().key() == I32_MIN);
+	CHECK(s.last().key() == I32_MAX);
+	CHECK(s[I32_MAX] == 0);
+	CHECK(s.lowerBound(-1).key() == 0);
+	CHECK(s.lowerBound(1).key() == I32_MAX - 999);
+	u32 num_negative = 0;
+	s.forEachInRange(I32_MIN, -1, [&](const i32&, i32&) { num_negative += 1; });
+	CHECK(num_negative == 1000);
+
+	SfzBTreeMap<i64, i64> l(&allocator, sfz_dbg(""));
+	l.put(I64_MAX, 1);
+	l.put(I64_MIN, 2);
+	CHECK(l[I64_MAX] == 1);
+	CHECK(l.begin().key() == I64_MIN);
+	CHECK(l.remove(I64_MAX));
+	CHECK(l.get(I64_MAX) == nullptr);
+}
+
+TEST_CASE("SfzBTreeMap: bulk load")
+{
+	SfzTestCountingAllocator counting;
+	using Map = SfzBTreeMap<u32, u32>;
+	const u32 fill = Map::BULK_LOAD_FILL;
+	const u32 sizes[] = { 1, fill, fill + 1, fill * (fill + 1), fill * (fill + 1) + 1, 100000 };
+	for (u32 n : sizes) {
+		CAPTURE(n);
+		std::vector<u32> keys(n), values(n);
+		for (u32 i = 0; i < n; i++) {
+			keys[i] = 3 * i;
+			values[i] = i;
+		}
+		Map m;
+		m.initFromSorted(keys.data(), values.data(), n, counting.ptr(), sfz_dbg(""));
+		CHECK(m.size() == n);
+		u32 expected_height = 1;
+		for (u32 num_nodes = (n + fill - 1) / fill; num_nodes > 1; num_nodes = (num_nodes + fill) / (fill + 1)) {
+			expected_height += 1;
+		}
+		CHECK(m.height() == expected_height);
+
+		bool ok = true;
+		u32 idx = 0;
+		for (Map::Itr itr = m.begin(); itr.valid(); ++itr, idx++) ok = ok && itr.key() == 3 * idx;
+		for (u32 i = 0; i < n; i++) ok = ok && m.get(3 * i) != nullptr && *m.get(3 * i) == i;
+		for (u32 i = 0; i < n; i++) ok = ok && m.get(3 * i + 1) == nullptr;
+		CHECK(ok);
+		CHECK(idx == n);
+
+		// Nodes are left partially empty, filling the gaps of a leaf doesn't split it
+		const u64 num_allocs = counting.num_allocs;
+		for (u32 i = 0; i < u32_min(n, Map::MAX_KEYS - fill); i++) m.put(3 * i + 1, 0);
+		CHECK(counting.num_allocs == num_allocs);
+		m.destroy();
+		CHECK(counting.numLive() == 0);
+	}
+}
+
+TEST_CASE("SfzBTreeMap: random operations against std::map")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	auto toStr = [](u32 x) { return std::to_string(x); };
+	auto toInt = [](u32 x) { return i32(x); };
+	SUBCASE("u32 -> std::string") { randomBTreeOps<u32, std::string>(&allocator, toStr, 3000, 100000); }
+	SUBCASE("i32 -> i32") { randomBTreeOps<i32, i32>(&allocator, toInt, 100000, 100000); }
+	SUBCASE("u64 -> i32") { randomBTreeOps<u64, i32>(&allocator, toInt, 500, 50000); }
+	SUBCASE("i64 -> std::string") { randomBTreeOps<i64, std::string>(&allocator, toStr, 20000, 50000); }
+	SUBCASE("u16 -> i32") { randomBTreeOps<u16, i32>(&allocator, toInt, 20000, 50000); }
+}
+
+// Benchmarks
+// ------------------------------------------------------------------------------------------------
+
+SFZ_BENCHMARK("SfzBTreeMap: inserts, deletes and range scans against a sorted SfzArray")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	struct Pair {
+		u64 key, value;
+		bool operator< (const Pair& o) const { return key < o.key; }
+	};
+	constexpr u32 BATCH_SIZE = 1000;
+	constexpr u32 SCAN_LENGTH = 100;
+	const u32 sizes[] = { 10000, 100000, 1000000 };
+
+	for (u32 n : sizes) {
+		std::mt19937_64 rng(n);
+		std::vector<u64> initial(n);
+		for (u64& k : initial) k = rng();
+		std::sort(initial.begin(), initial.end());
+		initial.erase(std::unique(initial.begin(), initial.end()), initial.end());
+		std::vector<u64> batch(BATCH_SIZE);
+		for (u64& k : batch) k = rng();
+
+		SfzBTreeMap<u64, u64> tree;
+		tree.initFromSorted(initial.data(), initial.data(), u32(initial.size()), &allocator, sfz_dbg(""));
+		SfzArray<Pair> arr(u32(initial.size()) + BATCH_SIZE, &allocator, sfz_dbg(""));
+		for (u64 k : initial) arr.add(Pair{ k, k });
+		auto arrLowerBound = [&](u64 key) {
+			return u32(std::lower_bound(arr.begin(), arr.end(), Pair{ key, 0 }) - arr.begin());
+		};
+
+		// A batch of inserts, e.g. one frame of new timeline events
+		SfzBenchTimer timer;
+		for (u64 k : batch) tree.put(k, k);
+		const f64 tree_insert_ms = timer.elapsedMs();
+		timer.restart();
+		for (u64 k : batch) arr.add(Pair{ k, k });
+		arr.sort();
+		const f64 arr_insert_ms = timer.elapsedMs();
+		CHECK(tree.size() == arr.size());
+
+		// Range scans starting at random keys
+		u64 tree_sum = 0, arr_sum = 0;
+		timer.restart();
+		for (u32 i = 0; i < BATCH_SIZE; i++) {
+			u32 num = 0;
+			for (auto itr = tree.lowerBound(batch[i]); itr.valid() && num < SCAN_LENGTH; ++itr, num++) {
+				tree_sum += itr.value();
+			}
+		}
+		const f64 tree_scan_ms = timer.elapsedMs();
+		timer.restart();
+		for (u32 i = 0; i < BATCH_SIZE; i++) {
+			const u32 first = arrLowerBound(batch[i]);
+			for (u32 j = first; j < u32_min(arr.size(), first + SCAN_LENGTH); j++) arr_sum += arr[j].value;
+		}
+		const f64 arr_scan_ms = timer.elapsedMs();
+		CHECK(tree_sum == arr_sum);
+
+		// Deleting the batch again, one element at a time
+		timer.restart();
+		for (u64 k : batch) tree.remove(k);
+		const f64 tree_delete_ms = timer.elapsedMs();
+		timer.restart();
+		for (u64 k : batch) arr.remove(arrLowerBound(k));
+		const f64 arr_delete_ms = timer.elapsedMs();
+		CHECK(tree.size() == arr.size());
+
+		SFZ_BENCH_PRINT("%7u keys, batches of %u: insert %7.3f ms vs %8.3f ms, scan %6.3f ms vs %6.3f ms, delete %6.3f ms vs %8.3f ms (SfzBTreeMap vs sorted SfzArray)",
+			n, BATCH_SIZE, tree_insert_ms, arr_insert_ms, tree_scan_ms, arr_scan_ms, tree_delete_ms, arr_delete_ms);
+	}
+}
@@ -0,0 +1,371 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#include "doctest.h"
+#include "sfz_bench.hpp"
+
+#include "sfz.h"
+#include "sfz_cpp.hpp"
+#include "skipifzero_allocators.hpp"
+#include "skipifzero_ecs.hpp"
+#include "skipifzero_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct Pos { f32x3 p; };
+struct Vel { f32x3 v; };
+struct Big { alignas(64) u8 d[200]; };
+struct Id { u32 id; };
+
+void threadDispatch(void*, u32 num_tasks, SfzEcsTaskFunc* task_func, void* task_data)
+{
+	std::vector<std::thread> threads;
+	for (u32 t = 0; t < 4; t++) {
+		threads.emplace_back([=]() {
+			for (u32 i = t; i < num_tasks; i += 4) task_func(task_data, i);
+		});
+	}
+	for (std::thread& thread : threads) thread.join();
+}
+
+} // namespace
+
+TEST_CASE("SfzEcsWorld: component values survive structural changes")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	SfzEcsWorld world(16, &allocator, sfz_dbg(""));
+	const u32 P = world.registerComponent<Pos>();
+	const u32 V = world.registerComponent<Vel>();
+	const u32 I = world.registerComponent<Id>();
+	const u64 PM = 1ull << P, VM = 1ull << V, IM = 1ull << I;
+	CHECK(world.registeredMask() == 0b111);
+
+	const SfzHandle e = world.createEntity(PM | IM);
+	CHECK(world.getComponent<Pos>(e, P)->p == f32x3_splat(0.0f)); // Zero initialized
+	CHECK(world.getComponent<Vel>(e, V) == nullptr);
+	world.getComponent<Pos>(e, P)->p = f32x3_init(1.0f, 2.0f, 3.0f);
+	world.getComponent<Id>(e, I)->id = 42;
+
+	// Kept components are copied, new ones are zeroed
+	world.addComponents(e, VM);
+	CHECK(world.entityMask(e) == (PM | VM | IM));
+	CHECK(world.getComponent<Pos>(e, P)->p == f32x3_init(1.0f, 2.0f, 3.0f));
+	CHECK(world.getComponent<Vel>(e, V)->v == f32x3_splat(0.0f));
+	CHECK(world.getComponent<Id>(e, I)->id == 42);
+
+	world.removeComponents(e, PM);
+	CHECK(world.entityMask(e) == (VM | IM));
+	CHECK(world.getComponent<Pos>(e, P) == nullptr);
+	CHECK(world.getComponent<Id>(e, I)->id == 42);
+
+	// Adding the same component back gives a zeroed one, not the old value
+	world.addComponents(e, PM);
+	CHECK(world.getComponent<Pos>(e, P)->p == f32x3_splat(0.0f));
+	CHECK(world.numArchetypes() == 3);
+
+	// An entity without components is valid and only matches queries without requirements
+	const SfzHandle empty = world.createEntity(0);
+	CHECK(world.entityIsValid(empty));
+	CHECK(world.entityMask(empty) == 0);
+	u32 num_all = 0, num_with_id = 0;
+	world.query(0, [&](const SfzEcsChunkView& view) { num_all += view.num_rows; });
+	world.query(IM, [&](const SfzEcsChunkView& view) { num_with_id += view.num_rows; });
+	CHECK(num_all == 2);
+	CHECK(num_with_id == 1);
+
+	world.destroyEntity(empty);
+	world.destroyEntity(empty); // Stale handles are ignored
+	CHECK(!world.entityIsValid(empty));
+	CHECK(world.numEntities() == 1);
+}
+
+TEST_CASE("SfzEcsWorld: rows span chunks and removal moves the last row")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	SfzEcsWorld world(10000, &allocator, sfz_dbg(""));
+	const u32 B = world.registerComponent<Big>();
+	const u32 I = world.registerComponent<Id>();
+	const u64 mask = (1ull << B) | (1ull << I);
+
+	std::vector<SfzHandle> entities;
+	for (u32 i = 0; i < 1000; i++) {
+		entities.push_back(world.createEntity(mask));
+		world.getComponent<Id>(entities.back(), I)->id = i;
+		memset(world.getComponent<Big>(entities.back(), B)->d, int(i & 0xFF), sizeof(Big::d));
+	}
+	REQUIRE(world.numArchetypes() == 1);
+	const SfzEcsArchetype& archetype = world.archetype(0);
+	const u32 rows_per_chunk = archetype.rows_per_chunk;
+	REQUIRE(rows_per_chunk < 1000);
+	CHECK(archetype.chunks.size() == (1000 + rows_per_chunk - 1) / rows_per_chunk);
+
+	// Every column in every chunk respects the component's alignment
+	bool aligned = true;
+	world.query(mask, [&](const SfzEcsChunkView& view) {
+		aligned = aligned && uintptr_t(view.chunk) % SFZ_ECS_CHUNK_ALIGNMENT == 0;
+		aligned = aligned && uintptr_t(view.column(B)) % alignof(Big) == 0;
+		CHECK(view.num_rows > 0);
+	});
+	CHECK(aligned);
+
+	// Destroying the first entity moves the last one (in the last chunk) into row 0
+	world.destroyEntity(entities[0]);
+	u32 first_id = ~0u;
+	world.query(mask, [&](const SfzEcsChunkView& view) {
+		if (first_id == ~0u) first_id = view.column<Id>(I)[0].id;
+	});
+	CHECK(first_id == 999);
+	CHECK(world.getComponent<Big>(entities[999], B)->d[199] == u8(999 & 0xFF));
+
+	// Emptying the last chunk releases it
+	const u32 num_in_last_chunk = 999 % rows_per_chunk;
+	const u32 num_chunks_before = archetype.chunks.size();
+	for (u32 i = 0; i < (num_in_last_chunk == 0 ? rows_per_chunk : num_in_last_chunk); i++) {
+		world.destroyEntity(entities[1 + i]);
+	}
+	CHECK(archetype.chunks.size() == num_chunks_before - 1);
+
+	bool all_found = true;
+	for (u32 i = 0; i < 1000; i++) {
+		if (!world.entityIsValid(entities[i])) continue;
+		all_found = all_found && world.getComponent<Id>(entities[i], I)->id == i;
+		all_found = all_found && world.getComponent<Big>(entities[i], B)->d[0] == u8(i & 0xFF);
+	}
+	CHECK(all_found);
+}
+
+TEST_CASE("SfzEcsWorld: bulk changes")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	SfzEcsWorld world(10000, &allocator, sfz_dbg(""));
+	const u32 P = world.registerComponent<Pos>();
+	const u32 V = world.registerComponent<Vel>();
+	const u32 I = world.registerComponent<Id>();
+	const u64 PM = 1ull << P, VM = 1ull << V, IM = 1ull << I;
+
+	// Enough entities to span several chunks in both the source and destination archetypes
+	std::vector<SfzHandle> with_pos, without_pos;
+	for (u32 i = 0; i < 3000; i++) {
+		const SfzHandle e = world.createEntity(i % 3 == 0 ? IM : (PM | IM));
+		world.getComponent<Id>(e, I)->id = i;
+		(i % 3 == 0 ? without_pos : with_pos).push_back(e);
+	}
+
+	// Adds velocity to all entities with position, moves whole column ranges
+	world.changeComponentsBulk(PM, 0, VM, 0);
+	bool ok = true;
+	for (SfzHandle e : with_pos) {
+		ok = ok && world.entityMask(e) == (PM | VM | IM);
+		ok = ok && world.getComponent<Vel>(e, V)->v == f32x3_splat(0.0f);
+	}
+	for (SfzHandle e : without_pos) ok = ok && world.entityMask(e) == IM;
+	for (u32 i = 0; i < 3000; i++) {
+		const SfzHandle e = (i % 3 == 0 ? without_pos[i / 3] : with_pos[i - i / 3 - 1]);
+		ok = ok && world.getComponent<Id>(e, I)->id == i;
+	}
+	CHECK(ok);
+	CHECK(world.archetype(1).num_rows == 0); // The old PM | IM archetype is empty
+
+	// Bulk destroy with an exclusion mask
+	world.destroyEntitiesBulk(IM, VM);
+	CHECK(world.numEntities() == u32(with_pos.size()));
+	for (SfzHandle e : without_pos) ok = ok && !world.entityIsValid(e);
+	for (SfzHandle e : with_pos) ok = ok && world.entityIsValid(e);
+	CHECK(ok);
+
+	// Serial queryParallel without dispatch function
+	u32 num_rows = 0;
+	world.queryParallel(VM, 0, [&](const SfzEcsChunkView& view) { num_rows += view.num_rows; }, nullptr, nullptr);
+	CHECK(num_rows == u32(with_pos.size()));
+}
+
+TEST_CASE("SfzEcsWorld: random entity operations against reference")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	SfzEcsWorld world(100000, &allocator, sfz_dbg(""));
+	const u32 P = world.registerComponent<Pos>();
+	const u32 V = world.registerComponent<Vel>();
+	const u32 B = world.registerComponent<Big>();
+	const u32 I = world.registerComponent<Id>();
+	const u64 PM = 1ull << P, VM = 1ull << V, BM = 1ull << B, IM = 1ull << I;
+
+	std::map<u32, std::pair<u64, u32>> ref; // handle bits -> (mask, id)
+	std::vector<SfzHandle> handles;
+	std::mt19937 rng(3);
+	u32 next_id = 1;
+
+	auto checkAll = [&]() {
+		REQUIRE(world.numEntities() == handles.size());
+		for (SfzHandle h : handles) {
+			const std::pair<u64, u32>& r = ref[h.bits];
+			REQUIRE(world.entityMask(h) == r.first);
+			if (r.first & IM) REQUIRE(world.getComponent<Id>(h, I)->id == r.second);
+		}
+	};
+
+	for (u32 it = 0; it < 30000; it++) {
+		const u32 op = rng() % 10;
+		if (op < 5 || handles.empty()) {
+			const u64 mask = (rng() % 16) | IM;
+			const SfzHandle h = world.createEntity(mask);
+			world.getComponent<Id>(h, I)->id = next_id;
+			handles.push_back(h);
+			ref[h.bits] = { mask, next_id++ };
+		}
+		else if (op < 7) {
+			const size_t i = rng() % handles.size();
+			const SfzHandle h = handles[i];
+			handles[i] = handles.back();
+			handles.pop_back();
+			world.destroyEntity(h);
+			ref.erase(h.bits);
+			REQUIRE(!world.entityIsValid(h));
+		}
+		else if (op < 9) {
+			const SfzHandle h = handles[rng() % handles.size()];
+			const u64 mask = (rng() % 16) | IM;
+			world.setComponents(h, mask);
+			ref[h.bits].first = mask;
+		}
+		else if (rng() % 50 == 0) {
+			const u64 with = (1ull << (rng() % 4)) & ~IM;
+			const u64 add = 1ull << (rng() % 3);
+			const u64 rem = (1ull << (rng() % 3)) & ~IM;
+			if (add == rem) continue;
+			world.changeComponentsBulk(with, 0, add, rem);
+			for (auto& [k, r] : ref) {
+				if ((r.first & with) == with) r.first = (r.first | add) & ~rem;
+			}
+		}
+		if (it % 1000 == 0) checkAll();
+	}
+	checkAll();
+
+	// Query
+	u32 num_queried = 0;
+	world.query(PM | VM, [&](const SfzEcsChunkView& view) {
+		num_queried += view.num_rows;
+		Pos* pos = view.column<Pos>(P);
+		Vel* vel = view.column<Vel>(V);
+		for (u32 i = 0; i < view.num_rows; i++) pos[i].p += vel[i].v;
+	});
+	u32 expected = 0;
+	for (auto& [k, r] : ref) expected += u32((r.first & (PM | VM)) == (PM | VM));
+	CHECK(num_queried == expected);
+
+	// Parallel query with exclusion mask, columns must respect component alignment
+	std::atomic<u32> num_queried_parallel = 0;
+	std::atomic<bool> aligned = true;
+	world.queryParallel(BM, VM, [&](const SfzEcsChunkView& view) {
+		num_queried_parallel += view.num_rows;
+		if (uintptr_t(view.column(B)) % 64 != 0) aligned = false;
+	}, threadDispatch, nullptr);
+	expected = 0;
+	for (auto& [k, r] : ref) expected += u32((r.first & BM) != 0 && (r.first & VM) == 0);
+	CHECK(num_queried_parallel.load() == expected);
+	CHECK(aligned.load());
+
+	// Bulk destroy
+	world.destroyEntitiesBulk(PM);
+	for (auto it = handles.begin(); it != handles.end();) {
+		if (ref[it->bits].first & PM) {
+			ref.erase(it->bits);
+			it = handles.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+	checkAll();
+}
+
+// Benchmarks
+// ------------------------------------------------------------------------------------------------
+
+namespace {
+
+struct Acc { f32x3 a; };
+
+} // namespace
+
+SFZ_BENCHMARK("SfzEcsWorld: iterating 1M entities with 3 components against a pool per component")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	constexpr u32 NUM_ENTITIES = 1000000;
+	const f32 dt = 0.016f;
+
+	// Pool per component, each entity stores handles to its components. Components are allocated in
+	// a different order in each pool, as they would be when they are added at different times.
+	struct EntityRec { SfzHandle pos, vel, acc; };
+	SfzPool<Pos> pos_pool(NUM_ENTITIES, &allocator, sfz_dbg(""));
+	SfzPool<Vel> vel_pool(NUM_ENTITIES, &allocator, sfz_dbg(""));
+	SfzPool<Acc> acc_pool(NUM_ENTITIES, &allocator, sfz_dbg(""));
+	std::vector<EntityRec> recs(NUM_ENTITIES);
+	std::vector<u32> order(NUM_ENTITIES);
+	for (u32 i = 0; i < NUM_ENTITIES; i++) order[i] = i;
+	std::mt19937 rng(1);
+	for (u32 i = 0; i < NUM_ENTITIES; i++) recs[i].pos = pos_pool.allocate(Pos{ f32x3_splat(f32(i)) });
+	std::shuffle(order.begin(), order.end(), rng);
+	for (u32 i : order) recs[i].vel = vel_pool.allocate(Vel{ f32x3_splat(1.0f) });
+	std::shuffle(order.begin(), order.end(), rng);
+	for (u32 i : order) recs[i].acc = acc_pool.allocate(Acc{ f32x3_init(0.0f, -9.82f, 0.0f) });
+
+	SfzEcsWorld world(NUM_ENTITIES, &allocator, sfz_dbg(""));
+	const u32 P = world.registerComponent<Pos>();
+	const u32 V = world.registerComponent<Vel>();
+	const u32 A = world.registerComponent<Acc>();
+	const u64 mask = (1ull << P) | (1ull << V) | (1ull << A);
+	for (u32 i = 0; i < NUM_ENTITIES; i++) {
+		const SfzHandle e = world.createEntity(mask);
+		world.getComponent<Pos>(e, P)->p = f32x3_splat(f32(i));
+		world.getComponent<Vel>(e, V)->v = f32x3_splat(1.0f);
+		world.getComponent<Acc>(e, A)->a = f32x3_init(0.0f, -9.82f, 0.0f);
+	}
+
+	const f64 pools_ms = sfzBenchMs(10, [&]() {
+		for (const EntityRec& rec : recs) {
+			Vel& vel = vel_pool[rec.vel];
+			vel.v += acc_pool[rec.acc].a * dt;
+			pos_pool[rec.pos].p += vel.v * dt;
+		}
+	});
+	const f64 ecs_ms = sfzBenchMs(10, [&]() {
+		world.query(mask, [&](const SfzEcsChunkView& view) {
+			Pos* pos = view.column<Pos>(P);
+			Vel* vel = view.column<Vel>(V);
+			const Acc* acc = view.column<Acc>(A);
+			for (u32 i = 0; i < view.num_rows; i++) {
+				vel[i].v += acc[i].a * dt;
+				pos[i].p += vel[i].v * dt;
+			}
+		});
+	});
+	// Both layouts integrated the same entities the same number of times
+	const SfzHandle first_entity = reinterpret_cast<const SfzHandle*>(world.archetype(0).chunks[0])[0];
+	CHECK(pos_pool[recs[0].pos].p.y == world.getComponent<Pos>(first_entity, P)->p.y);
+	SFZ_BENCH_PRINT("1M entities, 3 components: pool per component %7.3f ms, SfzEcsWorld %7.3f ms (%.2fx)",
+		pools_ms, ecs_ms, pools_ms / ecs_ms);
+}
@@ -0,0 +1,336 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#include "doctest.h"
+#include "sfz_bench.hpp"
+#include "sfz_test_utils.hpp"
+
+#include "sfz.h"
+#include "sfz_cpp.hpp"
+#include "skipifzero_allocators.hpp"
+#include "skipifzero_filters.hpp"
+#include "skipifzero_hash_maps.hpp"
+
+#include <cstddef>
+#include <random>
+#include <set>
+#include <vector>
+
+// SfzBloomFilter
+// ------------------------------------------------------------------------------------------------
+
+TEST_CASE("SfzBloomFilter: uninitialized filter is empty")
+{
+	SfzBloomFilter bloom;
+	CHECK(!bloom.mayContain(u64(42)));
+	CHECK(!bloom.mayContainHash(0));
+	CHECK(bloom.numBlocks() == 0);
+	CHECK(bloom.sizeBytes() == 0);
+	bloom.clear();
+	bloom.destroy();
+	CHECK(!bloom.mayContain(u64(42)));
+}
+
+TEST_CASE("SfzBloomFilter: sizing, clear and merge")
+{
+	SfzTestCountingAllocator counting;
+	SfzBloomFilter bloom(0, 0.01f, counting.ptr(), sfz_dbg(""));
+	CHECK(bloom.numBlocks() == 1);
+	CHECK(counting.max_align == 64);
+	CHECK(uintptr_t(bloom.blocks()) % 64 == 0);
+
+	// Lower false positive rates need more bits per key
+	SfzBloomFilter bloom_1(10000, 0.01f, counting.ptr(), sfz_dbg(""));
+	SfzBloomFilter bloom_01(10000, 0.001f, counting.ptr(), sfz_dbg(""));
+	CHECK(bloom_01.numBlocks() > bloom_1.numBlocks());
+	CHECK(bloom_1.sizeBytes() * 8 >= 10000 * 9);
+
+	// Equal hashes always collide, keys are hashed with sfzHash()
+	bloom_1.addHash(1234);
+	CHECK(bloom_1.mayContainHash(1234));
+	CHECK(bloom_1.mayContain(u64(1234)));
+
+	// Merge is the union of both filters
+	SfzBloomFilter other(10000, 0.01f, counting.ptr(), sfz_dbg(""));
+	for (u64 i = 0; i < 1000; i++) bloom_1.add(i);
+	for (u64 i = 1000; i < 2000; i++) other.add(i);
+	bloom_1.merge(other);
+	bool all_found = true;
+	for (u64 i = 0; i < 2000; i++) all_found = all_found && bloom_1.mayContain(i);
+	CHECK(all_found);
+
+	bloom_1.clear();
+	u32 num_found = 0;
+	for (u64 i = 0; i < 2000; i++) num_found += bloom_1.mayContain(i) ? 1 : 0;
+	CHECK(num_found == 0);
+
+	bloom.destroy();
+	bloom_1.destroy();
+	bloom_01.destroy();
+	other.destroy();
+	CHECK(counting.numLive() == 0);
+}
+
+TEST_CASE("SfzBloomFilter: deserialize rejects invalid buffers")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	SfzBloomFilter bloom(1000, 0.01f, &allocator, sfz_dbg(""));
+	bloom.add(u64(7));
+	std::vector<u8> buffer(bloom.serializedSizeBytes());
+	bloom.serialize(buffer.data());
+
+	SfzBloomFilter copy;
+	auto corrupted = [&](u32 offset, u32 value) {
+		std::vector<u8> bad = buffer;
+		memcpy(bad.data() + offset, &value, sizeof(u32));
+		return !copy.deserialize(bad.data(), bad.size(), &allocator, sfz_dbg(""));
+	};
+	CHECK(corrupted(offsetof(SfzBloomFilterHeader, magic), SFZ_CUCKOO_FILTER_MAGIC));
+	CHECK(corrupted(offsetof(SfzBloomFilterHeader, version), SFZ_FILTER_VERSION + 1));
+	CHECK(corrupted(offsetof(SfzBloomFilterHeader, num_blocks), 0));
+	CHECK(corrupted(offsetof(SfzBloomFilterHeader, num_blocks), bloom.numBlocks() + 1));
+	CHECK(!copy.deserialize(buffer.data(), sizeof(SfzBloomFilterHeader) - 1, &allocator, sfz_dbg("")));
+
+	// A failed deserialize leaves an empty (uninitialized) filter
+	CHECK(copy.numBlocks() == 0);
+	CHECK(!copy.mayContain(u64(7)));
+	REQUIRE(copy.deserialize(buffer.data(), buffer.size(), &allocator, sfz_dbg("")));
+	CHECK(copy.mayContain(u64(7)));
+}
+
+TEST_CASE("SfzBloomFilter: no false negatives, false positive rate and serialization")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	for (f32 fpr : { 0.1f, 0.01f, 0.001f }) {
+		CAPTURE(fpr);
+		const u32 n = 50000;
+		SfzBloomFilter bloom(n, fpr, &allocator, sfz_dbg(""));
+		for (u64 i = 0; i < n; i++) bloom.add(i * 2);
+
+		bool no_false_negatives = true;
+		for (u64 i = 0; i < n; i++) no_false_negatives = no_false_negatives && bloom.mayContain(i * 2);
+		CHECK(no_false_negatives);
+
+		u32 num_false_positives = 0;
+		const u32 num_queries = 200000;
+		for (u64 i = 0; i < num_queries; i++) num_false_positives += bloom.mayContain(i * 2 + 1) ? 1 : 0;
+		CHECK(f32(num_false_positives) / f32(num_queries) < fpr * 2.0f);
+
+		std::vector<u8> buffer(bloom.serializedSizeBytes());
+		bloom.serialize(buffer.data());
+		SfzBloomFilter copy;
+		REQUIRE(copy.deserialize(buffer.data(), buffer.size(), &allocator, sfz_dbg("")));
+		bool same = true;
+		for (u64 i = 0; i < 10000; i++) same = same && copy.mayContain(i) == bloom.mayContain(i);
+		CHECK(same);
+		CHECK(!copy.deserialize(buffer.data(), buffer.size() - 1, &allocator, sfz_dbg("")));
+	}
+}
+
+// SfzCuckooFilter
+// ------------------------------------------------------------------------------------------------
+
+TEST_CASE("SfzCuckooFilter: uninitialized filter is empty")
+{
+	SfzCuckooFilter cuckoo;
+	CHECK(!cuckoo.mayContain(42));
+	CHECK(!cuckoo.add(42));
+	CHECK(!cuckoo.remove(42));
+	CHECK(cuckoo.numKeys() == 0);
+}
+
+TEST_CASE("SfzCuckooFilter: fingerprint size, duplicates and the victim slot")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	SfzCuckooFilter cuckoo_8(100, 0.05f, &allocator, sfz_dbg(""));
+	SfzCuckooFilter cuckoo_16(100, 0.01f, &allocator, sfz_dbg(""));
+	CHECK(cuckoo_8.fingerprintBits() == 8);
+	CHECK(cuckoo_16.fingerprintBits() == 16);
+	CHECK(cuckoo_8.numBuckets() == 32); // Power of two, at most 84% load at max_num_keys
+	CHECK(cuckoo_16.sizeBytes() == 2 * cuckoo_8.sizeBytes());
+
+	// Duplicates are stored twice and have to be removed twice
+	CHECK(cuckoo_16.add(u64(5)));
+	CHECK(cuckoo_16.add(u64(5)));
+	CHECK(cuckoo_16.numKeys() == 2);
+	CHECK(cuckoo_16.remove(u64(5)));
+	CHECK(cuckoo_16.mayContain(u64(5)));
+	CHECK(cuckoo_16.remove(u64(5)));
+	CHECK(!cuckoo_16.mayContain(u64(5)));
+	CHECK(!cuckoo_16.remove(u64(5)));
+	CHECK(cuckoo_16.numKeys() == 0);
+
+	// The same key added until the filter is full ends up in the victim slot, which is still found
+	// and is moved back into the table when there is room again
+	u32 num_added = 0;
+	while (cuckoo_8.add(u64(9))) num_added += 1;
+	CHECK(cuckoo_8.isFull());
+	CHECK(num_added == 2 * SFZ_CUCKOO_BUCKET_SIZE + 1);
+	CHECK(cuckoo_8.numKeys() == num_added);
+	for (u32 i = 0; i < num_added; i++) {
+		REQUIRE(cuckoo_8.mayContain(u64(9)));
+		REQUIRE(cuckoo_8.remove(u64(9)));
+		REQUIRE(!cuckoo_8.isFull());
+	}
+	CHECK(!cuckoo_8.mayContain(u64(9)));
+	CHECK(cuckoo_8.numKeys() == 0);
+
+	cuckoo_8.add(u64(1));
+	cuckoo_8.clear();
+	CHECK(cuckoo_8.numKeys() == 0);
+	CHECK(!cuckoo_8.mayContain(u64(1)));
+}
+
+TEST_CASE("SfzCuckooFilter: deserialize rejects invalid buffers")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	SfzCuckooFilter cuckoo(1000, 0.01f, &allocator, sfz_dbg(""));
+	cuckoo.add(u64(7));
+	std::vector<u8> buffer(cuckoo.serializedSizeBytes());
+	cuckoo.serialize(buffer.data());
+
+	SfzCuckooFilter copy;
+	auto corrupted = [&](u32 offset, u32 value) {
+		std::vector<u8> bad = buffer;
+		memcpy(bad.data() + offset, &value, sizeof(u32));
+		return !copy.deserialize(bad.data(), bad.size(), &allocator, sfz_dbg(""));
+	};
+	CHECK(corrupted(offsetof(SfzCuckooFilterHeader, magic), SFZ_BLOOM_FILTER_MAGIC));
+	CHECK(corrupted(offsetof(SfzCuckooFilterHeader, version), SFZ_FILTER_VERSION + 1));
+	CHECK(corrupted(offsetof(SfzCuckooFilterHeader, num_buckets), 0));
+	CHECK(corrupted(offsetof(SfzCuckooFilterHeader, num_buckets), cuckoo.numBuckets() + 1));
+	CHECK(corrupted(offsetof(SfzCuckooFilterHeader, num_buckets), cuckoo.numBuckets() * 2));
+	CHECK(corrupted(offsetof(SfzCuckooFilterHeader, fingerprint_bits), 12));
+	CHECK(corrupted(offsetof(SfzCuckooFilterHeader, victim_bucket), cuckoo.numBuckets()));
+	CHECK(copy.numBuckets() == 0);
+	REQUIRE(copy.deserialize(buffer.data(), buffer.size(), &allocator, sfz_dbg("")));
+	CHECK(copy.numKeys() == 1);
+	CHECK(copy.mayContain(u64(7)));
+}
+
+TEST_CASE("SfzCuckooFilter: add/remove against std::multiset, fill and serialization")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	std::mt19937 rng(5);
+	for (f32 fpr : { 0.05f, 0.001f }) {
+		CAPTURE(fpr);
+		const u32 n = 50000;
+		SfzCuckooFilter cuckoo(n, fpr, &allocator, sfz_dbg(""));
+		std::multiset<u64> ref;
+		for (u32 it = 0; it < 200000; it++) {
+			const u64 k = rng() % 150000;
+			if (rng() % 3 != 0 && !cuckoo.isFull()) {
+				if (cuckoo.add(k)) ref.insert(k);
+			}
+			else if (ref.count(k) != 0) {
+				REQUIRE(cuckoo.remove(k));
+				ref.erase(ref.find(k));
+			}
+			REQUIRE(cuckoo.numKeys() == ref.size());
+		}
+		bool no_false_negatives = true;
+		for (u64 k : ref) no_false_negatives = no_false_negatives && cuckoo.mayContain(k);
+		CHECK(no_false_negatives);
+
+		u32 num_false_positives = 0;
+		const u32 num_queries = 200000;
+		for (u64 i = 0; i < num_queries; i++) num_false_positives += cuckoo.mayContain(i + 1000000) ? 1 : 0;
+		CHECK(f32(num_false_positives) / f32(num_queries) < fpr * 2.0f);
+
+		// Fill until full, at least the requested capacity must fit and all keys must still be found
+		u64 k = 5000000;
+		while (!cuckoo.isFull()) {
+			if (cuckoo.add(k)) ref.insert(k);
+			k += 1;
+		}
+		CHECK(cuckoo.numKeys() >= n);
+		no_false_negatives = true;
+		for (u64 key : ref) no_false_negatives = no_false_negatives && cuckoo.mayContain(key);
+		CHECK(no_false_negatives);
+
+		std::vector<u8> buffer(cuckoo.serializedSizeBytes());
+		cuckoo.serialize(buffer.data());
+		SfzCuckooFilter copy;
+		REQUIRE(copy.deserialize(buffer.data(), buffer.size(), &allocator, sfz_dbg("")));
+		bool all_removed = true;
+		for (u64 key : ref) all_removed = all_removed && copy.remove(key);
+		CHECK(all_removed);
+		CHECK(copy.numKeys() == 0);
+		CHECK(!copy.isFull());
+	}
+}
+
+// Benchmarks
+// ------------------------------------------------------------------------------------------------
+
+SFZ_BENCHMARK("SfzBloomFilter: negative queries against SfzHashMap lookups")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	constexpr u32 NUM_QUERIES = 1u << 22;
+	const u32 sizes[] = { 100000, 10000000 };
+	for (u32 n : sizes) {
+		SfzHashMap<u64, u64> map(0, &allocator, sfz_dbg(""));
+		SfzBloomFilter bloom(n, 0.01f, &allocator, sfz_dbg(""));
+		SfzCuckooFilter cuckoo(n, 0.01f, &allocator, sfz_dbg(""));
+		for (u64 i = 0; i < n; i++) {
+			const u64 key = i * 0x9E3779B97F4A7C15ull;
+			map.put(key, i);
+			bloom.add(key);
+			cuckoo.add(key);
+		}
+
+		// 1% of queries hit
+		std::vector<u64> queries(NUM_QUERIES);
+		std::mt19937_64 rng(n);
+		for (u32 i = 0; i < NUM_QUERIES; i++) {
+			queries[i] = (i % 100 == 0 ? rng() % n : n + rng() % (u64(n) * 100)) * 0x9E3779B97F4A7C15ull;
+		}
+
+		u64 map_sum = 0, bloom_sum = 0, cuckoo_sum = 0;
+		const f64 map_ms = sfzBenchMs(3, [&]() {
+			u64 sum = 0;
+			for (u64 q : queries) { const u64* v = map.get(q); sum += v != nullptr ? *v : 0; }
+			map_sum = sum;
+		});
+		const f64 bloom_ms = sfzBenchMs(3, [&]() {
+			u64 sum = 0;
+			for (u64 q : queries) {
+				if (!bloom.mayContain(q)) continue;
+				const u64* v = map.get(q);
+				sum += v != nullptr ? *v : 0;
+			}
+			bloom_sum = sum;
+		});
+		const f64 cuckoo_ms = sfzBenchMs(3, [&]() {
+			u64 sum = 0;
+			for (u64 q : queries) {
+				if (!cuckoo.mayContain(q)) continue;
+				const u64* v = map.get(q);
+				sum += v != nullptr ? *v : 0;
+			}
+			cuckoo_sum = sum;
+		});
+		CHECK(map_sum == bloom_sum);
+		CHECK(map_sum == cuckoo_sum);
+
+		const f64 mq = f64(NUM_QUERIES) / 1000.0;
+		SFZ_BENCH_PRINT("%8u keys, 99%% misses: SfzHashMap %6.1f M/s, bloom + map %6.1f M/s (%5.1f MiB), cuckoo + map %6.1f M/s (%5.1f MiB)",
+			n, mq / map_ms, mq / bloom_ms, f64(bloom.sizeBytes()) / (1024.0 * 1024.0),
+			mq / cuckoo_ms, f64(cuckoo.sizeBytes()) / (1024.0 * 1024.0));
+	}
+}
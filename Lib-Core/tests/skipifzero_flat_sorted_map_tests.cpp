@@ -0,0 +1,217 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#include "doctest.h"
+#include "sfz_bench.hpp"
+#include "sfz_test_utils.hpp"
+
+#include "sfz.h"
+#include "sfz_cpp.hpp"
+#include "skipifzero_allocators.hpp"
+#include "skipifzero_arrays.hpp"
+#include "skipifzero_flat_sorted_map.hpp"
+#include "skipifzero_hash_maps.hpp"
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+TEST_CASE("SfzFlatSortedMap: empty and single element maps")
+{
+	SfzTestCountingAllocator counting;
+	SfzFlatSortedMap<u32, u32> m;
+	m.init(nullptr, nullptr, 0, counting.ptr(), sfz_dbg(""));
+	CHECK(counting.num_allocs == 0);
+	CHECK(m.isEmpty());
+	CHECK(m.lowerBound(0) == 0);
+	CHECK(m.upperBound(U32_MAX) == 0);
+	CHECK(m.find(0) == ~0u);
+	CHECK(m.get(0) == nullptr);
+	u32 num_visited = 0;
+	m.forEachInRange(0, U32_MAX, [&](const u32&, u32&) { num_visited += 1; });
+	CHECK(num_visited == 0);
+
+	const u32 key = 10, value = 100;
+	m.init(&key, &value, 1, counting.ptr(), sfz_dbg(""));
+	CHECK(counting.num_allocs == 1); // Everything in one allocation
+	CHECK(counting.max_align == SfzFlatSortedMap<u32, u32>::ALIGNMENT);
+	CHECK(m.lowerBound(0) == 0);
+	CHECK(m.lowerBound(10) == 0);
+	CHECK(m.lowerBound(11) == 1);
+	CHECK(m.upperBound(10) == 1);
+	CHECK(m[10] == 100);
+	CHECK(m.get(9) == nullptr);
+	CHECK(m.get(11) == nullptr);
+	m.destroy();
+	CHECK(counting.numLive() == 0);
+}
+
+TEST_CASE("SfzFlatSortedMap: complete and incomplete trees")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+
+	// Sizes around powers of two, where the last level of the implicit tree is full, has a single
+	// node or is missing. Keys are the even numbers from 2, so every gap (and both ends) is tested.
+	const u32 sizes[] = { 2, 3, 4, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 64, 65, 255, 256, 257 };
+	for (u32 n : sizes) {
+		CAPTURE(n);
+		std::vector<u32> keys, values;
+		for (u32 i = 0; i < n; i++) {
+			keys.push_back(2 * (n - i)); // Reverse order input
+			values.push_back(n - i);
+		}
+		SfzFlatSortedMap<u32, u32> m;
+		m.init(keys.data(), values.data(), n, &allocator, sfz_dbg(""));
+
+		bool ok = true;
+		for (u32 i = 0; i < n; i++) {
+			ok = ok && m.keys()[i] == 2 * (i + 1);
+			ok = ok && m.values()[i] == i + 1; // Values follow their keys when sorted
+		}
+		for (u32 q = 0; q <= 2 * n + 2; q++) {
+			const u32 expected_lb = q <= 2 ? 0 : u32_min((q - 1) / 2, n);
+			ok = ok && m.lowerBound(q) == expected_lb;
+			ok = ok && m.contains(q) == (q % 2 == 0 && q >= 2 && q <= 2 * n);
+		}
+		ok = ok && m.lowerBound(U32_MAX) == n;
+		CHECK(ok);
+	}
+}
+
+TEST_CASE("SfzFlatSortedMap: signed keys and ranges")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	const i64 keys[] = { 5, -3, I64_MIN, 0, I64_MAX, -100 };
+	const std::string values[] = { "5", "-3", "min", "0", "max", "-100" };
+	SfzFlatSortedMap<i64, std::string> m;
+	m.init(keys, values, 6, &allocator, sfz_dbg(""));
+	CHECK(m.keys()[0] == I64_MIN);
+	CHECK(m.keys()[5] == I64_MAX);
+	CHECK(*m.get(I64_MIN) == "min");
+	CHECK(*m.get(-3) == "-3");
+	CHECK(m.lowerBound(-50) == 2);
+	CHECK(m.upperBound(0) == 4);
+
+	// Ranges are inclusive in both ends
+	std::string visited;
+	m.forEachInRange(-100, 5, [&](const i64&, std::string& v) { visited += v + ","; });
+	CHECK(visited == "-100,-3,0,5,");
+	visited.clear();
+	m.forEachInRange(6, I64_MAX, [&](const i64&, std::string& v) { visited += v; });
+	CHECK(visited == "max");
+	visited.clear();
+	m.forEachInRange(1, -1, [&](const i64&, std::string& v) { visited += v; });
+	CHECK(visited.empty());
+
+	// Values are mutable through get() and the range query
+	*m.get(0) = "zero";
+	m.forEachInRange(0, 0, [&](const i64&, std::string& v) { v += "!"; });
+	CHECK(m[0] == "zero!");
+}
+
+TEST_CASE("SfzFlatSortedMap: lookups and bounds against std::map")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	std::mt19937 rng(6);
+	for (u32 round = 0; round < 300; round++) {
+		const u32 n = rng() % (round < 200 ? 70 : 5000);
+		std::map<u32, std::string> ref;
+		SfzArray<u32> keys(0, &allocator, sfz_dbg(""));
+		SfzArray<std::string> values(0, &allocator, sfz_dbg(""));
+		while (ref.size() < n) {
+			const u32 k = rng() % (n * 3 + 1);
+			if (ref.count(k)) continue;
+			ref[k] = std::to_string(k * 7);
+			keys.add(k);
+			values.add(ref[k]);
+		}
+		SfzFlatSortedMap<u32, std::string> m(keys, values, &allocator, sfz_dbg(""));
+		REQUIRE(m.size() == n);
+
+		std::vector<u32> sorted_keys;
+		for (auto& [k, v] : ref) sorted_keys.push_back(k);
+		for (u32 q = 0; q < n * 3 + 5; q++) {
+			const u32 lb = u32(std::lower_bound(sorted_keys.begin(), sorted_keys.end(), q) - sorted_keys.begin());
+			const u32 ub = u32(std::upper_bound(sorted_keys.begin(), sorted_keys.end(), q) - sorted_keys.begin());
+			REQUIRE(m.lowerBound(q) == lb);
+			REQUIRE(m.upperBound(q) == ub);
+			const std::string* v = m.get(q);
+			REQUIRE((v != nullptr) == (ref.count(q) == 1));
+			if (v != nullptr) REQUIRE(*v == ref[q]);
+		}
+	}
+}
+
+// Benchmarks
+// ------------------------------------------------------------------------------------------------
+
+SFZ_BENCHMARK("SfzFlatSortedMap: lookups against SfzHashMap and binary search")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	constexpr u32 NUM_QUERIES = 1u << 22;
+	const u32 sizes[] = { 1000, 10000, 100000, 1000000, 10000000 };
+
+	for (u32 n : sizes) {
+		// Unique random looking keys (multiplying by an odd constant is a bijection on u32)
+		SfzArray<u32> keys(n, &allocator, sfz_dbg("")), values(n, &allocator, sfz_dbg(""));
+		for (u32 i = 0; i < n; i++) {
+			keys.add(i * 2654435761u);
+			values.add(i);
+		}
+		SfzFlatSortedMap<u32, u32> flat(keys, values, &allocator, sfz_dbg(""));
+		SfzHashMap<u32, u32> hash(0, &allocator, sfz_dbg(""));
+		for (u32 i = 0; i < n; i++) hash.put(keys[i], values[i]);
+		std::vector<u32> sorted(keys.data(), keys.data() + n);
+		std::sort(sorted.begin(), sorted.end());
+
+		// Half hits, half misses
+		std::vector<u32> queries(NUM_QUERIES);
+		std::mt19937 rng(n);
+		for (u32 i = 0; i < NUM_QUERIES; i++) {
+			queries[i] = (i % 2 == 0 ? rng() % n : n + rng() % n) * 2654435761u;
+		}
+
+		u64 flat_sum = 0, hash_sum = 0, binary_sum = 0;
+		const f64 flat_ms = sfzBenchMs(3, [&]() {
+			u64 sum = 0;
+			for (u32 q : queries) { const u32* v = flat.get(q); sum += v != nullptr ? *v : 1; }
+			flat_sum = sum;
+		});
+		const f64 hash_ms = sfzBenchMs(3, [&]() {
+			u64 sum = 0;
+			for (u32 q : queries) { const u32* v = hash.get(q); sum += v != nullptr ? *v : 1; }
+			hash_sum = sum;
+		});
+		const f64 binary_ms = sfzBenchMs(3, [&]() {
+			u64 sum = 0;
+			for (u32 q : queries) {
+				auto it = std::lower_bound(sorted.begin(), sorted.end(), q);
+				sum += (it != sorted.end() && *it == q) ? flat.values()[it - sorted.begin()] : 1;
+			}
+			binary_sum = sum;
+		});
+		CHECK(flat_sum == hash_sum);
+		CHECK(flat_sum == binary_sum);
+
+		const f64 mq = f64(NUM_QUERIES) / 1000.0;
+		SFZ_BENCH_PRINT("%8u keys: SfzFlatSortedMap %6.1f M/s, SfzHashMap %6.1f M/s, binary search %6.1f M/s",
+			n, mq / flat_ms, mq / hash_ms, mq / binary_ms);
+	}
+}
@@ -0,0 +1,238 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#include "doctest.h"
+#include "sfz_bench.hpp"
+
+#include "sfz.h"
+#include "sfz_cpp.hpp"
+#include "skipifzero_allocators.hpp"
+#include "skipifzero_frozen_hash_map.hpp"
+#include "skipifzero_hash_maps.hpp"
+#include "skipifzero_strings.hpp"
+
+#include <cstddef>
+#include <random>
+#include <vector>
+
+namespace {
+
+struct Val { u32 a; f32 b; };
+
+// Owning, suitably aligned memory for a frozen hash map image
+struct Blob {
+	SfzAllocator* allocator = nullptr;
+	u8* data = nullptr;
+	Blob(SfzAllocator* allocator, u64 size) : allocator(allocator)
+	{
+		data = static_cast<u8*>(allocator->alloc(sfz_dbg(""), size, SFZ_FROZEN_HASH_MAP_ALIGNMENT));
+	}
+	~Blob() { allocator->dealloc(data); }
+};
+
+} // namespace
+
+TEST_CASE("SfzFrozenHashMap: build, relocate and look up")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	std::mt19937 rng(1);
+	SfzHashMap<u64, Val> map(0, &allocator, sfz_dbg(""));
+	for (u32 i = 0; i < 50000; i++) {
+		const u64 k = (u64(rng()) << 20) ^ rng();
+		map.put(k, Val{ i, f32(i) });
+	}
+
+	using FrozenMap = SfzFrozenHashMap<u64, Val>;
+	const u64 size = FrozenMap::sizeBytesFor(map.size());
+	Blob blob(&allocator, size);
+	CHECK(!FrozenMap::build(map, blob.data, size - 1, 7));
+	REQUIRE(FrozenMap::build(map, blob.data, size, 7));
+
+	// The image contains no pointers, so it can be memcpy:d anywhere
+	Blob relocated(&allocator, size);
+	memcpy(relocated.data, blob.data, size);
+	memset(blob.data, 0xCD, size);
+
+	FrozenMap frozen;
+	CHECK(!frozen.init(relocated.data, size, 8)); // Wrong type tag
+	CHECK(!frozen.init(relocated.data, size - 1, 7)); // Truncated
+	CHECK(!SfzFrozenHashMap<u32, Val>().init(relocated.data, size, 7)); // Wrong key type
+	REQUIRE(frozen.init(relocated.data, size, 7));
+	REQUIRE(frozen.size() == map.size());
+
+	bool all_found = true;
+	for (auto pair : map) {
+		const Val* v = frozen.get(pair.key);
+		all_found = all_found && v != nullptr && v->a == pair.value.a;
+	}
+	CHECK(all_found);
+	bool misses_ok = true;
+	for (u32 i = 0; i < 50000; i++) {
+		const u64 k = (u64(rng()) << 40) + 1;
+		misses_ok = misses_ok && (frozen.get(k) != nullptr) == (map.get(k) != nullptr);
+	}
+	CHECK(misses_ok);
+}
+
+TEST_CASE("SfzFrozenHashMap: duplicates, empty and string keys")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	Blob blob(&allocator, 4096);
+
+	const u64 dup_keys[2] = { 5, 5 };
+	const Val dup_values[2] = {};
+	CHECK(!SfzFrozenHashMap<u64, Val>::build(dup_keys, dup_values, 2, blob.data, 4096));
+
+	SfzFrozenHashMap<u64, Val> empty;
+	REQUIRE(SfzFrozenHashMap<u64, Val>::build(dup_keys, dup_values, 0, blob.data, 4096));
+	REQUIRE(empty.init(blob.data, 4096));
+	CHECK(!empty.contains(5));
+
+	const SfzStr32 str_keys[3] = { "a", "bb", "ccc" };
+	const u32 str_values[3] = { 1, 2, 3 };
+	SfzFrozenHashMap<SfzStr32, u32> strs;
+	REQUIRE(SfzFrozenHashMap<SfzStr32, u32>::build(str_keys, str_values, 3, blob.data, 4096));
+	REQUIRE(strs.init(blob.data, 4096));
+	CHECK(strs["bb"] == 2);
+	CHECK(!strs.contains("dddd"));
+}
+
+TEST_CASE("SfzFrozenHashMap: header validation and validate_slots")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	using FrozenMap = SfzFrozenHashMap<u32, u32>;
+	std::vector<u32> keys, values;
+	for (u32 i = 0; i < 1000; i++) {
+		keys.push_back(i * 31);
+		values.push_back(i);
+	}
+	const u64 size = FrozenMap::sizeBytesFor(1000);
+	Blob blob(&allocator, size + SFZ_FROZEN_HASH_MAP_ALIGNMENT);
+	REQUIRE(FrozenMap::build(keys.data(), values.data(), 1000, blob.data, size));
+	std::vector<u8> original(blob.data, blob.data + size);
+
+	FrozenMap frozen;
+	auto corrupted = [&](u32 offset, u32 value) {
+		memcpy(blob.data, original.data(), size);
+		memcpy(blob.data + offset, &value, sizeof(u32));
+		return !frozen.init(blob.data, size) && !frozen.isValid();
+	};
+	CHECK(corrupted(offsetof(SfzFrozenHashMapHeader, magic), 0));
+	CHECK(corrupted(offsetof(SfzFrozenHashMapHeader, version), SFZ_FROZEN_HASH_MAP_VERSION + 1));
+	CHECK(corrupted(offsetof(SfzFrozenHashMapHeader, num_entries), 100000));
+	CHECK(corrupted(offsetof(SfzFrozenHashMapHeader, size_bytes), u32(size + 32)));
+	CHECK(corrupted(offsetof(SfzFrozenHashMapHeader, num_slot_bits), 31));
+	CHECK(corrupted(offsetof(SfzFrozenHashMapHeader, keys_offset), 0));
+	memcpy(blob.data, original.data(), size);
+	CHECK(!frozen.init(nullptr, size));
+	CHECK(!frozen.init(blob.data, sizeof(SfzFrozenHashMapHeader) - 1));
+
+	// Not aligned to SFZ_FROZEN_HASH_MAP_ALIGNMENT
+	memcpy(blob.data + 8, original.data(), size);
+	CHECK(!frozen.init(blob.data + 8, size));
+
+	// A bad entry index in a slot is only found when validating the slots
+	memcpy(blob.data, original.data(), size);
+	const u64 slots_offset = reinterpret_cast<const SfzFrozenHashMapHeader*>(blob.data)->slots_offset;
+	SfzFrozenHashMapSlot* slots = reinterpret_cast<SfzFrozenHashMapSlot*>(blob.data + slots_offset);
+	const u32 num_slots = 1u << FrozenMap::numSlotBitsFor(1000);
+	u32 occupied_idx = 0;
+	while (slots[occupied_idx].entry_idx == SFZ_FROZEN_HASH_MAP_EMPTY) occupied_idx += 1;
+	slots[occupied_idx].entry_idx = 1000;
+	CHECK(frozen.init(blob.data, size));
+	CHECK(!frozen.init(blob.data, size, 0, true));
+	CHECK(!frozen.isValid());
+
+	// Emptied slots (fewer occupied slots than entries)
+	memcpy(blob.data, original.data(), size);
+	slots[occupied_idx].entry_idx = SFZ_FROZEN_HASH_MAP_EMPTY;
+	CHECK(!frozen.init(blob.data, size, 0, true));
+
+	// Lookups terminate even if no slot is empty
+	for (u32 i = 0; i < num_slots; i++) slots[i] = { 0, 0 };
+	REQUIRE(frozen.init(blob.data, size));
+	CHECK(frozen.get(u32(12345)) == nullptr);
+	CHECK(!frozen.init(blob.data, size, 0, true));
+
+	memcpy(blob.data, original.data(), size);
+	REQUIRE(frozen.init(blob.data, size, 0, true));
+	bool all_found = true;
+	for (u32 i = 0; i < 1000; i++) all_found = all_found && frozen[i * 31] == i;
+	CHECK(all_found);
+	frozen.destroy();
+	CHECK(!frozen.isValid());
+	CHECK(frozen.get(u32(0)) == nullptr);
+}
+
+// Benchmarks
+// ------------------------------------------------------------------------------------------------
+
+SFZ_BENCHMARK("SfzFrozenHashMap: startup with 1M entries against rebuilding a SfzHashMap")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	constexpr u32 NUM_ENTRIES = 1000000;
+	using FrozenMap = SfzFrozenHashMap<u64, Val>;
+	std::mt19937_64 rng(1);
+	std::vector<u64> keys(NUM_ENTRIES);
+	std::vector<Val> values(NUM_ENTRIES);
+	for (u32 i = 0; i < NUM_ENTRIES; i++) {
+		keys[i] = rng();
+		values[i] = Val{ i, f32(i) };
+	}
+
+	// The "file" both approaches load from, the raw key/value arrays or the frozen blob
+	const u64 size = FrozenMap::sizeBytesFor(NUM_ENTRIES);
+	Blob file(&allocator, size);
+	REQUIRE(FrozenMap::build(keys.data(), values.data(), NUM_ENTRIES, file.data, size));
+	Blob loaded(&allocator, size);
+
+	u32 rebuilt_size = 0;
+	const f64 rebuild_ms = sfzBenchMs(3, [&]() {
+		SfzHashMap<u64, Val> map(0, &allocator, sfz_dbg(""));
+		for (u32 i = 0; i < NUM_ENTRIES; i++) map.put(keys[i], values[i]);
+		rebuilt_size = map.size();
+	});
+	const f64 rebuild_reserved_ms = sfzBenchMs(3, [&]() {
+		SfzHashMap<u64, Val> map(u32(NUM_ENTRIES / 0.8f) + 2, &allocator, sfz_dbg(""));
+		for (u32 i = 0; i < NUM_ENTRIES; i++) map.put(keys[i], values[i]);
+		sfzBenchKeep(map.size());
+	});
+	bool init_ok = false;
+	const f64 init_ms = sfzBenchMs(10, [&]() {
+		FrozenMap frozen;
+		init_ok = frozen.init(file.data, size);
+	});
+	const f64 copy_init_ms = sfzBenchMs(10, [&]() {
+		memcpy(loaded.data, file.data, size);
+		FrozenMap frozen;
+		init_ok = init_ok && frozen.init(loaded.data, size);
+	});
+	const f64 validate_ms = sfzBenchMs(10, [&]() {
+		FrozenMap frozen;
+		init_ok = init_ok && frozen.init(file.data, size, 0, true);
+	});
+	CHECK(rebuilt_size == NUM_ENTRIES);
+	CHECK(init_ok);
+
+	SFZ_BENCH_PRINT("%u entries (%.1f MiB blob):", NUM_ENTRIES, f64(size) / (1024.0 * 1024.0));
+	SFZ_BENCH_PRINT("  SfzHashMap put() rebuild:              %8.3f ms", rebuild_ms);
+	SFZ_BENCH_PRINT("  SfzHashMap put() rebuild, reserved:    %8.3f ms", rebuild_reserved_ms);
+	SFZ_BENCH_PRINT("  SfzFrozenHashMap init() (mapped):      %8.5f ms", init_ms);
+	SFZ_BENCH_PRINT("  SfzFrozenHashMap memcpy() + init():    %8.3f ms", copy_init_ms);
+	SFZ_BENCH_PRINT("  SfzFrozenHashMap init(validate_slots): %8.3f ms", validate_ms);
+}
@@ -0,0 +1,210 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#include "doctest.h"
+#include "sfz_bench.hpp"
+
+#include "sfz.h"
+#include "sfz_matrix.h"
+#include "skipifzero_geometry.hpp"
+
+#include <cstring>
+#include <limits>
+#include <random>
+#include <utility>
+#include <vector>
+
+using sfz::AABB;
+
+namespace {
+
+// Bitwise equal, except that any NaN is considered equal to any other NaN
+bool sameBits(const AABB& a, const AABB& b)
+{
+	const f32* a_f = &a.min.x;
+	const f32* b_f = &b.min.x;
+	for (u32 i = 0; i < 6; i++) {
+		if (a_f[i] != a_f[i] && b_f[i] != b_f[i]) continue;
+		if (memcmp(&a_f[i], &b_f[i], sizeof(f32)) != 0) return false;
+	}
+	return true;
+}
+
+SfzMat44 randomAffine(std::mt19937& rng, std::uniform_real_distribution<f32>& dist)
+{
+	SfzMat44 m;
+	for (u32 i = 0; i < 3; i++) {
+		m.rows[i] = f32x4_init(dist(rng), dist(rng), dist(rng), dist(rng));
+	}
+	m.rows[3] = f32x4_init(0.0f, 0.0f, 0.0f, 1.0f);
+	return m;
+}
+
+// Fills num AABBs with stride_floats floats between them, with min <= max per axis
+void fillAABBs(std::mt19937& rng, std::uniform_real_distribution<f32>& dist, f32* dst, u64 num, u64 stride_floats)
+{
+	for (u64 i = 0; i < num * stride_floats; i++) dst[i] = dist(rng);
+	for (u64 i = 0; i < num; i++) {
+		for (u64 k = 0; k < 3; k++) {
+			f32& min = dst[i * stride_floats + k];
+			f32& max = dst[i * stride_floats + 3 + k];
+			if (min > max) std::swap(min, max);
+		}
+	}
+}
+
+} // namespace
+
+// AABB transforms
+// ------------------------------------------------------------------------------------------------
+
+TEST_CASE("transformAABBs: identical to transformAABB() and encloses the transformed corners")
+{
+	std::mt19937 rng(3);
+	std::uniform_real_distribution<f32> dist(-10.0f, 10.0f);
+	u32 num_bad = 0;
+	u32 num_corners_outside = 0;
+	for (u32 it = 0; it < 2000; it++) {
+		const SfzMat44 m = randomAffine(rng, dist);
+
+		// Exactly sized strided source, so that reading past the last AABB is caught by sanitizers
+		const u64 num = rng() % 40;
+		const u64 stride_floats = it % 3 == 0 ? 6 : 6 + rng() % 4;
+		std::vector<f32> src(num * stride_floats);
+		fillAABBs(rng, dist, src.data(), num, stride_floats);
+		auto srcAt = [&](u64 i) { return *reinterpret_cast<const AABB*>(src.data() + i * stride_floats); };
+
+		std::vector<AABB> dst(num), ref(num);
+		transformAABBs(m, dst.data(), reinterpret_cast<const AABB*>(src.data()), stride_floats * sizeof(f32), num);
+		for (u64 i = 0; i < num; i++) ref[i] = transformAABB(m, srcAt(i));
+		if (num != 0 && memcmp(dst.data(), ref.data(), num * sizeof(AABB)) != 0) num_bad += 1;
+
+		for (u64 i = 0; i < num; i++) {
+			const AABB aabb = srcAt(i);
+			for (u32 c = 0; c < 8; c++) {
+				const f32x3 corner = f32x3_init(
+					(c & 1) ? aabb.max.x : aabb.min.x,
+					(c & 2) ? aabb.max.y : aabb.min.y,
+					(c & 4) ? aabb.max.z : aabb.min.z);
+				const f32x3 p = sfzMat44TransformPoint(m, corner);
+				for (u32 k = 0; k < 3; k++) {
+					if (p[k] < ref[i].min[k] - 1e-3f || p[k] > ref[i].max[k] + 1e-3f) num_corners_outside += 1;
+				}
+			}
+		}
+	}
+	CHECK(num_bad == 0);
+	CHECK(num_corners_outside == 0);
+}
+
+TEST_CASE("transformAABB: exact results for simple transforms")
+{
+	const AABB box = AABB::fromCorners(f32x3_init(-1.0f, 0.0f, 2.0f), f32x3_init(3.0f, 1.0f, 4.0f));
+	auto same = [](const AABB& a, const AABB& b) { return a.min == b.min && a.max == b.max; };
+
+	CHECK(same(transformAABB(sfzMat44Identity(), box), box));
+	CHECK(same(transformAABB(sfzMat44Translation3(f32x3_init(1.0f, 2.0f, 3.0f)), box),
+		AABB::fromCorners(f32x3_init(0.0f, 2.0f, 5.0f), f32x3_init(4.0f, 3.0f, 7.0f))));
+
+	// Mirroring swaps which corner ends up as min and max
+	CHECK(same(transformAABB(sfzMat44Scaling3(f32x3_init(-1.0f, 2.0f, -0.5f)), box),
+		AABB::fromCorners(f32x3_init(-3.0f, 0.0f, -2.0f), f32x3_init(1.0f, 2.0f, -1.0f))));
+
+	// 90 degrees around z, (x, y) -> (-y, x)
+	const SfzMat44 rot = sfzMat44InitElems(
+		0.0f, -1.0f, 0.0f, 0.0f,
+		1.0f, 0.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f);
+	CHECK(same(transformAABB(rot, box), AABB::fromCorners(f32x3_init(-1.0f, -1.0f, 2.0f), f32x3_init(0.0f, 3.0f, 4.0f))));
+
+	// A point stays a point, and the last row is ignored
+	SfzMat44 m = sfzMat44Translation3(f32x3_init(1.0f, 1.0f, 1.0f));
+	m.rows[3] = f32x4_init(5.0f, 6.0f, 7.0f, 8.0f);
+	const f32x3 p = f32x3_init(1.0f, 2.0f, 3.0f);
+	CHECK(same(transformAABB(m, AABB::fromCorners(p, p)), AABB::fromCorners(p + f32x3_splat(1.0f), p + f32x3_splat(1.0f))));
+}
+
+TEST_CASE("transformAABBs: special values, unaligned source and destination bounds")
+{
+	constexpr f32 INF = std::numeric_limits<f32>::infinity();
+	constexpr f32 NAN_F32 = std::numeric_limits<f32>::quiet_NaN();
+	constexpr f32 SPECIALS[] = { 0.0f, -0.0f, INF, -INF, NAN_F32, 1e-40f, 3e38f, -3e38f };
+	std::mt19937 rng(4);
+	std::uniform_real_distribution<f32> dist(-10.0f, 10.0f);
+	auto maybeSpecial = [&](f32 v) { return rng() % 4 == 0 ? SPECIALS[rng() % 8] : v; };
+
+	const AABB GUARD = AABB::fromCorners(f32x3_splat(12345.0f), f32x3_splat(12345.0f));
+	u32 num_bad = 0, num_guard_bad = 0;
+	for (u32 it = 0; it < 3000; it++) {
+		SfzMat44 m = randomAffine(rng, dist);
+		for (u32 y = 0; y < 3; y++) {
+			for (u32 x = 0; x < 4; x++) m.at(y, x) = maybeSpecial(m.at(y, x));
+		}
+
+		// Every count around the 4-wide main loop and its scalar tail, from a source that starts 4
+		// bytes into its allocation and ends exactly at its last AABB. min > max and NaNs are
+		// allowed here, the results must still match transformAABB() bit for bit.
+		const u64 num = it % 13;
+		const u64 stride_floats = 6 + it % 3;
+		std::vector<f32> src_storage(1 + num * stride_floats);
+		f32* src = src_storage.data() + 1;
+		for (u64 i = 0; i < num * stride_floats; i++) src[i] = maybeSpecial(dist(rng));
+
+		std::vector<AABB> dst(num + 1, GUARD);
+		transformAABBs(m, dst.data(), reinterpret_cast<const AABB*>(src), stride_floats * sizeof(f32), num);
+		for (u64 i = 0; i < num; i++) {
+			num_bad += sameBits(dst[i], transformAABB(m, *reinterpret_cast<const AABB*>(src + i * stride_floats))) ? 0 : 1;
+		}
+		num_guard_bad += sameBits(dst[num], GUARD) ? 0 : 1;
+	}
+	CHECK(num_bad == 0);
+	CHECK(num_guard_bad == 0);
+}
+
+// Benchmarks
+// ------------------------------------------------------------------------------------------------
+
+SFZ_BENCHMARK("transformAABBs: AABBs per second against the per-AABB loop for 1K to 10M AABBs")
+{
+	constexpr u64 MAX_NUM = 10000000;
+	constexpr u64 MAX_STRIDE_FLOATS = 8; // AABB plus e.g. an entity id and flags, i.e. 32 bytes
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<f32> dist(-10.0f, 10.0f);
+	std::vector<f32> src(MAX_NUM * MAX_STRIDE_FLOATS);
+	std::vector<AABB> dst(MAX_NUM), ref(MAX_NUM);
+	const SfzMat44 m = randomAffine(rng, dist);
+	SFZ_BENCH_PRINT("M AABBs/s; loop = transformAABB() per AABB");
+
+	for (u64 stride_floats : { u64(6), MAX_STRIDE_FLOATS }) {
+		fillAABBs(rng, dist, src.data(), MAX_NUM, stride_floats);
+		const u64 stride = stride_floats * sizeof(f32);
+		const AABB* src_ptr = reinterpret_cast<const AABB*>(src.data());
+		for (u64 num = 1000; num <= MAX_NUM; num *= 10) {
+			const u32 num_reps = u32(u64_max(3, 50000000 / num));
+			auto mps = [&](auto func) { return f64(num) / (sfzBenchMs(num_reps, func) * 1000.0); };
+
+			const f64 batch = mps([&]() { transformAABBs(m, dst.data(), src_ptr, stride, num); });
+			const f64 loop = mps([&]() {
+				for (u64 i = 0; i < num; i++) ref[i] = transformAABB(m, *reinterpret_cast<const AABB*>(src.data() + i * stride_floats));
+			});
+			CHECK(memcmp(dst.data(), ref.data(), num * sizeof(AABB)) == 0);
+			SFZ_BENCH_PRINT("stride %2llu B, %8llu: batch %7.1f loop %7.1f speedup %.2fx", stride, num, batch, loop, batch / loop);
+		}
+	}
+}
@@ -0,0 +1,262 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#include "doctest.h"
+#include "sfz_bench.hpp"
+#include "sfz_test_utils.hpp"
+
+#include "sfz.h"
+#include "sfz_cpp.hpp"
+#include "skipifzero_allocators.hpp"
+#include "skipifzero_hash_maps.hpp"
+#include "skipifzero_strings.hpp"
+
+#include <random>
+#include <set>
+#include <vector>
+
+// SfzHashSet
+// ------------------------------------------------------------------------------------------------
+
+TEST_CASE("SfzHashSet: random operations and set algebra against std::set")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	std::mt19937 rng(9);
+	SfzHashSet<u64> set(0, &allocator, sfz_dbg(""));
+	std::set<u64> ref;
+	SfzHashSetLocal<u64, 64> local_set;
+	std::set<u64> local_ref;
+
+	for (u32 it = 0; it < 100000; it++) {
+		const u64 k = rng() % 2000;
+		const u32 op = rng() % 10;
+		if (op < 5) {
+			REQUIRE(set.add(k) == ref.insert(k).second);
+		}
+		else if (op < 9) {
+			REQUIRE(set.remove(k) == (ref.erase(k) == 1));
+		}
+		else {
+			std::vector<u64> keys;
+			for (u32 i = 0; i < 50; i++) keys.push_back(rng() % 2000);
+			u32 num_new = 0;
+			for (u64 x : keys) num_new += ref.insert(x).second ? 1 : 0;
+			REQUIRE(set.add(keys.data(), 50) == num_new);
+		}
+		REQUIRE(set.size() == ref.size());
+		REQUIRE(set.contains(k) == (ref.count(k) == 1));
+
+		const u64 kl = rng() % 100;
+		if ((rng() % 2) != 0 && !local_set.isFull()) {
+			REQUIRE(local_set.add(kl) == local_ref.insert(kl).second);
+		}
+		else {
+			REQUIRE(local_set.remove(kl) == (local_ref.erase(kl) == 1));
+		}
+		REQUIRE(local_set.size() == local_ref.size());
+
+		if (it % 1000 == 0) {
+			REQUIRE(std::set<u64>(set.begin(), set.end()) == ref);
+
+			SfzHashSet<u64> copy = set.clone(&allocator, sfz_dbg(""));
+			SfzHashSet<u64> other(0, &allocator, sfz_dbg(""));
+			std::set<u64> other_ref;
+			const u32 num_other = rng() % 3000;
+			for (u32 i = 0; i < num_other; i++) {
+				const u64 x = rng() % 2000;
+				other.add(x);
+				other_ref.insert(x);
+			}
+
+			std::set<u64> expected;
+			switch (rng() % 3) {
+			case 0:
+				copy.unionWith(other);
+				expected = ref;
+				expected.insert(other_ref.begin(), other_ref.end());
+				break;
+			case 1:
+				copy.intersectWith(other);
+				for (u64 x : ref) if (other_ref.count(x)) expected.insert(x);
+				break;
+			case 2:
+				copy.differenceWith(other);
+				for (u64 x : ref) if (!other_ref.count(x)) expected.insert(x);
+				break;
+			}
+			REQUIRE(copy.size() == expected.size());
+			REQUIRE(std::set<u64>(copy.begin(), copy.end()) == expected);
+			bool contains_ok = true;
+			for (u64 x = 0; x < 2000; x++) contains_ok = contains_ok && copy.contains(x) == (expected.count(x) == 1);
+			REQUIRE(contains_ok);
+
+			SfzHashSetLocal<u64, 64> local_copy = local_set;
+			local_copy.intersectWith(set);
+			std::set<u64> local_expected;
+			for (u64 x : local_ref) if (ref.count(x)) local_expected.insert(x);
+			REQUIRE(std::set<u64>(local_copy.begin(), local_copy.end()) == local_expected);
+		}
+	}
+}
+
+TEST_CASE("SfzHashSet: string keys with alt key lookups")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	SfzHashSet<SfzStr32> set(0, &allocator, sfz_dbg(""));
+	CHECK(set.add("hello"));
+	CHECK(set.add(sfzStr32Init("world")));
+	CHECK(set.contains("hello"));
+	CHECK(!set.contains("nope"));
+	CHECK(!set.add("world"));
+	CHECK(set.remove("hello"));
+	CHECK(set.size() == 1);
+}
+
+TEST_CASE("SfzHashSet: adding keys from the set itself does not rehash")
+{
+	SfzTestCountingAllocator counting;
+	SfzHashSet<u64> set(1, counting.ptr(), sfz_dbg(""));
+	REQUIRE(set.capacity() == SfzHashSet<u64>::MIN_CAPACITY);
+
+	// Fill up to the point where the next add() rehashes
+	const u32 max_num_occupied = u32(set.capacity() * SfzHashSet<u64>::MAX_OCCUPIED_REHASH_FACTOR);
+	for (u64 i = 0; i < max_num_occupied; i++) set.add(i * 7);
+	const u64 num_allocs = counting.num_allocs;
+	const u32 capacity = set.capacity();
+
+	CHECK(!set.add(set.keys()[0]));
+	CHECK(!set.add(set.keys()[set.size() - 1]));
+	CHECK(set.add(set.keys(), set.size()) == 0);
+	CHECK(set.add(set.keys() + 10, 5) == 0);
+	set.unionWith(set);
+	CHECK(counting.num_allocs == num_allocs);
+	CHECK(set.capacity() == capacity);
+	CHECK(set.size() == max_num_occupied);
+
+	// Same keys from a different set are not aliased, and do rehash
+	SfzHashSet<u64> copy = set.clone(counting.ptr(), sfz_dbg(""));
+	const u64 num_allocs_after_clone = counting.num_allocs;
+	CHECK(copy.add(u64(1)));
+	CHECK(counting.num_allocs == num_allocs_after_clone + 1);
+	set.unionWith(copy);
+	CHECK(set.size() == max_num_occupied + 1);
+	CHECK(set.contains(u64(1)));
+
+	set.intersectWith(set);
+	CHECK(set.size() == max_num_occupied + 1);
+	set.differenceWith(set);
+	CHECK(set.isEmpty());
+
+	set.destroy();
+	copy.destroy();
+	CHECK(counting.numLive() == 0);
+}
+
+TEST_CASE("SfzHashSet: bulk add rehashes at most once")
+{
+	SfzTestCountingAllocator counting;
+	SfzHashSet<u64> set(0, counting.ptr(), sfz_dbg(""));
+	std::vector<u64> keys;
+	for (u64 i = 0; i < 10000; i++) keys.push_back(i % 5000); // Every key twice
+	const u64 num_allocs = counting.num_allocs;
+	CHECK(set.add(keys.data(), u32(keys.size())) == 5000);
+	CHECK(counting.num_allocs == num_allocs + 1);
+	CHECK(set.add(keys.data(), 0) == 0);
+	CHECK(set.add(keys.data(), u32(keys.size())) == 0);
+	CHECK(set.size() == 5000);
+}
+
+TEST_CASE("SfzHashSetLocal: set algebra with itself and SfzHashSet")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	SfzHashSetLocal<u32, 16> local;
+	for (u32 i = 0; i < 12; i++) local.add(i);
+	CHECK(local.add(local.keys(), local.size()) == 0);
+	local.unionWith(local);
+	local.intersectWith(local);
+	CHECK(local.size() == 12);
+
+	SfzHashSet<u32> set(0, &allocator, sfz_dbg(""));
+	for (u32 i = 8; i < 100; i++) set.add(i);
+	local.intersectWith(set);
+	CHECK(local.size() == 4);
+	for (u32 i = 8; i < 12; i++) CHECK(local.contains(i));
+	set.differenceWith(local);
+	CHECK(set.size() == 88);
+	CHECK(!set.contains(u32(8)));
+	set.unionWith(local);
+	CHECK(set.size() == 92);
+	SfzHashSet<u32> small(0, &allocator, sfz_dbg(""));
+	for (u32 i = 0; i < 16; i++) small.add(i);
+	local.unionWith(small);
+	CHECK(local.isFull());
+
+	local.differenceWith(local);
+	CHECK(local.isEmpty());
+	CHECK(local.placeholders() == 16);
+	CHECK(local.add(u32(3)));
+	CHECK(local.placeholders() == 15);
+}
+
+// Benchmarks
+// ------------------------------------------------------------------------------------------------
+
+SFZ_BENCHMARK("SfzHashSet: footprint and contains() against SfzHashMap<K, u8> as a set")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	const u32 sizes[] = { 1000, 100000, 10000000 };
+	for (u32 n : sizes) {
+		SfzHashSet<u64> set(0, &allocator, sfz_dbg(""));
+		SfzHashMap<u64, u8> map(0, &allocator, sfz_dbg(""));
+		std::mt19937_64 rng(n);
+		std::vector<u64> keys(n);
+		for (u32 i = 0; i < n; i++) {
+			keys[i] = rng();
+			set.add(keys[i]);
+			map.put(keys[i], 1);
+		}
+
+		// Cloning makes a single allocation of the final size
+		SfzTestCountingAllocator set_counting, map_counting;
+		SfzHashSet<u64> set_clone = set.clone(set_counting.ptr(), sfz_dbg(""));
+		SfzHashMap<u64, u8> map_clone = map.clone(map_counting.ptr(), sfz_dbg(""));
+
+		// Half hits, half misses
+		constexpr u32 NUM_QUERIES = 1u << 22;
+		std::vector<u64> queries(NUM_QUERIES);
+		for (u32 i = 0; i < NUM_QUERIES; i++) queries[i] = (i & 1) ? keys[rng() % n] : rng();
+
+		u32 set_hits = 0, map_hits = 0;
+		const f64 set_ms = sfzBenchMs(3, [&]() {
+			u32 hits = 0;
+			for (u64 q : queries) hits += set.contains(q) ? 1 : 0;
+			set_hits = hits;
+		});
+		const f64 map_ms = sfzBenchMs(3, [&]() {
+			u32 hits = 0;
+			for (u64 q : queries) hits += map.get(q) != nullptr ? 1 : 0;
+			map_hits = hits;
+		});
+		CHECK(set_hits == map_hits);
+
+		const f64 mq = f64(NUM_QUERIES) / 1000.0;
+		SFZ_BENCH_PRINT("%8u keys: SfzHashSet %7.2f MiB, %6.1f M/s | SfzHashMap<u64, u8> %7.2f MiB, %6.1f M/s",
+			n, f64(set_counting.num_bytes_allocated) / (1024.0 * 1024.0), mq / set_ms,
+			f64(map_counting.num_bytes_allocated) / (1024.0 * 1024.0), mq / map_ms);
+	}
+}
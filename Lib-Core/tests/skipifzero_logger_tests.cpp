@@ -0,0 +1,347 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#include "doctest.h"
+#include "sfz_bench.hpp"
+
+#include "sfz.h"
+#include "sfz_cpp.hpp"
+#include "skipifzero_allocators.hpp"
+#include "skipifzero_logger.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Collected {
+	std::vector<std::string> msgs;
+	std::vector<SfzLogLevel> levels;
+	std::vector<u32> thread_idxs;
+	std::vector<u64> timestamps;
+};
+
+void collectSink(void* userdata, const SfzLogMessage* msg)
+{
+	Collected& collected = *static_cast<Collected*>(userdata);
+	collected.msgs.push_back(msg->msg);
+	collected.levels.push_back(msg->level);
+	collected.thread_idxs.push_back(msg->thread_idx);
+	collected.timestamps.push_back(msg->timestamp_ns);
+}
+
+// Parses the messages logged by the threads in the multi-threaded test and checks that the
+// arguments survived the trip through the ring buffer.
+struct Verifier {
+	u64 num_received = 0;
+	u64 num_bad = 0;
+	u64 num_dropped_reported = 0;
+};
+
+void verifySink(void* userdata, const SfzLogMessage* msg)
+{
+	Verifier& v = *static_cast<Verifier*>(userdata);
+	if (strncmp(msg->msg, "Dropped ", 8) == 0) {
+		v.num_dropped_reported += strtoull(msg->msg + 8, nullptr, 10);
+		return;
+	}
+	i32 t = 0;
+	unsigned long long i = 0;
+	f64 f = 0.0;
+	char name[64] = {};
+	if (sscanf(msg->msg, "thread %d iter %llu f=%lf name=%63s", &t, &i, &f, name) != 4) {
+		v.num_bad += 1;
+		return;
+	}
+	char expected_name[64] = {};
+	snprintf(expected_name, 64, "thr%d_%llu", t, i);
+	if (strcmp(expected_name, name) != 0 || f != f64(f32(i) * 0.5f)) v.num_bad += 1;
+	v.num_received += 1;
+}
+
+} // namespace
+
+// SfzLogger
+// ------------------------------------------------------------------------------------------------
+
+TEST_CASE("SfzLogger: formatting of argument types")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	SfzLogger logger;
+	logger.init(&allocator, false);
+	Collected collected;
+	logger.addSink(collectSink, &collected);
+
+	const char* null_str = nullptr;
+	char mutable_str[16] = "mutable";
+	std::string temporary = "temp";
+	SFZ_LOG_WARNING(&logger, "no args");
+	SFZ_LOG_ERROR(&logger, "%s %s %ls %c %i %u %.3f %s",
+		null_str, mutable_str, L"wide", 'x', -5, 7u, 3.14159, temporary.c_str());
+	temporary = "overwritten"; // Strings are copied on the calling thread
+	SFZ_LOG_NOISE(&logger, "%s|%s", "", "");
+
+	logger.setMinLevel(SFZ_LOG_LEVEL_WARNING);
+	SFZ_LOG_INFO(&logger, "filtered");
+	SFZ_LOG_INFO(&logger, "filtered %i", 1);
+	const std::string big(3000, 'a');
+	SFZ_LOG_ERROR(&logger, "big %s", big.c_str());
+	logger.flush();
+
+	REQUIRE(collected.msgs.size() == 4);
+	CHECK(collected.msgs[0] == "no args");
+	CHECK(collected.levels[0] == SFZ_LOG_LEVEL_WARNING);
+	CHECK(collected.msgs[1] == "(null) mutable wide x -5 7 3.142 temp");
+	CHECK(collected.levels[1] == SFZ_LOG_LEVEL_ERROR);
+	CHECK(collected.msgs[2] == "|");
+	CHECK(collected.msgs[3].size() < 2560);
+	CHECK(collected.msgs[3].compare(0, 8, "big aaaa") == 0);
+	CHECK(logger.numDropped() == 0);
+	CHECK(logger.numRegisteredThreads() == 1);
+	CHECK(collected.thread_idxs[0] == 0);
+}
+
+TEST_CASE("SfzLogger: ring buffer wrap around, oversized messages and merge order")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	SfzLogger logger;
+	logger.init(&allocator, false, 1024);
+	Collected collected;
+	logger.addSink(collectSink, &collected);
+
+	// Entries of varying sizes wrap around the end of the 1 KiB ring many times, both with and
+	// without room for a padding header before the end
+	u32 num_bad = 0;
+	u32 next_idx = 0;
+	for (u32 i = 0; i < 500; i++) {
+		const std::string str(i % 97, char('a' + i % 26));
+		SFZ_LOG_INFO(&logger, "%u %s", i, str.c_str());
+		if (i % 3 == 0 || i == 499) {
+			logger.drain();
+			for (const std::string& msg : collected.msgs) {
+				const std::string expected =
+					std::to_string(next_idx) + " " + std::string(next_idx % 97, char('a' + next_idx % 26));
+				if (msg != expected) num_bad += 1;
+				next_idx += 1;
+			}
+			collected = {};
+		}
+	}
+	CHECK(num_bad == 0);
+	CHECK(next_idx == 500);
+	CHECK(logger.numDropped() == 0);
+
+	// A message larger than half the ring is dropped, the drop is reported as a warning
+	const std::string big(600, 'x');
+	SFZ_LOG_ERROR(&logger, "%s", big.c_str());
+	CHECK(logger.numDropped() == 1);
+	CHECK(logger.drain() == 0);
+	REQUIRE(collected.msgs.size() == 1);
+	CHECK(collected.levels[0] == SFZ_LOG_LEVEL_WARNING);
+	CHECK(collected.msgs[0].compare(0, 10, "Dropped 1 ") == 0);
+	collected = {};
+
+	// Messages from different threads are merged in timestamp order
+	SFZ_LOG_INFO(&logger, "first");
+	std::thread([&]() { SFZ_LOG_INFO(&logger, "second"); }).join();
+	SFZ_LOG_INFO(&logger, "third");
+	CHECK(logger.drain() == 3);
+	REQUIRE(collected.msgs.size() == 3);
+	CHECK(collected.msgs[0] == "first");
+	CHECK(collected.msgs[1] == "second");
+	CHECK(collected.msgs[2] == "third");
+	CHECK(collected.thread_idxs[0] == collected.thread_idxs[2]);
+	CHECK(collected.thread_idxs[0] != collected.thread_idxs[1]);
+	CHECK(std::is_sorted(collected.timestamps.begin(), collected.timestamps.end()));
+}
+
+TEST_CASE("SfzLogger: threads beyond the ring buffer limit are counted and reported")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	SfzLogger logger;
+	logger.init(&allocator, false, 1024);
+	Collected collected;
+	logger.addSink(collectSink, &collected);
+
+	// All threads are alive at the same time, so each needs its own ring buffer
+	constexpr u32 NUM_EXTRA = 6;
+	constexpr u32 NUM_THREADS = SFZ_LOGGER_MAX_NUM_THREADS + NUM_EXTRA;
+	std::atomic<u32> num_logged = 0;
+	std::vector<std::thread> threads;
+	for (u32 t = 0; t < NUM_THREADS; t++) {
+		threads.emplace_back([&]() {
+			SFZ_LOG_INFO(&logger, "hello");
+			num_logged += 1;
+			while (num_logged.load() != NUM_THREADS) std::this_thread::yield();
+			SFZ_LOG_INFO(&logger, "hello again");
+		});
+	}
+	for (std::thread& thread : threads) thread.join();
+
+	CHECK(logger.numRegisteredThreads() == SFZ_LOGGER_MAX_NUM_THREADS);
+	CHECK(logger.numDropped() == 2 * NUM_EXTRA);
+	CHECK(logger.drain() == 2 * SFZ_LOGGER_MAX_NUM_THREADS);
+	u32 num_reports = 0;
+	for (u32 i = 0; i < collected.msgs.size(); i++) {
+		if (collected.thread_idxs[i] != SFZ_LOGGER_MAX_NUM_THREADS) continue;
+		num_reports += 1;
+		CHECK(collected.levels[i] == SFZ_LOG_LEVEL_WARNING);
+		CHECK(collected.msgs[i].compare(0, 11, "Dropped 12 ") == 0);
+	}
+	CHECK(num_reports == 1);
+
+	// Only reported once
+	collected = {};
+	CHECK(logger.drain() == 0);
+	CHECK(collected.msgs.empty());
+}
+
+TEST_CASE("SfzLogger: many threads, every message received or counted as dropped")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	constexpr u32 NUM_THREADS = 6;
+	constexpr u32 NUM_MSGS = 20000;
+
+	for (bool background_thread : { true, false }) {
+		CAPTURE(background_thread);
+		SfzLogger logger;
+		logger.init(&allocator, background_thread, 4096);
+		Verifier v;
+		logger.addSink(verifySink, &v);
+
+		std::atomic<u32> num_done = 0;
+		std::vector<std::thread> threads;
+		for (u32 t = 0; t < NUM_THREADS; t++) {
+			threads.emplace_back([&, t]() {
+				for (u32 i = 0; i < NUM_MSGS; i++) {
+					const std::string name = "thr" + std::to_string(t) + "_" + std::to_string(i);
+					SFZ_LOG_INFO(&logger, "thread %d iter %llu f=%f name=%s",
+						i32(t), (unsigned long long)i, f32(i) * 0.5f, name.c_str());
+					if (background_thread && i % 5000 == 0) logger.flush();
+				}
+				num_done += 1;
+			});
+		}
+		if (!background_thread) {
+			while (num_done.load() != NUM_THREADS) logger.drain();
+		}
+		for (std::thread& thread : threads) thread.join();
+		logger.flush();
+
+		CHECK(v.num_bad == 0);
+		CHECK(logger.numRegisteredThreads() == NUM_THREADS);
+		CHECK(v.num_received + logger.numDropped() == u64(NUM_THREADS) * NUM_MSGS);
+		CHECK(v.num_dropped_reported == logger.numDropped());
+	}
+}
+
+// Benchmarks
+// ------------------------------------------------------------------------------------------------
+
+namespace {
+
+void nullSink(void* userdata, const SfzLogMessage* msg)
+{
+	sfzBenchKeep(msg->msg[0]);
+	(void)userdata;
+}
+
+// What the synchronous logging in the extensions does on the caller's thread, before writing out.
+void formatSync(char* buf, u32 buf_size, const char* fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	vsnprintf(buf, buf_size, fmt, args);
+	va_end(args);
+}
+
+// Times num_calls calls of func() in batches, returns (average, p99 of batch averages) in ns per
+// call. after_batch() runs untimed after each batch.
+template<typename Func, typename AfterFunc>
+std::pair<f64, f64> benchCalls(u32 num_batches, u32 batch_size, Func func, AfterFunc after_batch)
+{
+	std::vector<f64> batch_ns;
+	for (u32 b = 0; b < num_batches; b++) {
+		SfzBenchTimer timer;
+		for (u32 i = 0; i < batch_size; i++) func(i);
+		batch_ns.push_back(timer.elapsedNs() / f64(batch_size));
+		after_batch();
+	}
+	std::sort(batch_ns.begin(), batch_ns.end());
+	f64 sum = 0.0;
+	for (f64 ns : batch_ns) sum += ns;
+	return { sum / f64(num_batches), batch_ns[std::min(batch_ns.size() - 1, batch_ns.size() * 99 / 100)] };
+}
+
+} // namespace
+
+SFZ_BENCHMARK("SfzLogger: caller side cost per log call against synchronous vsnprintf")
+{
+	constexpr u32 NUM_BATCHES = 200;
+	constexpr u32 BATCH_SIZE = 256;
+	SfzAllocator allocator = sfz::createStandardAllocator();
+
+	// Drained manually between batches, so only the caller side is timed
+	SfzLogger logger;
+	logger.init(&allocator, false, 1024 * 1024);
+	logger.addSink(nullSink, nullptr);
+	char buf[512] = {};
+	const char* name = "gpuAllocHeapRange";
+
+	const auto drain = [&]() { logger.drain(); };
+	const auto none = []() {};
+	struct Case { const char* desc; std::pair<f64, f64> sync, async; };
+	const Case cases[] = {
+		{ "no args",
+			benchCalls(NUM_BATCHES, BATCH_SIZE, [&](u32) { formatSync(buf, sizeof(buf), "Kernel initialized"); sfzBenchKeep(buf[0]); }, none),
+			benchCalls(NUM_BATCHES, BATCH_SIZE, [&](u32) { SFZ_LOG_INFO(&logger, "Kernel initialized"); }, drain) },
+		{ "3 ints + float",
+			benchCalls(NUM_BATCHES, BATCH_SIZE, [&](u32 i) { formatSync(buf, sizeof(buf), "Heap %u: offset %u size %u (%.2f%% used)", i, i * 256, 4096u, f32(i) * 0.25f); sfzBenchKeep(buf[0]); }, none),
+			benchCalls(NUM_BATCHES, BATCH_SIZE, [&](u32 i) { SFZ_LOG_INFO(&logger, "Heap %u: offset %u size %u (%.2f%% used)", i, i * 256, 4096u, f32(i) * 0.25f); }, drain) },
+		{ "string + int",
+			benchCalls(NUM_BATCHES, BATCH_SIZE, [&](u32 i) { formatSync(buf, sizeof(buf), "%s: out of memory, requested %u bytes", name, i); sfzBenchKeep(buf[0]); }, none),
+			benchCalls(NUM_BATCHES, BATCH_SIZE, [&](u32 i) { SFZ_LOG_ERROR(&logger, "%s: out of memory, requested %u bytes", name, i); }, drain) },
+	};
+	CHECK(logger.numDropped() == 0);
+
+	logger.setMinLevel(SFZ_LOG_LEVEL_WARNING);
+	const std::pair<f64, f64> filtered = benchCalls(NUM_BATCHES, BATCH_SIZE,
+		[&](u32 i) { SFZ_LOG_INFO(&logger, "Heap %u: offset %u", i, i * 256); }, drain);
+
+	// Errors wake up the background thread of a threaded logger
+	SfzLogger threaded;
+	threaded.init(&allocator, true, 1024 * 1024);
+	threaded.addSink(nullSink, nullptr);
+	const std::pair<f64, f64> waking = benchCalls(NUM_BATCHES, BATCH_SIZE,
+		[&](u32 i) { SFZ_LOG_ERROR(&threaded, "%s: out of memory, requested %u bytes", name, i); },
+		[&]() { threaded.flush(); });
+	CHECK(threaded.numDropped() == 0);
+
+	for (const Case& c : cases) {
+		SFZ_BENCH_PRINT("%-15s (ns/call): vsnprintf avg %6.1f p99 %6.1f | SfzLogger avg %6.1f p99 %6.1f",
+			c.desc, c.sync.first, c.sync.second, c.async.first, c.async.second);
+	}
+	SFZ_BENCH_PRINT("%-15s (ns/call): SfzLogger avg %6.1f p99 %6.1f", "below min level", filtered.first, filtered.second);
+	SFZ_BENCH_PRINT("%-15s (ns/call): SfzLogger avg %6.1f p99 %6.1f", "error, threaded", waking.first, waking.second);
+}
@@ -0,0 +1,341 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#include "doctest.h"
+#include "sfz_bench.hpp"
+#include "sfz_test_utils.hpp"
+
+#include "sfz.h"
+#include "sfz_cpp.hpp"
+#include "skipifzero_allocators.hpp"
+#include "skipifzero_hash_maps.hpp"
+#include "skipifzero_lru_cache.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <list>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct Tracked {
+	static inline i32 num_alive = 0;
+	i32 value = -1;
+	Tracked() { num_alive += 1; }
+	explicit Tracked(i32 v) : value(v) { num_alive += 1; }
+	Tracked(const Tracked& o) : value(o.value) { num_alive += 1; }
+	Tracked& operator= (const Tracked& o) { value = o.value; return *this; }
+	~Tracked() { num_alive -= 1; }
+};
+
+// Reference LRU cache, most recently used entry first
+struct RefEntry { u64 key; std::string value; u64 cost; };
+struct RefLru {
+	std::list<RefEntry> list;
+	std::map<u64, std::list<RefEntry>::iterator> map;
+	u64 cost = 0;
+
+	void erase(std::list<RefEntry>::iterator itr)
+	{
+		cost -= itr->cost;
+		map.erase(itr->key);
+		list.erase(itr);
+	}
+};
+
+void recordEvicted(void* userdata, const u32& key, Tracked&, u64)
+{
+	static_cast<std::vector<u32>*>(userdata)->push_back(key);
+}
+
+} // namespace
+
+TEST_CASE("SfzLruCache: recency order and the eviction callback")
+{
+	SfzTestCountingAllocator counting;
+	Tracked::num_alive = 0;
+	std::vector<u32> evicted;
+	{
+		SfzLruCache<u32, Tracked> cache(2, SFZ_LRU_CACHE_NO_COST_LIMIT, counting.ptr(), sfz_dbg(""));
+		CHECK(counting.num_allocs == 1); // Entries and index in one allocation
+		cache.setEvictFunc(recordEvicted, &evicted);
+
+		// peek() doesn't refresh an entry, get() does
+		cache.put(1, Tracked(1));
+		cache.put(2, Tracked(2));
+		CHECK(cache.peek(1)->value == 1);
+		cache.put(3, Tracked(3));
+		CHECK(evicted == std::vector<u32>{ 1 });
+		CHECK(cache.get(2)->value == 2);
+		cache.put(4, Tracked(4));
+		CHECK(evicted == std::vector<u32>{ 1, 3 });
+
+		// Replacing a value when full doesn't evict anything
+		cache.put(2, Tracked(22));
+		CHECK(evicted.size() == 2);
+		CHECK(cache.get(2)->value == 22);
+		CHECK(Tracked::num_alive == 2);
+
+		// remove() doesn't call the callback, clear() does
+		CHECK(cache.remove(4));
+		CHECK(!cache.remove(4));
+		CHECK(evicted.size() == 2);
+		cache.clear();
+		CHECK(evicted == std::vector<u32>{ 1, 3, 2 });
+		CHECK(Tracked::num_alive == 0);
+		CHECK(cache.capacity() == 2);
+
+		// Destroying evicts the remaining entries
+		cache.put(5, Tracked(5));
+	}
+	CHECK(evicted.back() == 5);
+	CHECK(Tracked::num_alive == 0);
+	CHECK(counting.numLive() == 0);
+
+	// Capacity 1
+	SfzLruCache<u32, u32> single(1, SFZ_LRU_CACHE_NO_COST_LIMIT, counting.ptr(), sfz_dbg(""));
+	single.put(1, 1);
+	single.put(2, 2);
+	CHECK(!single.contains(1));
+	CHECK(*single.get(2) == 2);
+	CHECK(single.size() == 1);
+}
+
+TEST_CASE("SfzLruCache: cost budget")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	SfzLruCache<u32, u32> cache(100, 10, &allocator, sfz_dbg(""));
+	cache.put(1, 1, 4);
+	cache.put(2, 2, 4);
+	cache.put(3, 3, 4); // Evicts 1
+	CHECK(!cache.contains(1));
+	CHECK(cache.totalCost() == 8);
+
+	// An entry more expensive than the whole budget is kept, evicting everything else
+	cache.put(4, 4, 50);
+	CHECK(cache.size() == 1);
+	CHECK(cache.totalCost() == 50);
+	CHECK(*cache.get(4) == 4);
+
+	// ... until the next put
+	cache.put(5, 5, 1);
+	CHECK(!cache.contains(4));
+	CHECK(cache.totalCost() == 1);
+
+	// Raising the cost of an existing entry evicts others but never the entry itself
+	cache.put(6, 6, 2);
+	cache.put(5, 55, 10);
+	CHECK(!cache.contains(6));
+	CHECK(*cache.peek(5) == 55);
+	CHECK(cache.totalCost() == 10);
+
+	cache.setMaxCost(100);
+	cache.put(7, 7, 0); // Free entries
+	cache.put(8, 8, 0);
+	cache.evictUntilCost(5);
+	CHECK(cache.totalCost() == 0);
+	CHECK(cache.size() == 2);
+	CHECK(cache.maxCost() == 100);
+	cache.evictUntilCost(0);
+	CHECK(cache.size() == 2); // Already within budget, nothing evicted
+}
+
+TEST_CASE("SfzLruCache: index stays consistent under churn")
+{
+	// Keys that are multiples of large powers of two, and dense sequential keys, removed in
+	// different orders to exercise the backward shift deletion
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	SfzLruCache<u64, u64> cache(64, SFZ_LRU_CACHE_NO_COST_LIMIT, &allocator, sfz_dbg(""));
+	std::mt19937 rng(2);
+	for (u32 it = 0; it < 20000; it++) {
+		const u64 key = (it % 2 == 0) ? u64(rng() % 200) << 32 : u64(rng() % 200);
+		if (rng() % 4 == 0) cache.remove(key);
+		else cache.put(key, key + 1);
+	}
+	bool consistent = true;
+	u32 num_entries = 0;
+	cache.forEach([&](const u64& key, u64& value, u64) {
+		consistent = consistent && value == key + 1 && cache.peek(key) == &value;
+		num_entries += 1;
+	});
+	CHECK(consistent);
+	CHECK(num_entries == cache.size());
+}
+
+TEST_CASE("SfzLruCache: random operations and evictions against reference")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	std::mt19937 rng(3);
+
+	for (u32 round = 0; round < 3; round++) {
+		const u32 capacity = round == 0 ? 7 : round == 1 ? 100 : 1000;
+		const u64 max_cost = round == 2 ? SFZ_LRU_CACHE_NO_COST_LIMIT : capacity * 3;
+		SfzLruCache<u64, std::string> cache(capacity, max_cost, &allocator, sfz_dbg(""));
+		std::vector<u64> evicted;
+		cache.setEvictFunc([](void* userdata, const u64& key, std::string&, u64) {
+			static_cast<std::vector<u64>*>(userdata)->push_back(key);
+		}, &evicted);
+		RefLru ref;
+
+		for (u32 it = 0; it < 100000; it++) {
+			const u32 op = rng() % 10;
+			const u64 key = (rng() % (capacity * 3)) * 64;
+			if (op < 4) {
+				const u64 cost = 1 + rng() % 8;
+				const std::string value = std::to_string(rng());
+				evicted.clear();
+				cache.put(key, value, cost);
+
+				auto found = ref.map.find(key);
+				if (found != ref.map.end()) ref.erase(found->second);
+				std::vector<u64> expected_evicted;
+				if (ref.list.size() == capacity) {
+					expected_evicted.push_back(ref.list.back().key);
+					ref.erase(std::prev(ref.list.end()));
+				}
+				ref.list.push_front({ key, value, cost });
+				ref.map[key] = ref.list.begin();
+				ref.cost += cost;
+				while (ref.cost > max_cost && ref.list.size() > 1) {
+					expected_evicted.push_back(ref.list.back().key);
+					ref.erase(std::prev(ref.list.end()));
+				}
+				REQUIRE(evicted == expected_evicted);
+			}
+			else if (op < 8) {
+				const std::string* value = cache.get(key);
+				auto found = ref.map.find(key);
+				REQUIRE((value != nullptr) == (found != ref.map.end()));
+				if (value != nullptr) {
+					REQUIRE(*value == found->second->value);
+					ref.list.splice(ref.list.begin(), ref.list, found->second);
+				}
+			}
+			else if (op < 9) {
+				const bool removed = cache.remove(key);
+				auto found = ref.map.find(key);
+				REQUIRE(removed == (found != ref.map.end()));
+				if (removed) ref.erase(found->second);
+			}
+			else {
+				// peek() must not change the recency order
+				const std::string* value = cache.peek(key);
+				REQUIRE((value != nullptr) == (ref.map.count(key) == 1));
+			}
+			REQUIRE(cache.size() == ref.list.size());
+			REQUIRE(cache.totalCost() == ref.cost);
+
+			if (it % 5000 == 0) {
+				auto ref_itr = ref.list.begin();
+				bool order_ok = true;
+				cache.forEach([&](const u64& k, std::string& v, u64 cost) {
+					if (ref_itr == ref.list.end() || ref_itr->key != k || ref_itr->value != v || ref_itr->cost != cost) {
+						order_ok = false;
+					}
+					else {
+						++ref_itr;
+					}
+				});
+				REQUIRE(order_ok);
+				REQUIRE(ref_itr == ref.list.end());
+			}
+		}
+
+		cache.setMaxCost(5);
+		CHECK(cache.totalCost() <= 5);
+		cache.clear();
+		CHECK(cache.size() == 0);
+		CHECK(cache.totalCost() == 0);
+	}
+}
+
+// Benchmarks
+// ------------------------------------------------------------------------------------------------
+
+SFZ_BENCHMARK("SfzLruCache: Zipfian access against scan based eviction")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	constexpr u32 NUM_KEYS = 1000000;
+	constexpr u32 NUM_ACCESSES = 200000;
+
+	// Zipfian distribution (s = 0.99) over NUM_KEYS keys, sampled by binary search in the CDF
+	std::vector<f64> cdf(NUM_KEYS);
+	f64 sum = 0.0;
+	for (u32 i = 0; i < NUM_KEYS; i++) {
+		sum += 1.0 / std::pow(f64(i + 1), 0.99);
+		cdf[i] = sum;
+	}
+	std::mt19937_64 rng(1);
+	std::uniform_real_distribution<f64> uniform(0.0, sum);
+	std::vector<u64> accesses(NUM_ACCESSES);
+	for (u64& key : accesses) {
+		const u64 rank = u64(std::lower_bound(cdf.begin(), cdf.end(), uniform(rng)) - cdf.begin());
+		key = rank * 0x9E3779B97F4A7C15ull; // Spread the popular keys
+	}
+
+	const u32 capacities[] = { 1000, 10000 };
+	for (u32 capacity : capacities) {
+		u32 lru_hits = 0, scan_hits = 0;
+		const f64 lru_ms = sfzBenchMs(1, [&]() {
+			SfzLruCache<u64, u64> cache(capacity, SFZ_LRU_CACHE_NO_COST_LIMIT, &allocator, sfz_dbg(""));
+			lru_hits = 0;
+			for (u64 key : accesses) {
+				if (cache.get(key) != nullptr) lru_hits += 1;
+				else cache.put(key, key);
+			}
+		});
+
+		// The hand-rolled alternative, a hash map with a last used timestamp per entry and a scan
+		// over the whole map to find the entry to evict
+		struct Timestamped { u64 value, last_used; };
+		const f64 scan_ms = sfzBenchMs(1, [&]() {
+			SfzHashMap<u64, Timestamped> map(capacity * 2, &allocator, sfz_dbg(""));
+			u64 time = 0;
+			scan_hits = 0;
+			for (u64 key : accesses) {
+				time += 1;
+				Timestamped* entry = map.get(key);
+				if (entry != nullptr) {
+					entry->last_used = time;
+					scan_hits += 1;
+					continue;
+				}
+				if (map.size() == capacity) {
+					u64 oldest_key = 0, oldest_time = U64_MAX;
+					for (auto pair : map) {
+						if (pair.value.last_used < oldest_time) {
+							oldest_time = pair.value.last_used;
+							oldest_key = pair.key;
+						}
+					}
+					map.remove(oldest_key);
+				}
+				map.put(key, Timestamped{ key, time });
+			}
+		});
+		CHECK(lru_hits == scan_hits);
+
+		SFZ_BENCH_PRINT("capacity %5u, hit rate %4.1f%%: SfzLruCache %7.2f M accesses/s, scan based eviction %7.3f M accesses/s",
+			capacity, 100.0 * f64(lru_hits) / f64(NUM_ACCESSES),
+			f64(NUM_ACCESSES) / (lru_ms * 1000.0), f64(NUM_ACCESSES) / (scan_ms * 1000.0));
+	}
+}
@@ -0,0 +1,228 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#include "doctest.h"
+#include "sfz_bench.hpp"
+
+#include "sfz.h"
+#include "sfz_cpp.hpp"
+#include "skipifzero_mem_stream.hpp"
+
+#include <random>
+#include <vector>
+
+// sfzMemcpyStream and sfzMemsetStream
+// ------------------------------------------------------------------------------------------------
+
+TEST_CASE("sfzMemcpyStream and sfzMemsetStream: unaligned sizes and offsets")
+{
+	constexpr u64 MAX_SIZE = 24ull << 20; // Above the non-temporal and parallel thresholds
+	constexpr u8 GUARD = 0xCD;
+	std::mt19937_64 rng(1);
+	std::vector<u8> src(MAX_SIZE + 64);
+	std::vector<u8> dst(MAX_SIZE + 128);
+	for (u8& b : src) b = u8(rng());
+
+	for (u32 it = 0; it < 120; it++) {
+		const u64 num_bytes = it % 4 == 0 ? rng() % MAX_SIZE : rng() % 300000;
+		const u64 src_offset = rng() % 64;
+		const u64 dst_offset = rng() % 64;
+		const bool parallel = it % 2 != 0;
+		CAPTURE(num_bytes);
+		CAPTURE(parallel);
+		u8* d = dst.data() + dst_offset;
+		const u8* s = src.data() + src_offset;
+
+		memset(dst.data(), GUARD, dst.size());
+		if (parallel) sfzMemcpyStreamParallel(d, s, num_bytes, 1 + u32(rng() % 20));
+		else sfzMemcpyStream(d, s, num_bytes);
+		CHECK(memcmp(d, s, num_bytes) == 0);
+
+		const u8 value = u8(rng());
+		if (parallel) sfzMemsetStreamParallel(d, value, num_bytes, 8);
+		else sfzMemsetStream(d, value, num_bytes);
+		bool all_set = true;
+		for (u64 i = 0; i < num_bytes; i++) all_set = all_set && d[i] == value;
+		CHECK(all_set);
+
+		// Nothing outside the destination range may be touched
+		bool guards_intact = d[num_bytes] == GUARD;
+		for (u64 i = 0; i < dst_offset; i++) guards_intact = guards_intact && dst[i] == GUARD;
+		CHECK(guards_intact);
+	}
+}
+
+TEST_CASE("sfzMemcpyStream and sfzMemsetStream: around the streaming threshold")
+{
+	// Every destination alignment, with sizes just below, at and above the threshold so the
+	// unaligned head, the 64 byte lines and a tail that is not a multiple of 64 are all covered
+	constexpr u64 T = SFZ_MEM_STREAM_THRESHOLD;
+	std::vector<u8> src(T + 256);
+	std::vector<u8> dst(T + 256);
+	for (u64 i = 0; i < src.size(); i++) src[i] = u8(i * 7 + 3);
+	bool all_equal = true;
+	bool guards_intact = true;
+	for (u64 num_bytes : { T - 1, T, T + 1, T + 63, T + 64, T + 100 }) {
+		for (u64 dst_offset = 0; dst_offset < 16; dst_offset++) {
+			const u64 src_offset = (dst_offset * 5) % 16;
+			memset(dst.data(), 0, dst.size());
+			sfzMemcpyStream(dst.data() + dst_offset, src.data() + src_offset, num_bytes);
+			all_equal = all_equal && memcmp(dst.data() + dst_offset, src.data() + src_offset, num_bytes) == 0;
+			guards_intact = guards_intact && dst[dst_offset + num_bytes] == 0;
+			if (dst_offset != 0) guards_intact = guards_intact && dst[dst_offset - 1] == 0;
+
+			sfzMemsetStream(dst.data() + dst_offset, 0xEE, num_bytes);
+			for (u64 i = 0; i < num_bytes; i++) all_equal = all_equal && dst[dst_offset + i] == 0xEE;
+			guards_intact = guards_intact && dst[dst_offset + num_bytes] == 0;
+			if (dst_offset != 0) guards_intact = guards_intact && dst[dst_offset - 1] == 0;
+		}
+	}
+	CHECK(all_equal);
+	CHECK(guards_intact);
+}
+
+TEST_CASE("sfzMemcpyStreamParallel: thread counts and chunk boundaries")
+{
+	// Exactly 2 and 3 times the minimum bytes per thread, with an unaligned destination so that
+	// the page aligned chunk ends don't coincide with multiples of the chunk size
+	constexpr u64 MIN = SFZ_MEM_STREAM_MIN_BYTES_PER_THREAD;
+	std::vector<u8> src(3 * MIN + 64);
+	std::vector<u8> dst(3 * MIN + 64);
+	for (u64 i = 0; i < src.size(); i++) src[i] = u8(i ^ (i >> 12));
+	bool all_equal = true;
+	for (u64 num_bytes : { 2 * MIN - 1, 2 * MIN, 3 * MIN }) {
+		for (u32 max_num_threads : { 0u, 1u, 2u, 3u, 100u }) {
+			memset(dst.data(), 0, dst.size());
+			sfzMemcpyStreamParallel(dst.data() + 33, src.data() + 5, num_bytes, max_num_threads);
+			all_equal = all_equal && memcmp(dst.data() + 33, src.data() + 5, num_bytes) == 0;
+			all_equal = all_equal && dst[32] == 0 && dst[33 + num_bytes] == 0;
+		}
+	}
+	CHECK(all_equal);
+}
+
+TEST_CASE("sfzMemcpyStream: zero bytes")
+{
+	u8 a[4] = { 1, 2, 3, 4 };
+	u8 b[4] = { 5, 6, 7, 8 };
+	sfzMemcpyStream(a, b, 0);
+	sfzMemcpyStreamParallel(a, b, 0, 8);
+	sfzMemsetStream(a, 0, 0);
+	sfzMemsetStreamParallel(a, 0, 0, 8);
+	CHECK((a[0] == 1 && a[3] == 4));
+}
+
+// Benchmarks
+// ------------------------------------------------------------------------------------------------
+
+namespace {
+
+#if defined(SFZ_MEM_STREAM_SSE2)
+// sfzMemcpyStream() with the source prefetched using the NTA hint, kept here to check the claim
+// that it is slower than not prefetching at all. Only the bulk loop differs.
+void memcpyStreamPrefetchNta(void* __restrict dst, const void* __restrict src, u64 num_bytes)
+{
+	u8* d = static_cast<u8*>(dst);
+	const u8* s = static_cast<const u8*>(src);
+	const u64 head = (16 - (u64(uintptr_t(d)) & 15)) & 15;
+	memcpy(d, s, head);
+	d += head;
+	s += head;
+	num_bytes -= head;
+	constexpr u64 PREFETCH_DIST = 512;
+	const u64 num_lines = num_bytes / 64;
+	for (u64 i = 0; i < num_lines; i++) {
+		_mm_prefetch(reinterpret_cast<const char*>(s + PREFETCH_DIST), _MM_HINT_NTA);
+		const __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 0));
+		const __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 16));
+		const __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 32));
+		const __m128i v3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 48));
+		_mm_stream_si128(reinterpret_cast<__m128i*>(d + 0), v0);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(d + 16), v1);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(d + 32), v2);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(d + 48), v3);
+		d += 64;
+		s += 64;
+	}
+	num_bytes -= num_lines * 64;
+	_mm_sfence();
+	memcpy(d, s, num_bytes);
+}
+#endif
+
+// Sums a buffer with one load per cache line, returns ns per cache line.
+f64 readLinesNs(const u8* data, u64 num_bytes)
+{
+	SfzBenchTimer timer;
+	u64 sum = 0;
+	for (u64 i = 0; i < num_bytes; i += 64) sum += data[i];
+	const f64 ns = timer.elapsedNs();
+	sfzBenchKeep(sum);
+	return ns / f64(num_bytes / 64);
+}
+
+} // namespace
+
+SFZ_BENCHMARK("sfzMemcpyStream: bandwidth and cache impact against memcpy for 64 KiB to 256 MiB")
+{
+	constexpr u64 MAX_SIZE = 256ull << 20;
+	constexpr u64 HOT_SIZE = 1ull << 20; // Working set that fits in L2, read before and after the copy
+	std::vector<u8> src(MAX_SIZE);
+	std::vector<u8> dst(MAX_SIZE);
+	std::vector<u8> hot(HOT_SIZE);
+	for (u64 i = 0; i < MAX_SIZE; i++) src[i] = u8(i);
+	memset(dst.data(), 0, MAX_SIZE); // Fault in all pages up front
+	memset(hot.data(), 1, HOT_SIZE);
+	SFZ_BENCH_PRINT("GB/s; hot = ns per cache line to re-read a 1 MiB working set after the copy");
+
+	for (u64 size = 64ull << 10; size <= MAX_SIZE; size *= 4) {
+		const u32 num_reps = u32(u64_max(3, (2ull << 30) / size));
+		auto gbs = [&](auto copy) {
+			const f64 ms = sfzBenchMs(num_reps, [&]() { copy(dst.data(), src.data(), size); });
+			return f64(size) / (ms * 1000000.0);
+		};
+		auto hotNs = [&](auto copy) {
+			f64 total = 0.0;
+			for (u32 i = 0; i < 5; i++) {
+				readLinesNs(hot.data(), HOT_SIZE);
+				copy(dst.data(), src.data(), size);
+				total += readLinesNs(hot.data(), HOT_SIZE);
+			}
+			return total / 5.0;
+		};
+		const auto plain = [](void* d, const void* s, u64 n) { memcpy(d, s, n); };
+		const auto stream = [](void* d, const void* s, u64 n) { sfzMemcpyStream(d, s, n); };
+		const auto parallel = [](void* d, const void* s, u64 n) { sfzMemcpyStreamParallel(d, s, n, 4); };
+
+		const f64 memcpy_gbs = gbs(plain);
+		const f64 stream_gbs = gbs(stream);
+		const f64 parallel_gbs = gbs(parallel);
+#if defined(SFZ_MEM_STREAM_SSE2)
+		const auto nta = [](void* d, const void* s, u64 n) { memcpyStreamPrefetchNta(d, s, n); };
+		const f64 nta_gbs = gbs(nta);
+#else
+		const f64 nta_gbs = 0.0;
+#endif
+		const f64 hot_memcpy = hotNs(plain);
+		const f64 hot_stream = hotNs(stream);
+		CHECK(memcmp(dst.data(), src.data(), size) == 0);
+
+		SFZ_BENCH_PRINT("%7.0f KiB: memcpy %6.2f | stream %6.2f | stream+prefetchnta %6.2f | parallel(4) %6.2f | hot after memcpy %5.2f, after stream %5.2f",
+			f64(size) / 1024.0, memcpy_gbs, stream_gbs, nta_gbs, parallel_gbs, hot_memcpy, hot_stream);
+	}
+}
@@ -0,0 +1,218 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#include "doctest.h"
+#include "sfz_bench.hpp"
+#include "sfz_test_utils.hpp"
+
+#include "sfz.h"
+#include "sfz_cpp.hpp"
+#include "skipifzero_allocators.hpp"
+#include "skipifzero_hash_maps.hpp"
+#include "skipifzero_perfect_hash.hpp"
+
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr const char* NAMES[] = {
+	"font_color", "base_color", "focus_color", "activate_color",
+	"button_text_scaling", "button_border_width", "button_inner_padding", "default_font"
+};
+constexpr auto NAMES_TABLE = sfzPerfectHashCreate(NAMES);
+static_assert(NAMES_TABLE.isValid(), "");
+static_assert(NAMES_TABLE.find("focus_color") == 2, "");
+static_assert(NAMES_TABLE.find("nope") == SFZ_PERFECT_HASH_NOT_FOUND, "");
+
+constexpr const char* DUPLICATES[] = { "a", "b", "a" };
+static_assert(!sfzPerfectHashCreate(DUPLICATES).isValid(), "");
+
+template<u32 N>
+struct Hashes {
+	u64 h[N] = {};
+	constexpr Hashes()
+	{
+		for (u32 i = 0; i < N; i++) {
+			u64 x = (i + 1) * 0x9E3779B97F4A7C15ull;
+			x ^= x >> 29;
+			h[i] = x | 1; // Odd, so that no even hash is a key
+		}
+	}
+};
+constexpr Hashes<1024> BIG_HASHES;
+constexpr auto BIG_TABLE = sfzPerfectHashCreate(BIG_HASHES.h);
+static_assert(BIG_TABLE.isValid(), "");
+
+constexpr const char* SINGLE[] = { "only" };
+constexpr auto SINGLE_TABLE = sfzPerfectHashCreate(SINGLE);
+static_assert(SINGLE_TABLE.isValid(), "");
+static_assert(SfzPerfectHash<1>::NUM_SLOTS == 2 && SfzPerfectHash<1>::NUM_BUCKETS == 1, "");
+static_assert(SINGLE_TABLE.find("only") == 0, "");
+static_assert(SINGLE_TABLE.find("other") == SFZ_PERFECT_HASH_NOT_FOUND, "");
+
+// Hash 0 marks empty slots, so it can't be a key
+constexpr u64 ZERO_HASH[] = { 5, 0 };
+static_assert(!sfzPerfectHashCreate(ZERO_HASH).isValid(), "");
+
+} // namespace
+
+TEST_CASE("SfzPerfectHashTable: compile time table with 1024 keys")
+{
+	bool all_found = true;
+	for (u32 i = 0; i < 1024; i++) all_found = all_found && BIG_TABLE.findHash(BIG_HASHES.h[i]) == i;
+	CHECK(all_found);
+
+	u32 num_false_positives = 0;
+	for (u64 i = 0; i < 100000; i++) {
+		num_false_positives += BIG_TABLE.findHash(i * 2 + 2) != SFZ_PERFECT_HASH_NOT_FOUND ? 1 : 0;
+	}
+	CHECK(num_false_positives == 0);
+}
+
+TEST_CASE("SfzPerfectHashMap: known keys and fallback keys")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	SfzPerfectHashMap<f32, 8> map(&NAMES_TABLE, 16, &allocator, sfz_dbg(""));
+	map.put("base_color", 1.0f);
+	map.put("custom", 2.0f);
+	REQUIRE(map.get("base_color") != nullptr);
+	REQUIRE(map.get("custom") != nullptr);
+	CHECK(*map.get("base_color") == 1.0f);
+	CHECK(*map.get("custom") == 2.0f);
+	CHECK(map.get("font_color") == nullptr);
+	CHECK(map.size() == 2);
+
+	CHECK(map.remove("custom"));
+	CHECK(!map.remove("font_color"));
+	CHECK(map.remove("base_color"));
+	CHECK(map.size() == 0);
+}
+
+TEST_CASE("SfzPerfectHash: string, SfzStrID and hash lookups agree")
+{
+	for (u32 i = 0; i < 8; i++) {
+		CHECK(NAMES_TABLE.find(NAMES[i]) == i);
+		CHECK(NAMES_TABLE.find(sfzStrIDCreate(NAMES[i])) == i);
+		CHECK(NAMES_TABLE.findHash(sfzHashStringFNV1a(NAMES[i])) == i);
+	}
+	CHECK(NAMES_TABLE.findHash(0) == SFZ_PERFECT_HASH_NOT_FOUND);
+
+	// Tables can also be built at runtime
+	const SfzPerfectHash<8> runtime_table(NAMES);
+	CHECK(runtime_table.isValid());
+	CHECK(runtime_table.find("default_font") == 7);
+}
+
+TEST_CASE("SfzPerfectHashMap: fallback map is only allocated for unknown keys")
+{
+	SfzTestCountingAllocator counting;
+	SfzPerfectHashMap<u32, 8> map(&NAMES_TABLE, 0, counting.ptr(), sfz_dbg(""));
+	for (u32 i = 0; i < 8; i++) map.put(NAMES[i], i);
+	map.put("font_color", 100);
+	CHECK(map.size() == 8);
+	CHECK(counting.num_allocs == 0);
+	CHECK(map.fallback().size() == 0);
+
+	map.put("unknown_0", 1000);
+	map.put(sfzHashStringFNV1a("unknown_1"), 1001);
+	CHECK(counting.num_allocs == 1);
+	CHECK(map.size() == 10);
+	CHECK(map.fallback().size() == 2);
+
+	const SfzPerfectHashMap<u32, 8>& const_map = map;
+	REQUIRE(const_map.get("font_color") != nullptr);
+	CHECK(*const_map.get("font_color") == 100);
+	CHECK(*const_map.get("default_font") == 7);
+	CHECK(*const_map.get("unknown_1") == 1001);
+	CHECK(const_map.get("unknown_2") == nullptr);
+
+	map.clear();
+	CHECK(map.size() == 0);
+	CHECK(map.get("font_color") == nullptr);
+	CHECK(map.get("unknown_0") == nullptr);
+	map.destroy();
+	CHECK(counting.numLive() == 0);
+}
+
+// Benchmarks
+// ------------------------------------------------------------------------------------------------
+
+namespace {
+
+template<u32 N>
+void benchPerfectHash(SfzAllocator* allocator)
+{
+	u64 hashes[N] = {};
+	std::vector<std::string> names;
+	for (u32 i = 0; i < N; i++) {
+		names.push_back("attrib_" + std::to_string(i));
+		hashes[i] = sfzHashStringFNV1a(names.back().c_str());
+	}
+	static SfzPerfectHash<N> table;
+	table = SfzPerfectHash<N>(hashes);
+	REQUIRE(table.isValid());
+	SfzHashMap<u64, u32> map(0, allocator, sfz_dbg(""));
+	for (u32 i = 0; i < N; i++) map.put(hashes[i], i);
+
+	constexpr u32 NUM_QUERIES = 1u << 22;
+	std::vector<u64> hits(NUM_QUERIES), misses(NUM_QUERIES);
+	std::mt19937_64 rng(N);
+	for (u32 i = 0; i < NUM_QUERIES; i++) {
+		hits[i] = hashes[rng() % N];
+		misses[i] = rng() | 1;
+	}
+
+	auto run = [&](const std::vector<u64>& queries, u64& table_sum, u64& map_sum, f64& table_ms, f64& map_ms) {
+		table_ms = sfzBenchMs(3, [&]() {
+			u64 sum = 0;
+			for (u64 q : queries) sum += table.findHash(q);
+			table_sum = sum;
+		});
+		map_ms = sfzBenchMs(3, [&]() {
+			u64 sum = 0;
+			for (u64 q : queries) {
+				const u32* v = map.get(q);
+				sum += v != nullptr ? *v : SFZ_PERFECT_HASH_NOT_FOUND;
+			}
+			map_sum = sum;
+		});
+	};
+	u64 hit_table_sum = 0, hit_map_sum = 0, miss_table_sum = 0, miss_map_sum = 0;
+	f64 hit_table_ms = 0, hit_map_ms = 0, miss_table_ms = 0, miss_map_ms = 0;
+	run(hits, hit_table_sum, hit_map_sum, hit_table_ms, hit_map_ms);
+	run(misses, miss_table_sum, miss_map_sum, miss_table_ms, miss_map_ms);
+	CHECK(hit_table_sum == hit_map_sum);
+	CHECK(miss_table_sum == miss_map_sum);
+
+	const f64 mq = f64(NUM_QUERIES) / 1000.0;
+	SFZ_BENCH_PRINT("%4u keys: hits SfzPerfectHash %6.1f M/s, SfzHashMap %6.1f M/s | misses SfzPerfectHash %6.1f M/s, SfzHashMap %6.1f M/s",
+		N, mq / hit_table_ms, mq / hit_map_ms, mq / miss_table_ms, mq / miss_map_ms);
+}
+
+} // namespace
+
+SFZ_BENCHMARK("SfzPerfectHash: lookups against SfzHashMap<u64, u32> for 16-1024 keys")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	benchPerfectHash<16>(&allocator);
+	benchPerfectHash<64>(&allocator);
+	benchPerfectHash<256>(&allocator);
+	benchPerfectHash<1024>(&allocator);
+}
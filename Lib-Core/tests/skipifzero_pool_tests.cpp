@@ -0,0 +1,227 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#include "doctest.h"
+#include "sfz_bench.hpp"
+
+#include "sfz.h"
+#include "sfz_cpp.hpp"
+#include "skipifzero_allocators.hpp"
+#include "skipifzero_pool.hpp"
+
+#include <map>
+#include <random>
+#include <vector>
+
+namespace {
+
+struct Foo { i32 a = 7; f64 b[4] = {}; };
+
+// Counts live instances, to check that every constructed component is destroyed exactly once
+struct Tracked {
+	static inline i32 num_alive = 0;
+	i32 value = -1;
+	Tracked() { num_alive += 1; }
+	explicit Tracked(i32 v) : value(v) { num_alive += 1; }
+	Tracked(const Tracked& o) : value(o.value) { num_alive += 1; }
+	Tracked& operator= (const Tracked& o) { value = o.value; return *this; }
+	~Tracked() { num_alive -= 1; }
+};
+
+} // namespace
+
+TEST_CASE("SfzSoAPool: columns are dense and aligned")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	SfzSoAPool<u8, f32x3, Foo> pool(100, &allocator, sfz_dbg(""));
+	CHECK(uintptr_t(pool.column<0>()) % SfzSoAPool<u8, f32x3, Foo>::ALIGNMENT == 0);
+	CHECK(uintptr_t(pool.column<1>()) % SfzSoAPool<u8, f32x3, Foo>::ALIGNMENT == 0);
+	CHECK(uintptr_t(pool.column<2>()) % SfzSoAPool<u8, f32x3, Foo>::ALIGNMENT == 0);
+
+	SfzHandle handles[4];
+	for (u32 i = 0; i < 4; i++) handles[i] = pool.allocate(u8(i), f32x3_splat(f32(i)), Foo{ i32(i) });
+	CHECK(pool.numAllocated() == 4);
+	CHECK(pool.arraySize() == 4);
+
+	// Removing from the middle moves the last element into the hole in every column
+	pool.deallocate(handles[1]);
+	CHECK(pool.numAllocated() == 3);
+	CHECK(pool.numHoles() == 1);
+	CHECK(pool.column<0>()[1] == 3);
+	CHECK(pool.column<1>()[1].x == 3.0f);
+	CHECK(pool.column<2>()[1].a == 3);
+	CHECK(pool.denseIdx(handles[3]) == 1);
+	CHECK(pool.getHandleDense(1) == handles[3]);
+	CHECK(pool.denseToIdx()[1] == handles[3].idx());
+
+	// Removing the last dense element moves nothing
+	pool.deallocate(handles[3]);
+	CHECK(pool.column<0>()[0] == 0);
+	CHECK(pool.column<0>()[1] == 2);
+	CHECK(pool.denseIdx(handles[2]) == 1);
+
+	// Stale handles
+	CHECK(!pool.handleIsValid(handles[1]));
+	CHECK(pool.denseIdx(handles[1]) == ~0u);
+	CHECK(pool.get<2>(handles[3]) == nullptr);
+	CHECK(pool.get<2>(SFZ_NULL_HANDLE) == nullptr);
+
+	// Holes are reused before the array grows, and reused components are default constructed
+	const SfzHandle reused = pool.allocate();
+	CHECK(pool.arraySize() == 4);
+	CHECK((reused.idx() == handles[1].idx() || reused.idx() == handles[3].idx()));
+	CHECK(pool.get<2>(reused)->a == 7);
+	CHECK(pool.denseIdx(reused) == 2);
+}
+
+TEST_CASE("SfzSoAPool: versions wrap around and never become 0")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	SfzSoAPool<u32> pool(1, &allocator, sfz_dbg(""));
+	SfzHandle first = pool.allocate(0u);
+	CHECK(first.version() == 1);
+	CHECK(pool.isFull());
+	SfzHandle prev = first;
+	for (u32 i = 1; i < 300; i++) {
+		pool.deallocate(prev);
+		const SfzHandle h = pool.allocate(i);
+		CHECK(h.idx() == 0);
+		CHECK(h.version() != 0);
+		CHECK(h.version() <= 127);
+		CHECK(!pool.handleIsValid(prev));
+		prev = h;
+	}
+	CHECK(prev.version() == ((299 % 127) + 1));
+	CHECK(*pool.get<0>(prev) == 299);
+}
+
+TEST_CASE("SfzSoAPool: components are destroyed exactly once")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	Tracked::num_alive = 0;
+	{
+		SfzSoAPool<Tracked, u32> pool(64, &allocator, sfz_dbg(""));
+		std::vector<SfzHandle> handles;
+		for (i32 i = 0; i < 64; i++) handles.push_back(pool.allocate(Tracked(i), u32(i)));
+		CHECK(Tracked::num_alive == 64);
+		for (u32 i = 0; i < 64; i += 3) pool.deallocate(handles[i]);
+		CHECK(Tracked::num_alive == i32(pool.numAllocated()));
+		for (u32 i = 0; i < pool.numAllocated(); i++) {
+			CHECK(pool.column<0>()[i].value == i32(pool.column<1>()[i]));
+		}
+
+		// Moving the pool transfers ownership, the moved-from pool is empty
+		SfzSoAPool<Tracked, u32> moved = sfz_move(pool);
+		CHECK(pool.capacity() == 0);
+		CHECK(moved.numAllocated() == 64 - 22);
+		CHECK(Tracked::num_alive == i32(moved.numAllocated()));
+	}
+	CHECK(Tracked::num_alive == 0);
+}
+
+TEST_CASE("SfzSoAPool: random allocate/deallocate against reference")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	SfzSoAPool<f32x3, Foo> pool(1000, &allocator, sfz_dbg(""));
+	std::map<u32, i32> ref;
+	std::vector<SfzHandle> handles;
+	std::mt19937 rng(1);
+	bool consistent = true;
+	for (u32 it = 0; it < 20000; it++) {
+		if (handles.empty() || (rng() % 3 != 0 && !pool.isFull())) {
+			const i32 v = i32(rng() % 100000);
+			const SfzHandle h = pool.allocate(f32x3_splat(f32(v)), Foo{ v });
+			handles.push_back(h);
+			ref[h.bits] = v;
+		}
+		else {
+			const size_t i = rng() % handles.size();
+			const SfzHandle h = handles[i];
+			handles[i] = handles.back();
+			handles.pop_back();
+			pool.deallocate(h);
+			ref.erase(h.bits);
+			consistent = consistent && !pool.handleIsValid(h);
+		}
+		consistent = consistent && pool.numAllocated() == handles.size();
+	}
+	CHECK(consistent);
+	for (SfzHandle h : handles) {
+		consistent = consistent && pool.get<1>(h)->a == ref[h.bits];
+		consistent = consistent && pool.get<0>(h)->x == f32(ref[h.bits]);
+		consistent = consistent && pool.getHandleDense(pool.denseIdx(h)) == h;
+	}
+	CHECK(consistent);
+}
+
+// Benchmarks
+// ------------------------------------------------------------------------------------------------
+
+namespace {
+
+struct Particle {
+	f32x3 pos;
+	f32x3 vel;
+	f32 data[16]; // Stuff the integration pass doesn't touch
+};
+
+} // namespace
+
+SFZ_BENCHMARK("SfzSoAPool: position integration against AoS SfzPool")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	for (u32 num : { 1000u, 100000u, 1000000u }) {
+		SfzPool<Particle> aos(num, &allocator, sfz_dbg(""));
+		SfzSoAPool<f32x3, f32x3, Particle> soa(num, &allocator, sfz_dbg(""));
+
+		// Allocate everything, then free a random 25% so both pools have holes
+		std::mt19937 rng(1);
+		std::vector<SfzHandle> aos_handles, soa_handles;
+		for (u32 i = 0; i < num; i++) {
+			const f32x3 pos = f32x3_splat(f32(i)), vel = f32x3_init(1.0f, 2.0f, 3.0f);
+			aos_handles.push_back(aos.allocate(Particle{ pos, vel, {} }));
+			soa_handles.push_back(soa.allocate(pos, vel, Particle{}));
+		}
+		for (u32 i = 0; i < num; i++) {
+			if (rng() % 4 != 0) continue;
+			aos.deallocate(aos_handles[i]);
+			soa.deallocate(soa_handles[i]);
+		}
+
+		const f32 dt = 0.016f;
+		const u32 reps = u32(100000000 / num) + 1;
+		const f64 aos_ms = sfzBenchMs(reps, [&]() {
+			Particle* data = aos.data();
+			const SfzPoolSlot* slots = aos.slots();
+			const u32 array_size = aos.arraySize();
+			for (u32 i = 0; i < array_size; i++) {
+				if (!slots[i].active()) continue;
+				data[i].pos += data[i].vel * dt;
+			}
+		});
+		const f64 soa_ms = sfzBenchMs(reps, [&]() {
+			f32x3* pos = soa.column<0>();
+			const f32x3* vel = soa.column<1>();
+			const u32 num_allocated = soa.numAllocated();
+			for (u32 i = 0; i < num_allocated; i++) pos[i] += vel[i] * dt;
+		});
+		CHECK((aos.get(aos_handles[0]) == nullptr || aos.get(aos_handles[0])->pos.y == soa.get<0>(soa_handles[0])->y));
+		SFZ_BENCH_PRINT("%8u particles: AoS SfzPool %8.3f ms, SfzSoAPool %8.3f ms (%.2fx)",
+			num, aos_ms, soa_ms, aos_ms / soa_ms);
+	}
+}
@@ -0,0 +1,408 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#include "doctest.h"
+#include "sfz_bench.hpp"
+
+#include "sfz.h"
+#include "sfz_cpp.hpp"
+#include "skipifzero_allocators.hpp"
+#include "skipifzero_arrays.hpp"
+#include "skipifzero_priority_queue.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <queue>
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+template<typename T, typename Cmp, u32 Arity>
+bool isHeap(const SfzPriorityQueue<T, Cmp, Arity>& q, const Cmp& cmp = {})
+{
+	for (u32 i = 1; i < q.size(); i++) {
+		if (cmp(q.data()[i], q.data()[sfzHeapParent<Arity>(i)])) return false;
+	}
+	return true;
+}
+
+// Orders indices by an external cost table, to check that the comparator passed to init() is used
+struct CostCmp {
+	const f32* costs = nullptr;
+	bool operator() (u32 lhs, u32 rhs) const { return costs[lhs] < costs[rhs]; }
+};
+
+} // namespace
+
+TEST_CASE("SfzPriorityQueue: heap property for each arity and bulk path")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	std::mt19937 rng(10);
+	auto test = [&](auto q) {
+		// Small batches are sifted up one by one, large ones re-heapify the whole heap
+		std::vector<i32> ref;
+		const u32 batch_sizes[] = { 0, 1, 3, 1000, 2, 5000, 7 };
+		for (u32 batch_size : batch_sizes) {
+			std::vector<i32> batch;
+			for (u32 i = 0; i < batch_size; i++) batch.push_back(i32(rng() % 100)); // Many duplicates
+			q.pushMany(batch.data(), batch_size);
+			ref.insert(ref.end(), batch.begin(), batch.end());
+			REQUIRE(q.size() == ref.size());
+			REQUIRE(isHeap(q));
+		}
+		std::sort(ref.begin(), ref.end());
+		bool sorted = true;
+		for (i32 v : ref) sorted = sorted && q.pop() == v;
+		CHECK(sorted);
+		CHECK(q.isEmpty());
+	};
+	test(SfzPriorityQueue<i32, SfzLess<i32>, 2>(0, &allocator, sfz_dbg("")));
+	test(SfzPriorityQueue<i32, SfzLess<i32>, 4>(0, &allocator, sfz_dbg("")));
+	test(SfzPriorityQueue<i32, SfzLess<i32>, 8>(0, &allocator, sfz_dbg("")));
+	test(SfzPriorityQueue<i32, SfzLess<i32>, 3>(0, &allocator, sfz_dbg("")));
+}
+
+TEST_CASE("SfzPriorityQueue: edge cases")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+
+	SfzPriorityQueue<i32> q;
+	q.initFrom(nullptr, 0, &allocator, sfz_dbg(""));
+	CHECK(q.isEmpty());
+	q.push(5);
+	CHECK(q.top() == 5);
+	CHECK(q.pop() == 5);
+	CHECK(q.isEmpty());
+	q.push(3);
+	q.push(3);
+	CHECK(q.pop() == 3);
+	CHECK(q.pop() == 3);
+
+	// Already sorted and reverse sorted input
+	std::vector<i32> ascending(500), descending(500);
+	for (i32 i = 0; i < 500; i++) {
+		ascending[i] = i;
+		descending[i] = 499 - i;
+	}
+	SfzPriorityQueue<i32, SfzGreater<i32>, 8> max_q;
+	max_q.initFrom(ascending.data(), 500, &allocator, sfz_dbg(""));
+	CHECK(max_q.top() == 499);
+	max_q.pushMany(descending.data(), 500);
+	bool ok = true;
+	for (i32 i = 499; i >= 0; i--) ok = ok && max_q.pop() == i && max_q.pop() == i;
+	CHECK(ok);
+
+	// Stateful comparator
+	const f32 costs[] = { 5.0f, -1.0f, 3.0f, 0.5f };
+	const u32 indices[] = { 0, 1, 2, 3 };
+	SfzPriorityQueue<u32, CostCmp> cost_q;
+	cost_q.initFrom(indices, 4, &allocator, sfz_dbg(""), CostCmp{ costs });
+	CHECK(cost_q.pop() == 1);
+	CHECK(cost_q.pop() == 3);
+	CHECK(cost_q.pop() == 2);
+	CHECK(cost_q.pop() == 0);
+}
+
+TEST_CASE("SfzIndexedPriorityQueue: handles")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	SfzIndexedPriorityQueue<i32> q(4, &allocator, sfz_dbg(""));
+	const SfzHandle a = q.push(10);
+	const SfzHandle b = q.push(20);
+	const SfzHandle c = q.push(30);
+	const SfzHandle d = q.push(40);
+	CHECK(q.isFull());
+	CHECK(q.capacity() == 4);
+
+	// Decrease-key and increase-key
+	q.update(d, 5);
+	CHECK(q.topHandle() == d);
+	q.update(d, 50);
+	CHECK(q.topHandle() == a);
+	q.update(a, 10); // Same value
+	CHECK(*q.get(a) == 10);
+
+	// Removing the last heap entry and the top entry
+	CHECK(q.remove(d));
+	CHECK(q.remove(a));
+	CHECK(q.top() == 20);
+	CHECK(*q.get(c) == 30);
+
+	// Stale handles are rejected, also after the slot is reused
+	CHECK(!q.contains(a));
+	CHECK(q.get(a) == nullptr);
+	CHECK(!q.remove(a));
+	CHECK(q.pop() == 20);
+	CHECK(!q.contains(b));
+	const SfzHandle e = q.push(1);
+	CHECK(e != b);
+	CHECK(e != a);
+	CHECK(q.get(b) == nullptr);
+
+	q.clear();
+	CHECK(!q.contains(c));
+	CHECK(!q.contains(e));
+	CHECK(q.isEmpty());
+	CHECK(!q.isFull());
+}
+
+TEST_CASE("SfzPriorityQueue: random operations against std::priority_queue")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	std::mt19937 rng(8);
+
+	SfzPriorityQueue<std::string, SfzLess<std::string>, 8> q(0, &allocator, sfz_dbg(""));
+	std::priority_queue<std::string, std::vector<std::string>, std::greater<std::string>> ref;
+	for (u32 it = 0; it < 50000; it++) {
+		const u32 op = rng() % 10;
+		if (op < 5) {
+			const std::string s = std::to_string(rng());
+			q.push(s);
+			ref.push(s);
+		}
+		else if (op < 9) {
+			if (!ref.empty()) {
+				REQUIRE(q.pop() == ref.top());
+				ref.pop();
+			}
+		}
+		else {
+			std::vector<std::string> strs;
+			const u32 n = rng() % 300;
+			for (u32 i = 0; i < n; i++) {
+				strs.push_back(std::to_string(rng()));
+				ref.push(strs.back());
+			}
+			q.pushMany(strs.data(), n);
+		}
+		REQUIRE(q.size() == ref.size());
+		if (!ref.empty()) REQUIRE(q.top() == ref.top());
+	}
+
+	// Heapify and pop in sorted order with a binary max-heap
+	std::vector<i32> values;
+	for (u32 i = 0; i < 1000; i++) values.push_back(i32(rng() % 100000));
+	SfzPriorityQueue<i32, SfzGreater<i32>, 2> max_q;
+	max_q.initFrom(values.data(), 1000, &allocator, sfz_dbg(""));
+	std::sort(values.begin(), values.end());
+	bool sorted = true;
+	for (i32 i = 999; i >= 0; i--) sorted = sorted && max_q.pop() == values[i];
+	CHECK(sorted);
+	CHECK(max_q.size() == 0);
+}
+
+TEST_CASE("SfzIndexedPriorityQueue: random operations with update/remove by handle")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	std::mt19937 rng(9);
+
+	SfzIndexedPriorityQueue<i32> q(5000, &allocator, sfz_dbg(""));
+	std::vector<SfzHandle> handles;
+	std::map<u32, i32> values; // handle bits -> value
+	std::set<std::pair<i32, u32>> order;
+	auto removeHandle = [&](SfzHandle h) {
+		auto itr = std::find(handles.begin(), handles.end(), h);
+		*itr = handles.back();
+		handles.pop_back();
+		order.erase({ values[h.bits], h.bits });
+		values.erase(h.bits);
+	};
+	auto addHandle = [&](SfzHandle h, i32 v) {
+		handles.push_back(h);
+		values[h.bits] = v;
+		order.insert({ v, h.bits });
+	};
+
+	for (u32 it = 0; it < 100000; it++) {
+		const u32 op = rng() % 10;
+		if ((op < 4 && !q.isFull()) || handles.empty()) {
+			const i32 v = i32(rng() % 100000);
+			addHandle(q.push(v), v);
+		}
+		else if (op < 6) {
+			const SfzHandle h = handles[rng() % handles.size()];
+			const i32 v = i32(rng() % 100000);
+			q.update(h, v);
+			order.erase({ values[h.bits], h.bits });
+			values[h.bits] = v;
+			order.insert({ v, h.bits });
+		}
+		else if (op < 8) {
+			const SfzHandle h = handles[rng() % handles.size()];
+			REQUIRE(q.remove(h));
+			REQUIRE(!q.contains(h));
+			removeHandle(h);
+		}
+		else if (op < 9) {
+			const i32 top = q.top();
+			const SfzHandle h = q.topHandle();
+			REQUIRE(top == order.begin()->first);
+			REQUIRE(q.pop() == top);
+			removeHandle(h);
+		}
+		else if (q.size() + 100 < 5000) {
+			i32 new_values[100];
+			SfzHandle new_handles[100];
+			const u32 n = rng() % 100;
+			for (u32 i = 0; i < n; i++) new_values[i] = i32(rng() % 100000);
+			q.pushMany(new_values, n, new_handles);
+			for (u32 i = 0; i < n; i++) addHandle(new_handles[i], new_values[i]);
+		}
+
+		REQUIRE(q.size() == handles.size());
+		if (!handles.empty()) {
+			REQUIRE(q.top() == order.begin()->first);
+			const SfzHandle h = handles[rng() % handles.size()];
+			REQUIRE(*q.get(h) == values[h.bits]);
+		}
+	}
+
+	q.clear();
+	CHECK(q.size() == 0);
+	q.push(1);
+	CHECK(q.top() == 1);
+}
+
+// Benchmarks
+// ------------------------------------------------------------------------------------------------
+
+namespace {
+
+// Open lists for A*, entries are (f << 32) | node so ties are broken the same way in all of them.
+struct IndexedHeapOpen {
+	SfzIndexedPriorityQueue<u64> q;
+	std::vector<SfzHandle> handles;
+	IndexedHeapOpen(u32 num_nodes, SfzAllocator* allocator) : q(num_nodes, allocator, sfz_dbg("")), handles(num_nodes) {}
+	bool empty() const { return q.isEmpty(); }
+	void push(u32 node, u32 f) { handles[node] = q.push((u64(f) << 32) | node); }
+	void decrease(u32 node, u32 f) { q.update(handles[node], (u64(f) << 32) | node); }
+	u32 popMin() { return u32(q.pop()); }
+};
+
+// Pushes a new entry instead of decreasing, stale entries are skipped when popped
+struct LazyHeapOpen {
+	SfzPriorityQueue<u64> q;
+	LazyHeapOpen(u32, SfzAllocator* allocator) : q(0, allocator, sfz_dbg("")) {}
+	bool empty() const { return q.isEmpty(); }
+	void push(u32 node, u32 f) { q.push((u64(f) << 32) | node); }
+	void decrease(u32 node, u32 f) { push(node, f); }
+	u32 popMin() { return u32(q.pop()); }
+};
+
+struct SortedArrayOpen {
+	SfzArray<u64> a;
+	SortedArrayOpen(u32, SfzAllocator* allocator) : a(0, allocator, sfz_dbg("")) {}
+	bool empty() const { return a.isEmpty(); }
+	void push(u32 node, u32 f) { a.add((u64(f) << 32) | node); }
+	void decrease(u32 node, u32 f) { *a.find([&](u64 e) { return u32(e) == node; }) = (u64(f) << 32) | node; }
+	u32 popMin() { a.sort([](u64 lhs, u64 rhs) { return lhs > rhs; }); return u32(a.pop()); }
+};
+
+struct LinearSearchOpen {
+	SfzArray<u64> a;
+	LinearSearchOpen(u32, SfzAllocator* allocator) : a(0, allocator, sfz_dbg("")) {}
+	bool empty() const { return a.isEmpty(); }
+	void push(u32 node, u32 f) { a.add((u64(f) << 32) | node); }
+	void decrease(u32 node, u32 f) { *a.find([&](u64 e) { return u32(e) == node; }) = (u64(f) << 32) | node; }
+	u32 popMin()
+	{
+		u32 min_idx = 0;
+		for (u32 i = 1; i < a.size(); i++) if (a[i] < a[min_idx]) min_idx = i;
+		const u64 e = a[min_idx];
+		a.removeQuickSwap(min_idx);
+		return u32(e);
+	}
+};
+
+// 4-connected grid with unit costs and the Manhattan heuristic, returns the cost of the shortest
+// path from the top left to the bottom right corner.
+template<typename Open>
+u32 aStarGrid(const std::vector<u8>& blocked, u32 width, SfzAllocator* allocator)
+{
+	const u32 num_nodes = width * width;
+	const u32 goal = num_nodes - 1;
+	std::vector<u32> g(num_nodes, ~0u);
+	std::vector<u8> closed(num_nodes, 0);
+	auto h = [&](u32 node) { return (width - 1 - node % width) + (width - 1 - node / width); };
+	Open open(num_nodes, allocator);
+	g[0] = 0;
+	open.push(0, h(0));
+	while (!open.empty()) {
+		const u32 node = open.popMin();
+		if (closed[node]) continue;
+		closed[node] = 1;
+		if (node == goal) return g[node];
+		const u32 x = node % width, y = node / width;
+		const u32 neighbours[4] = {
+			x > 0 ? node - 1 : ~0u, x + 1 < width ? node + 1 : ~0u,
+			y > 0 ? node - width : ~0u, y + 1 < width ? node + width : ~0u };
+		for (u32 n : neighbours) {
+			if (n == ~0u || blocked[n] || closed[n]) continue;
+			const u32 new_g = g[node] + 1;
+			if (new_g >= g[n]) continue;
+			const bool is_open = g[n] != ~0u;
+			g[n] = new_g;
+			if (is_open) open.decrease(n, new_g + h(n));
+			else open.push(n, new_g + h(n));
+		}
+	}
+	return ~0u;
+}
+
+} // namespace
+
+SFZ_BENCHMARK("SfzPriorityQueue: A* on a grid against sort based open lists")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	const u32 widths[] = { 64, 256, 1024 };
+	for (u32 width : widths) {
+		std::mt19937 rng(width);
+		std::vector<u8> blocked(width * width);
+		for (u8& b : blocked) b = u8(rng() % 100 < 20);
+		for (u32 i = 0; i < 3; i++) {
+			for (u32 j = 0; j < 3; j++) {
+				blocked[i * width + j] = 0; // Keep the corners open, so start and goal aren't walled in
+				blocked[(width - 1 - i) * width + (width - 1 - j)] = 0;
+			}
+		}
+
+		u32 indexed_cost = 0, lazy_cost = 0, sorted_cost = 0, linear_cost = 0;
+		const u32 reps = width <= 256 ? 5 : 1;
+		const f64 indexed_ms = sfzBenchMs(reps, [&]() { indexed_cost = aStarGrid<IndexedHeapOpen>(blocked, width, &allocator); });
+		const f64 lazy_ms = sfzBenchMs(reps, [&]() { lazy_cost = aStarGrid<LazyHeapOpen>(blocked, width, &allocator); });
+		CHECK(indexed_cost == lazy_cost);
+		CHECK(indexed_cost != ~0u);
+		if (width > 256) {
+			// The sort based open lists are quadratic, too slow to run on the largest grid
+			SFZ_BENCH_PRINT("%4ux%-4u grid, path cost %5u: indexed heap %9.3f ms, lazy heap %9.3f ms",
+				width, width, indexed_cost, indexed_ms, lazy_ms);
+			continue;
+		}
+		const f64 sorted_ms = sfzBenchMs(1, [&]() { sorted_cost = aStarGrid<SortedArrayOpen>(blocked, width, &allocator); });
+		const f64 linear_ms = sfzBenchMs(1, [&]() { linear_cost = aStarGrid<LinearSearchOpen>(blocked, width, &allocator); });
+		CHECK(indexed_cost == sorted_cost);
+		CHECK(indexed_cost == linear_cost);
+		SFZ_BENCH_PRINT("%4ux%-4u grid, path cost %5u: indexed heap %9.3f ms, lazy heap %9.3f ms, sorted SfzArray %9.3f ms, linear min search %9.3f ms",
+			width, width, indexed_cost, indexed_ms, lazy_ms, sorted_ms, linear_ms);
+	}
+}
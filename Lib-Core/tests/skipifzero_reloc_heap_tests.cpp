@@ -0,0 +1,320 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#include "doctest.h"
+#include "sfz_bench.hpp"
+
+#include "sfz.h"
+#include "sfz_cpp.hpp"
+#include "skipifzero_allocators.hpp"
+#include "skipifzero_reloc_heap.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+
+struct Live {
+	SfzHandle handle;
+	u64 size;
+	u8 pattern;
+	void* pinned_ptr;
+};
+
+// Checks that every live block is intact, aligned, that pinned blocks have not moved and that the
+// heap's bookkeeping agrees with the test's.
+bool validHeap(SfzRelocHeap& heap, const std::vector<Live>& live)
+{
+	const SfzRelocHeapStats stats = heap.stats();
+	if (stats.num_blocks != live.size()) return false;
+	u64 total = 0;
+	for (const Live& l : live) {
+		if (!heap.handleIsValid(l.handle)) return false;
+		const u8* ptr = static_cast<const u8*>(heap.get(l.handle));
+		if (uintptr_t(ptr) % SFZ_RELOC_HEAP_ALIGNMENT != 0) return false;
+		if (l.pinned_ptr != nullptr && l.pinned_ptr != ptr) return false;
+		for (u64 i = 0; i < l.size; i++) {
+			if (ptr[i] != u8(l.pattern + i)) return false;
+		}
+		total += heap.blockSize(l.handle);
+	}
+	return total == heap.numBytesAllocated() && total == stats.num_bytes_allocated;
+}
+
+struct WorkloadResult {
+	bool valid = true;
+	u64 peak_num_bytes_used = 0;
+	u64 max_live_bytes = 0; // Lower bound on the peak of any allocator
+	u32 num_failed_allocs = 0;
+	std::vector<f64> defrag_ms; // Per frame
+	u64 num_bytes_moved = 0;
+	SfzRelocHeapStats final_stats;
+};
+
+// Runs a random allocate/deallocate/pin workload. Block sizes drift over the run, so holes left by
+// earlier phases don't fit later allocations, like a long session loading different levels. If
+// target_live_bytes is not 0 the live bytes hover around it, otherwise they grow slowly. Every 50
+// steps is a "frame", where the heap is incrementally defragmented if a budget is given. With a
+// byte budget but no time limit the run is deterministic.
+WorkloadResult runWorkload(
+	u32 num_steps, u64 target_live_bytes, bool defrag, f32 time_budget_ms, u64 byte_budget, bool check_contents)
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	SfzRelocHeap heap(512ull << 20, 20000, &allocator, sfz_dbg(""));
+	std::mt19937_64 rng(42);
+	std::vector<Live> live;
+	WorkloadResult res;
+	u64 live_bytes = 0;
+	for (u32 step = 0; step < num_steps; step++) {
+		u32 op = u32(rng() % 100);
+		if (target_live_bytes != 0 && op < 90) op = live_bytes < target_live_bytes ? 0 : 50;
+		const u64 phase_scale = 1 + (step / 20000) % 4;
+		if (op < 50 || live.empty()) {
+			const u64 size = 1 + phase_scale * (rng() % 4 == 0 ? rng() % 50000 : rng() % 4000);
+			const SfzHandle handle = heap.allocate(size);
+			if (handle == SFZ_NULL_HANDLE) {
+				res.num_failed_allocs += 1;
+				continue;
+			}
+			const u8 pattern = u8(rng());
+			u8* ptr = static_cast<u8*>(heap.get(handle));
+			if (check_contents) for (u64 i = 0; i < size; i++) ptr[i] = u8(pattern + i);
+			else memset(ptr, pattern, size);
+			live.push_back({ handle, check_contents ? size : 0, pattern, nullptr });
+			live_bytes += heap.blockSize(handle);
+			res.max_live_bytes = u64_max(res.max_live_bytes, live_bytes);
+		}
+		else if (op < 90) {
+			const size_t i = size_t(rng() % live.size());
+			if (live[i].pinned_ptr != nullptr) heap.unpin(live[i].handle);
+			const SfzHandle stale = live[i].handle;
+			live_bytes -= heap.blockSize(stale);
+			heap.deallocate(stale);
+			live[i] = live.back();
+			live.pop_back();
+			res.valid = res.valid && !heap.handleIsValid(stale) && heap.get(stale) == nullptr;
+		}
+		else {
+			Live& l = live[size_t(rng() % live.size())];
+			if (l.pinned_ptr != nullptr) {
+				heap.unpin(l.handle);
+				l.pinned_ptr = nullptr;
+			}
+			else {
+				l.pinned_ptr = heap.pin(l.handle);
+			}
+		}
+		if (defrag && step % 50 == 0) {
+			SfzBenchTimer timer;
+			res.num_bytes_moved += heap.defragment(time_budget_ms, byte_budget);
+			res.defrag_ms.push_back(timer.elapsedMs());
+		}
+		if (check_contents && step % 5000 == 0) res.valid = res.valid && validHeap(heap, live);
+	}
+	if (check_contents) res.valid = res.valid && validHeap(heap, live);
+	res.final_stats = heap.stats();
+	res.peak_num_bytes_used = res.final_stats.peak_num_bytes_used;
+
+	// Once nothing is pinned a full defragment must close every hole
+	for (Live& l : live) {
+		if (l.pinned_ptr == nullptr) continue;
+		heap.unpin(l.handle);
+		l.pinned_ptr = nullptr;
+	}
+	heap.defragmentFull();
+	const SfzRelocHeapStats stats = heap.stats();
+	res.valid = res.valid && (!check_contents || validHeap(heap, live));
+	res.valid = res.valid && stats.num_holes == 0 && stats.num_bytes_in_holes == 0;
+	res.valid = res.valid && heap.numBytesUsed() == stats.num_bytes_allocated && !heap.needsDefragment();
+	return res;
+}
+
+} // namespace
+
+// SfzRelocHeap
+// ------------------------------------------------------------------------------------------------
+
+TEST_CASE("SfzRelocHeap: random workload with and without incremental defragmentation")
+{
+	const WorkloadResult without_defrag = runWorkload(60000, 0, false, 0.0f, 0, true);
+	const WorkloadResult with_defrag = runWorkload(60000, 0, true, SFZ_RELOC_HEAP_MAX_TIME_BUDGET_MS, 1 << 20, true);
+	CHECK(without_defrag.valid);
+	CHECK(with_defrag.valid);
+	CHECK(with_defrag.peak_num_bytes_used < without_defrag.peak_num_bytes_used);
+	CHECK(with_defrag.peak_num_bytes_used >= with_defrag.max_live_bytes);
+}
+
+TEST_CASE("SfzRelocHeap: defragment moves blocks down and keeps pinned blocks in place")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	SfzRelocHeap heap(1 << 20, 16, &allocator, sfz_dbg(""));
+	const SfzHandle a = heap.allocate(500);
+	const SfzHandle b = heap.allocate(1000);
+	const SfzHandle c = heap.allocate(2000);
+	const SfzHandle d = heap.allocate(1000);
+	memset(heap.get(d), 0xAB, 1000);
+	void* pinned = heap.pin(b);
+	const u64 used_before = heap.numBytesUsed();
+
+	heap.deallocate(a);
+	heap.deallocate(c);
+	CHECK(!heap.handleIsValid(a));
+	CHECK(heap.stats().num_holes == 2);
+	CHECK(heap.needsDefragment());
+
+	// d doesn't fit in a's hole but moves down into c's. The hole in front of b can't be closed
+	// while b is pinned.
+	heap.defragmentFull();
+	CHECK(heap.get(b) == pinned);
+	CHECK(heap.numBytesUsed() < used_before);
+	CHECK(heap.stats().num_holes == 1);
+	const u8* d_ptr = static_cast<const u8*>(heap.get(d));
+	CHECK((d_ptr[0] == 0xAB && d_ptr[999] == 0xAB));
+
+	heap.unpin(b);
+	heap.defragmentFull();
+	CHECK(heap.stats().num_holes == 0);
+	CHECK(heap.numBytesUsed() == heap.numBytesAllocated());
+	CHECK(heap.stats().peak_num_bytes_used == used_before);
+}
+
+TEST_CASE("SfzRelocHeap: limits, stale handles, pin counts and stats")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	SfzRelocHeap heap(1000, 4, &allocator, sfz_dbg(""));
+	CHECK(heap.capacity() == 1024);
+
+	// Empty heap, all free memory is one range
+	SfzRelocHeapStats stats = heap.stats();
+	CHECK(stats.num_bytes_free == 1024);
+	CHECK(stats.largest_free_range == 1024);
+	CHECK(stats.fragmentation == 0.0f);
+	CHECK(!heap.needsDefragment());
+	CHECK(heap.defragment(1.0f) == 0);
+
+	// Sizes are rounded up to the alignment, allocations fail when out of memory or blocks
+	const SfzHandle a = heap.allocate(1);
+	CHECK(heap.blockSize(a) == SFZ_RELOC_HEAP_ALIGNMENT);
+	CHECK(heap.allocate(1024) == SFZ_NULL_HANDLE);
+	const SfzHandle b = heap.allocate(256);
+	const SfzHandle c = heap.allocate(256);
+	const SfzHandle d = heap.allocate(32);
+	CHECK(heap.numBlocks() == 4);
+	CHECK(heap.allocate(32) == SFZ_NULL_HANDLE);
+
+	// Stale handles are detected, also after the slot is reused
+	heap.deallocate(a);
+	CHECK(heap.get(a) == nullptr);
+	const SfzHandle e = heap.allocate(32);
+	CHECK(e.idx() == a.idx());
+	CHECK(!heap.handleIsValid(a));
+	CHECK(heap.get(a) == nullptr);
+	CHECK(heap.get(e) == heap.get(SfzHandle(e)));
+
+	// Holes: [e 32][b 256][hole 256][d 32][free 448]
+	heap.deallocate(c);
+	stats = heap.stats();
+	CHECK(stats.num_holes == 1);
+	CHECK(stats.num_bytes_in_holes == 256);
+	CHECK(stats.largest_free_range == 448);
+	CHECK(stats.fragmentation == doctest::Approx(1.0 - 448.0 / 704.0));
+
+	// Pins are reference counted
+	heap.pin(d);
+	heap.pin(d);
+	heap.unpin(d);
+	CHECK(heap.isPinned(d));
+	CHECK(heap.pinCount(d) == 1);
+	heap.defragmentFull();
+	CHECK(heap.stats().num_holes == 1);
+	heap.unpin(d);
+	CHECK(!heap.isPinned(d));
+	CHECK(heap.needsDefragment());
+
+	// Non-finite budgets mean no time limit, a byte budget still moves at least one block
+	CHECK(heap.defragment(NAN, 1) == 32);
+	CHECK(heap.stats().num_holes == 0);
+	CHECK(heap.defragment(INFINITY) == 0);
+	CHECK(heap.numBytesUsed() == heap.numBytesAllocated());
+}
+
+TEST_CASE("SfzRelocHeap: deallocating the block at the defragment cursor")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	SfzRelocHeap heap(1 << 16, 16, &allocator, sfz_dbg(""));
+	SfzHandle handles[8];
+	for (u32 i = 0; i < 8; i++) {
+		handles[i] = heap.allocate(1024);
+		memset(heap.get(handles[i]), int(i), 1024);
+	}
+	heap.pin(handles[7]); // Keeps the top block in place, so only sliding is done
+	heap.deallocate(handles[0]);
+	heap.deallocate(handles[2]);
+
+	// Slides handles[1] down and stops at handles[3], which is then freed
+	CHECK(heap.defragment(SFZ_RELOC_HEAP_MAX_TIME_BUDGET_MS, 1) == 1024);
+	heap.deallocate(handles[3]);
+	heap.defragmentFull();
+	bool intact = true;
+	for (u32 i : { 1u, 4u, 5u, 6u, 7u }) {
+		const u8* ptr = static_cast<const u8*>(heap.get(handles[i]));
+		intact = intact && ptr[0] == u8(i) && ptr[1023] == u8(i);
+	}
+	CHECK(intact);
+	CHECK(heap.stats().num_holes == 1); // In front of the pinned block
+	heap.unpin(handles[7]);
+	heap.defragmentFull();
+	CHECK(heap.stats().num_holes == 0);
+}
+
+// Benchmarks
+// ------------------------------------------------------------------------------------------------
+
+SFZ_BENCHMARK("SfzRelocHeap: peak footprint of a long running alloc/free trace")
+{
+	constexpr u32 NUM_STEPS = 400000;
+	constexpr u64 TARGET_LIVE_BYTES = 64ull << 20;
+	SFZ_BENCH_PRINT("%u steps (%u frames), live bytes kept around %.0f MiB",
+		NUM_STEPS, NUM_STEPS / 50, f64(TARGET_LIVE_BYTES) / 1048576.0);
+	struct Config { const char* name; bool defrag; f32 time_budget_ms; u64 byte_budget; };
+	const Config configs[] = {
+		{ "no defragment", false, 0.0f, 0 },
+		{ "defragment 0.05 ms/frame", true, 0.05f, U64_MAX },
+		{ "defragment 0.25 ms/frame", true, 0.25f, U64_MAX },
+		{ "defragment 1 MiB/frame", true, SFZ_RELOC_HEAP_MAX_TIME_BUDGET_MS, 1 << 20 },
+	};
+	for (const Config& c : configs) {
+		WorkloadResult res = runWorkload(NUM_STEPS, TARGET_LIVE_BYTES, c.defrag, c.time_budget_ms, c.byte_budget, false);
+		CHECK(res.valid);
+		f64 avg_ms = 0.0, p99_ms = 0.0, max_ms = 0.0;
+		if (!res.defrag_ms.empty()) {
+			std::sort(res.defrag_ms.begin(), res.defrag_ms.end());
+			for (f64 ms : res.defrag_ms) avg_ms += ms;
+			avg_ms /= f64(res.defrag_ms.size());
+			p99_ms = res.defrag_ms[res.defrag_ms.size() * 99 / 100];
+			max_ms = res.defrag_ms.back();
+		}
+		const SfzRelocHeapStats& s = res.final_stats;
+		SFZ_BENCH_PRINT("%-26s peak %6.1f MiB (max live %6.1f MiB) | end: used %6.1f MiB, %5u holes, frag %.3f | defrag avg %.3f p99 %.3f max %.3f ms/frame, %.0f MiB moved",
+			c.name, f64(res.peak_num_bytes_used) / 1048576.0, f64(res.max_live_bytes) / 1048576.0,
+			f64(s.capacity - s.largest_free_range) / 1048576.0, s.num_holes, s.fragmentation,
+			avg_ms, p99_ms, max_ms, f64(res.num_bytes_moved) / 1048576.0);
+	}
+}
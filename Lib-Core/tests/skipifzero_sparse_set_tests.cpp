@@ -0,0 +1,231 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#include "doctest.h"
+#include "sfz_bench.hpp"
+#include "sfz_test_utils.hpp"
+
+#include "sfz.h"
+#include "sfz_cpp.hpp"
+#include "skipifzero_allocators.hpp"
+#include "skipifzero_hash_maps.hpp"
+#include "skipifzero_sparse_set.hpp"
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+TEST_CASE("SfzSparseSet: pages are allocated lazily")
+{
+	SfzTestCountingAllocator counting;
+	{
+		SfzSparseSet<u32> set(0, counting.ptr(), sfz_dbg(""));
+		CHECK(counting.num_allocs == 0);
+		CHECK(set.get(0) == nullptr);
+		CHECK(!set.contains(SFZ_SPARSE_SET_MAX_KEY));
+		CHECK(!set.remove(123));
+
+		// First key allocates the dense arrays, the page directory and one page
+		set.put(SFZ_SPARSE_SET_MAX_KEY, 1);
+		CHECK(counting.num_allocs == 3);
+		CHECK(set.numPages() == SFZ_SPARSE_SET_MAX_NUM_PAGES);
+		CHECK(set.page(0) == nullptr);
+
+		// Keys in the same page don't allocate, a new page does
+		set.put(SFZ_SPARSE_SET_MAX_KEY - 1, 2);
+		CHECK(counting.num_allocs == 3);
+		set.put(0, 3);
+		CHECK(counting.num_allocs == 4);
+		CHECK(set.page(0) != nullptr);
+		CHECK(set.page(0)[1] == SFZ_SPARSE_SET_EMPTY);
+		CHECK(set.page(0)[0] == 2);
+		CHECK(set[SFZ_SPARSE_SET_MAX_KEY] == 1);
+		CHECK(set[0] == 3);
+	}
+	CHECK(counting.numLive() == 0);
+}
+
+TEST_CASE("SfzSparseSet: put, replace and swap-remove")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	SfzSparseSet<std::string> set(0, &allocator, sfz_dbg(""));
+	set.put(10, "a");
+	set.put(20, "b");
+	set.put(30, "c");
+
+	// Replacing keeps the dense position and the size
+	set.put(20, "B");
+	CHECK(set.size() == 3);
+	CHECK(set.values()[1] == "B");
+	CHECK(&set.put(20) == &set.values()[1]); // put(key) returns the existing element
+
+	// Removing from the middle swaps in the last element
+	CHECK(set.remove(10));
+	CHECK(!set.remove(10));
+	CHECK(set.size() == 2);
+	CHECK(set.keys()[0] == 30);
+	CHECK(set.values()[0] == "c");
+	CHECK(set.denseIdx(30) == 0);
+	CHECK(set.denseIdx(10) == SFZ_SPARSE_SET_EMPTY);
+
+	// Removing the last element moves nothing
+	CHECK(set.remove(20));
+	CHECK(set.keys()[0] == 30);
+	CHECK(set.size() == 1);
+
+	// Clear keeps the memory, the set is usable afterwards
+	const u32 capacity = set.capacity();
+	set.clear();
+	CHECK(set.isEmpty());
+	CHECK(!set.contains(30));
+	CHECK(set.capacity() == capacity);
+	set.put(30, "again");
+	CHECK(set[30] == "again");
+
+	// setCapacity never drops elements
+	set.setCapacity(0);
+	CHECK(set.capacity() >= 1);
+	CHECK(set[30] == "again");
+
+	SfzSparseSet<std::string> moved = sfz_move(set);
+	CHECK(moved[30] == "again");
+	CHECK(set.size() == 0);
+}
+
+TEST_CASE("SfzSparseSet: random put/remove against reference")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	SfzSparseSet<i32> set(0, &allocator, sfz_dbg(""));
+	std::map<u32, i32> ref;
+	std::mt19937 rng(2);
+	bool consistent = true;
+	for (u32 it = 0; it < 50000; it++) {
+		const u32 key = rng() % 4 == 0 ? u32(rng() % (SFZ_SPARSE_SET_MAX_KEY + 1)) : u32(rng() % 5000);
+		if (rng() % 3 != 0) {
+			set.put(key, i32(it));
+			ref[key] = i32(it);
+		}
+		else {
+			consistent = consistent && set.remove(key) == (ref.erase(key) == 1);
+		}
+	}
+	CHECK(consistent);
+	REQUIRE(set.size() == ref.size());
+	for (u32 i = 0; i < set.size(); i++) {
+		consistent = consistent && ref[set.keys()[i]] == set.values()[i];
+		consistent = consistent && set.denseIdx(set.keys()[i]) == i;
+	}
+	CHECK(consistent);
+}
+
+TEST_CASE("sfzSparseSetIntersect: unordered and ordered")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	SfzSparseSet<std::string> names(0, &allocator, sfz_dbg(""));
+	SfzSparseSet<i32> ages(0, &allocator, sfz_dbg(""));
+
+	// Inserted out of order and across pages, with a removal to shuffle the dense order
+	const u32 keys[] = { 9000, 5, 70000, 3, 4096, 4095, 1 };
+	for (u32 key : keys) names.put(key, std::to_string(key));
+	for (u32 key : keys) ages.put(key, i32(key) * 2);
+	names.remove(3);
+	ages.remove(70000);
+	ages.put(6, 12); // Only in ages
+
+	std::vector<u32> visited;
+	bool values_match = true;
+	auto visit = [&](u32 key, std::string& name, i32& age) {
+		visited.push_back(key);
+		values_match = values_match && name == std::to_string(key) && age == i32(key) * 2;
+	};
+
+	sfzSparseSetIntersect(names, ages, visit);
+	CHECK(values_match);
+	std::vector<u32> unordered = visited;
+	std::sort(unordered.begin(), unordered.end());
+	CHECK(unordered == std::vector<u32>{ 1, 5, 4095, 4096, 9000 });
+
+	visited.clear();
+	sfzSparseSetIntersectOrdered(names, ages, visit);
+	CHECK(values_match);
+	CHECK(visited == std::vector<u32>{ 1, 5, 4095, 4096, 9000 });
+
+	// Empty sets
+	SfzSparseSet<i32> empty(0, &allocator, sfz_dbg(""));
+	u32 num_calls = 0;
+	sfzSparseSetIntersectOrdered(names, empty, [&](u32, std::string&, i32&) { num_calls += 1; });
+	sfzSparseSetIntersect(empty, ages, [&](u32, i32&, i32&) { num_calls += 1; });
+	CHECK(num_calls == 0);
+}
+
+// Benchmarks
+// ------------------------------------------------------------------------------------------------
+
+SFZ_BENCHMARK("SfzSparseSet: random access, iteration and churn against SfzHashMap")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	constexpr u32 NUM_KEYS = 100000;
+	constexpr u32 KEY_RANGE = 1 << 20;
+	std::mt19937 rng(1);
+	std::vector<u32> keys;
+	for (u32 i = 0; i < NUM_KEYS; i++) keys.push_back(u32(rng() % KEY_RANGE));
+	std::vector<u32> lookups;
+	for (u32 i = 0; i < 1000000; i++) lookups.push_back(keys[rng() % NUM_KEYS]);
+
+	SfzSparseSet<f32x3> set(0, &allocator, sfz_dbg(""));
+	SfzHashMap<u32, f32x3> map(0, &allocator, sfz_dbg(""));
+	for (u32 key : keys) {
+		set.put(key, f32x3_splat(f32(key)));
+		map.put(key, f32x3_splat(f32(key)));
+	}
+	CHECK(set.size() == map.size());
+
+	f32 set_sum = 0.0f, map_sum = 0.0f;
+	const f64 set_get_ms = sfzBenchMs(5, [&]() { for (u32 key : lookups) set_sum += set.get(key)->x; });
+	const f64 map_get_ms = sfzBenchMs(5, [&]() { for (u32 key : lookups) map_sum += map.get(key)->x; });
+	CHECK(set_sum == map_sum);
+	sfzBenchKeep(set_sum);
+	SFZ_BENCH_PRINT("1M random gets:   SfzSparseSet %7.3f ms, SfzHashMap %7.3f ms", set_get_ms, map_get_ms);
+
+	f32x3 set_acc = f32x3_splat(0.0f), map_acc = f32x3_splat(0.0f);
+	const f64 set_iter_ms = sfzBenchMs(20, [&]() { for (const f32x3& v : set) set_acc += v; });
+	const f64 map_iter_ms = sfzBenchMs(20, [&]() { for (auto pair : map) map_acc += pair.value; });
+	sfzBenchKeep(set_acc);
+	sfzBenchKeep(map_acc);
+	SFZ_BENCH_PRINT("iterate 100K:     SfzSparseSet %7.3f ms, SfzHashMap %7.3f ms", set_iter_ms, map_iter_ms);
+
+	// Churn: remove a key and add a new one, the steady state of e.g. a component set
+	std::vector<u32> new_keys;
+	for (u32 i = 0; i < 1000000; i++) new_keys.push_back(u32(rng() % KEY_RANGE));
+	auto churn = [&](auto& container) {
+		std::vector<u32> current = keys;
+		SfzBenchTimer timer;
+		for (u32 i = 0; i < 1000000; i++) {
+			container.remove(current[i % NUM_KEYS]);
+			container.put(new_keys[i], f32x3_splat(1.0f));
+			current[i % NUM_KEYS] = new_keys[i];
+		}
+		return timer.elapsedMs();
+	};
+	const f64 set_churn_ms = churn(set);
+	const f64 map_churn_ms = churn(map);
+	CHECK(set.size() == map.size());
+	SFZ_BENCH_PRINT("1M remove + put:  SfzSparseSet %7.3f ms, SfzHashMap %7.3f ms", set_churn_ms, map_churn_ms);
+}
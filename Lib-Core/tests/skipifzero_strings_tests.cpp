@@ -0,0 +1,215 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#include "doctest.h"
+#include "sfz_bench.hpp"
+#include "sfz_test_utils.hpp"
+
+// SfzStrIDs is only defined in the implementation, which must live in exactly one translation unit.
+#define SFZ_STR_ID_IMPLEMENTATION
+#include "sfz.h"
+#include "sfz_cpp.hpp"
+#include "skipifzero_allocators.hpp"
+#include "skipifzero_hash_maps.hpp"
+#include "skipifzero_strings.hpp"
+
+#include <atomic>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// SfzStrIDs
+// ------------------------------------------------------------------------------------------------
+
+TEST_CASE("SfzStrIDs: concurrent registration with lock-free lookups")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+
+	// Mix of short strings and one string larger than an arena page
+	const u32 NUM_STRS = 50000;
+	std::vector<std::string> strs;
+	for (u32 i = 0; i < NUM_STRS; i++) {
+		const u32 num_x = i == 7 ? 70000 : (i % 7 == 0 ? 0 : i % 50);
+		strs.push_back("str_" + std::to_string(i) + std::string(num_x, 'x'));
+	}
+
+	for (u32 num_shards : { 1u, 16u }) {
+		CAPTURE(num_shards);
+		SfzStrIDs* ids = sfz_new<SfzStrIDs>(&allocator, sfz_dbg(""), 16, &allocator, num_shards);
+
+		// A reader looks up strings while they are being registered, they must either be
+		// unregistered or complete.
+		std::atomic<bool> done = false;
+		std::atomic<u32> num_bad = 0;
+		std::thread reader([&]() {
+			while (!done.load()) {
+				for (u32 i = 0; i < NUM_STRS; i += 997) {
+					const SfzStrID id = sfzStrIDCreate(strs[i].c_str());
+					const u32 len = sfzStrIDGetStrLen(ids, id);
+					if (len == 0) continue;
+					if (len != strs[i].size() || strs[i] != sfzStrIDGetStr(ids, id)) num_bad += 1;
+				}
+			}
+		});
+
+		std::vector<std::thread> writers;
+		const u32 num_writers = num_shards == 1 ? 1 : 8;
+		for (u32 t = 0; t < num_writers; t++) {
+			writers.emplace_back([&, t]() {
+				for (u32 i = 0; i < NUM_STRS; i++) {
+					const std::string& str = strs[(i * 7 + t * 13) % NUM_STRS];
+					const SfzStrID id = sfzStrIDCreateRegister(ids, str.c_str());
+					if (id != sfzStrIDCreate(str.c_str())) num_bad += 1;
+				}
+			});
+		}
+		for (std::thread& writer : writers) writer.join();
+		done = true;
+		reader.join();
+		CHECK(num_bad.load() == 0);
+
+		bool all_registered = true;
+		for (const std::string& str : strs) {
+			const SfzStrID id = sfzStrIDCreate(str.c_str());
+			all_registered = all_registered &&
+				str == sfzStrIDGetStr(ids, id) && sfzStrIDGetStrLen(ids, id) == str.size();
+		}
+		CHECK(all_registered);
+		CHECK(std::string(sfzStrIDGetStr(ids, sfzStrIDCreate("nope"))) == "<unknown>");
+		CHECK(sfzStrIDGetStrLen(ids, sfzStrIDCreate("nope")) == 0);
+
+		sfz_delete(&allocator, ids);
+	}
+}
+
+TEST_CASE("SfzStrIDs: shards, pages and tables are allocated from the allocator")
+{
+	SfzTestCountingAllocator counting;
+	SfzStrIDs ids;
+	CHECK(std::string(sfzStrIDGetStr(&ids, sfzStrIDCreate("a"))) == "<unknown>");
+	CHECK(sfzStrIDGetStrLen(&ids, sfzStrIDCreate("a")) == 0);
+
+	for (u32 num_shards : { 1u, 3u, 64u, 100u }) {
+		CAPTURE(num_shards);
+		ids.init(0, counting.ptr(), num_shards);
+		CHECK(counting.num_allocs == counting.num_deallocs + 1 + num_shards); // Shards + one table each
+		CHECK(counting.max_align == 64);
+		CHECK(uintptr_t(ids.shards) % 64 == 0);
+
+		// One string larger than a page, the rest fill up pages and grow the tables
+		const std::string big(SFZ_STR_IDS_PAGE_SIZE, 'b');
+		CHECK(sfzStrIDCreateRegister(&ids, big.c_str()) == sfzStrIDCreate(big.c_str()));
+		std::vector<std::string> strs;
+		for (u32 i = 0; i < 20000; i++) strs.push_back("string_" + std::to_string(i));
+		for (const std::string& str : strs) sfzStrIDCreateRegister(&ids, str.c_str());
+		for (const std::string& str : strs) sfzStrIDCreateRegister(&ids, str.c_str());
+		CHECK(sfzStrIDCreateRegister(&ids, "") == sfzStrIDCreate(""));
+
+		bool all_found = true;
+		for (const std::string& str : strs) {
+			const SfzStrID id = sfzStrIDCreate(str.c_str());
+			all_found = all_found && sfzStrIDGetStrLen(&ids, id) == str.size() && str == sfzStrIDGetStr(&ids, id);
+		}
+		CHECK(all_found);
+		CHECK(sfzStrIDGetStrLen(&ids, sfzStrIDCreate(big.c_str())) == big.size());
+		CHECK(std::string(sfzStrIDGetStr(&ids, sfzStrIDCreate(""))) == "");
+
+		u32 num_pages = 0;
+		for (u32 i = 0; i < ids.num_shards; i++) {
+			for (SfzStrIDPage* page = ids.shards[i].pages; page != nullptr; page = page->next) {
+				CHECK(page->used <= page->size);
+				num_pages += 1;
+			}
+		}
+		CHECK(num_pages >= 1 + (20000 * 32) / SFZ_STR_IDS_PAGE_SIZE);
+	}
+	ids.destroy();
+	CHECK(ids.shards == nullptr);
+	CHECK(counting.numLive() == 0);
+}
+
+// Benchmarks
+// ------------------------------------------------------------------------------------------------
+
+SFZ_BENCHMARK("SfzStrIDs: registering 1M strings from 16 threads and reverse lookups")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	constexpr u32 NUM_STRS = 1000000;
+	constexpr u32 NUM_THREADS = 16;
+	std::vector<std::string> strs;
+	for (u32 i = 0; i < NUM_STRS; i++) strs.push_back("asset/texture_" + std::to_string(i) + ".png");
+	std::vector<SfzStrID> lookups;
+	std::mt19937 rng(1);
+	for (u32 i = 0; i < NUM_STRS; i++) lookups.push_back(sfzStrIDCreate(strs[rng() % NUM_STRS].c_str()));
+
+	// The previous implementation, one allocation per string in a SfzHashMap
+	SfzBenchTimer timer;
+	SfzHashMap<SfzStrID, char*> map(0, &allocator, sfz_dbg(""));
+	for (const std::string& str : strs) {
+		const SfzStrID id = sfzStrIDCreate(str.c_str());
+		if (map.get(id) != nullptr) continue;
+		char* copy = static_cast<char*>(allocator.alloc(sfz_dbg(""), str.size() + 1, 1));
+		memcpy(copy, str.c_str(), str.size() + 1);
+		map.put(id, copy);
+	}
+	const f64 map_register_ms = timer.elapsedMs();
+	u64 map_sum = 0;
+	const f64 map_lookup_ms = sfzBenchMs(3, [&]() {
+		u64 sum = 0;
+		for (SfzStrID id : lookups) sum += u64(strlen(*map.get(id)));
+		map_sum = sum;
+	});
+	for (auto pair : map) allocator.dealloc(pair.value);
+
+	SFZ_BENCH_PRINT("%u strings, %u hardware threads", NUM_STRS, std::thread::hardware_concurrency());
+	SFZ_BENCH_PRINT("  SfzHashMap<SfzStrID, char*>:  register %7.1f ms, lookup + strlen %6.1f M/s",
+		map_register_ms, f64(NUM_STRS) / 1000.0 / map_lookup_ms);
+
+	for (u32 num_shards : { 1u, NUM_THREADS }) {
+		SfzStrIDs ids(0, &allocator, num_shards);
+		const u32 num_threads = num_shards == 1 ? 1 : NUM_THREADS;
+		timer.restart();
+		std::vector<std::thread> threads;
+		for (u32 t = 0; t < num_threads; t++) {
+			threads.emplace_back([&, t]() {
+				for (u32 i = t; i < NUM_STRS; i += num_threads) sfzStrIDCreateRegister(&ids, strs[i].c_str());
+			});
+		}
+		for (std::thread& thread : threads) thread.join();
+		const f64 register_ms = timer.elapsedMs();
+
+		u64 len_sum = 0, str_sum = 0;
+		const f64 len_ms = sfzBenchMs(3, [&]() {
+			u64 sum = 0;
+			for (SfzStrID id : lookups) sum += sfzStrIDGetStrLen(&ids, id);
+			len_sum = sum;
+		});
+		const f64 str_ms = sfzBenchMs(3, [&]() {
+			u64 sum = 0;
+			for (SfzStrID id : lookups) sum += u64(sfzStrIDGetStr(&ids, id)[0]);
+			str_sum = sum;
+		});
+		sfzBenchKeep(str_sum);
+		CHECK(len_sum == map_sum);
+
+		SFZ_BENCH_PRINT("  SfzStrIDs, %2u shards, %2u threads: register %7.1f ms, lookup len %6.1f M/s, lookup str %6.1f M/s",
+			num_shards, num_threads, register_ms,
+			f64(NUM_STRS) / 1000.0 / len_ms, f64(NUM_STRS) / 1000.0 / str_ms);
+	}
+}
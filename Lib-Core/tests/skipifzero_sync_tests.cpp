@@ -0,0 +1,584 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#include "doctest.h"
+#include "sfz_bench.hpp"
+
+#include "sfz.h"
+#include "sfz_cpp.hpp"
+#include "skipifzero_sync.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct State { u64 seq; u64 data[30]; u64 check; };
+struct Small { u64 a; u32 b; u32 c; };
+struct Odd { u8 bytes[13]; }; // Not a multiple of the 8 byte words the seqlock stores
+
+} // namespace
+
+// SfzTripleBuffer
+// ------------------------------------------------------------------------------------------------
+
+TEST_CASE("SfzTripleBuffer: single threaded handoff")
+{
+	SfzTripleBuffer<u32> tb(7);
+	CHECK(tb.readBuffer() == 7);
+	CHECK(tb.writeBuffer() == 7);
+	CHECK(!tb.update());
+	CHECK(tb.read() == 7);
+
+	tb.write(1);
+	CHECK(tb.readBuffer() == 7);
+	CHECK(tb.update());
+	CHECK(tb.readBuffer() == 1);
+	CHECK(!tb.update());
+	CHECK(tb.readBuffer() == 1);
+
+	// Values published faster than they are read are overwritten, the reader gets the latest
+	tb.write(2);
+	tb.write(3);
+	tb.write(4);
+	CHECK(tb.read() == 4);
+	CHECK(!tb.update());
+
+	// Writer and reader never own the same buffer, whatever the interleaving
+	bool aliased = false;
+	for (u32 i = 0; i < 100; i++) {
+		if (i % 3 != 0) tb.write(i);
+		if (i % 2 != 0) tb.update();
+		aliased = aliased || &tb.writeBuffer() == &tb.readBuffer();
+	}
+	CHECK(!aliased);
+
+	tb.reset(42);
+	CHECK(!tb.update());
+	CHECK(tb.readBuffer() == 42);
+	CHECK(tb.writeBuffer() == 42);
+
+	// Each buffer on its own cache line
+	SfzTripleBuffer<u8> tb8;
+	tb8.update();
+	const uintptr_t read_addr = uintptr_t(&tb8.readBuffer());
+	const uintptr_t write_addr = uintptr_t(&tb8.writeBuffer());
+	CHECK(read_addr % SFZ_SYNC_CACHE_LINE_SIZE == 0);
+	CHECK(write_addr % SFZ_SYNC_CACHE_LINE_SIZE == 0);
+	CHECK(read_addr != write_addr);
+}
+
+TEST_CASE("SfzTripleBuffer: reader always sees a complete, monotonic state")
+{
+	constexpr u64 NUM_UPDATES = 200000;
+	SfzTripleBuffer<State> tb;
+	std::atomic<bool> done = false;
+	std::thread writer([&]() {
+		for (u64 i = 1; i <= NUM_UPDATES; i++) {
+			State& s = tb.writeBuffer();
+			s.seq = i;
+			u64 check = i;
+			for (u32 j = 0; j < 30; j++) {
+				s.data[j] = i * j;
+				check ^= s.data[j];
+			}
+			s.check = check;
+			tb.publish();
+		}
+		done = true;
+	});
+
+	u64 last = 0;
+	u32 num_bad = 0;
+	while (true) {
+		const bool writer_done = done.load();
+		const State& s = tb.read();
+		u64 check = s.seq;
+		for (u32 j = 0; j < 30; j++) check ^= s.data[j];
+		if (check != s.check || s.seq < last) num_bad += 1;
+		last = s.seq;
+		if (writer_done) break;
+	}
+	writer.join();
+	CHECK(num_bad == 0);
+	tb.update();
+	CHECK(tb.readBuffer().seq == NUM_UPDATES);
+}
+
+// SfzSeqLock
+// ------------------------------------------------------------------------------------------------
+
+TEST_CASE("SfzSeqLock: single threaded store and load")
+{
+	SfzSeqLock<Small> zero;
+	CHECK(zero.version() == 0);
+	CHECK(zero.load().a == 0);
+	CHECK(zero.load().c == 0);
+
+	static_assert(SfzSeqLock<Odd>::NUM_WORDS == 2, "");
+	Odd odd = {};
+	for (u32 i = 0; i < 13; i++) odd.bytes[i] = u8(0xF0 + i);
+	SfzSeqLock<Odd> seqlock(odd);
+	CHECK(seqlock.version() == 0);
+	Odd out = {};
+	CHECK(seqlock.tryLoad(&out));
+	CHECK(memcmp(&out, &odd, sizeof(Odd)) == 0);
+
+	for (u32 i = 1; i <= 10; i++) {
+		odd.bytes[12] = u8(i);
+		seqlock.store(odd);
+		CHECK(seqlock.version() == i);
+	}
+	out = seqlock.load();
+	CHECK(memcmp(&out, &odd, sizeof(Odd)) == 0);
+}
+
+TEST_CASE("SfzSeqLock: loads are never torn with several readers")
+{
+	constexpr u32 NUM_STORES = 200000;
+	SfzSeqLock<Small> seqlock(Small{ 0, 0, ~0u });
+	std::atomic<bool> done = false;
+	std::atomic<u32> num_bad = 0;
+	std::thread writer([&]() {
+		for (u32 i = 1; i <= NUM_STORES; i++) seqlock.store(Small{ u64(i) * 3, i, ~i });
+		done = true;
+	});
+	std::vector<std::thread> readers;
+	for (u32 t = 0; t < 3; t++) {
+		readers.emplace_back([&]() {
+			u64 prev = 0;
+			while (!done.load()) {
+				const Small s = seqlock.load();
+				if (s.a != u64(s.b) * 3 || s.c != ~s.b || s.a < prev) num_bad += 1;
+				prev = s.a;
+			}
+		});
+	}
+	writer.join();
+	for (std::thread& reader : readers) reader.join();
+	CHECK(num_bad.load() == 0);
+	CHECK(seqlock.version() == NUM_STORES);
+	CHECK(seqlock.load().b == NUM_STORES);
+}
+
+// SfzMutex and SfzRWLock
+// ------------------------------------------------------------------------------------------------
+
+namespace {
+
+// Spins until pred() is true, the condition is expected to become true within milliseconds.
+template<typename Pred>
+bool waitFor(Pred pred)
+{
+	for (u32 i = 0; i < 100000; i++) {
+		if (pred()) return true;
+		std::this_thread::yield();
+	}
+	return pred();
+}
+
+} // namespace
+
+TEST_CASE("SfzMutex and SfzRWLock: tryLock")
+{
+	static_assert(sizeof(SfzMutex) == 4, "");
+	static_assert(sizeof(SfzRWLock) == 4, "");
+
+	SfzMutex mutex;
+	CHECK(mutex.tryLock());
+	CHECK(!mutex.tryLock());
+	mutex.unlock();
+	CHECK(mutex.tryLock());
+	mutex.unlock();
+
+	SfzRWLock rw;
+	CHECK(rw.tryLockShared());
+	CHECK(rw.tryLockShared());
+	CHECK(!rw.tryLock());
+	rw.unlockShared();
+	rw.unlockShared();
+	CHECK(rw.tryLock());
+	CHECK(!rw.tryLockShared());
+	CHECK(!rw.tryLock());
+	rw.unlock();
+	CHECK(rw.tryLockShared());
+	rw.unlockShared();
+}
+
+TEST_CASE("SfzMutexWithStats: uncontended and parked acquires")
+{
+	SfzMutexWithStats mutex;
+	for (u32 i = 0; i < 10; i++) {
+		SfzLockGuard guard(mutex);
+	}
+	CHECK(mutex.tryLock());
+	mutex.unlock();
+	SfzLockStats stats = mutex.stats();
+	CHECK(stats.num_acquires == 11);
+	CHECK(stats.num_contended == 0);
+	CHECK(stats.num_parks == 0);
+	CHECK(stats.wait_time_ns == 0);
+
+	// A failed tryLock() is not an acquire
+	mutex.resetStats();
+	mutex.lock();
+	CHECK(!mutex.tryLock());
+	CHECK(mutex.stats().num_acquires == 1);
+
+	// A waiter that runs out of spins parks, and is woken by unlock()
+	std::atomic<bool> acquired = false;
+	std::thread waiter([&]() {
+		mutex.lock();
+		acquired = true;
+		mutex.unlock();
+	});
+	CHECK(waitFor([&]() { return mutex.stats().num_parks >= 1; }));
+	CHECK(!acquired.load());
+	mutex.unlock();
+	waiter.join();
+	CHECK(acquired.load());
+	stats = mutex.stats();
+	CHECK(stats.num_acquires == 2);
+	CHECK(stats.num_contended == 1);
+	CHECK(stats.wait_time_ns > 0);
+
+	// Back to a plain uncontended lock once the waiter is gone
+	CHECK(mutex.tryLock());
+	mutex.unlock();
+}
+
+TEST_CASE("SfzMutexWithStats: contended counter")
+{
+	SfzMutexWithStats mutex;
+	u64 counter = 0;
+	std::vector<std::thread> threads;
+	for (u32 t = 0; t < 8; t++) {
+		threads.emplace_back([&]() {
+			for (u32 i = 0; i < 100000; i++) {
+				SfzLockGuard guard(mutex);
+				counter += 1;
+			}
+		});
+	}
+	for (std::thread& thread : threads) thread.join();
+	CHECK(counter == 800000);
+
+	const SfzLockStats stats = mutex.stats();
+	CHECK(stats.num_acquires == 800000);
+	CHECK(stats.num_contended <= stats.num_acquires);
+	CHECK(stats.num_parks <= stats.num_contended * 64);
+}
+
+TEST_CASE("SfzRWLockWithStats: a waiting writer blocks new readers")
+{
+	SfzRWLockWithStats rw;
+	rw.lockShared();
+
+	std::atomic<bool> writer_done = false;
+	std::thread writer([&]() {
+		rw.lock();
+		writer_done = true;
+		rw.unlock();
+	});
+	CHECK(waitFor([&]() { return rw.stats().num_parks >= 1; }));
+
+	// The parked writer has set the waiters bit, new readers must not barge past it
+	CHECK(!rw.tryLockShared());
+	CHECK(!rw.tryLock());
+	CHECK(!writer_done.load());
+
+	// Last reader out wakes the writer
+	rw.unlockShared();
+	writer.join();
+	CHECK(writer_done.load());
+	CHECK(rw.tryLockShared());
+	rw.unlockShared();
+	CHECK(rw.stats().num_contended == 1);
+}
+
+TEST_CASE("SfzRWLockWithStats: readers never see a torn write")
+{
+	SfzRWLockWithStats rw;
+	u64 a = 0, b = 0;
+	std::atomic<u32> num_torn = 0;
+	std::vector<std::thread> threads;
+	for (u32 t = 0; t < 3; t++) {
+		threads.emplace_back([&]() {
+			for (u32 i = 0; i < 50000; i++) {
+				SfzLockGuard guard(rw);
+				a += 1;
+				b += 1;
+			}
+		});
+	}
+	for (u32 t = 0; t < 5; t++) {
+		threads.emplace_back([&]() {
+			for (u32 i = 0; i < 100000; i++) {
+				SfzSharedLockGuard guard(rw);
+				if (a != b) num_torn += 1;
+			}
+		});
+	}
+	for (std::thread& thread : threads) thread.join();
+	CHECK(num_torn.load() == 0);
+	CHECK(a == 150000);
+	CHECK(rw.stats().num_acquires == 650000);
+}
+
+// Benchmarks
+// ------------------------------------------------------------------------------------------------
+
+namespace {
+
+struct SimState { u64 tick; f32 data[1022]; }; // 4 KiB, e.g. the transforms of a few hundred objects
+struct CameraState { u64 tick; f32 data[14]; }; // 64 bytes
+
+struct LatencyStats { f64 p50_ns, p99_ns, max_ns; };
+
+LatencyStats latencyStats(std::vector<f64>& samples)
+{
+	std::sort(samples.begin(), samples.end());
+	const size_t n = samples.size();
+	return { samples[n / 2], samples[std::min(n - 1, n * 99 / 100)], samples[n - 1] };
+}
+
+// Runs a 360 Hz producer thread against a consumer_hz consumer on the calling thread for
+// duration_ms. write(tick) hands off the state of a tick and read() returns the tick of the latest
+// state. Prints the latency of each side and how many ticks old the state seen by the consumer was.
+template<typename WriteFunc, typename ReadFunc>
+void benchHandoff(const char* name, u32 consumer_hz, u32 duration_ms, WriteFunc write, ReadFunc read)
+{
+	using Clock = std::chrono::steady_clock;
+	const Clock::time_point begin = Clock::now();
+	const Clock::time_point end = begin + std::chrono::milliseconds(duration_ms);
+	std::atomic<u64> current_tick = 0;
+
+	std::vector<f64> write_ns;
+	std::thread producer([&]() {
+		Clock::time_point next = begin;
+		for (u64 tick = 1; Clock::now() < end; tick++) {
+			SfzBenchTimer timer;
+			write(tick);
+			write_ns.push_back(timer.elapsedNs());
+			current_tick.store(tick, std::memory_order_relaxed);
+			next += std::chrono::nanoseconds(1000000000 / 360);
+			std::this_thread::sleep_until(next);
+		}
+	});
+
+	std::vector<f64> read_ns;
+	u64 sum_age = 0;
+	u64 max_age = 0;
+	Clock::time_point next = begin;
+	while (Clock::now() < end) {
+		const u64 tick_before = current_tick.load(std::memory_order_relaxed);
+		SfzBenchTimer timer;
+		const u64 seen_tick = read();
+		read_ns.push_back(timer.elapsedNs());
+		const u64 age = tick_before > seen_tick ? tick_before - seen_tick : 0;
+		sum_age += age;
+		max_age = u64_max(max_age, age);
+		next += std::chrono::nanoseconds(1000000000 / consumer_hz);
+		std::this_thread::sleep_until(next);
+	}
+	producer.join();
+
+	const LatencyStats w = latencyStats(write_ns);
+	const LatencyStats r = latencyStats(read_ns);
+	SFZ_BENCH_PRINT("%-26s 360 Hz -> %3u Hz: write p50 %6.0f p99 %7.0f max %8.0f ns | read p50 %6.0f p99 %7.0f max %8.0f ns | age avg %.2f max %u ticks",
+		name, consumer_hz, w.p50_ns, w.p99_ns, w.max_ns, r.p50_ns, r.p99_ns, r.max_ns,
+		f64(sum_age) / f64(read_ns.size()), u32(max_age));
+}
+
+template<typename T>
+void fillState(T& s, u64 tick)
+{
+	s.tick = tick;
+	for (f32& f : s.data) f = f32(tick);
+}
+
+} // namespace
+
+SFZ_BENCHMARK("SfzTripleBuffer and SfzSeqLock: 360 Hz producer against 60-240 Hz consumers")
+{
+	constexpr u32 DURATION_MS = 500;
+	SFZ_BENCH_PRINT("%u hardware threads, %u ms per run", std::thread::hardware_concurrency(), DURATION_MS);
+	for (u32 consumer_hz : { 60u, 144u, 240u }) {
+		// 4 KiB state, copied under a mutex on both sides vs handed off with a triple buffer
+		{
+			std::mutex mutex;
+			SimState shared = {};
+			SimState local = {};
+			SimState render = {};
+			benchHandoff("std::mutex (4 KiB)", consumer_hz, DURATION_MS,
+				[&](u64 tick) {
+					fillState(local, tick);
+					std::lock_guard<std::mutex> guard(mutex);
+					shared = local;
+				},
+				[&]() {
+					std::lock_guard<std::mutex> guard(mutex);
+					render = shared;
+					return render.tick;
+				});
+		}
+		{
+			SfzTripleBuffer<SimState> tb;
+			benchHandoff("SfzTripleBuffer (4 KiB)", consumer_hz, DURATION_MS,
+				[&](u64 tick) {
+					fillState(tb.writeBuffer(), tick);
+					tb.publish();
+				},
+				[&]() { return tb.read().tick; });
+		}
+
+		// 64 byte snapshot
+		{
+			std::mutex mutex;
+			CameraState shared = {};
+			benchHandoff("std::mutex (64 B)", consumer_hz, DURATION_MS,
+				[&](u64 tick) {
+					CameraState local;
+					fillState(local, tick);
+					std::lock_guard<std::mutex> guard(mutex);
+					shared = local;
+				},
+				[&]() {
+					std::lock_guard<std::mutex> guard(mutex);
+					return shared.tick;
+				});
+		}
+		{
+			SfzSeqLock<CameraState> seqlock;
+			benchHandoff("SfzSeqLock (64 B)", consumer_hz, DURATION_MS,
+				[&](u64 tick) {
+					CameraState local;
+					fillState(local, tick);
+					seqlock.store(local);
+				},
+				[&]() { return seqlock.load().tick; });
+		}
+	}
+}
+
+namespace {
+
+// Adapters so that the benchmark can use the sfz and std locks through the same interface.
+struct NoLock final {
+	void lock() {}
+	void unlock() {}
+	void lockShared() {}
+	void unlockShared() {}
+};
+
+struct StdSharedMutex final {
+	std::shared_mutex m;
+	void lock() { m.lock(); }
+	void unlock() { m.unlock(); }
+	void lockShared() { m.lock_shared(); }
+	void unlockShared() { m.unlock_shared(); }
+};
+
+void benchWork(u32 num_iters)
+{
+	static volatile u32 sink = 0;
+	for (u32 i = 0; i < num_iters; i++) sink = sink + 1;
+}
+
+struct Contention { const char* name; u32 outside_iters; u32 inside_iters; };
+constexpr Contention CONTENTION_LEVELS[] = {
+	{ "low", 400, 4 },
+	{ "medium", 40, 4 },
+	{ "high", 0, 4 },
+};
+
+// Each thread does num_ops lock/work/unlock sequences with work outside the lock in between. If
+// Shared is true that read_percent of the operations take the lock shared. Returns ns per op.
+template<bool Shared, typename LockT>
+f64 benchLock(LockT& lock, u32 num_threads, u32 num_ops, Contention c, u32 read_percent)
+{
+	std::vector<std::thread> threads;
+	SfzBenchTimer timer;
+	for (u32 t = 0; t < num_threads; t++) {
+		threads.emplace_back([&, t]() {
+			u32 rng = 0x9E3779B9u * (t + 1);
+			for (u32 i = 0; i < num_ops; i++) {
+				benchWork(c.outside_iters);
+				rng = rng * 1664525u + 1013904223u;
+				if constexpr (Shared) {
+					if ((rng >> 8) % 100 < read_percent) {
+						lock.lockShared();
+						benchWork(c.inside_iters);
+						lock.unlockShared();
+						continue;
+					}
+				}
+				lock.lock();
+				benchWork(c.inside_iters);
+				lock.unlock();
+			}
+		});
+	}
+	for (std::thread& thread : threads) thread.join();
+	return timer.elapsedNs() / f64(num_threads * num_ops);
+}
+
+} // namespace
+
+SFZ_BENCHMARK("SfzMutex and SfzRWLock: against std::mutex and std::shared_mutex under contention")
+{
+	constexpr u32 NUM_THREADS = 4;
+	constexpr u32 NUM_OPS = 200000;
+	SFZ_BENCH_PRINT("%u hardware threads, %u threads with %u ops each",
+		std::thread::hardware_concurrency(), NUM_THREADS, NUM_OPS);
+	for (const Contention& c : CONTENTION_LEVELS) {
+		NoLock no_lock;
+		std::mutex std_mutex;
+		SfzMutex sfz_mutex;
+		SfzMutexWithStats sfz_mutex_stats;
+		const f64 base_ns = benchLock<false>(no_lock, NUM_THREADS, NUM_OPS, c, 0);
+		const f64 std_ns = benchLock<false>(std_mutex, NUM_THREADS, NUM_OPS, c, 0);
+		const f64 sfz_ns = benchLock<false>(sfz_mutex, NUM_THREADS, NUM_OPS, c, 0);
+		const f64 stats_ns = benchLock<false>(sfz_mutex_stats, NUM_THREADS, NUM_OPS, c, 0);
+		const SfzLockStats stats = sfz_mutex_stats.stats();
+		CHECK(stats.num_acquires == NUM_THREADS * NUM_OPS);
+		SFZ_BENCH_PRINT("%-6s mutex  (ns/op): no lock %6.1f | std::mutex %6.1f | SfzMutex %6.1f | WithStats %6.1f, %llu contended, %llu parks, %.2f ms waited",
+			c.name, base_ns, std_ns, sfz_ns, stats_ns, (unsigned long long)stats.num_contended,
+			(unsigned long long)stats.num_parks, f64(stats.wait_time_ns) / 1000000.0);
+	}
+	for (const Contention& c : CONTENTION_LEVELS) {
+		NoLock no_lock;
+		StdSharedMutex std_rw;
+		SfzRWLock sfz_rw;
+		SfzRWLockWithStats sfz_rw_stats;
+		const f64 base_ns = benchLock<true>(no_lock, NUM_THREADS, NUM_OPS, c, 90);
+		const f64 std_ns = benchLock<true>(std_rw, NUM_THREADS, NUM_OPS, c, 90);
+		const f64 sfz_ns = benchLock<true>(sfz_rw, NUM_THREADS, NUM_OPS, c, 90);
+		const f64 stats_ns = benchLock<true>(sfz_rw_stats, NUM_THREADS, NUM_OPS, c, 90);
+		const SfzLockStats stats = sfz_rw_stats.stats();
+		CHECK(stats.num_acquires == NUM_THREADS * NUM_OPS);
+		SFZ_BENCH_PRINT("%-6s rwlock (ns/op, 90%% reads): no lock %6.1f | std::shared_mutex %6.1f | SfzRWLock %6.1f | WithStats %6.1f, %llu contended, %llu parks",
+			c.name, base_ns, std_ns, sfz_ns, stats_ns, (unsigned long long)stats.num_contended,
+			(unsigned long long)stats.num_parks);
+	}
+}
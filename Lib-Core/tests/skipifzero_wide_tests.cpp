@@ -0,0 +1,476 @@
+// Copyright (c) Peter Hillerström (skipifzero.com, peter@hstroem.se)
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#include "doctest.h"
+#include "sfz_bench.hpp"
+
+#include "sfz.h"
+#include "sfz_cpp.hpp"
+#include "skipifzero_allocators.hpp"
+#include "skipifzero_wide.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace {
+
+bool bitwiseEqual(f32 a, f32 b) { return memcmp(&a, &b, sizeof(f32)) == 0; }
+
+// The particle update used by the tests and the benchmark, gravity, integration and a bounce on
+// the floor at y = 0
+constexpr f32 PARTICLE_DT = 0.016f;
+constexpr f32x3 PARTICLE_GRAVITY = { 0.0f, -9.82f, 0.0f };
+
+void particleUpdateAoS(f32x3* pos, f32x3* vel, u32 num)
+{
+	for (u32 i = 0; i < num; i++) {
+		vel[i] += PARTICLE_GRAVITY * PARTICLE_DT;
+		pos[i] += vel[i] * PARTICLE_DT;
+		if (pos[i].y < 0.0f) {
+			pos[i].y = 0.0f;
+			vel[i].y = -vel[i].y;
+		}
+	}
+}
+
+void particleUpdateWide(SfzArray<f32x3>& pos, SfzArray<f32x3>& vel)
+{
+	const f32x8w dt = f32x8w_splat(PARTICLE_DT);
+	const f32x8w zero = f32x8w_zero();
+	const f32x3_soa8 gravity_dt = f32x3_soa8_splat(PARTICLE_GRAVITY * PARTICLE_DT);
+	for (u32 i = 0; i < pos.size(); i += 8) {
+		f32x3_soa8 p = f32x3_soa8_load(pos, i);
+		f32x3_soa8 v = f32x3_soa8_load(vel, i);
+		v += gravity_dt;
+		p += v * dt;
+		const mask8w below = p.y < zero;
+		p.y = f32x8w_select(below, zero, p.y);
+		v.y = f32x8w_select(below, -v.y, v.y);
+		f32x3_soa8_store(pos, i, p);
+		f32x3_soa8_store(vel, i, v);
+	}
+}
+
+} // namespace
+
+// f32x4w and f32x8w
+// ------------------------------------------------------------------------------------------------
+
+TEST_CASE("f32x8w and f32x4w: lane-wise identical to scalar")
+{
+	std::mt19937 rng(5);
+	std::uniform_real_distribution<f32> dist(-10.0f, 10.0f);
+	for (u32 it = 0; it < 2000; it++) {
+		// Includes equal lanes, signed zeroes and NaNs
+		f32 a[8], b[8], c[8];
+		for (u32 i = 0; i < 8; i++) {
+			a[i] = dist(rng);
+			b[i] = rng() % 5 == 0 ? a[i] : dist(rng);
+			c[i] = dist(rng);
+			if (rng() % 17 == 0) a[i] = -0.0f;
+			if (rng() % 19 == 0) b[i] = 0.0f;
+			if (rng() % 23 == 0) a[i] = NAN;
+		}
+		const f32x8w A = f32x8w_load(a), B = f32x8w_load(b), C = f32x8w_load(c);
+		const f32x4w A4 = f32x4w_load(a), B4 = f32x4w_load(b);
+
+		f32 o[8];
+		f32x8w_store(o, A + B);
+		for (u32 i = 0; i < 8; i++) CHECK(bitwiseEqual(o[i], a[i] + b[i]));
+		f32x8w_store(o, A - B);
+		for (u32 i = 0; i < 8; i++) CHECK(bitwiseEqual(o[i], a[i] - b[i]));
+		f32x8w_store(o, A * B);
+		for (u32 i = 0; i < 8; i++) CHECK(bitwiseEqual(o[i], a[i] * b[i]));
+		f32x8w_store(o, A / B);
+		for (u32 i = 0; i < 8; i++) CHECK(bitwiseEqual(o[i], a[i] / b[i]));
+		f32x8w_store(o, -A);
+		for (u32 i = 0; i < 8; i++) CHECK(bitwiseEqual(o[i], -a[i]));
+		f32x8w_store(o, f32x8w_min(A, B));
+		for (u32 i = 0; i < 8; i++) CHECK(bitwiseEqual(o[i], f32_min(a[i], b[i])));
+		f32x8w_store(o, f32x8w_max(A, B));
+		for (u32 i = 0; i < 8; i++) CHECK(bitwiseEqual(o[i], f32_max(a[i], b[i])));
+		f32x8w_store(o, f32x8w_abs(A));
+		for (u32 i = 0; i < 8; i++) CHECK(bitwiseEqual(o[i], fabsf(a[i])));
+		f32x8w_store(o, f32x8w_sqrt(f32x8w_abs(B)));
+		for (u32 i = 0; i < 8; i++) CHECK(bitwiseEqual(o[i], sqrtf(fabsf(b[i]))));
+		f32x8w_store(o, f32x8w_select(A < B, A, C));
+		for (u32 i = 0; i < 8; i++) CHECK(bitwiseEqual(o[i], a[i] < b[i] ? a[i] : c[i]));
+		f32x4w_store(o, f32x4w_max(A4, B4));
+		for (u32 i = 0; i < 4; i++) CHECK(bitwiseEqual(o[i], f32_max(a[i], b[i])));
+
+		// fma may or may not be fused depending on the target
+		f32x8w_store(o, f32x8w_fma(A, B, C));
+		for (u32 i = 0; i < 8; i++) {
+			if (std::isnan(a[i])) CHECK(std::isnan(o[i]));
+			else CHECK(fabsf(o[i] - (a[i] * b[i] + c[i])) <= 1e-4f * (1.0f + fabsf(a[i] * b[i])));
+		}
+
+		u32 lt = 0, le = 0, gt = 0, ge = 0, eq = 0, ne = 0;
+		for (u32 i = 0; i < 8; i++) {
+			lt |= u32(a[i] < b[i]) << i;
+			le |= u32(a[i] <= b[i]) << i;
+			gt |= u32(a[i] > b[i]) << i;
+			ge |= u32(a[i] >= b[i]) << i;
+			eq |= u32(a[i] == b[i]) << i;
+			ne |= u32(a[i] != b[i]) << i;
+		}
+		CHECK(mask8w_bits(A < B) == lt);
+		CHECK(mask8w_bits(A <= B) == le);
+		CHECK(mask8w_bits(A > B) == gt);
+		CHECK(mask8w_bits(A >= B) == ge);
+		CHECK(mask8w_bits(A == B) == eq);
+		CHECK(mask8w_bits(A != B) == ne);
+		CHECK(mask4w_bits(A4 < B4) == (lt & 0xF));
+		CHECK(mask4w_bits(A4 != B4) == (ne & 0xF));
+		CHECK(mask8w_bits(~(A < B)) == (~lt & 0xFF));
+		CHECK(mask8w_bits((A < B) & (A == B)) == 0);
+		CHECK(mask8w_bits((A < B) | (A == B)) == (lt | eq));
+		CHECK(mask8w_bits((A <= B) ^ (A == B)) == (le ^ eq));
+		CHECK(mask8w_any(A < B) == (lt != 0));
+		CHECK(mask8w_all(A == A) == (mask8w_bits(A == A) == 0xFF));
+
+		f32 sum = 0.0f, min = F32_MAX, max = -F32_MAX;
+		for (u32 i = 0; i < 8; i++) {
+			sum += b[i];
+			min = fminf(min, b[i]);
+			max = fmaxf(max, b[i]);
+		}
+		CHECK(fabsf(f32x8w_hsum(B) - sum) < 1e-4f);
+		CHECK(f32x8w_hmin(B) == min);
+		CHECK(f32x8w_hmax(B) == max);
+		CHECK(f32x8w_lane(B, 5) == b[5]);
+		CHECK(f32x4w_lane(B4, 2) == b[2]);
+	}
+}
+
+TEST_CASE("f32x4w: lane-wise identical to scalar")
+{
+	// With AVX2 f32x8w has its own backend, so f32x4w needs to be covered separately
+	std::mt19937 rng(8);
+	std::uniform_real_distribution<f32> dist(-10.0f, 10.0f);
+	u32 num_bad = 0;
+	for (u32 it = 0; it < 2000; it++) {
+		f32 a[4], b[4], c[4];
+		for (u32 i = 0; i < 4; i++) {
+			a[i] = rng() % 13 == 0 ? NAN : dist(rng);
+			b[i] = rng() % 5 == 0 ? a[i] : dist(rng);
+			c[i] = rng() % 11 == 0 ? -0.0f : dist(rng);
+		}
+		const f32x4w A = f32x4w_load(a), B = f32x4w_load(b), C = f32x4w_load(c);
+		f32 o[4];
+		auto check = [&](f32x4w res, auto ref) {
+			f32x4w_store(o, res);
+			for (u32 i = 0; i < 4; i++) num_bad += bitwiseEqual(o[i], ref(i)) ? 0 : 1;
+		};
+		check(A + B, [&](u32 i) { return a[i] + b[i]; });
+		check(A - B, [&](u32 i) { return a[i] - b[i]; });
+		check(A * B, [&](u32 i) { return a[i] * b[i]; });
+		check(A / B, [&](u32 i) { return a[i] / b[i]; });
+		check(-C, [&](u32 i) { return -c[i]; });
+		check(f32x4w_min(A, C), [&](u32 i) { return f32_min(a[i], c[i]); });
+		check(f32x4w_max(C, A), [&](u32 i) { return f32_max(c[i], a[i]); });
+		check(f32x4w_abs(C), [&](u32 i) { return fabsf(c[i]); });
+		check(f32x4w_sqrt(f32x4w_abs(B)), [&](u32 i) { return sqrtf(fabsf(b[i])); });
+		check(f32x4w_select(A <= B, C, A), [&](u32 i) { return a[i] <= b[i] ? c[i] : a[i]; });
+
+		u32 gt = 0, ge = 0, eq = 0;
+		for (u32 i = 0; i < 4; i++) {
+			gt |= u32(a[i] > b[i]) << i;
+			ge |= u32(a[i] >= b[i]) << i;
+			eq |= u32(a[i] == b[i]) << i;
+		}
+		num_bad += mask4w_bits(A > B) == gt ? 0 : 1;
+		num_bad += mask4w_bits(A >= B) == ge ? 0 : 1;
+		num_bad += mask4w_bits(A == B) == eq ? 0 : 1;
+		num_bad += mask4w_bits((A >= B) ^ ~(A == B)) == ((ge ^ ~eq) & 0xF) ? 0 : 1;
+		num_bad += mask4w_any(A >= B) == (ge != 0) ? 0 : 1;
+		num_bad += mask4w_all(A == A) == (mask4w_bits(A == A) == 0xF) ? 0 : 1;
+		num_bad += f32x4w_hmax(C) == fmaxf(fmaxf(c[0], c[1]), fmaxf(c[2], c[3])) ? 0 : 1;
+		num_bad += f32x4w_hmin(C) == fminf(fminf(c[0], c[1]), fminf(c[2], c[3])) ? 0 : 1;
+		num_bad += fabsf(f32x4w_hsum(C) - (c[0] + c[1] + c[2] + c[3])) < 1e-4f ? 0 : 1;
+	}
+	CHECK(num_bad == 0);
+}
+
+TEST_CASE("f32x8w: masks, reductions and fma edge cases")
+{
+	const f32 INF = std::numeric_limits<f32>::infinity();
+	const f32 vals[8] = { 1.0f, -INF, 3.0f, -0.0f, INF, 0.0f, -2.0f, 5.0f };
+	const f32x8w v = f32x8w_load(vals);
+	const f32x8w zero = f32x8w_zero();
+
+	// All, none and exactly one lane set
+	CHECK(mask8w_bits(v == v) == 0xFF);
+	CHECK(mask8w_all(v == v));
+	CHECK(!mask8w_any(v != v));
+	CHECK(mask8w_bits(v < f32x8w_splat(-INF)) == 0);
+	CHECK(mask8w_bits(v == f32x8w_splat(INF)) == (1u << 4));
+	CHECK(!mask8w_all(v > f32x8w_splat(-INF)));
+
+	// -0 == 0, and NaN lanes compare false except for !=
+	CHECK(mask8w_bits(v == zero) == ((1u << 3) | (1u << 5)));
+	const f32x8w nans = f32x8w_splat(NAN);
+	CHECK(mask8w_bits(nans == nans) == 0);
+	CHECK(mask8w_bits(nans < v) == 0);
+	CHECK(mask8w_bits(nans >= v) == 0);
+	CHECK(mask8w_bits(nans != nans) == 0xFF);
+
+	// Reductions with infinities, each lane wins once
+	CHECK(f32x8w_hmin(v) == -INF);
+	CHECK(f32x8w_hmax(v) == INF);
+	CHECK(std::isnan(f32x8w_hsum(v)));
+	for (u32 lane = 0; lane < 8; lane++) {
+		f32 tmp[8];
+		for (u32 i = 0; i < 8; i++) tmp[i] = i == lane ? -7.0f : f32(i);
+		CHECK(f32x8w_hmin(f32x8w_load(tmp)) == -7.0f);
+		for (u32 i = 0; i < 8; i++) tmp[i] = i == lane ? 70.0f : f32(i);
+		CHECK(f32x8w_hmax(f32x8w_load(tmp)) == 70.0f);
+		CHECK(f32x8w_lane(f32x8w_load(tmp), lane) == 70.0f);
+	}
+
+	// (1 + 2^-12)^2 - (1 + 2^-11) is 2^-24 with a single rounding, but the product alone rounds
+	// (ties to even) to 1 + 2^-11, so a separate multiply and add gives exactly 0.
+	const f32 a = 1.0f + 1.0f / 4096.0f;
+	const f32 c = -(1.0f + 1.0f / 2048.0f);
+	const f32 fma = f32x8w_lane(f32x8w_fma(f32x8w_splat(a), f32x8w_splat(a), f32x8w_splat(c)), 7);
+	const f32 fma4 = f32x4w_lane(f32x4w_fma(f32x4w_splat(a), f32x4w_splat(a), f32x4w_splat(c)), 0);
+#if defined(SFZ_WIDE_AVX2) || defined(SFZ_WIDE_NEON)
+	CHECK(fma == 1.0f / 16777216.0f);
+	CHECK(fma4 == 1.0f / 16777216.0f);
+#else
+	CHECK(fma == 0.0f);
+	CHECK(fma4 == 0.0f);
+#endif
+}
+
+// f32x3_soa8
+// ------------------------------------------------------------------------------------------------
+
+TEST_CASE("f32x3_soa8: AoS to SoA conversions")
+{
+	std::mt19937 rng(6);
+	std::uniform_real_distribution<f32> dist(-10.0f, 10.0f);
+	for (u32 it = 0; it < 1000; it++) {
+		f32x3 pts[8];
+		for (f32x3& p : pts) p = f32x3_init(dist(rng), dist(rng), dist(rng));
+
+		// Partial loads are zero padded, partial stores leave the rest untouched
+		const u32 count = rng() % 9;
+		const f32x3_soa8 v = f32x3_soa8_load(pts, count);
+		for (u32 i = 0; i < 8; i++) {
+			CHECK(f32x8w_lane(v.x, i) == (i < count ? pts[i].x : 0.0f));
+			CHECK(f32x8w_lane(v.y, i) == (i < count ? pts[i].y : 0.0f));
+			CHECK(f32x8w_lane(v.z, i) == (i < count ? pts[i].z : 0.0f));
+		}
+		f32x3 out[9];
+		for (f32x3& p : out) p = f32x3_splat(77.0f);
+		f32x3_soa8_store(out, count, v + v);
+		for (u32 i = 0; i < 9; i++) {
+			CHECK(out[i] == (i < count ? pts[i] + pts[i] : f32x3_splat(77.0f)));
+		}
+
+		const f32x8w dots = f32x3_soa8_dot(v, v);
+		for (u32 i = 0; i < count; i++) {
+			CHECK(f32x8w_lane(dots, i) == doctest::Approx(f32x3_dot(pts[i], pts[i])));
+		}
+
+		u32 indices[8];
+		for (u32& idx : indices) idx = rng() % 8;
+		const f32x3_soa8 gathered = f32x3_soa8_gather(pts, indices);
+		for (u32 i = 0; i < 8; i++) CHECK(f32x8w_lane(gathered.y, i) == pts[indices[i]].y);
+
+		f32x3 scattered[8] = {};
+		const u32 perm[8] = { 3, 1, 7, 0, 2, 6, 5, 4 };
+		f32x3_soa8_scatter(scattered, perm, f32x3_soa8_load(pts, 8));
+		for (u32 i = 0; i < 8; i++) CHECK(scattered[perm[i]] == pts[i]);
+	}
+}
+
+TEST_CASE("f32x3_soa8: partial loads and stores stay within bounds")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	std::mt19937 rng(9);
+	std::uniform_real_distribution<f32> dist(-10.0f, 10.0f);
+
+	// Exactly sized sources, so reading past count is caught by sanitizers
+	for (u32 count = 0; count <= 8; count++) {
+		std::vector<f32x3> src(count);
+		for (f32x3& p : src) p = f32x3_init(dist(rng), dist(rng), dist(rng));
+		const f32x3_soa8 v = f32x3_soa8_load(src.data(), count);
+		std::vector<f32x3> dst(count);
+		f32x3_soa8_store(dst.data(), count, v);
+		CHECK(dst == src);
+		CHECK(f32x8w_hsum(v.x) == doctest::Approx(f32x8w_hsum(f32x3_soa8_load(src.data(), count).x)));
+	}
+
+	// SfzArray ranges at the end of the array, the capacity past size is left untouched
+	for (u32 size = 1; size <= 20; size++) {
+		SfzArray<f32x3> arr(32, &allocator, sfz_dbg(""));
+		for (u32 i = 0; i < 32; i++) arr.add(f32x3_splat(-1.0f));
+		arr.hackSetSize(size);
+		for (u32 i = 0; i < size; i++) arr[i] = f32x3_splat(f32(i));
+		for (u32 first = 0; first < size; first += 8) {
+			f32x3_soa8 v = f32x3_soa8_load(arr, first);
+			for (u32 i = 0; i < 8; i++) {
+				CHECK(f32x8w_lane(v.z, i) == (first + i < size ? f32(first + i) : 0.0f));
+			}
+			v.x = v.x + f32x8w_splat(100.0f);
+			f32x3_soa8_store(arr, first, v);
+		}
+		u32 num_bad = 0;
+		for (u32 i = 0; i < 32; i++) {
+			const f32x3 expected = i < size ? f32x3_init(f32(i) + 100.0f, f32(i), f32(i)) : f32x3_splat(-1.0f);
+			num_bad += arr.data()[i] == expected ? 0 : 1;
+		}
+		CHECK(num_bad == 0);
+	}
+}
+
+TEST_CASE("f32x3_soa8: scatter with repeated indices, last lane wins")
+{
+	f32x3 pts[8];
+	for (u32 i = 0; i < 8; i++) pts[i] = f32x3_splat(f32(i));
+	const f32x3_soa8 v = f32x3_soa8_load(pts, 8);
+
+	f32x3 dst[4] = {};
+	const u32 indices[8] = { 0, 1, 0, 2, 1, 0, 3, 3 };
+	f32x3_soa8_scatter(dst, indices, v);
+	CHECK(dst[0] == f32x3_splat(5.0f));
+	CHECK(dst[1] == f32x3_splat(4.0f));
+	CHECK(dst[2] == f32x3_splat(3.0f));
+	CHECK(dst[3] == f32x3_splat(7.0f));
+
+	// Gathering the same element into every lane
+	const u32 same[8] = { 6, 6, 6, 6, 6, 6, 6, 6 };
+	const f32x3_soa8 g = f32x3_soa8_gather(pts, same);
+	CHECK(mask8w_all(g.x == f32x8w_splat(6.0f)));
+	CHECK(mask8w_all(g.z == f32x8w_splat(6.0f)));
+}
+
+// Particle kernel
+// ------------------------------------------------------------------------------------------------
+
+TEST_CASE("f32x3_soa8: particle kernel identical to scalar loop")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<f32> dist(-10.0f, 10.0f);
+
+	// Not a multiple of 8, to exercise the partial tail
+	for (u32 N : { 1u, 7u, 8u, 9u, 10003u }) {
+		SfzArray<f32x3> pos(N, &allocator, sfz_dbg(""));
+		SfzArray<f32x3> vel(N, &allocator, sfz_dbg(""));
+		for (u32 i = 0; i < N; i++) {
+			pos.add(f32x3_init(dist(rng), dist(rng), dist(rng)));
+			vel.add(f32x3_init(dist(rng), dist(rng), dist(rng)));
+		}
+		SfzArray<f32x3> pos_wide(N, &allocator, sfz_dbg(""));
+		SfzArray<f32x3> vel_wide(N, &allocator, sfz_dbg(""));
+		pos_wide.add(pos.data(), N);
+		vel_wide.add(vel.data(), N);
+
+		for (u32 step = 0; step < 10; step++) {
+			particleUpdateAoS(pos.data(), vel.data(), N);
+			particleUpdateWide(pos_wide, vel_wide);
+		}
+
+		bool all_equal = true;
+		for (u32 i = 0; i < N; i++) {
+			all_equal = all_equal && pos[i] == pos_wide[i] && vel[i] == vel_wide[i];
+		}
+		CHECK(all_equal);
+	}
+}
+
+// Benchmarks
+// ------------------------------------------------------------------------------------------------
+
+SFZ_BENCHMARK("f32x3_soa8: particle update against the scalar AoS loop")
+{
+	SfzAllocator allocator = sfz::createStandardAllocator();
+	constexpr u32 MAX_NUM = 4u << 20;
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<f32> dist(-10.0f, 10.0f);
+	SfzArray<f32x3> pos_init(MAX_NUM, &allocator, sfz_dbg(""));
+	SfzArray<f32x3> vel_init(MAX_NUM, &allocator, sfz_dbg(""));
+	for (u32 i = 0; i < MAX_NUM; i++) {
+		pos_init.add(f32x3_init(dist(rng), dist(rng) + 10.0f, dist(rng)));
+		vel_init.add(f32x3_init(dist(rng), dist(rng), dist(rng)));
+	}
+	SFZ_BENCH_PRINT("ns per particle; aos = scalar loop over SfzArray<f32x3>, wide = f32x3_soa8 with AoS <-> SoA "
+		"conversion, soa = f32x8w over separate x/y/z arrays (no conversion)");
+
+	for (u32 num = 1024; num <= MAX_NUM; num *= 8) {
+		const u32 num_reps = u32(u64_max(3, (64ull << 20) / num));
+		SfzArray<f32x3> pos(num, &allocator, sfz_dbg(""));
+		SfzArray<f32x3> vel(num, &allocator, sfz_dbg(""));
+		pos.add(pos_init.data(), num);
+		vel.add(vel_init.data(), num);
+		SfzArray<f32x3> pos_wide(num, &allocator, sfz_dbg(""));
+		SfzArray<f32x3> vel_wide(num, &allocator, sfz_dbg(""));
+		pos_wide.add(pos_init.data(), num);
+		vel_wide.add(vel_init.data(), num);
+
+		// Native SoA storage, num is a multiple of 8
+		std::vector<f32> soa[6];
+		for (std::vector<f32>& v : soa) v.resize(num);
+		for (u32 i = 0; i < num; i++) {
+			for (u32 k = 0; k < 3; k++) {
+				soa[k][i] = pos_init[i][k];
+				soa[3 + k][i] = vel_init[i][k];
+			}
+		}
+		const f32x8w dt = f32x8w_splat(PARTICLE_DT);
+		const f32x8w zero = f32x8w_zero();
+		const f32x8w gravity_dt_y = f32x8w_splat(PARTICLE_GRAVITY.y * PARTICLE_DT);
+		auto updateSoA = [&]() {
+			f32* px = soa[0].data(); f32* py = soa[1].data(); f32* pz = soa[2].data();
+			f32* vx = soa[3].data(); f32* vy = soa[4].data(); f32* vz = soa[5].data();
+			for (u32 i = 0; i < num; i += 8) {
+				const f32x8w vx_i = f32x8w_load(vx + i);
+				f32x8w vy_i = f32x8w_load(vy + i) + gravity_dt_y;
+				const f32x8w vz_i = f32x8w_load(vz + i);
+				f32x8w py_i = f32x8w_load(py + i) + vy_i * dt;
+				const mask8w below = py_i < zero;
+				py_i = f32x8w_select(below, zero, py_i);
+				vy_i = f32x8w_select(below, -vy_i, vy_i);
+				f32x8w_store(px + i, f32x8w_load(px + i) + vx_i * dt);
+				f32x8w_store(py + i, py_i);
+				f32x8w_store(pz + i, f32x8w_load(pz + i) + vz_i * dt);
+				f32x8w_store(vy + i, vy_i);
+			}
+		};
+
+		const f64 aos_ns = sfzBenchMs(num_reps, [&]() { particleUpdateAoS(pos.data(), vel.data(), num); }) * 1e6 / num;
+		const f64 wide_ns = sfzBenchMs(num_reps, [&]() { particleUpdateWide(pos_wide, vel_wide); }) * 1e6 / num;
+		const f64 soa_ns = sfzBenchMs(num_reps, updateSoA) * 1e6 / num;
+		SFZ_BENCH_PRINT("%8u particles: aos %.3f ns  wide %.3f ns (%.2fx)  soa %.3f ns (%.2fx)",
+			num, aos_ns, wide_ns, aos_ns / wide_ns, soa_ns, aos_ns / soa_ns);
+
+		// All three ran the same number of steps (warmup included) from the same start
+		bool all_equal = true;
+		for (u32 i = 0; i < num; i++) {
+			all_equal = all_equal && pos[i] == pos_wide[i] && vel[i] == vel_wide[i];
+			all_equal = all_equal && pos[i].y == soa[1][i] && vel[i].y == soa[4][i];
+		}
+		CHECK(all_equal);
+	}
+}
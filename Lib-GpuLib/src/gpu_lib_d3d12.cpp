@@ -1745,8 +1745,9 @@ sfz_extern_c void gpuQueueMemcpyUpload(GpuLib* gpu, GpuPtr dst, const void* src,
 		return;
 	}
 
-	// Memcpy data to upload heap and commit change
-	memcpy(gpu->upload_heap_mapped_ptr + range_alloc.begin_mapped, src, num_bytes);
+	// Memcpy data to upload heap and commit change. The upload heap is write-combined memory which
+	// the CPU never reads back, so use streaming stores to avoid polluting the caches.
+	sfzMemcpyStream(gpu->upload_heap_mapped_ptr + range_alloc.begin_mapped, src, num_bytes);
 	gpu->upload_heap_offset = range_alloc.end;
 
 	// Ensure heap is in COPY_DEST state
@@ -1878,10 +1879,15 @@ sfz_extern_c void gpuQueueMemcpyUploadTexMip(
 	const u32 dst_pitch = footprint.Footprint.RowPitch;
 	const u32 src_pitch = mip_dims.x * formatToPixelSize(format);
 	sfz_assert(src_pitch <= row_size_bytes);
-	for (i32 y = 0; y < mip_dims.y; y++) {
-		u8* dst_row = dst_img + dst_pitch * u32(y);
-		const u8* src_row = static_cast<const u8*>(src) + src_pitch * u32(y);
-		memcpy(dst_row, src_row, src_pitch);
+	if (dst_pitch == src_pitch) {
+		sfzMemcpyStream(dst_img, src, u64(src_pitch) * u64(mip_dims.y));
+	}
+	else {
+		for (i32 y = 0; y < mip_dims.y; y++) {
+			u8* dst_row = dst_img + dst_pitch * u32(y);
+			const u8* src_row = static_cast<const u8*>(src) + src_pitch * u32(y);
+			sfzMemcpyStream(dst_row, src_row, src_pitch);
+		}
 	}
 	gpu->upload_heap_offset = range_alloc.end;
 
@@ -29,6 +29,7 @@
 #include <sfz_math.h>
 #include <sfz_time.h>
 #include <skipifzero_arrays.hpp>
+#include <skipifzero_mem_stream.hpp>
 #include <skipifzero_pool.hpp>
 #include <skipifzero_strings.hpp>
 
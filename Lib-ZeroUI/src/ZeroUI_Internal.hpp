@@ -36,6 +36,9 @@
 // You should normally NOT include this if you are only using ZeroUI. Rather, this header is meant
 // for people who are extending ZeroUI and creating their own widgets.
 
+// ZuiID is compared bitwise, lets e.g. input_locks.findElement() use the SIMD search kernels.
+template<> struct SfzArraySimdTraits<ZuiID> { static constexpr bool BITWISE_EQ = true; static constexpr bool INTEGER = false; };
+
 // Draw context
 // ------------------------------------------------------------------------------------------------
 